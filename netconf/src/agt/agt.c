@@ -51,6 +51,7 @@ date         init     comment
 #include "agt_nmda.h"
 #include "agt_not.h"
 #include "agt_not_queue_notification_cb.h"
+#include "agt_nvstore.h"
 #include "agt_plock.h"
 #include "agt_proc.h"
 #include "agt_rpc.h"
@@ -59,6 +60,7 @@ date         init     comment
 #include "agt_state.h"
 #include "agt_sys.h"
 #include "agt_val.h"
+#include "agt_val_pool.h"
 #include "agt_time_filter.h"
 #include "agt_timer.h"
 #include "agt_util.h"
@@ -167,6 +169,14 @@ static void
     agt_profile.agt_accesscontrol_enum = AGT_ACMOD_ENFORCING;
     agt_profile.agt_system_sorted = AGT_DEF_SYSTEM_SORTED;
     agt_profile.agt_max_sessions = 1024;
+    agt_profile.agt_max_chunksize = SES_DEF_OUT_CHUNKSIZE;
+    agt_profile.agt_buffsize = SES_MSG_BUFFSIZE;
+    agt_profile.agt_max_buffsize = SES_MSG_DEF_MAX_BUFFSIZE;
+    agt_profile.agt_listen_backlog = AGT_DEF_LISTEN_BACKLOG;
+    agt_profile.agt_eventlog_dir = NULL;
+    agt_profile.agt_log_async = FALSE;
+    agt_profile.agt_nvstore_journal = FALSE;
+    agt_profile.agt_validate_threads = AGT_VAL_POOL_DEF_THREADS;
 
 } /* init_server_profile */
 
@@ -630,6 +640,15 @@ status_t
 
     /* initialize the server timer service */
     agt_timer_init();
+
+    /* initialize the NV-store journal before the startup load */
+    agt_nvstore_init(agt_profile.agt_nvstore_journal);
+
+    /* set up the commit validation threads */
+    res = agt_val_pool_init(agt_profile.agt_validate_threads);
+    if (res != NO_ERR) {
+        return res;
+    }
     
     /* initialize the RPC server callback structures */
     res = agt_rpc_init();
@@ -1108,6 +1127,9 @@ status_t
         }
     }
 
+    /* the loaded running config is what is in NV-store now */
+    agt_nvstore_init2();
+
     /* allow users to access the configuration databases now */
     cfg_set_state(NCX_CFGID_RUNNING, CFG_ST_READY);
 
@@ -1171,6 +1193,8 @@ void
 
         clean_server_profile();
         agt_acm_cleanup();
+        agt_nvstore_cleanup();
+        agt_val_pool_cleanup();
         agt_ncx_cleanup();
         agt_hello_cleanup();
         agt_cli_cleanup();
@@ -157,6 +157,9 @@ extern "C" {
 /* this is over-ridden by the --system-sorted CLI parameter */
 #define AGT_DEF_SYSTEM_SORTED     FALSE
 
+/* default --listen-backlog for the ncxserver socket */
+#define AGT_DEF_LISTEN_BACKLOG    128
+
 #define AGT_USER_VAR        (const xmlChar *)"user"
 
 #define AGT_URL_SCHEME_LIST (const xmlChar *)"file"
@@ -267,9 +270,17 @@ typedef struct agt_profile_t_ {
 
     /* yuma123 extended parameters */
     uint32              agt_max_sessions;
+    uint32              agt_max_chunksize;
+    uint32              agt_buffsize;
+    uint32              agt_max_buffsize;
+    uint32              agt_listen_backlog;
     const xmlChar      *agt_tcp_direct_address;
     int32               agt_tcp_direct_port;
     const xmlChar      *agt_ncxserver_sockname;
+    const xmlChar      *agt_eventlog_dir;
+    boolean             agt_log_async;
+    boolean             agt_nvstore_journal;
+    uint32              agt_validate_threads;
 
     /****** state variables; TBD: move out of profile ******/
 
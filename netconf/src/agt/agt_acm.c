@@ -23,6 +23,11 @@ date         init     comment
 20feb10      abb      add enable-nacm leaf and notification-rules
                       change indexing to user-ordered rule-name
                       instead of allowed-rights bits field
+17oct26               compile data rules per user into a schema
+                      node index instead of evaluating every rule
+                      path for each node checked
+17oct26               share one cache between all the sessions of
+                      a user; versioned by a NACM config generation
 
 *********************************************************************
 *                                                                   *
@@ -42,6 +47,7 @@ date         init     comment
 #include "agt_ses.h"
 #include "agt_util.h"
 #include "agt_val.h"
+#include "bobhash.h"
 #include "def_reg.h"
 #include "dlq.h"
 #include "ncx.h"
@@ -51,6 +57,7 @@ date         init     comment
 #include "ncxmod.h"
 #include "obj.h"
 #include "status.h"
+#include "tk.h"
 #include "val.h"
 #include "val_util.h"
 #include "xmlns.h"
@@ -137,6 +144,12 @@ static uint32         denied_data_writes_count;
 
 static agt_acm_cache_t  *notif_cache;
 
+/* Q of agt_acm_cache_t shared by the sessions of each user */
+static dlq_hdr_t         acm_cacheQ;
+
+/* bumped each time the /nacm config changes */
+static uint32            acm_generation;
+
 static boolean log_reads;
 
 static boolean log_writes;
@@ -328,6 +341,176 @@ static void
 }  /* free_datarule */
 
 
+/********************************************************************
+* FUNCTION find_objnode
+*
+* Find the entry for a schema node in a compiled data rule index
+*
+* INPUTS:
+*    ruleidx == rule index to check
+*    obj == object template to find
+*
+* RETURNS:
+*   pointer to the entry or NULL if not found
+*********************************************************************/
+static agt_acm_objnode_t *
+    find_objnode (const agt_acm_ruleidx_t *ruleidx,
+                  const obj_template_t *obj)
+{
+    agt_acm_objnode_t  *objnode;
+    uint32              hash;
+
+    if (ruleidx->hashsize == 0) {
+        return NULL;
+    }
+
+    hash = bobhash((const ub1 *)&obj, (ub4)sizeof(obj), 0);
+    for (objnode = ruleidx->buckets[hash & (ruleidx->hashsize - 1)];
+         objnode != NULL;
+         objnode = objnode->next) {
+        if (objnode->obj == obj) {
+            return objnode;
+        }
+    }
+    return NULL;
+
+}  /* find_objnode */
+
+
+/********************************************************************
+* FUNCTION grow_ruleidx
+*
+* Double the hash table size in a compiled data rule index
+*
+* INPUTS:
+*    ruleidx == rule index to resize
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    grow_ruleidx (agt_acm_ruleidx_t *ruleidx)
+{
+    agt_acm_objnode_t  **newbuckets, *objnode, *nextnode;
+    uint32               newsize, hash, i;
+
+    newsize = (ruleidx->hashsize) ? 
+        ruleidx->hashsize * 2 : ACM_OBJIDX_HASHSIZE;
+
+    newbuckets = m__getMem(newsize * sizeof(agt_acm_objnode_t *));
+    if (!newbuckets) {
+        return ERR_INTERNAL_MEM;
+    }
+    memset(newbuckets, 0x0, newsize * sizeof(agt_acm_objnode_t *));
+
+    for (i = 0; i < ruleidx->hashsize; i++) {
+        for (objnode = ruleidx->buckets[i];
+             objnode != NULL;
+             objnode = nextnode) {
+            nextnode = objnode->next;
+            hash = bobhash((const ub1 *)&objnode->obj,
+                           (ub4)sizeof(objnode->obj), 0);
+            objnode->next = newbuckets[hash & (newsize - 1)];
+            newbuckets[hash & (newsize - 1)] = objnode;
+        }
+    }
+
+    if (ruleidx->buckets) {
+        m__free(ruleidx->buckets);
+    }
+    ruleidx->buckets = newbuckets;
+    ruleidx->hashsize = newsize;
+    return NO_ERR;
+
+}  /* grow_ruleidx */
+
+
+/********************************************************************
+* FUNCTION add_objnode
+*
+* Get the entry for a schema node in a compiled data rule index
+* The entry is created if it does not exist yet
+*
+* INPUTS:
+*    ruleidx == rule index to use
+*    obj == object template to find or add
+*    res == address of return status
+*
+* OUTPUTS:
+*    *res == return status
+*
+* RETURNS:
+*   pointer to the entry or NULL if malloc error
+*********************************************************************/
+static agt_acm_objnode_t *
+    add_objnode (agt_acm_ruleidx_t *ruleidx,
+                 const obj_template_t *obj,
+                 status_t *res)
+{
+    agt_acm_objnode_t  *objnode;
+    uint32              hash;
+
+    *res = NO_ERR;
+
+    objnode = find_objnode(ruleidx, obj);
+    if (objnode) {
+        return objnode;
+    }
+
+    if (ruleidx->nodecnt >= ruleidx->hashsize) {
+        *res = grow_ruleidx(ruleidx);
+        if (*res != NO_ERR) {
+            return NULL;
+        }
+    }
+
+    objnode = m__getObj(agt_acm_objnode_t);
+    if (!objnode) {
+        *res = ERR_INTERNAL_MEM;
+        return NULL;
+    }
+    memset(objnode, 0x0, sizeof(agt_acm_objnode_t));
+    objnode->obj = obj;
+
+    hash = bobhash((const ub1 *)&obj, (ub4)sizeof(obj), 0);
+    objnode->next = ruleidx->buckets[hash & (ruleidx->hashsize - 1)];
+    ruleidx->buckets[hash & (ruleidx->hashsize - 1)] = objnode;
+    ruleidx->nodecnt++;
+    return objnode;
+
+}  /* add_objnode */
+
+
+/********************************************************************
+* FUNCTION clean_ruleidx
+*
+* Free all the entries in a compiled data rule index
+*
+* INPUTS:
+*    ruleidx == rule index to clean
+*********************************************************************/
+static void
+    clean_ruleidx (agt_acm_ruleidx_t *ruleidx)
+{
+    agt_acm_objnode_t  *objnode, *nextnode;
+    uint32              i;
+
+    for (i = 0; i < ruleidx->hashsize; i++) {
+        for (objnode = ruleidx->buckets[i];
+             objnode != NULL;
+             objnode = nextnode) {
+            nextnode = objnode->next;
+            m__free(objnode);
+        }
+    }
+    if (ruleidx->buckets) {
+        m__free(ruleidx->buckets);
+    }
+    memset(ruleidx, 0x0, sizeof(agt_acm_ruleidx_t));
+
+}  /* clean_ruleidx */
+
+
 /********************************************************************
 * FUNCTION new_group_ptr
 *
@@ -613,6 +796,7 @@ static agt_acm_cache_t  *
     }
     acm_cache->mode = acmode;
     acm_cache->flags = FL_ACM_CACHE_VALID;
+    acm_cache->generation = acm_generation;
     return acm_cache;
 
 } /* new_acm_cache */
@@ -645,17 +829,114 @@ static void
             dlq_deque(&acm_cache->dataruleQ[i]);
             free_datarule(datarule);
         }
+        clean_ruleidx(&acm_cache->ruleidx[i]);
     }
 
     if (acm_cache->usergroups) {
         free_usergroups(acm_cache->usergroups);
     }
 
+    if (acm_cache->username) {
+        m__free(acm_cache->username);
+    }
+
     m__free(acm_cache);
 
 } /* free_acm_cache */
 
 
+/********************************************************************
+* FUNCTION cache_is_current
+*
+* Check if an agt_acm_cache_t struct can still be used
+*
+* INPUTS:
+*   acm_cache == cache struct to check
+*
+* RETURNS:
+*   TRUE if the cache is valid and the NACM config has not
+*   changed since it was created; FALSE otherwise
+*********************************************************************/
+static boolean
+    cache_is_current (const agt_acm_cache_t *acm_cache)
+{
+    return ((acm_cache->flags & FL_ACM_CACHE_VALID) &&
+            acm_cache->generation == acm_generation) ? TRUE : FALSE;
+
+} /* cache_is_current */
+
+
+/********************************************************************
+* FUNCTION release_shared_cache
+*
+* Release 1 session reference to a shared cache
+* The cache is freed when the last session lets go of it
+*
+* INPUTS:
+*   acm_cache == cache struct to release
+*********************************************************************/
+static void
+    release_shared_cache (agt_acm_cache_t *acm_cache)
+{
+    if (acm_cache->refcnt > 0) {
+        acm_cache->refcnt--;
+    }
+    if (acm_cache->refcnt == 0) {
+        dlq_remove(acm_cache);
+        free_acm_cache(acm_cache);
+    }
+
+} /* release_shared_cache */
+
+
+/********************************************************************
+* FUNCTION get_shared_cache
+*
+* Get the current shared cache for a user, or create one
+* Stale caches are skipped; they are freed when the sessions
+* still holding them move to the new one
+*
+* INPUTS:
+*   username == user name for the session; may be NULL
+*
+* RETURNS:
+*   cache with a new reference added or NULL if malloc error
+*********************************************************************/
+static agt_acm_cache_t *
+    get_shared_cache (const xmlChar *username)
+{
+    agt_acm_cache_t  *acm_cache;
+
+    if (username == NULL) {
+        username = NCX_EL_NONE;
+    }
+
+    for (acm_cache = (agt_acm_cache_t *)dlq_firstEntry(&acm_cacheQ);
+         acm_cache != NULL;
+         acm_cache = (agt_acm_cache_t *)dlq_nextEntry(acm_cache)) {
+        if (cache_is_current(acm_cache) &&
+            !xml_strcmp(acm_cache->username, username)) {
+            acm_cache->refcnt++;
+            return acm_cache;
+        }
+    }
+
+    acm_cache = new_acm_cache();
+    if (acm_cache == NULL) {
+        return NULL;
+    }
+    acm_cache->username = xml_strdup(username);
+    if (acm_cache->username == NULL) {
+        free_acm_cache(acm_cache);
+        return NULL;
+    }
+    acm_cache->refcnt = 1;
+    dlq_enque(acm_cache, &acm_cacheQ);
+    return acm_cache;
+
+} /* get_shared_cache */
+
+
 /********************************************************************
 * FUNCTION check_access_bit
 *
@@ -1251,18 +1532,334 @@ static unsigned int get_rule_queue_access_id(const char* access_str)
     }
 }
 
+/********************************************************************
+* FUNCTION clean_data_rules
+*
+* Remove all the compiled data rules from the cache
+*
+* INPUTS:
+*    cache == agt_acm cache to clean
+*********************************************************************/
+static void
+    clean_data_rules (agt_acm_cache_t *cache)
+{
+    agt_acm_datarule_t  *datarule;
+    int                  i;
+
+    for (i = 0; i < DATA_RULE_QUEUE_NUM; i++) {
+        while (!dlq_empty(&cache->dataruleQ[i])) {
+            datarule = (agt_acm_datarule_t *)
+                dlq_deque(&cache->dataruleQ[i]);
+            free_datarule(datarule);
+        }
+        clean_ruleidx(&cache->ruleidx[i]);
+    }
+    cache->flags &= ~(FL_ACM_DATARULES_SET | FL_ACM_XPATHRES_SET);
+
+}  /* clean_data_rules */
+
+
+/********************************************************************
+* FUNCTION find_rule_target
+*
+* Resolve a rule path to a schema node if it is path-only;
+* an absolute location path of module-qualified child steps
+* with no predicates, like /if:interfaces/if:interface
+*
+* INPUTS:
+*    pcb == parsed XPath for the rule path
+*    isroot == address of return root path flag
+*
+* OUTPUTS:
+*    *isroot == TRUE if the path is just '/'
+*
+* RETURNS:
+*   the target object template or NULL if the path needs
+*   to be evaluated as an XPath expression
+*********************************************************************/
+static obj_template_t *
+    find_rule_target (const xpath_pcb_t *pcb,
+                      boolean *isroot)
+{
+    tk_token_t      *tk;
+    obj_template_t  *obj;
+    ncx_module_t    *mod;
+    boolean          wantslash;
+
+    *isroot = FALSE;
+
+    if (!pcb->tkc) {
+        return NULL;
+    }
+
+    obj = NULL;
+    wantslash = TRUE;
+    for (tk = (tk_token_t *)dlq_firstEntry(&pcb->tkc->tkQ);
+         tk != NULL;
+         tk = (tk_token_t *)dlq_nextEntry(tk)) {
+
+        if (wantslash) {
+            if (tk->typ != TK_TT_FSLASH) {
+                return NULL;
+            }
+            wantslash = FALSE;
+            continue;
+        }
+
+        if (tk->typ != TK_TT_MSTRING || tk->nsid == 0) {
+            return NULL;
+        }
+
+        mod = (ncx_module_t *)xmlns_get_modptr(tk->nsid);
+        if (!mod) {
+            return NULL;
+        }
+
+        if (obj) {
+            obj = obj_find_child(obj, ncx_get_modname(mod), tk->val);
+        } else {
+            obj = obj_find_template_top(mod, ncx_get_modname(mod),
+                                        tk->val);
+        }
+        if (!obj || !obj_is_data_db(obj)) {
+            return NULL;
+        }
+        wantslash = TRUE;
+    }
+
+    if (!obj && !wantslash) {
+        /* the path is a single '/' */
+        *isroot = TRUE;
+    } else if (!wantslash) {
+        /* path ended with a '/' */
+        obj = NULL;
+    }
+    return obj;
+
+}  /* find_rule_target */
+
+
+/********************************************************************
+* FUNCTION add_rule_target
+*
+* Add the target of a path-only rule to the rule index
+* The target and all its ancestors get an index entry
+*
+* INPUTS:
+*    ruleidx == rule index to use
+*    targobj == object template selected by the rule
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_rule_target (agt_acm_ruleidx_t *ruleidx,
+                     obj_template_t *targobj)
+{
+    agt_acm_objnode_t  *objnode;
+    obj_template_t     *obj;
+    status_t            res;
+
+    objnode = add_objnode(ruleidx, targobj, &res);
+    if (!objnode) {
+        return res;
+    }
+    objnode->flags |= FL_ACM_OBJ_TARGET;
+
+    for (obj = obj_get_real_parent(targobj);
+         obj != NULL && !obj_is_root(obj);
+         obj = obj_get_real_parent(obj)) {
+        objnode = add_objnode(ruleidx, obj, &res);
+        if (!objnode) {
+            return res;
+        }
+        objnode->flags |= FL_ACM_OBJ_ANCESTOR;
+    }
+    return NO_ERR;
+
+}  /* add_rule_target */
+
+
+/********************************************************************
+* FUNCTION get_obj_match
+*
+* Check if a schema node is a path-only rule target or is
+* nested within one; the answer is saved in the rule index
+* so each object template is only checked once
+*
+* INPUTS:
+*    ruleidx == rule index to use
+*    obj == object template to check
+*
+* RETURNS:
+*   TRUE if the path-only rules select this object
+*   FALSE otherwise
+*********************************************************************/
+static boolean
+    get_obj_match (agt_acm_ruleidx_t *ruleidx,
+                   obj_template_t *obj)
+{
+    agt_acm_objnode_t  *objnode;
+    obj_template_t     *parent;
+    boolean             match;
+    status_t            res;
+
+    objnode = find_objnode(ruleidx, obj);
+    if (objnode) {
+        if (objnode->flags & FL_ACM_OBJ_DONE) {
+            return (objnode->flags & FL_ACM_OBJ_MATCH) ? TRUE : FALSE;
+        }
+        if (objnode->flags & FL_ACM_OBJ_TARGET) {
+            objnode->flags |= (FL_ACM_OBJ_DONE | FL_ACM_OBJ_MATCH);
+            return TRUE;
+        }
+    }
+
+    parent = obj_get_real_parent(obj);
+    if (parent == NULL || obj_is_root(parent)) {
+        match = FALSE;
+    } else {
+        match = get_obj_match(ruleidx, parent);
+    }
+
+    /* the verdict is only a shortcut so a malloc failure
+     * here just means it gets computed again next time
+     */
+    if (!objnode) {
+        objnode = add_objnode(ruleidx, obj, &res);
+    }
+    if (objnode) {
+        objnode->flags |= FL_ACM_OBJ_DONE;
+        if (match) {
+            objnode->flags |= FL_ACM_OBJ_MATCH;
+        }
+    }
+    return match;
+
+}  /* get_obj_match */
+
+
+/********************************************************************
+* FUNCTION find_any_obj
+*
+* Find the anyxml or anydata object for the top node of
+* some anyxml contents; that node has a generic object template
+*
+* INPUTS:
+*    parent == closest ancestor with a real schema node
+*    anyval == child of parent that has a generic object template
+*
+* RETURNS:
+*   pointer to the anyxml or anydata object
+*   NULL if not found
+*********************************************************************/
+static obj_template_t *
+    find_any_obj (const val_value_t *parent,
+                  const val_value_t *anyval)
+{
+    const xmlChar  *modname;
+    ncx_module_t   *mod;
+    obj_template_t *obj;
+
+    modname = xmlns_get_module(val_get_nsid(anyval));
+    if (modname == NULL) {
+        return NULL;
+    }
+
+    if (obj_is_root(parent->obj)) {
+        mod = ncx_find_module(modname, NULL);
+        obj = (mod) ? ncx_find_object(mod, anyval->name) : NULL;
+    } else {
+        obj = obj_find_child(parent->obj, modname, anyval->name);
+    }
+
+    if (obj && (obj->objtype == OBJ_TYP_ANYXML ||
+                obj->objtype == OBJ_TYP_ANYDATA)) {
+        return obj;
+    }
+    return NULL;
+
+}  /* find_any_obj */
+
+
+/********************************************************************
+* FUNCTION check_path_rules
+*
+* Check the path-only rules in the rule index for a value node
+*
+* INPUTS:
+*    ruleidx == rule index to use
+*    val == value node requested
+*    isread == TRUE if this is a read access check
+*
+* RETURNS:
+*   TRUE if a path-only rule matches the node
+*   FALSE otherwise
+*********************************************************************/
+static boolean
+    check_path_rules (agt_acm_ruleidx_t *ruleidx,
+                      const val_value_t *val,
+                      boolean isread)
+{
+    const agt_acm_objnode_t  *objnode;
+    const val_value_t        *anyval;
+    obj_template_t           *obj;
+
+    if (ruleidx->nodecnt == 0) {
+        return FALSE;
+    }
+
+    /* anyxml contents use generic object templates, including
+     * the anyxml node itself, so find the anyxml object
+     * above them and use the rules for that object
+     */
+    anyval = NULL;
+    while (val->parent &&
+           (val_get_nsid(val) != obj_get_nsid(val->obj) ||
+            xml_strcmp(val->name, obj_get_name(val->obj)))) {
+        anyval = val;
+        val = val->parent;
+    }
+    if (anyval) {
+        obj = find_any_obj(val, anyval);
+        if (obj) {
+            return get_obj_match(ruleidx, obj);
+        }
+    }
+    if (obj_is_root(val->obj)) {
+        return FALSE;
+    }
+
+    /* a read of a node above a rule target is allowed
+     * so the target can be reached
+     */
+    if (isread && !anyval) {
+        objnode = find_objnode(ruleidx, val->obj);
+        if (objnode && (objnode->flags & FL_ACM_OBJ_ANCESTOR)) {
+            return TRUE;
+        }
+    }
+
+    return get_obj_match(ruleidx, val->obj);
+
+}  /* check_path_rules */
+
+
 /********************************************************************
 * FUNCTION cache_data_rules
 *
-* Cache the data rules.
-* -- If there is a failure partway through caching the items
-*    all the new datarules will be deleted
-* -- Do not set the flag unless the entire operation succeeds
+* Compile the data rules for the groups this user is in.
+* -- Each rule is checked against the user groups and the
+*    access-operations once, and the path-only rules are
+*    resolved into the schema node index for each access type
+* -- This is kept until the /nacm config changes and the
+*    cache is invalidated
 * -- On failure remove all added datarules
 *
 * INPUTS:
 *    cache == agt_acm cache to use
 *    nacmroot == /nacm node
+*    usergroups == user-to-group mapping for access processing
 *
 * OUTPUTS:
 *    *cache is modified with the cached datarules items.
@@ -1273,56 +1870,33 @@ static unsigned int get_rule_queue_access_id(const char* access_str)
 *********************************************************************/
 static status_t
     cache_data_rules( agt_acm_cache_t *cache,
-                      val_value_t *nacmroot)
+                      val_value_t *nacmroot,
+                      agt_acm_usergroups_t *usergroups)
 {
     status_t            res = NO_ERR;
     val_value_t         *rule, *rule_list;
-    val_value_t         *valroot;
     int                 i;
 
     if (cache->flags & FL_ACM_DATARULES_SET) {
-        // datarules have already been already cached, return no error
-        //return NO_ERR;
-
-
-        /* regenerate all cached datarules since no mechanism for updating config=false rules is in place yet */
-        agt_acm_datarule_t  *freerule;
-        for(i=0;i<DATA_RULE_QUEUE_NUM;i++) {
-            while (!dlq_empty(&cache->dataruleQ[i])) {
-                freerule = (agt_acm_datarule_t *)dlq_deque(&cache->dataruleQ[i]);
-                if (freerule) {
-                    free_datarule(freerule);
-                } else {
-                    return SET_ERROR(ERR_INTERNAL_VAL);
-                }
-            }
-        }
-    }
-
-    /* the /nacm node is supposed to be a child of <config> */
-    valroot = nacmroot->parent;
-    if (!valroot || !obj_is_root(valroot->obj)) 
-    {
-        return SET_ERROR(ERR_INTERNAL_VAL);
+        return NO_ERR;
     }
 
 for ( rule_list = val_find_child( nacmroot, AGT_ACM_MODULE, 
                                      nacm_N_ruleList );
-          rule_list != NULL;
+          rule_list != NULL && res == NO_ERR;
           rule_list = val_find_next_child( rule_list, AGT_ACM_MODULE,
                                           nacm_N_ruleList, rule_list ) ) {
     /* check all the rule entries */
     for ( rule = val_find_child( rule_list, AGT_ACM_MODULE, 
                                      nacm_N_rule );
-          rule != NULL;
+          rule != NULL && res == NO_ERR;
           rule = val_find_next_child( rule_list, AGT_ACM_MODULE,
                                           nacm_N_rule, rule ) ) 
     {
         val_value_t         *path;
         val_value_t         *access_operations;
-        xpath_pcb_t         *pcb;
-        xpath_result_t      *result;
-
+        obj_template_t      *targobj;
+        boolean              isroot;
 
         /* get the XPath expression leaf */
         path = val_find_child( rule, AGT_ACM_MODULE, nacm_N_path );
@@ -1335,71 +1909,157 @@ for ( rule_list = val_find_child( nacmroot, AGT_ACM_MODULE,
             continue;
         }
 
+        if (!check_rule_group(rule, usergroups)) {
+            continue;
+        }
+
+        targobj = find_rule_target(path->xpathpcb, &isroot);
+
         for(i=0;i<DATA_RULE_QUEUE_NUM;i++) {
+            agt_acm_datarule_t  *datarule_cache;
+            agt_acm_ruleidx_t   *ruleidx = &cache->ruleidx[i];
 
-            /* make sure the source is not XML so the defunct reader
-             * does not get accessed; the clone should save the
-             * NSID bindings in all the tokens
-             */
             if((0!=strcmp("*",VAL_STRING(access_operations))) && (NULL==strstr(get_rule_queue_access_str(i),VAL_STRING(access_operations)))) {
                 continue;
             }
 
-            pcb = xpath_clone_pcb( path->xpathpcb );
-            if(!pcb) {
+            datarule_cache = new_datarule(NULL, NULL, rule);
+            if ( !datarule_cache ) {
                 res = ERR_INTERNAL_MEM;
                 break;
             }
+            datarule_cache->targobj = targobj;
+            dlq_enque( datarule_cache, &cache->dataruleQ[i] );
+            ruleidx->rulecnt++;
+
+            if (isroot) {
+                ruleidx->matchall = TRUE;
+            } else if (targobj) {
+                res = add_rule_target(ruleidx, targobj);
+                if (res != NO_ERR) {
+                    break;
+                }
+            } else {
+                ruleidx->xpathcnt++;
+            }
+        }
+    }
+}
+    if (res == NO_ERR) {
+        cache->flags |= FL_ACM_DATARULES_SET;
+    } else {
+        clean_data_rules(cache);
+        log_error("\nError: cache NACM data rules failed! (%s)",
+                  get_error_string(res));
+    }
 
-            pcb->source = XP_SRC_YANG;
-            result = xpath1_eval_expr( pcb, valroot, valroot, FALSE,
-                                       (i==DATA_RULE_QUEUE_READ)?FALSE:TRUE /*configonly*/, &res );
-            if ( !result ) {
-                res = ERR_INTERNAL_MEM;
-                xpath_free_pcb(pcb);
+    return res;
+}
+
+
+/********************************************************************
+* FUNCTION eval_data_rules
+*
+* Evaluate the data rules that are not path-only.
+* The result node-sets depend on the data, including
+* config=false nodes, so this is done once per message
+*
+* INPUTS:
+*    cache == agt_acm cache to use
+*    nacmroot == /nacm node
+*
+* OUTPUTS:
+*    datarule->pcb and datarule->result set for each XPath rule
+*
+* RETURNS:
+*    NO_ERR on success or an error if the operation failed.
+*
+*********************************************************************/
+static status_t
+    eval_data_rules (agt_acm_cache_t *cache,
+                     val_value_t *nacmroot)
+{
+    agt_acm_datarule_t  *datarule_cache;
+    val_value_t         *valroot, *path;
+    xpath_pcb_t         *pcb;
+    xpath_result_t      *result;
+    status_t             res = NO_ERR;
+    int                  i;
+
+    if (cache->flags & FL_ACM_XPATHRES_SET) {
+        return NO_ERR;
+    }
+
+    /* the /nacm node is supposed to be a child of <config> */
+    valroot = nacmroot->parent;
+    if (!valroot || !obj_is_root(valroot->obj)) 
+    {
+        return SET_ERROR(ERR_INTERNAL_VAL);
+    }
+
+    for (i = 0; i < DATA_RULE_QUEUE_NUM && res == NO_ERR; i++) {
+        if (cache->ruleidx[i].xpathcnt == 0) {
+            continue;
+        }
+
+        for (datarule_cache = (agt_acm_datarule_t *)
+                 dlq_firstEntry(&cache->dataruleQ[i]);
+             datarule_cache != NULL && res == NO_ERR;
+             datarule_cache = (agt_acm_datarule_t *)
+                 dlq_nextEntry(datarule_cache)) {
+
+            if (datarule_cache->targobj) {
+                continue;
+            }
+
+            xpath_free_result(datarule_cache->result);
+            datarule_cache->result = NULL;
+            xpath_free_pcb(datarule_cache->pcb);
+            datarule_cache->pcb = NULL;
+
+            path = val_find_child(datarule_cache->datarule, 
+                                  AGT_ACM_MODULE, nacm_N_path);
+            if (!path || !path->xpathpcb) {
+                res = SET_ERROR(ERR_INTERNAL_VAL);
                 break;
             }
 
-            if ( res == NO_ERR) {
-                agt_acm_datarule_t  *datarule_cache;
-                datarule_cache = new_datarule(pcb, result, rule);
-                if ( datarule_cache ) {
-                    /* pass off 'pcb' and 'result' memory here */
-                    dlq_enque( datarule_cache, &cache->dataruleQ[i] );
-                } else {
-                    res = ERR_INTERNAL_MEM;
-                }
+            /* make sure the source is not XML so the defunct reader
+             * does not get accessed; the clone should save the
+             * NSID bindings in all the tokens
+             */
+            pcb = xpath_clone_pcb(path->xpathpcb);
+            if (!pcb) {
+                res = ERR_INTERNAL_MEM;
+                break;
             }
 
-            if ( res != NO_ERR ) {
-                xpath_free_pcb( pcb );
-                xpath_free_result( result );
+            pcb->source = XP_SRC_YANG;
+            result = xpath1_eval_expr(pcb, valroot, valroot, FALSE,
+                                      (i==DATA_RULE_QUEUE_READ) ? 
+                                      FALSE : TRUE /*configonly*/, &res);
+            if (!result) {
+                res = ERR_INTERNAL_MEM;
+                xpath_free_pcb(pcb);
                 break;
             }
+
+            /* pass off 'pcb' and 'result' memory here */
+            datarule_cache->pcb = pcb;
+            datarule_cache->result = result;
         }
     }
-}
+
     if (res == NO_ERR) {
-        cache->flags |= FL_ACM_DATARULES_SET;
+        cache->flags |= FL_ACM_XPATHRES_SET;
     } else {
-        for(i=0;i<DATA_RULE_QUEUE_NUM;i++) {
-
-            agt_acm_datarule_t  *freerule;
-            while (!dlq_empty(&cache->dataruleQ[i])) {
-                freerule = (agt_acm_datarule_t *)dlq_deque(&cache->dataruleQ[i]);
-                if (freerule) {
-                    free_datarule(freerule);
-                } else {
-                    SET_ERROR(ERR_INTERNAL_VAL);
-                }
-            }
-            log_error("\nError: cache NACM data rules failed! (%s)",
-                      get_error_string(res));
-        }
+        log_error("\nError: evaluate NACM data rules failed! (%s)",
+                  get_error_string(res));
     }
 
     return res;
-}
+
+} /* eval_data_rules */
 
 
 /********************************************************************
@@ -1437,60 +2097,67 @@ static boolean
 {
     dlq_hdr_t           *resnodeQ;
     agt_acm_datarule_t  *datarule_cache;
-    boolean              granted = FALSE;
+    agt_acm_ruleidx_t   *ruleidx;
     status_t             res = NO_ERR;
     int                  access_id;
     *done = FALSE;
 
     /* fill the dataruleQ in the cache if needed */
-#if 0
-    if (!(cache->flags & FL_ACM_DATARULES_SET)) 
-#else
-    if (1)
-#endif
+    res = cache_data_rules(cache, nacmroot, usergroups);
+    if ( res != NO_ERR )
     {
-        res = cache_data_rules( cache, nacmroot);
+        return FALSE;
+    }
+
+    access_id = get_rule_queue_access_id((const char *)access);
+    ruleidx = &cache->ruleidx[access_id];
+
+    if (ruleidx->rulecnt == 0) {
+        return FALSE;
+    }
+
+    if (ruleidx->matchall ||
+        ((access_id==DATA_RULE_QUEUE_UPDATE) && !obj_is_leaf(val->obj)) ||
+        check_path_rules(ruleidx, val,
+                         (access_id==DATA_RULE_QUEUE_READ) ? TRUE : FALSE)) {
+        *done = TRUE;
+        return TRUE;
+    }
+
+    if (ruleidx->xpathcnt == 0) {
+        return FALSE;
     }
 
+    res = eval_data_rules(cache, nacmroot);
     if ( res != NO_ERR )
     {
-        *done = FALSE;
         return FALSE;
     }
 
-    access_id = get_rule_queue_access_id(access);
+    /* go through the XPath rules and exit if any matches are found */
+    for ( datarule_cache = (agt_acm_datarule_t *) 
+              dlq_firstEntry(&cache->dataruleQ[access_id]);
+          datarule_cache != NULL;
+          datarule_cache = (agt_acm_datarule_t *) 
+              dlq_nextEntry(datarule_cache)) 
     {
+        if (datarule_cache->targobj || !datarule_cache->result) {
+            continue;
+        }
 
-        /* go through the cache and exit if any matches are found */
-        for ( datarule_cache = (agt_acm_datarule_t *) 
-                  dlq_firstEntry(&cache->dataruleQ[access_id]);
-              datarule_cache != NULL && !*done;
-              datarule_cache = (agt_acm_datarule_t *) 
-                  dlq_nextEntry(datarule_cache)) 
-        {
-            if(!check_rule_group (datarule_cache->datarule, usergroups)) {
-                continue;
-            }
-
-            resnodeQ = xpath_get_resnodeQ(datarule_cache->result);
-            assert(resnodeQ);
+        resnodeQ = xpath_get_resnodeQ(datarule_cache->result);
+        assert(resnodeQ);
 
-            if ( ((access_id==DATA_RULE_QUEUE_READ) && xpath1_check_node_child_exists_slow( datarule_cache->pcb,resnodeQ, val )) ||
-                 ((access_id==DATA_RULE_QUEUE_UPDATE) && !obj_is_leaf(val->obj)) ||
-                 xpath1_check_node_exists_slow( datarule_cache->pcb,
-                                                resnodeQ, val ))
-            {
-                *done = TRUE;
-                granted = TRUE;
-            }
+        if ( ((access_id==DATA_RULE_QUEUE_READ) && xpath1_check_node_child_exists_slow( datarule_cache->pcb,resnodeQ, val )) ||
+             xpath1_check_node_exists_slow( datarule_cache->pcb,
+                                            resnodeQ, val ))
+        {
+            *done = TRUE;
+            return TRUE;
         }
     }
 
-    if ( res != NO_ERR )
-    {
-        *done = TRUE;
-    } 
-    return granted;
+    return FALSE;
 
 } /* check_data_rules */
 
@@ -1976,7 +2643,11 @@ static status_t
             free_acm_cache(notif_cache);
             notif_cache = NULL;
         }
-        agt_ses_invalidate_session_acm_caches();
+
+        /* every session cache is stale now; each one gets
+         * replaced the next time its session uses it
+         */
+        acm_generation++;
     }
 
     return res;
@@ -2055,6 +2726,9 @@ static status_t
         default:
             res = SET_ERROR(ERR_INTERNAL_VAL);
         }
+
+        /* the cached mode in each session cache is stale */
+        acm_generation++;
         break;
     case AGT_CB_ROLLBACK:
         break;
@@ -2096,6 +2770,8 @@ status_t
 
     nacmmod = NULL;
     notif_cache = NULL;
+    dlq_createSQue(&acm_cacheQ);
+    acm_generation = 1;
 
     /* load in the access control parameters */
     res = ncxmod_load_module(AGT_ACM_MODULE, NULL, &agt_profile->agt_savedevQ,
@@ -2609,15 +3285,16 @@ boolean
 /********************************************************************
 * FUNCTION agt_acm_init_msg_cache
 *
-* Malloc and initialize an agt_acm_cache_t struct
-* and attach it to the incoming message
+* Attach the shared agt_acm_cache_t struct for the session user
+* to the incoming message; a new one is made if the NACM config
+* has changed since the session cache was set up
 *
 * INPUTS:
 *   scb == session control block to use
 *   msg == message to use
 *
 * OUTPUTS:
-*   scb->acm_cache pointer may be set, if it was NULL
+*   scb->acm_cache pointer may be set, if it was NULL or stale
 *   msg->acm_cache pointer set
 *
 * RETURNS:
@@ -2637,22 +3314,22 @@ status_t
 
     msg->acm_cbfn = agt_acm_val_read_allowed;
 
-    if (agt_acm_session_cache_valid(scb)) {
-        msg->acm_cache = scb->acm_cache;
-    } else {
+    if (!agt_acm_session_cache_valid(scb)) {
         if (scb->acm_cache != NULL) {
-            free_acm_cache(scb->acm_cache);
+            release_shared_cache(scb->acm_cache);
         }
-        scb->acm_cache = new_acm_cache();
-        msg->acm_cache = scb->acm_cache;
+        scb->acm_cache = get_shared_cache(scb->username);
     }
 
-    if (msg->acm_cache == NULL) {
+    if (scb->acm_cache == NULL) {
         return ERR_INTERNAL_MEM;
-    } else {
-        return NO_ERR;
     }
 
+    /* XPath data rule results are refreshed once per message */
+    scb->acm_cache->flags &= ~FL_ACM_XPATHRES_SET;
+    msg->acm_cache = scb->acm_cache;
+    return NO_ERR;
+
 } /* agt_acm_init_msg_cache */
 
 
@@ -2687,14 +3364,15 @@ void agt_acm_clear_msg_cache (xml_msg_hdr_t *msg)
 *   scb == sesion control block to use
 *
 * OUTPUTS:
-*   scb->acm_cache pointer is freed and set to NULL
+*   scb->acm_cache pointer is released and set to NULL
+*   the cache is freed if no other session is using it
 *
 *********************************************************************/
 void agt_acm_clear_session_cache (ses_cb_t *scb)
 {
     assert( scb && "scb is NULL!" );
     if (scb->acm_cache != NULL) {
-        free_acm_cache(scb->acm_cache);
+        release_shared_cache(scb->acm_cache);
         scb->acm_cache = NULL;
     }
 
@@ -2737,8 +3415,7 @@ boolean agt_acm_session_cache_valid (const ses_cb_t *scb)
 {
     assert( scb && "scb is NULL!" );
     if (scb->acm_cache != NULL) {
-        return (scb->acm_cache->flags 
-                & FL_ACM_CACHE_VALID) ? TRUE : FALSE;
+        return cache_is_current(scb->acm_cache);
     } else {
         return FALSE;
     }
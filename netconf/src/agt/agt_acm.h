@@ -30,6 +30,8 @@ date	     init     comment
 ----------------------------------------------------------------------
 03-feb-06    abb      Begun
 14-may-09    abb      add per-msg cache to speed up performance
+17-oct-26             compile data rules into a schema node index
+17-oct-26             share one cache between sessions of a user
 */
 
 #include <xmlstring.h>
@@ -90,6 +92,16 @@ extern "C" {
 #define FL_ACM_MODRULES_SET     bit6
 #define FL_ACM_DATARULES_SET    bit7
 #define FL_ACM_CACHE_VALID      bit8
+#define FL_ACM_XPATHRES_SET     bit9
+
+/* flags fields for the agt_acm_objnode_t */
+#define FL_ACM_OBJ_TARGET       bit0   /* path-only rule selects obj */
+#define FL_ACM_OBJ_ANCESTOR     bit1   /* obj is above a target */
+#define FL_ACM_OBJ_DONE         bit2   /* MATCH bit is set */
+#define FL_ACM_OBJ_MATCH        bit3   /* obj or an ancestor is a target */
+
+/* start size of the schema node index hash table; power of 2 */
+#define ACM_OBJIDX_HASHSIZE     64
 
 
 /********************************************************************
@@ -118,14 +130,38 @@ typedef struct agt_acm_modrule_t_ {
     val_value_t    *modrule;  /* back-ptr */
 } agt_acm_modrule_t;
 
-/* cache for 1 NACM dataRule entry */
+/* cache for 1 NACM dataRule entry
+ * a path-only rule is resolved to its schema node (targobj)
+ * and has no pcb or result; any other path is kept as
+ * an XPath expression and evaluated once per message
+ */
 typedef struct agt_acm_datarule_t_ {
     dlq_hdr_t           qhdr;
     xpath_pcb_t        *pcb;
     xpath_result_t     *result;
     val_value_t        *datarule;   /* back-ptr */
+    obj_template_t     *targobj;    /* back-ptr */
 } agt_acm_datarule_t;
 
+/* 1 schema node in the compiled data rule index */
+typedef struct agt_acm_objnode_t_ {
+    struct agt_acm_objnode_t_ *next;      /* hash chain */
+    const obj_template_t      *obj;       /* back-ptr, hash key */
+    uint32                     flags;     /* FL_ACM_OBJ_* */
+} agt_acm_objnode_t;
+
+/* compiled data rules for 1 access type, limited to the
+ * rules that apply to the groups the user is in
+ */
+typedef struct agt_acm_ruleidx_t_ {
+    uint32              rulecnt;      /* rules for the user's groups */
+    uint32              xpathcnt;     /* rules that are not path-only */
+    boolean             matchall;     /* a rule path selects '/' */
+    agt_acm_objnode_t **buckets;      /* hash table of objnodes */
+    uint32              hashsize;     /* power of 2 */
+    uint32              nodecnt;
+} agt_acm_ruleidx_t;
+
 /* NACM cache control block */
 #define DATA_RULE_QUEUE_READ 0
 #define DATA_RULE_QUEUE_UPDATE 1
@@ -133,7 +169,14 @@ typedef struct agt_acm_datarule_t_ {
 #define DATA_RULE_QUEUE_DELETE 3
 #define DATA_RULE_QUEUE_NUM 4
 
+/* 1 cache is shared by all the sessions of the same user;
+ * it is stale once its generation is behind the NACM config
+ */
 typedef struct agt_acm_cache_t_ {
+    dlq_hdr_t             qhdr;
+    xmlChar              *username;
+    uint32                refcnt;       /* sessions using this cache */
+    uint32                generation;   /* NACM config generation */
     agt_acm_usergroups_t *usergroups;
     val_value_t          *nacmroot;     /* back-ptr */
     val_value_t          *rulesval;     /* back-ptr */
@@ -142,6 +185,7 @@ typedef struct agt_acm_cache_t_ {
     agt_acmode_t          mode;
     dlq_hdr_t             modruleQ;     /* Q of agt_acm_modrule_t */
     dlq_hdr_t             dataruleQ[4];    /* Q of agt_acm_datarule_t */
+    agt_acm_ruleidx_t     ruleidx[4];      /* index for dataruleQ */
 } agt_acm_cache_t;
 
     
@@ -277,15 +321,16 @@ extern boolean
 /********************************************************************
 * FUNCTION agt_acm_init_msg_cache
 *
-* Malloc and initialize an agt_acm_cache_t struct
-* and attach it to the incoming message
+* Attach the shared agt_acm_cache_t struct for the session user
+* to the incoming message; a new one is made if the NACM config
+* has changed since the session cache was set up
 *
 * INPUTS:
 *   scb == session control block to use
 *   msg == message to use
 *
 * OUTPUTS:
-*   scb->acm_cache pointer may be set, if it was NULL
+*   scb->acm_cache pointer may be set, if it was NULL or stale
 *   msg->acm_cache pointer set
 *
 * RETURNS:
@@ -322,7 +367,8 @@ extern void
 *   scb == sesion control block to use
 *
 * OUTPUTS:
-*   scb->acm_cache pointer is freed and set to NULL
+*   scb->acm_cache pointer is released and set to NULL
+*   the cache is freed if no other session is using it
 *
 *********************************************************************/
 extern void agt_acm_clear_session_cache (ses_cb_t *scb);
@@ -506,6 +506,8 @@ agt_cfg_transaction_t *
     txcb->apply_res = ERR_NCX_SKIPPED;
     txcb->commit_res = ERR_NCX_SKIPPED;
     txcb->rollback_res = ERR_NCX_SKIPPED;
+    txcb->nvdelta = NULL;
+    txcb->nvbase_txid = 0;
 
     agt_profile_t *profile = agt_get_profile();
     if (profile->agt_config_state == AGT_CFG_STATE_BAD) {
@@ -568,6 +570,10 @@ void
         agt_cfg_free_nodeptr(nodeptr);
     }
 
+    if (txcb->nvdelta) {
+        val_free_value(txcb->nvdelta);
+    }
+
     m__free(txcb);
 
 }  /* agt_cfg_free_transaction */
@@ -838,6 +844,7 @@ agt_cfg_commit_test_t *
     agt_cfg_commit_test_t *commit_test = m__getObj(agt_cfg_commit_test_t);
     if (commit_test) {
         memset(commit_test, 0x0, sizeof(agt_cfg_commit_test_t));
+        dlq_createSQue(&commit_test->depQ);
     }
     return commit_test;
 
@@ -866,11 +873,67 @@ void
     if (commit_test->result) {
         xpath_free_result(commit_test->result);
     }
+    while (!dlq_empty(&commit_test->depQ)) {
+        agt_cfg_commit_dep_t *commit_dep = (agt_cfg_commit_dep_t *)
+            dlq_deque(&commit_test->depQ);
+        agt_cfg_free_commit_dep(commit_dep);
+    }
     m__free(commit_test);
 
 } /* agt_cfg_free_commit_test */
 
 
+/********************************************************************
+* FUNCTION agt_cfg_new_commit_dep
+*
+* Malloc a agt_cfg_commit_dep_t struct
+*
+* INPUTS:
+*    name == schema node name to copy into the record
+*
+* RETURNS:
+*   malloced commit dependency struct or NULL if ERR_INTERNAL_MEM
+*********************************************************************/
+agt_cfg_commit_dep_t *
+    agt_cfg_new_commit_dep (const xmlChar *name)
+{
+    agt_cfg_commit_dep_t *commit_dep = m__getObj(agt_cfg_commit_dep_t);
+    if (commit_dep == NULL) {
+        return NULL;
+    }
+    memset(commit_dep, 0x0, sizeof(agt_cfg_commit_dep_t));
+
+    commit_dep->name = xml_strdup(name);
+    if (commit_dep->name == NULL) {
+        m__free(commit_dep);
+        return NULL;
+    }
+    return commit_dep;
+
+} /* agt_cfg_new_commit_dep */
+
+
+/********************************************************************
+* FUNCTION agt_cfg_free_commit_dep
+*
+* Free a previously malloced agt_cfg_commit_dep_t struct
+*
+* INPUTS:
+*    commit_dep == commit dependency record to free
+*
+*********************************************************************/
+void
+    agt_cfg_free_commit_dep (agt_cfg_commit_dep_t *commit_dep)
+{
+    if (commit_dep == NULL) {
+        return;
+    }
+    m__free(commit_dep->name);
+    m__free(commit_dep);
+
+} /* agt_cfg_free_commit_dep */
+
+
 /********************************************************************
 * FUNCTION agt_cfg_new_nodeptr
 *
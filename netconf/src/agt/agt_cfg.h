@@ -150,6 +150,12 @@ typedef struct agt_cfg_transaction_t_ {
 
     /* contains nodes marked as deleted by the delete_dead_nodes test */
     dlq_hdr_t            deadnodeQ;   /* Q of agt_cfg_nodeptr_t */
+
+    /* NV-store journal record for this transaction, or NULL
+     * if the full config needs to be saved; nvbase_txid is the
+     * running config txid that the record applies to */
+    val_value_t         *nvdelta;
+    cfg_transaction_id_t nvbase_txid;
 } agt_cfg_transaction_t;
 
 
@@ -195,6 +201,18 @@ typedef struct agt_cfg_audit_rec_t_ {
 } agt_cfg_audit_rec_t;
 
 
+/* struct for one schema node name referenced by the XPath
+ * expressions of a commit test (must, when, leafref path)
+ */
+typedef struct agt_cfg_commit_dep_t_ {
+    dlq_hdr_t          qhdr;
+    xmlChar           *name;       /* local name of the node */
+    uint32             testflags;  /* AGT_TEST_FL_FOO bits using it */
+    boolean            isvalue;    /* node value is used, not just
+                                    * the node-set it selects */
+} agt_cfg_commit_dep_t;
+
+
 /* struct for the commit-time tests for a single object */
 typedef struct agt_cfg_commit_test_t_ {
     dlq_hdr_t          qhdr;
@@ -204,6 +222,11 @@ typedef struct agt_cfg_commit_test_t_ {
     cfg_transaction_id_t result_txid;
     ncx_btype_t        btyp;
     uint32             testflags;  /* AGT_TEST_FL_FOO bits */
+    dlq_hdr_t          depQ;       /* Q of agt_cfg_commit_dep_t */
+
+    /* AGT_TEST_FL_FOO bits for the XPath tests that can depend
+     * on any node, so the depQ cannot be used to prune them */
+    uint32             depallflags;
 } agt_cfg_commit_test_t;
 
 
@@ -403,6 +426,34 @@ extern void
     agt_cfg_free_commit_test (agt_cfg_commit_test_t *commit_test);
 
 
+/********************************************************************
+* FUNCTION agt_cfg_new_commit_dep
+*
+* Malloc a agt_cfg_commit_dep_t struct
+*
+* INPUTS:
+*    name == schema node name to copy into the record
+*
+* RETURNS:
+*   malloced commit dependency struct or NULL if ERR_INTERNAL_MEM
+*********************************************************************/
+extern agt_cfg_commit_dep_t *
+    agt_cfg_new_commit_dep (const xmlChar *name);
+
+
+/********************************************************************
+* FUNCTION agt_cfg_free_commit_dep
+*
+* Free a previously malloced agt_cfg_commit_dep_t struct
+*
+* INPUTS:
+*    commit_dep == commit dependency record to free
+*
+*********************************************************************/
+extern void
+    agt_cfg_free_commit_dep (agt_cfg_commit_dep_t *commit_dep);
+
+
 /********************************************************************
 * FUNCTION agt_cfg_new_nodeptr
 *
@@ -324,6 +324,30 @@ static void
         agt_profile->agt_max_sessions = VAL_UINT(val);
     }
 
+    /* get max-chunk-size param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_MAX_CHUNK_SIZE);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_max_chunksize = VAL_UINT(val);
+    }
+
+    /* get buffer-size param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_BUFFER_SIZE);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_buffsize = VAL_UINT(val);
+    }
+
+    /* get max-buffer-size param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_MAX_BUFFER_SIZE);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_max_buffsize = VAL_UINT(val);
+    }
+
+    /* get listen-backlog param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_LISTEN_BACKLOG);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_listen_backlog = VAL_UINT(val);
+    }
+
     val = val_find_child(valset,
                          AGT_CLI_MODULE_EX,
                          NCX_EL_TCP_DIRECT_PORT);
@@ -350,6 +374,30 @@ static void
         agt_profile->agt_ncxserver_sockname = NCXSERVER_SOCKNAME;
     }
 
+    /* get eventlog-dir param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_EVENTLOG_DIR);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_eventlog_dir = VAL_STR(val);
+    }
+
+    /* get log-async param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_LOG_ASYNC);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_log_async = TRUE;
+    }
+
+    /* get nvstore-journal param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_NVSTORE_JOURNAL);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_nvstore_journal = TRUE;
+    }
+
+    /* get validate-threads param */
+    val = val_find_child(valset, AGT_CLI_MODULE_EX, AGT_CLI_VALIDATE_THREADS);
+    if (val && val->res == NO_ERR) {
+        agt_profile->agt_validate_threads = VAL_UINT(val);
+    }
+
 } /* set_server_profile */
 
 
@@ -515,6 +563,16 @@ status_t
             }
         }
 
+        /* log-async param */
+        if (agt_profile->agt_log_async) {
+            res = log_async_start();
+            if (res != NO_ERR) {
+                log_error("\nError: start async logging failed (%s)",
+                          get_error_string(res));
+                return res;
+            }
+        }
+
         /* set the file search path parms */
         res = val_set_path_parms(valset);
         if (res != NO_ERR) {
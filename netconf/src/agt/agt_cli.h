@@ -78,6 +78,22 @@ extern "C" {
 
 #define AGT_CLI_MAX_BURST NCX_EL_MAX_BURST
 
+#define AGT_CLI_MAX_CHUNK_SIZE (const xmlChar *)"max-chunk-size"
+
+#define AGT_CLI_BUFFER_SIZE (const xmlChar *)"buffer-size"
+
+#define AGT_CLI_MAX_BUFFER_SIZE (const xmlChar *)"max-buffer-size"
+
+#define AGT_CLI_EVENTLOG_DIR (const xmlChar *)"eventlog-dir"
+
+#define AGT_CLI_LOG_ASYNC (const xmlChar *)"log-async"
+
+#define AGT_CLI_NVSTORE_JOURNAL (const xmlChar *)"nvstore-journal"
+
+#define AGT_CLI_VALIDATE_THREADS (const xmlChar *)"validate-threads"
+
+#define AGT_CLI_LISTEN_BACKLOG (const xmlChar *)"listen-backlog"
+
 /********************************************************************
 *								    *
 *			F U N C T I O N S			    *
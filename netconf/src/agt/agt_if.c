@@ -21,6 +21,7 @@
 date         init     comment
 ----------------------------------------------------------------------
 18jul09      abb      begun
+17oct26               share one parsed /proc/net/dev snapshot
 
 *********************************************************************
 *                                                                   *
@@ -43,6 +44,7 @@ date         init     comment
 #include "agt_if.h"
 #include "agt_rpc.h"
 #include "agt_util.h"
+#include "bobhash.h"
 #include "cfg.h"
 #include "getcb.h"
 #include "log.h"
@@ -52,6 +54,7 @@ date         init     comment
 #include "ses.h"
 #include "ses_msg.h"
 #include "status.h"
+#include "uptime.h"
 #include "val.h"
 #include "val_util.h"
 #include "xmlns.h"
@@ -79,12 +82,43 @@ date         init     comment
 #define interfaces_OID_counters (const xmlChar *)\
     "/interfaces/interface/counters"
 
+/* number of counter fields on a /proc/net/dev line */
+#define AGT_IF_MAX_COUNTERS   16
+
+/* longest interface name kept in the snapshot */
+#define AGT_IF_MAX_NAMELEN    31
+
 /********************************************************************
 *                                                                   *
 *                           T Y P E S                               *
 *                                                                   *
 *********************************************************************/
 
+/* one parsed /proc/net/dev line */
+typedef struct agt_if_stats_t_ {
+    xmlChar        name[AGT_IF_MAX_NAMELEN+1];
+    uint32         hash;
+    uint32         hashnext;     /* next index + 1 in bucket, 0 == end */
+    status_t       res;                   /* line parse status */
+    uint32         numcounters;
+    uint64         counters[AGT_IF_MAX_COUNTERS];
+} agt_if_stats_t;
+
+
+/* parsed copy of /proc/net/dev shared by all the counters
+ * callbacks in one retrieval; refreshed once it is older
+ * than the virtual node cache timeout
+ */
+typedef struct agt_if_snapshot_t_ {
+    boolean          valid;
+    time_t           snaptime;
+    agt_if_stats_t  *stats;                   /* malloced array */
+    uint32           count;
+    uint32           max;
+    uint32          *buckets;         /* index + 1, 0 == empty */
+    uint32           hashsize;                   /* power of 2 */
+} agt_if_snapshot_t;
+
 
 /********************************************************************
 *                                                                   *
@@ -98,6 +132,8 @@ static boolean              agt_if_not_supported;
 
 static ncx_module_t         *ifmod;
 
+static agt_if_snapshot_t     snapshot;
+
 
 /********************************************************************
 * FUNCTION is_interfaces_supported
@@ -291,84 +327,51 @@ static val_value_t *
 
 
 /********************************************************************
-* FUNCTION fill_if_counters
+* FUNCTION parse_if_line
 *
-* <get> operation handler for the interfaces/interface/counters node
+* Parse one interface line from the /proc/net/dev file
 *
 * INPUTS:
-*   countersobj == object template with all the child node to use
-*   nameval == value node for the <name> key that is desired
 *   buffer == line from the /proc/net/dev file to read
-*   dstval == destination value to fill in
+*   stats == stats entry to fill in
 *
 * OUTPUTS:
-*   child nodes added to dstval->v.childQ if NO_ERR returned
+*   *stats filled in; stats->res is set to an error
+*   if the counters could not be converted
 *
 * RETURNS:
 *    status
-*    NO_ERR if this is the right line for the <name> key
-*      and everything filled in OK
-*    ERR_NCX_SKIPPED if this is the wrong line for this <name>
-*    some other error like ERR_INTERNAL_MEM
+*    NO_ERR if this is an interface line
+*    ERR_NCX_SKIPPED if this is not an interface line
 *********************************************************************/
-static status_t 
-    fill_if_counters (obj_template_t *countersobj,
-                      val_value_t *nameval,
-                      xmlChar *buffer,
-                      val_value_t  *dstval)
+static status_t
+    parse_if_line (xmlChar *buffer,
+                   agt_if_stats_t *stats)
 {
-    obj_template_t        *childobj;
-    val_value_t           *childval;
     xmlChar               *str, *name;
     char                  *endptr;
-    status_t               res;
-    uint32                 leafcount;
     uint64                 counter;
+    int                    namelen;
+    status_t               res;
     boolean                done;
 
-    res = NO_ERR;
-    leafcount = 0;
-    counter = 0;
-
-    /* get the start of the interface name */
-    str = buffer;
-    while (*str && isspace(*str)) {
-        str++;
-    }
-    if (*str == '\0') {
-        /* not expecting a line with just whitespace on it */
-        return ERR_NCX_SKIPPED;
-    } else {
-        name = str++;
-    }
+    memset(stats, 0x0, sizeof(agt_if_stats_t));
 
-    /* get the end of the interface name */
-    while (*str && *str != ':') {
-        str++;
+    res = get_ifname_string(buffer, &name, &namelen);
+    if (res != NO_ERR) {
+        return res;
     }
-    if (*str == '\0') {
-        /* not expecting a line with just foo on it */
-        return ERR_NCX_SKIPPED;
-    }
-
-    /* is this the requested interface line? */
-    if (xml_strncmp((const xmlChar *)name,
-                    VAL_STR(nameval),
-                    (uint32)(str - name))) {
-        /* not the right interface name */
+    if (namelen > AGT_IF_MAX_NAMELEN) {
+        log_warn("\nWarning: agt_if: skipping long interface name");
         return ERR_NCX_SKIPPED;
     }
+    xml_strncpy(stats->name, name, (uint32)namelen);
+    stats->hash = bobhash((const ub1 *)name, (ub4)namelen, 0);
 
     /* get the str pointed at the first byte of the
      * 16 ordered counter values
      */
-    str++;
-
-    /* get the first counter object ready */
-    childobj = obj_first_child(countersobj);
-    if (childobj == NULL) {
-        return SET_ERROR(ERR_NCX_DEF_NOT_FOUND);
-    }
+    str = name + namelen + 1;
 
     /* keep getting counters until the line runs out */
     done = FALSE;
@@ -377,38 +380,285 @@ static status_t
         counter = strtoull((const char *)str, &endptr, 10);
         if (counter == 0 && str == (xmlChar *)endptr) {
             /* number conversion failed */
-            log_error("\nError: /proc/net/dev number conversion failed");
-            return ERR_NCX_OPERATION_FAILED;
+            stats->res = ERR_NCX_OPERATION_FAILED;
+            return NO_ERR;
+        }
+
+        stats->counters[stats->numcounters++] = counter;
+
+        str = (xmlChar *)endptr;
+        if (*str == '\0' || *str == '\n' ||
+            stats->numcounters == AGT_IF_MAX_COUNTERS) {
+            done = TRUE;
+        }
+    }
+
+    return NO_ERR;
+
+} /* parse_if_line */
+
+
+/********************************************************************
+* FUNCTION clean_snapshot
+*
+* Free the parsed /proc/net/dev snapshot
+*
+*********************************************************************/
+static void
+    clean_snapshot (void)
+{
+    if (snapshot.stats != NULL) {
+        m__free(snapshot.stats);
+    }
+    if (snapshot.buckets != NULL) {
+        m__free(snapshot.buckets);
+    }
+    memset(&snapshot, 0x0, sizeof(agt_if_snapshot_t));
+
+} /* clean_snapshot */
+
+
+/********************************************************************
+* FUNCTION index_snapshot
+*
+* Build the interface name hash index for the snapshot
+*
+* RETURNS:
+*    status
+*********************************************************************/
+static status_t
+    index_snapshot (void)
+{
+    agt_if_stats_t  *stats;
+    uint32           i, hashsize, bucket;
+
+    hashsize = 16;
+    while (hashsize < snapshot.count * 2) {
+        hashsize <<= 1;
+    }
+
+    if (hashsize != snapshot.hashsize) {
+        if (snapshot.buckets != NULL) {
+            m__free(snapshot.buckets);
+        }
+        snapshot.buckets = m__getMem(hashsize * sizeof(uint32));
+        if (snapshot.buckets == NULL) {
+            snapshot.hashsize = 0;
+            return ERR_INTERNAL_MEM;
+        }
+        snapshot.hashsize = hashsize;
+    }
+    memset(snapshot.buckets, 0x0, hashsize * sizeof(uint32));
+
+    for (i = 0; i < snapshot.count; i++) {
+        stats = &snapshot.stats[i];
+        bucket = stats->hash & (hashsize - 1);
+        stats->hashnext = snapshot.buckets[bucket];
+        snapshot.buckets[bucket] = i + 1;
+    }
+
+    return NO_ERR;
+
+} /* index_snapshot */
+
+
+/********************************************************************
+* FUNCTION load_snapshot
+*
+* Make sure the /proc/net/dev snapshot is loaded and fresh
+* The file is only read again once the snapshot is older
+* than the virtual node cache timeout, so all the counters
+* callbacks for one <get> share one read of the file
+*
+* RETURNS:
+*    status
+*********************************************************************/
+static status_t
+    load_snapshot (void)
+{
+    FILE                  *countersfile;
+    agt_if_stats_t        *newstats;
+    xmlChar               *buffer, *readtest;
+    time_t                 timenow;
+    status_t               res;
+    uint32                 linecount, newmax;
+
+    (void)uptime(&timenow);
+    if (snapshot.valid &&
+        difftime(timenow, snapshot.snaptime) <=
+        (double)ncx_get_vtimeout_value()) {
+        return NO_ERR;
+    }
+
+    snapshot.valid = FALSE;
+    snapshot.count = 0;
+
+    /* open the /proc/net/dev file for reading */
+    countersfile = fopen("/proc/net/dev", "r");
+    if (countersfile == NULL) {
+        return errno_to_status();
+    }
+
+    /* get a file read line buffer */
+    buffer = m__getMem(NCX_MAX_LINELEN);
+    if (buffer == NULL) {
+        fclose(countersfile);
+        return ERR_INTERNAL_MEM;
+    }
+
+    /* loop through the file until done */
+    res = NO_ERR;
+    linecount = 0;
+
+    while (res == NO_ERR) {
+        readtest = (xmlChar *)
+            fgets((char *)buffer, NCX_MAX_LINELEN, countersfile);
+        if (readtest == NULL) {
+            break;
+        }
+
+        if (++linecount < 3) {
+            /* skip the header junk on the first 2 lines */
+            continue;
+        }
+
+        if (snapshot.count == snapshot.max) {
+            newmax = (snapshot.max) ? snapshot.max * 2 : 64;
+            newstats = m__getMem(newmax * sizeof(agt_if_stats_t));
+            if (newstats == NULL) {
+                res = ERR_INTERNAL_MEM;
+                continue;
+            }
+            if (snapshot.stats != NULL) {
+                memcpy(newstats, snapshot.stats,
+                       snapshot.count * sizeof(agt_if_stats_t));
+                m__free(snapshot.stats);
+            }
+            snapshot.stats = newstats;
+            snapshot.max = newmax;
         }
 
+        if (parse_if_line(buffer,
+                          &snapshot.stats[snapshot.count]) == NO_ERR) {
+            snapshot.count++;
+        }
+    }
+
+    fclose(countersfile);
+    m__free(buffer);
+
+    if (res == NO_ERR) {
+        res = index_snapshot();
+    }
+
+    if (res == NO_ERR) {
+        snapshot.valid = TRUE;
+        snapshot.snaptime = timenow;
+        if (LOGDEBUG3) {
+            log_debug3("\nagt_if: loaded %u interfaces from /proc/net/dev",
+                       snapshot.count);
+        }
+    }
+
+    return res;
+
+} /* load_snapshot */
+
+
+/********************************************************************
+* FUNCTION find_if_stats
+*
+* Find the snapshot entry for an interface name
+*
+* INPUTS:
+*   name == interface name to find
+*
+* RETURNS:
+*    pointer to the entry or NULL if not found
+*********************************************************************/
+static const agt_if_stats_t *
+    find_if_stats (const xmlChar *name)
+{
+    const agt_if_stats_t  *stats;
+    uint32                 hash, i;
+
+    if (snapshot.hashsize == 0) {
+        return NULL;
+    }
+
+    hash = bobhash((const ub1 *)name, xml_strlen(name), 0);
+    for (i = snapshot.buckets[hash & (snapshot.hashsize - 1)];
+         i != 0;
+         i = stats->hashnext) {
+        stats = &snapshot.stats[i - 1];
+        if (stats->hash == hash && !xml_strcmp(stats->name, name)) {
+            return stats;
+        }
+    }
+
+    return NULL;
+
+} /* find_if_stats */
+
+
+/********************************************************************
+* FUNCTION fill_if_counters
+*
+* Add the counter leafs for one interface
+*
+* INPUTS:
+*   countersobj == object template with all the child node to use
+*   stats == snapshot entry for the interface
+*   dstval == destination value to fill in
+*
+* OUTPUTS:
+*   child nodes added to dstval->v.childQ if NO_ERR returned
+*
+* RETURNS:
+*    status
+*********************************************************************/
+static status_t
+    fill_if_counters (obj_template_t *countersobj,
+                      const agt_if_stats_t *stats,
+                      val_value_t  *dstval)
+{
+    obj_template_t        *childobj;
+    val_value_t           *childval;
+    uint32                 leafcount;
+
+    if (stats->res != NO_ERR) {
+        log_error("\nError: /proc/net/dev number conversion failed");
+        return stats->res;
+    }
+
+    /* get the first counter object ready */
+    childobj = obj_first_child(countersobj);
+    if (childobj == NULL) {
+        return SET_ERROR(ERR_NCX_DEF_NOT_FOUND);
+    }
+
+    for (leafcount = 0;
+         leafcount < stats->numcounters && childobj != NULL;
+         leafcount++) {
+
         childval = val_new_value();
         if (childval == NULL) {
             return ERR_INTERNAL_MEM;
         }
         val_init_from_template(childval, childobj);
-        VAL_ULONG(childval) = counter;
+        VAL_ULONG(childval) = stats->counters[leafcount];
         val_add_child(childval, dstval);
 
-        leafcount++;
-
-        str = (xmlChar *)endptr;
-        if (*str == '\0' || *str == '\n') {
-            done = TRUE;
-        } else {
-            childobj = obj_next_child(childobj);
-            if (childobj == NULL) {
-                done = TRUE;
-            }
-        }
+        childobj = obj_next_child(childobj);
     }
 
     if (LOGDEBUG2) {
         log_debug2("\nagt_if: filled %u of 16 counters for '%s'",
                    leafcount,
-                   VAL_STR(nameval));
+                   stats->name);
     }
 
-    return res;
+    return NO_ERR;
 
 } /* fill_if_counters */
 
@@ -424,29 +674,23 @@ static status_t
 * RETURNS:
 *    status
 *********************************************************************/
-static status_t 
+static status_t
     get_if_counters (ses_cb_t *scb,
                      getcb_mode_t cbmode,
                      val_value_t *virval,
                      val_value_t  *dstval)
 {
-    FILE                  *countersfile;
-    obj_template_t        *countersobj;
-    val_value_t           *parentval, *nameval;
-    xmlChar               *buffer, *readtest;
-    boolean                done;
+    val_value_t           *parentval;
+    val_index_t           *keyindex;
+    const agt_if_stats_t  *stats;
     status_t               res;
-    uint32                 linecount;
 
     (void)scb;
-    res = NO_ERR;
 
     if (cbmode != GETCB_GET_VALUE) {
         return ERR_NCX_OPERATION_NOT_SUPPORTED;
     }
 
-    countersobj = virval->obj;
-
     /* get the interface parent entry for this counters entry */
     parentval = virval->parent;
     if (parentval == NULL) {
@@ -454,63 +698,25 @@ static status_t
         return SET_ERROR(ERR_INTERNAL_VAL);
     }
 
-    /* get the name key leaf from the parent */
-    nameval = val_find_child(parentval,
-                             interfaces_MOD,
-                             interfaces_N_name);
-    if (nameval == NULL) {
+    /* the name key leaf is the first index of the parent */
+    keyindex = val_get_first_key(parentval);
+    if (keyindex == NULL || keyindex->val == NULL) {
         /* there should be a key present */
         return SET_ERROR(ERR_INTERNAL_VAL);
-    }        
-
-    /* open the /proc/net/dev file for reading */
-    countersfile = fopen("/proc/net/dev", "r");
-    if (countersfile == NULL) {
-        return errno_to_status();
     }
 
-    /* get a file read line buffer */
-    buffer = m__getMem(NCX_MAX_LINELEN);
-    if (buffer == NULL) {
-        fclose(countersfile);
-        return ERR_INTERNAL_MEM;
+    res = load_snapshot();
+    if (res != NO_ERR) {
+        return res;
     }
 
-    /* loop through the file until done */
-    res = NO_ERR;
-    done = FALSE;
-    linecount = 0;
-
-    while (!done) {
-      readtest = (xmlChar *)
-	fgets((char *)buffer, NCX_MAX_LINELEN, countersfile);
-        if (readtest == NULL) {
-            done = TRUE;
-            continue;
-        } else {
-            linecount++;
-        }
-
-        if (linecount < 3) {
-            /* skip the header junk on the first 2 lines */
-            continue;
-        } 
-
-        res = fill_if_counters(countersobj,
-                               nameval, 
-                               buffer, 
-                               dstval);
-        if (res == ERR_NCX_SKIPPED) {
-            res = NO_ERR;
-        } else {
-            done = TRUE;
-        }
+    stats = find_if_stats(VAL_STR(keyindex->val));
+    if (stats == NULL) {
+        /* interface is gone; leave the counters empty */
+        return NO_ERR;
     }
 
-    fclose(countersfile);
-    m__free(buffer);
-
-    return res;
+    return fill_if_counters(virval->obj, stats, dstval);
 
 } /* get_if_counters */
 
@@ -533,14 +739,11 @@ static status_t
     add_interface_entries (val_value_t *interfacesval)
 {
 
-    FILE                  *countersfile;
     obj_template_t        *interfaceobj, *countersobj;
     val_value_t           *interfaceval, *countersval;
-    xmlChar               *buffer, *readtest, *ifname;
-    boolean                done;
+    agt_if_stats_t        *stats;
     status_t               res;
-    uint32                 linecount;
-    int                    ifnamelen;
+    uint32                 i;
 
     res = NO_ERR;
 
@@ -558,83 +761,40 @@ static status_t
         return SET_ERROR(ERR_NCX_DEF_NOT_FOUND);
     }
 
-    /* open the /proc/net/dev file for reading */
-    countersfile = fopen("/proc/net/dev", "r");
-    if (countersfile == NULL) {
-        return errno_to_status();
-    }
-
-    /* get a file read line buffer */
-    buffer = m__getMem(NCX_MAX_LINELEN);
-    if (buffer == NULL) {
-        fclose(countersfile);
-        return ERR_INTERNAL_MEM;
+    res = load_snapshot();
+    if (res != NO_ERR) {
+        return res;
     }
 
-    /* loop through the file until done */
-    res = NO_ERR;
-    done = FALSE;
-    linecount = 0;
+    for (i = 0; i < snapshot.count && res == NO_ERR; i++) {
+        stats = &snapshot.stats[i];
 
-    while (!done) {
-      readtest = (xmlChar *)
-	fgets((char *)buffer, NCX_MAX_LINELEN, countersfile);
-        if (readtest == NULL) {
-            done = TRUE;
-            continue;
-        } else {
-            linecount++;
-        }
-
-        if (linecount < 3) {
-            /* skip the header junk on the first 2 lines */
-            continue;
-        } 
-
-        ifname = NULL;
-        ifnamelen = 0;
-        res = get_ifname_string(buffer, &ifname, &ifnamelen);
-        if (res != NO_ERR) {
-            done = TRUE;
-        } else {
-            /* got the name string
-             * see if this entry is already present
-             */
-            interfaceval = find_interface_entry(interfacesval,
-                                                ifname,
-                                                ifnamelen);
+        /* see if this entry is already present */
+        interfaceval = find_interface_entry(interfacesval,
+                                            stats->name,
+                                            (int)xml_strlen(stats->name));
+        if (interfaceval == NULL) {
+            /* create a new entry */
+            interfaceval = make_interface_entry(interfaceobj,
+                                                stats->name,
+                                                &res);
             if (interfaceval == NULL) {
-                /* create a new entry */
-                res = NO_ERR;
-                ifname[ifnamelen] = 0;
-                interfaceval = make_interface_entry(interfaceobj,
-                                                    ifname,
-                                                    &res);
-                if (interfaceval == NULL) {
-                    done = TRUE;
-                    continue;
-                } else {
-                    val_add_child(interfaceval, interfacesval);
-                }
-            }
-
-            /* add the counters virtual node to the entry */
-            countersval = val_new_value();
-            if (countersval == NULL) {
-                res = ERR_INTERNAL_MEM;
-                done = TRUE;
                 continue;
-            } else {
-                val_init_virtual(countersval,
-                                 get_if_counters,
-                                 countersobj);
-                val_add_child(countersval, interfaceval);
             }
+            val_add_child(interfaceval, interfacesval);
         }
-    }
 
-    fclose(countersfile);
-    m__free(buffer);
+        /* add the counters virtual node to the entry */
+        countersval = val_new_value();
+        if (countersval == NULL) {
+            res = ERR_INTERNAL_MEM;
+        } else {
+            val_init_virtual(countersval,
+                             get_if_counters,
+                             countersobj);
+            val_add_child(countersval, interfaceval);
+        }
+    }
 
     return res;
 
@@ -668,6 +828,7 @@ status_t
     log_debug2("\nagt: Loading interfaces module");
 
     ifmod = NULL;
+    memset(&snapshot, 0x0, sizeof(agt_if_snapshot_t));
     agt_if_not_supported = FALSE;
     agt_if_init_done = TRUE;
     agt_profile = agt_get_profile();
@@ -768,6 +929,7 @@ void
     agt_if_cleanup (void)
 {
     if (agt_if_init_done) {
+        clean_snapshot();
         ifmod = NULL;
         agt_if_init_done = FALSE;
     }
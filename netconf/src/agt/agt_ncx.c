@@ -39,6 +39,7 @@ date         init     comment
 #include "agt_cli.h"
 #include "agt_ncx.h"
 #include "agt_nmda.h"
+#include "agt_nvstore.h"
 #include "agt_rpc.h"
 #include "agt_rpcerr.h"
 #include "agt_ses.h"
@@ -872,7 +873,7 @@ static status_t
         profile->agt_targ == NCX_AGT_TARG_RUNNING &&
         profile->agt_has_startup == FALSE) {
 
-        res = agt_ncx_cfg_save(target, FALSE);
+        res = agt_nvstore_save(target, msg->rpc_txcb);
         if (res != NO_ERR) {
             log_error("\nError: Save <running> to NV-storage failed (%s)",
                       get_error_string(res));
@@ -1341,6 +1342,10 @@ static status_t
                 msg->rpc_top_editop = OP_EDITOP_REPLACE;
                 res = agt_val_apply_write(scb, msg, copyparms->destcfg,
                                           sourceval, OP_EDITOP_REPLACE);
+
+                /* compare the whole config at the next commit
+                 * instead of trusting the per-edit record */
+                cfg_set_full_compare(copyparms->destcfg);
                 break;
             default:
                 res = SET_ERROR(ERR_INTERNAL_VAL);
@@ -1369,7 +1374,7 @@ static status_t
                 switch (copyparms->srccfg->cfg_id) {
                 case NCX_CFGID_RUNNING:
                     /* same as discard-changes */
-                    res = cfg_fill_candidate_from_running();
+                    res = cfg_sync_candidate_from_running();
                     break;
                 case NCX_CFGID_STARTUP:
                     res = cfg_fill_candidate_from_startup();
@@ -2593,7 +2598,7 @@ static status_t
                 }
             }
         } else {
-            res = cfg_fill_candidate_from_running();
+            res = cfg_sync_candidate_from_running();
         }
     }
 
@@ -2802,7 +2807,7 @@ static status_t
     if (!candidate) {
         res = SET_ERROR(ERR_INTERNAL_VAL);
     } else if (cfg_get_dirty_flag(candidate)) {
-        res = cfg_fill_candidate_from_running();
+        res = cfg_sync_candidate_from_running();
     }
 
     if (res != NO_ERR) {
@@ -3781,9 +3786,7 @@ status_t
     cfg_template_t    *startup;
     val_value_t       *copystartup;
     xmlChar           *filebuffer;
-    agt_profile_t     *profile;
     status_t           res;
-    xml_attrs_t        attrs;
 
 #ifdef DEBUG
     if (!cfg) {
@@ -3798,7 +3801,6 @@ status_t
     startup = NULL;
     copystartup = NULL;
     res = ERR_NCX_OPERATION_NOT_SUPPORTED;
-    profile = agt_get_profile();
 
     switch (cfg->cfg_loc) {
     case CFG_LOC_INTERNAL:
@@ -3831,21 +3833,9 @@ status_t
                               cfg->name,
                               filebuffer);
                 }
-                /* write the new startup config */
-                xml_init_attrs(&attrs);
-
-                /* output to the specified file or STDOUT */
-                res = xml_wr_check_file(filebuffer,
-                                        cfg->root,
-                                        &attrs,
-                                        XMLMODE,
-                                        WITHHDR,
-                                        TRUE,
-                                        0,
-                                        profile->agt_indent,
-                                        agt_check_save);
-
-                xml_clean_attrs(&attrs);
+                /* write the new startup config; this also
+                 * restarts the NV-store journal */
+                res = agt_nvstore_write_snapshot(filebuffer, cfg);
 
                 if (res == NO_ERR && startup != NULL) {
                     /* toss the old startup and save the new one */
@@ -36,6 +36,8 @@ date         init     comment
 #include <errno.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
@@ -67,16 +69,38 @@ date         init     comment
  *                                                                   *
  *********************************************************************/
 
-/* how often to check for agent shutown (in seconds) */
+/* how often to check for agent shutown, and the interval
+ * for the session timeout and notification polling (in seconds)
+ */
 #define AGT_NCXSERVER_TIMEOUT  1
 
 /* number of notifications to send out in 1 timeout interval */
 #define MAX_NOTIFICATION_BURST  10
 
+/* max number of socket events handled per epoll_wait call */
+#define AGT_NCXSERVER_MAX_EVENTS  256
+
+/* epoll user data for the ncxserver listen socket;
+ * session sockets use the session ID, which is never 0
+ */
+#define NCXSOCK_EVENT_ID  0
 
-static fd_set active_fd_set;
-static fd_set read_fd_set;
-static fd_set write_fd_set;
+/* epoll user data for the notification wakeup eventfd;
+ * outside the range of session IDs
+ */
+#define WAKEUP_EVENT_ID  ((uint64)1 << 32)
+
+
+/* epoll instance for the ncxserver and all session sockets */
+static int epfd = -1;
+
+/* eventfd used to wake up the epoll loop when there are
+ * notifications to send
+ */
+static int wakefd = -1;
+
+/* TRUE if wakefd has been written and not read yet */
+static boolean wakeup_pending;
 
 
 /********************************************************************
@@ -197,16 +221,8 @@ static status_t
  * FUNCTION send_some_notifications
  * 
  * Send some notifications as needed
- * 
- * INPUTS:
- *    filename == full filespec of the socket filename
- *    sock == ptr to return value
- *
- * OUTPUTS:
- *    *sock == the FD for the socket if return ok
- *
- * RETURNS:
- *    status   
+ * Stops after --maxburst notifications; the loop is woken up
+ * again to send the rest after the pending socket events
  *********************************************************************/
 static void
     send_some_notifications (void)
@@ -228,6 +244,10 @@ static void
         if (sendcount) {
             sendtotal += sendcount;
             if (sendmax && (sendtotal >= sendmax)) {
+                /* more may be waiting; come back after
+                 * the sockets that are ready now
+                 */
+                agt_ncxserver_wakeup();
                 done = TRUE;
             }
         } else {
@@ -243,6 +263,300 @@ static void
 
 
 
+/********************************************************************
+ * FUNCTION clear_wakeup
+ * 
+ * Read the wakeup eventfd after the epoll loop was woken up
+ *********************************************************************/
+static void
+    clear_wakeup (void)
+{
+    uint64_t  count;
+
+    if (read(wakefd, &count, sizeof(count)) < 0 &&
+        errno != EAGAIN && LOGDEBUG) {
+        log_debug("\nagt_ncxserver: wakeup read failed (%s)",
+                  strerror(errno));
+    }
+    wakeup_pending = FALSE;
+
+} /* clear_wakeup */
+
+
+/********************************************************************
+ * FUNCTION set_write_events
+ * 
+ * Turn write events on or off for a session socket
+ * Only calls epoll_ctl if the setting is changed
+ * 
+ * INPUTS:
+ *    scb == session control block to use
+ *    on == TRUE to wait for POLLOUT; FALSE for input only
+ *********************************************************************/
+static void
+    set_write_events (ses_cb_t *scb,
+                      boolean on)
+{
+    struct epoll_event  ev;
+
+    if (scb->outpoll == on) {
+        return;
+    }
+
+    memset(&ev, 0x0, sizeof(ev));
+    ev.events = (on) ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u64 = scb->sid;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, scb->fd, &ev) != 0) {
+        log_error("\nError: epoll_ctl failed for session %d (%s)",
+                  scb->sid,
+                  strerror(errno));
+        return;
+    }
+    scb->outpoll = on;
+
+} /* set_write_events */
+
+
+/********************************************************************
+ * FUNCTION enable_outready_events
+ * 
+ * Drain the outreadyQ and turn on write events for
+ * each session that has output waiting for the socket
+ *********************************************************************/
+static void
+    enable_outready_events (void)
+{
+    ses_cb_t  *scb;
+
+    for (scb = agt_ses_get_next_outready();
+         scb != NULL;
+         scb = agt_ses_get_next_outready()) {
+        set_write_events(scb, TRUE);
+    }
+
+} /* enable_outready_events */
+
+
+/********************************************************************
+ * FUNCTION write_session
+ * 
+ * Handle a write event for a session socket
+ * 
+ * INPUTS:
+ *    scb == session control block to use
+ *********************************************************************/
+static void
+    write_session (ses_cb_t *scb)
+{
+    status_t  res;
+
+    /* try to send 1 packet worth of buffers for a session;
+     * in stream output mode this resumes a reply that
+     * was blocked by the socket
+     */
+    if (!dlq_empty(&scb->outQ)) {
+        res = ses_msg_send_buffs(scb);
+        if (res != NO_ERR) {
+            if (LOGINFO) {
+                log_info("\nagt_ncxserver write failed; "
+                         "closing session %d ", 
+                         scb->sid);
+            }
+            agt_ses_kill_session(scb, 
+                                 scb->sid,
+                                 SES_TR_OTHER);
+            return;
+        }
+
+        if (scb->state == SES_ST_SHUTDOWN_REQ &&
+            dlq_empty(&scb->outQ)) {
+            /* close-session reply sent, now kill ses */
+            agt_ses_kill_session(scb, 
+                                 scb->killedbysid,
+                                 scb->termreason);
+            return;
+        }
+    }
+
+    /* stop the write events once all buffers are sent;
+     * a subscriber held back by its outQ size can get more
+     */
+    if (dlq_empty(&scb->outQ)) {
+        set_write_events(scb, FALSE);
+        if (scb->notif_active) {
+            agt_ncxserver_wakeup();
+        }
+    }
+
+} /* write_session */
+
+
+/********************************************************************
+ * FUNCTION read_session
+ * 
+ * Handle a read event for a session socket
+ * 
+ * INPUTS:
+ *    scb == session control block to use
+ *********************************************************************/
+static void
+    read_session (ses_cb_t *scb)
+{
+    status_t  res;
+
+    res = ses_accept_input(scb);
+    if (res == NO_ERR) {
+        return;
+    }
+
+    if (res != ERR_NCX_SESSION_CLOSED) {
+        if (LOGINFO) {
+            log_info("\nagt_ncxserver: input failed"
+                     " for session %d (%s)",
+                     scb->sid, 
+                     get_error_string(res));
+        }
+        /* send an error reply instead of
+         * killing the session right now
+         */
+        agt_rpc_send_error_reply(scb, res);
+        agt_ses_request_close(scb, 
+                              0, 
+                              SES_TR_OTHER);
+    } else {
+        /* connection already closed
+         * so kill session right now
+         */
+        agt_ses_kill_session(scb,
+                             scb->sid,
+                             SES_TR_DROPPED);
+    }
+
+} /* read_session */
+
+
+/********************************************************************
+ * FUNCTION accept_session
+ * 
+ * Accept a new connection on the ncxserver socket
+ * 
+ * INPUTS:
+ *    ncxsock == ncxserver listen socket (non-blocking)
+ *
+ * RETURNS:
+ *    TRUE if a connection was taken from the listen queue
+ *    FALSE if the queue is empty or accept failed
+ *********************************************************************/
+static boolean
+    accept_session (int ncxsock)
+{
+    ses_cb_t            *scb;
+    struct sockaddr_un   clientname;
+    struct epoll_event   ev;
+    socklen_t            size;
+    int                  new;
+
+    size = (socklen_t)sizeof(clientname);
+    new = accept(ncxsock,
+                 (struct sockaddr *)&clientname,
+                 &size);
+    if (new < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && LOGINFO) {
+            log_info("\nagt_ncxserver accept "
+                     "connection failed (%d)",
+                     new);
+        }
+        return FALSE;
+    }
+
+    /* get a new session control block */
+    scb = agt_ses_new_session(SES_TRANSPORT_SSH, new);
+    if (scb == NULL) {
+        close(new);
+        if (LOGINFO) {
+            log_info("\nagt_ncxserver new "
+                     "session failed (%d)", 
+                     new);
+        }
+        return TRUE;
+    }
+
+    /* set non-blocking IO */
+    if (fcntl(new, F_SETFL, 
+              fcntl(new, F_GETFL) | O_NONBLOCK)) {
+        if (LOGINFO) {
+            log_info("\nfnctl failed");
+        }
+    }
+
+    memset(&ev, 0x0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = scb->sid;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, new, &ev) != 0) {
+        log_error("\nError: epoll_ctl add failed for session %d (%s)",
+                  scb->sid,
+                  strerror(errno));
+        agt_ses_kill_session(scb, scb->sid, SES_TR_OTHER);
+        return TRUE;
+    }
+    scb->outpoll = FALSE;
+    return TRUE;
+
+} /* accept_session */
+
+
+/********************************************************************
+ * FUNCTION process_ready_sessions
+ * 
+ * Drain the ready queue before accepting new input
+ * 
+ * RETURNS:
+ *   TRUE if a server shutdown was requested
+ *********************************************************************/
+static boolean
+    process_ready_sessions (void)
+{
+    for (;;) {
+        if (!agt_ses_process_first_ready()) {
+            return FALSE;
+        } else if (agt_shutdown_requested()) {
+            return TRUE;
+        } else {
+            send_some_notifications();
+        }
+    }
+    /*NOTREACHED*/
+
+} /* process_ready_sessions */
+
+
+/********************************************************************
+ * FUNCTION housekeeping_timer
+ * 
+ * Periodic timer callback for the session timeout and
+ * notification polling; runs even if the sockets never go idle
+ * 
+ * INPUTS:
+ *    timer_id == timer identifier
+ *    cookie == not used
+ *
+ * RETURNS:
+ *    0 to keep the timer running
+ *********************************************************************/
+static int
+    housekeeping_timer (uint32 timer_id,
+                        void *cookie)
+{
+    (void)timer_id;
+    (void)cookie;
+
+    agt_ses_check_timeouts();
+    send_some_notifications();
+    return 0;
+
+} /* housekeeping_timer */
+
+
 /***********     E X P O R T E D   F U N C T I O N S   *************/
 
 
@@ -251,6 +565,12 @@ static void
  * 
  * IO server loop for the ncxserver socket
  * 
+ * Uses a level-triggered epoll set, so the cost of each
+ * loop iteration depends on the number of sockets with events,
+ * not the number of open sessions.  Session sockets wait
+ * for write events only while the session is in the outreadyQ
+ * or still has buffers in its outQ.
+ *
  * RETURNS:
  *   status
  *********************************************************************/
@@ -259,15 +579,12 @@ status_t
 {
     ses_cb_t              *scb;
     agt_profile_t         *profile;
-    int                    ncxsock, maxwrnum, maxrdnum;
-    int                    i, new, ret;
-    struct sockaddr_un     clientname;
-    struct timeval         timeout;
-    socklen_t              size;
+    struct epoll_event    *events;
+    struct epoll_event     ev;
+    int                    ncxsock, i, ret;
+    uint32                 sid, timer_id;
     status_t               res;
-    boolean                done, done2, stream_output;
-    val_value_t            *clivalset;
-    val_value_t            *val;
+    boolean                done, done2, newconn, deferred, notify;
 
     profile = agt_get_profile();
     if (profile == NULL) {
@@ -290,19 +607,87 @@ status_t
         }
     }
 
-    stream_output = profile->agt_stream_output;
-
-    if (listen(ncxsock, 1) < 0) {
+    if (listen(ncxsock, (int)profile->agt_listen_backlog) < 0) {
         log_error("\nError: listen failed");
         return ERR_NCX_OPERATION_FAILED;
     }
-     
+
+    /* accept_session takes connections until the queue is empty */
+    if (fcntl(ncxsock, F_SETFL, fcntl(ncxsock, F_GETFL) | O_NONBLOCK)) {
+        log_error("\nError: fcntl failed on ncxserver socket");
+        close(ncxsock);
+        return ERR_NCX_OPERATION_FAILED;
+    }
+
+    events = m__getMem(AGT_NCXSERVER_MAX_EVENTS * sizeof(struct epoll_event));
+    if (events == NULL) {
+        close(ncxsock);
+        return ERR_INTERNAL_MEM;
+    }
+
     /* Initialize the set of active sockets. */
-    FD_ZERO(&read_fd_set);
-    FD_ZERO(&write_fd_set);
-    FD_ZERO(&active_fd_set);
-    FD_SET(ncxsock, &active_fd_set);
-    maxwrnum = maxrdnum = ncxsock;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        log_error("\nError: epoll_create failed (%s)", strerror(errno));
+        m__free(events);
+        close(ncxsock);
+        return ERR_NCX_OPERATION_FAILED;
+    }
+
+    memset(&ev, 0x0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = NCXSOCK_EVENT_ID;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, ncxsock, &ev) != 0) {
+        log_error("\nError: epoll_ctl failed (%s)", strerror(errno));
+        close(epfd);
+        epfd = -1;
+        m__free(events);
+        close(ncxsock);
+        return ERR_NCX_OPERATION_FAILED;
+    }
+
+    /* notifications queued from timers or session events
+     * wake up the epoll loop through this eventfd
+     */
+    wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakefd < 0) {
+        log_error("\nError: eventfd failed (%s)", strerror(errno));
+        close(epfd);
+        epfd = -1;
+        m__free(events);
+        close(ncxsock);
+        return ERR_NCX_OPERATION_FAILED;
+    }
+    wakeup_pending = FALSE;
+
+    memset(&ev, 0x0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKEUP_EVENT_ID;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev) != 0) {
+        log_error("\nError: epoll_ctl failed (%s)", strerror(errno));
+        close(wakefd);
+        wakefd = -1;
+        close(epfd);
+        epfd = -1;
+        m__free(events);
+        close(ncxsock);
+        return ERR_NCX_OPERATION_FAILED;
+    }
+
+    res = agt_timer_create(AGT_NCXSERVER_TIMEOUT,
+                           TRUE,
+                           housekeeping_timer,
+                           NULL,
+                           &timer_id);
+    if (res != NO_ERR) {
+        close(wakefd);
+        wakefd = -1;
+        close(epfd);
+        epfd = -1;
+        m__free(events);
+        close(ncxsock);
+        return res;
+    }
 
     done = FALSE;
     while (!done) {
@@ -316,38 +701,30 @@ status_t
         ret = 0;
         done2 = FALSE;
         while (!done2) {
-            read_fd_set = active_fd_set;
-            agt_ses_fill_writeset(&write_fd_set, &maxwrnum);
-            timeout.tv_sec = AGT_NCXSERVER_TIMEOUT;
-            timeout.tv_usec = 0;
+            enable_outready_events();
 
-            /* Block until input arrives on one or more active sockets. 
-             * or the timer expires
+            /* Block until input arrives on one or more active sockets,
+             * a blocked socket becomes writable, or the next timer
+             * is due
              */
-            ret = select(max(maxrdnum+1, maxwrnum+1), 
-                         &read_fd_set, 
-                         &write_fd_set, 
-                         NULL, 
-                         &timeout);
+            ret = epoll_wait(epfd, 
+                             events, 
+                             AGT_NCXSERVER_MAX_EVENTS,
+                             (int)agt_timer_get_timeout(
+                                 AGT_NCXSERVER_TIMEOUT * 1000));
             if (ret > 0) {
                 done2 = TRUE;
             } else if (ret < 0) {
                 if (!(errno == EINTR || errno==EAGAIN)) {
                     done2 = TRUE;
                 }
-            } else if (ret == 0) {
+            } else {
                 /* should only happen if a timeout occurred */
                 if (agt_shutdown_requested()) {
                     done2 = TRUE; 
                 } else {
-                    /* !! put all polling callbacks here for now !! */
-                    agt_ses_check_timeouts();
                     agt_timer_handler();
-                    send_some_notifications();
                 }
-            } else {
-                /* normal return with some bytes */
-                done2 = TRUE;
             }
         }
 
@@ -357,161 +734,109 @@ status_t
             continue;
         }
 
-        /* check select return status for non-recoverable error */
+        /* check epoll return status for non-recoverable error */
         if (ret < 0) {
             res = ERR_NCX_OPERATION_FAILED;
-            log_error("\nncxserver select failed (%s)", 
+            log_error("\nncxserver epoll_wait failed (%s)", 
                       strerror(errno));
             agt_request_shutdown(NCX_SHUT_EXIT);
             done = TRUE;
             continue;
         }
-     
-        /* Service all the sockets with input and/or output pending */
-        done2 = FALSE;
-        for (i = 0; i < max(maxrdnum+1, maxwrnum+1) && !done2; i++) {
-            scb=NULL;
+
+        /* Service all the sockets with input and/or output pending.
+         * New connections are accepted after the other events so
+         * a session ID freed in this loop is not reused until the
+         * events reported for it are skipped
+         */
+        newconn = FALSE;
+        notify = FALSE;
+        for (i = 0; i < ret; i++) {
+            if (events[i].data.u64 == WAKEUP_EVENT_ID) {
+                clear_wakeup();
+                notify = TRUE;
+                continue;
+            }
+
+            sid = (uint32)events[i].data.u64;
+            if (sid == NCXSOCK_EVENT_ID) {
+                newconn = TRUE;
+                continue;
+            }
+
+            /* session may have been killed by an earlier event */
+            scb = agt_ses_get_session_for_id(sid);
+            if (scb == NULL) {
+                continue;
+            }
+
             /* check write output to client sessions */
-            if (!stream_output && FD_ISSET(i, &write_fd_set)) {
-                /* try to send 1 packet worth of buffers for a session */
-                scb = def_reg_find_scb(i);
-                if (scb) {
-                    /* check if anything to write */
-                    if (!dlq_empty(&scb->outQ)) {
-                        res = ses_msg_send_buffs(scb);
-                        if (res != NO_ERR) {
-                            if (LOGINFO) {
-                                log_info("\nagt_ncxserver write failed; "
-                                         "closing session %d ", 
-                                         scb->sid);
-                            }
-                        }
-                        if (res != NO_ERR) {
-                            agt_ses_kill_session(scb, 
-                                                 scb->sid,
-                                                 SES_TR_OTHER);
-                            scb = NULL;
-                        } else if (scb->state == SES_ST_SHUTDOWN_REQ) {
-                            /* close-session reply sent, now kill ses */
-                            agt_ses_kill_session(scb, 
-                                                 scb->killedbysid,
-                                                 scb->termreason);
-                            scb = NULL;
-                        }
-                    }
-
-                    /* check if any buffers left over for next loop */
-                    if (scb && !dlq_empty(&scb->outQ)) {
-                        ses_msg_make_outready(scb);
-                    }
+            if (events[i].events & EPOLLOUT) {
+                write_session(scb);
+                scb = agt_ses_get_session_for_id(sid);
+                if (scb == NULL) {
+                    continue;
                 }
             }
 
-            /* check read input from client sessions */
-            if (FD_ISSET(i, &read_fd_set)) {
-                if (i == ncxsock) {
-                    /* Connection request on original socket. */
-                    size = (socklen_t)sizeof(clientname);
-                    new = accept(ncxsock,
-                                 (struct sockaddr *)&clientname,
-                                 &size);
-                    if (new < 0) {
-                        if (LOGINFO) {
-                            log_info("\nagt_ncxserver accept "
-                                     "connection failed (%d)",
-                                     new);
-                        }
-                        continue;
-                    }
-
-                    /* get a new session control block */
-                    if (!agt_ses_new_session(SES_TRANSPORT_SSH, new)) {
-                        close(new);
-                        if (LOGINFO) {
-                            log_info("\nagt_ncxserver new "
-                                     "session failed (%d)", 
-                                     new);
-                        }
-                    } else {
-                        /* set non-blocking IO */
-                        if (fcntl(new, F_SETFD, O_NONBLOCK)) {
-                            if (LOGINFO) {
-                                log_info("\nfnctl failed");
-                            }
-                        }
-                        FD_SET(new, &active_fd_set);
-                        if (new > maxrdnum) {
-                            maxrdnum = new;
-                        }
-                    }
-                } else {
-                    /* Data arriving on an already-connected socket.
-                     * Need to have the xmlreader for this session
-                     */
-                    scb = def_reg_find_scb(i);
-
-ses_accept_defered_input:
-                    if (scb != NULL) {
-                        res = ses_accept_input(scb);
-                        if (res != NO_ERR) {
-                            if (i >= maxrdnum) {
-                                maxrdnum = i-1;
-                            }
-                            if (res != ERR_NCX_SESSION_CLOSED) {
-                                if (LOGINFO) {
-                                    log_info("\nagt_ncxserver: input failed"
-                                             " for session %d (%s)",
-                                             scb->sid, 
-                                             get_error_string(res));
-                                }
-                                /* send an error reply instead of
-                                 * killing the session right now
-                                 */
-                                agt_rpc_send_error_reply(scb, res);
-                                agt_ses_request_close(scb, 
-                                                      0, 
-                                                      SES_TR_OTHER);
-                            } else {
-                                /* connection already closed
-                                 * so kill session right now
-                                 */
-                                agt_ses_kill_session(scb,
-                                                     scb->sid,
-                                                     SES_TR_DROPPED);
-                            }
-                        }
-                    }
-                }
+            /* check read input from client sessions; a hangup
+             * or error is reported by the read as well
+             */
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                read_session(scb);
             }
         }
 
+        /* accept a burst of connections at once */
+        for (i = 0; newconn && i < AGT_NCXSERVER_MAX_EVENTS; i++) {
+            newconn = accept_session(ncxsock);
+        }
+
+        /* run any timers that are due even if the
+         * sockets are always busy
+         */
+        agt_timer_handler();
+
+        /* send the notifications queued since the last loop */
+        if (notify) {
+            send_some_notifications();
+        }
+
         /* drain the ready queue before accepting new input */
-        if (!done) {
-            done2 = FALSE;
-            while (!done2) {
-                if (!agt_ses_process_first_ready()) {
-                    done2 = TRUE;
-                } else if (agt_shutdown_requested()) {
-                    done = done2 = TRUE;
-                } else {
-                    send_some_notifications();
-                }
-            }
-            if(scb && scb->indefer_len>0) {
-                /*
-                 * input defered until previous message
-                 * is processed e.g. <rpc> trailing <hello>
-                 */
-                log_debug3("\nagt_ncxserver: goto deferred trailing input processing.");
+        deferred = TRUE;
+        while (!done && deferred) {
+            done = process_ready_sessions();
 
-                goto ses_accept_defered_input;
+            /* input defered until previous message
+             * is processed e.g. <rpc> trailing <hello>
+             */
+            deferred = FALSE;
+            for (i = 0; i < ret && !done; i++) {
+                sid = (uint32)events[i].data.u64;
+                if (events[i].data.u64 == WAKEUP_EVENT_ID ||
+                    sid == NCXSOCK_EVENT_ID) {
+                    continue;
+                }
+                scb = agt_ses_get_session_for_id(sid);
+                if (scb && scb->indefer_len > 0) {
+                    log_debug3("\nagt_ncxserver: deferred trailing "
+                               "input processing.");
+                    read_session(scb);
+                    deferred = TRUE;
+                }
             }
         }
-    }  /* end select loop */
+    }  /* end epoll loop */
 
     /* all open client sockets will be closed as the sessions are
      * torn down, but the original ncxserver socket needs to be closed now
      */
+    agt_timer_delete(timer_id);
+    close(wakefd);
+    wakefd = -1;
+    close(epfd);
+    epfd = -1;
+    m__free(events);
     close(ncxsock);
     unlink(NCXSERVER_SOCKNAME);
     return NO_ERR;
@@ -522,7 +847,7 @@ ses_accept_defered_input:
 /********************************************************************
  * FUNCTION agt_ncxserver_clear_fd
  * 
- * Clear a dead session from the select loop
+ * Clear a dead session from the epoll set
  * 
  * INPUTS:
  *   fd == file descriptor number for the socket to clear
@@ -530,12 +855,39 @@ ses_accept_defered_input:
 void
     agt_ncxserver_clear_fd (int fd)
 {
-    FD_CLR(fd, &active_fd_set);
+    if (epfd >= 0 && fd > 0) {
+        (void)epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    }
 
 } /* agt_ncxserver_clear_fd */
 
 
-/* END agt_ncxserver.c */
+/********************************************************************
+ * FUNCTION agt_ncxserver_wakeup
+ * 
+ * Wake up the ncxserver loop to send the queued notifications
+ * Only the first call after the loop last ran writes the eventfd
+ *********************************************************************/
+void
+    agt_ncxserver_wakeup (void)
+{
+    uint64_t  one;
+
+    if (wakefd < 0 || wakeup_pending) {
+        return;
+    }
+
+    one = 1;
+    if (write(wakefd, &one, sizeof(one)) < 0) {
+        if (errno != EAGAIN && LOGDEBUG) {
+            log_debug("\nagt_ncxserver: wakeup write failed (%s)",
+                      strerror(errno));
+        }
+        return;
+    }
+    wakeup_pending = TRUE;
 
+} /* agt_ncxserver_wakeup */
 
 
+/* END agt_ncxserver.c */
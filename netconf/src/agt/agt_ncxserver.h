@@ -74,7 +74,7 @@ extern status_t
 /********************************************************************
  * FUNCTION agt_ncxserver_clear_fd
  * 
- * Clear a dead session from the select loop
+ * Clear a dead session from the epoll set
  * 
  * INPUTS:
  *   fd == file descriptor number for the socket to clear
@@ -82,6 +82,9 @@ extern status_t
 extern void
     agt_ncxserver_clear_fd (int fd);
 
+extern void
+    agt_ncxserver_wakeup (void);
+
 #ifdef __cplusplus
 }  /* end extern 'C' */
 #endif
@@ -53,11 +53,15 @@ date         init     comment
 #include "agt_acm.h"
 #include "agt_cap.h"
 #include "agt_cb.h"
+#include "agt_ncxserver.h"
 #include "agt_not.h"
+#include "agt_not_log.h"
 #include "agt_rpc.h"
 #include "agt_ses.h"
 #include "agt_tree.h"
 #include "agt_util.h"
+#include "agt_val_parse.h"
+#include "agt_xml.h"
 #include "agt_xpath.h"
 #include "agt_not_queue_notification_cb.h"
 #include "cfg.h"
@@ -119,6 +123,21 @@ date         init     comment
 *                                                                   *
 *********************************************************************/
 
+/* one notification encoded for a set of session output settings;
+ * every session with the same settings gets a reference to the
+ * same bytes instead of encoding the value tree again
+ */
+typedef struct agt_not_encoding_t_ {
+    dlq_hdr_t             qhdr;
+    const agt_not_msg_t  *notif;
+    uint32                msgid;
+    int32                 indent;
+    uint32                linesize;
+    ses_mode_t            mode;
+    boolean               noxmlns;
+    ses_msg_shared_t     *shared;
+} agt_not_encoding_t;
+
 
 /********************************************************************
 *                                                                   *
@@ -175,6 +194,15 @@ static uint32                msgid;
 /* keep track of eventlog size */
 static uint32                notification_count;
 
+/* eventTime of the oldest event in the --eventlog-dir log */
+static xmlChar               logstarttime[TSTAMP_MIN_SIZE];
+
+/* Q of agt_not_encoding_t
+ * notifications encoded during one agt_not_send_notifications
+ * call; cleared at the end of the call
+ */
+static dlq_hdr_t             encodingQ;
+
 /********************************************************************
 * FUNCTION free_subscription
 *
@@ -199,6 +227,9 @@ static void
     if (sub->filterval) {
         val_free_value(sub->filterval);
     }
+    if (sub->logcur) {
+        agt_not_log_close(sub->logcur);
+    }
     if (sub->scb) {
         sub->scb->notif_active = FALSE;
     }
@@ -617,7 +648,22 @@ static status_t
     (void)methnode;
     sub = (agt_not_subscription_t *)msg->rpc_user1;
 
-    if (sub->startTime) {
+    if (sub->startTime && agt_not_log_enabled()) {
+        /* replay the events up to now from the event log files;
+         * the events queued after this are sent from the
+         * notificationQ once the replay is done
+         */
+        sub->state = AGT_NOT_STATE_REPLAY;
+        sub->lastmsg = (agt_not_msg_t *)
+            dlq_lastEntry(&notificationQ);
+        sub->lastmsgid = (sub->lastmsg) ? sub->lastmsg->msgid : msgid;
+        sub->logendid = sub->lastmsgid;
+        sub->logcur = agt_not_log_open_time(sub->startTime);
+        if (!sub->logcur) {
+            /* the startTime is after the last logged event */
+            sub->flags |= AGT_NOT_FL_RC_READY;
+        }
+    } else if (sub->startTime) {
         /* this subscription has requested replay
          * go through the notificationQ and set
          * the start replay pointer
@@ -788,6 +834,256 @@ static agt_not_msg_t *
 } /* get_entry_after */
 
 
+/********************************************************************
+* FUNCTION encode_notification
+*
+* Encode a notification message the same way xml_wr_full_val
+* would write it to the specified session, into a shared buffer
+*
+* INPUTS:
+*   notif == notification to encode; notif->msg must be set
+*   scb == session to copy the output settings from
+*          NULL to use the default session settings
+*
+* RETURNS:
+*   malloced shared buffer with refcnt 1, or NULL if some error
+*********************************************************************/
+static ses_msg_shared_t *
+    encode_notification (agt_not_msg_t *notif,
+                         const ses_cb_t *scb)
+{
+    ses_cb_t          *encscb;
+    ses_msg_shared_t  *shared;
+    xml_msg_hdr_t      msghdr;
+    char              *data;
+    size_t             len;
+
+    encscb = ses_new_dummy_scb();
+    if (!encscb) {
+        return NULL;
+    }
+
+    data = NULL;
+    len = 0;
+    encscb->fp = open_memstream(&data, &len);
+    if (!encscb->fp) {
+        ses_free_scb(encscb);
+        return NULL;
+    }
+    if (scb) {
+        encscb->indent = scb->indent;
+        encscb->linesize = scb->linesize;
+        encscb->mode = scb->mode;
+        encscb->noxmlns = scb->noxmlns;
+    } else {
+        encscb->indent = agt_get_profile()->agt_indent;
+        encscb->linesize = agt_get_profile()->agt_linesize;
+    }
+
+    xml_msg_init_hdr(&msghdr);
+    xml_wr_full_val(encscb, &msghdr, notif->msg, 0);
+    xml_msg_clean_hdr(&msghdr);
+
+    shared = NULL;
+    if (fclose(encscb->fp) == 0) {
+        shared = ses_msg_new_shared((const xmlChar *)data, len);
+    }
+    encscb->fp = NULL;
+    free(data);
+    ses_free_scb(encscb);
+
+    return shared;
+
+}  /* encode_notification */
+
+
+/********************************************************************
+* FUNCTION get_encoding
+*
+* Get the shared encoding of a notification for a session,
+* encoding it the first time it is needed for the
+* output settings of that session
+*
+* INPUTS:
+*   notif == notification to use; notif->msg must be set
+*   scb == session the notification will be sent to
+*
+* RETURNS:
+*   shared buffer (owned by the encodingQ), or NULL if some error
+*********************************************************************/
+static ses_msg_shared_t *
+    get_encoding (agt_not_msg_t *notif,
+                  const ses_cb_t *scb)
+{
+    agt_not_encoding_t  *enc;
+
+    for (enc = (agt_not_encoding_t *)dlq_firstEntry(&encodingQ);
+         enc != NULL;
+         enc = (agt_not_encoding_t *)dlq_nextEntry(enc)) {
+        if (enc->notif == notif &&
+            enc->msgid == notif->msgid &&
+            enc->indent == scb->indent &&
+            enc->linesize == scb->linesize &&
+            enc->mode == scb->mode &&
+            enc->noxmlns == scb->noxmlns) {
+            return enc->shared;
+        }
+    }
+
+    enc = m__getObj(agt_not_encoding_t);
+    if (!enc) {
+        return NULL;
+    }
+    memset(enc, 0x0, sizeof(agt_not_encoding_t));
+
+    enc->shared = encode_notification(notif, scb);
+    if (!enc->shared) {
+        m__free(enc);
+        return NULL;
+    }
+    enc->notif = notif;
+    enc->msgid = notif->msgid;
+    enc->indent = scb->indent;
+    enc->linesize = scb->linesize;
+    enc->mode = scb->mode;
+    enc->noxmlns = scb->noxmlns;
+    dlq_enque(enc, &encodingQ);
+
+    return enc->shared;
+
+}  /* get_encoding */
+
+
+/********************************************************************
+* FUNCTION clean_encodings
+*
+* Release all the notification encodings in the encodingQ
+* Sessions that still have the bytes queued for output
+* keep their own reference
+*
+*********************************************************************/
+static void
+    clean_encodings (void)
+{
+    agt_not_encoding_t  *enc;
+
+    while (!dlq_empty(&encodingQ)) {
+        enc = (agt_not_encoding_t *)dlq_deque(&encodingQ);
+        ses_msg_release_shared(enc->shared);
+        m__free(enc);
+    }
+
+}  /* clean_encodings */
+
+
+/********************************************************************
+* FUNCTION subscription_blocked
+*
+* Check if a subscription has to wait for its session
+* to write out the notifications already queued
+*
+* INPUTS:
+*   sub == subscription to check
+*
+* RETURNS:
+*   TRUE if the session outQ is over the backpressure limit
+*   FALSE if notifications can be sent to the session
+*********************************************************************/
+static boolean
+    subscription_blocked (const agt_not_subscription_t *sub)
+{
+    /* a stream output session blocks the server until the
+     * socket takes more data once a full chunk is queued,
+     * so stop at half a chunk and let the ncxserver loop
+     * write it out first
+     */
+    return (sub->scb != NULL &&
+            sub->scb->outq_bytes >= (sub->scb->out_chunksize / 2));
+
+}  /* subscription_blocked */
+
+
+/********************************************************************
+* FUNCTION build_notification_msg
+*
+* Construct the /notification element for a notification
+* The payloadQ is moved into the new value tree
+*
+* INPUTS:
+*   notif == notification to use
+*   usemsgid == TRUE to add the sequence-id if enabled
+*
+* OUTPUTS:
+*   notif->msg and notif->event are set
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    build_notification_msg (agt_not_msg_t *notif,
+                            boolean usemsgid)
+{
+    const agt_profile_t *profile;
+    val_value_t         *topval, *eventTime;
+    val_value_t         *eventType, *payloadval, *sequenceid;
+    status_t             res;
+    xmlChar              numbuff[NCX_MAX_NUMLEN];
+
+    topval = val_new_value();
+    if (!topval) {
+        log_error("\nError: malloc failed: cannot send notification");
+        return ERR_INTERNAL_MEM;
+    }
+    val_init_from_template(topval, notificationobj);
+
+    eventTime = val_make_simval_obj(eventTimeobj, notif->eventTime, &res);
+    if (!eventTime) {
+        log_error("\nError: make simval failed (%s): cannot "
+                  "send notification", 
+                  get_error_string(res));
+        val_free_value(topval);
+        return res;
+    }
+    val_add_child(eventTime, topval);
+
+    eventType = val_new_value();
+    if (!eventType) {
+        log_error("\nError: malloc failed: cannot send notification");
+        val_free_value(topval);
+        return ERR_INTERNAL_MEM;
+    }
+    val_init_from_template(eventType, notif->notobj);
+    val_add_child(eventType, topval);
+    notif->event = eventType;
+
+    /* move the payloadQ: transfer the memory here */
+    while (!dlq_empty(&notif->payloadQ)) {
+        payloadval = (val_value_t *)dlq_deque(&notif->payloadQ);
+        val_add_child(payloadval, eventType);
+    }
+
+    /* only use a msgid on a real event, not replay
+     * also only use if enabled in the agt_profile
+     */
+    profile = agt_get_profile();
+    if (usemsgid && profile->agt_notif_sequence_id) {
+        snprintf((char *)numbuff, sizeof(numbuff), "%u", notif->msgid);
+        sequenceid = val_make_simval_obj(sequenceidobj, numbuff, &res);
+        if (!sequenceid) {
+            log_error("\nError: malloc failed: cannot "
+                      "add sequence-id");
+        } else {
+            val_add_child(sequenceid, topval);
+        }
+    }
+
+    notif->msg = topval;
+
+    return NO_ERR;
+
+}  /* build_notification_msg */
+
+
 /********************************************************************
 * FUNCTION send_notification
 *
@@ -813,69 +1109,21 @@ static status_t
                        agt_not_msg_t *notif,
                        boolean checkfilter)
 {
-    val_value_t        *topval, *eventTime;
-    val_value_t        *eventType, *payloadval, *sequenceid;
     ses_total_stats_t  *totalstats;
+    ses_msg_shared_t   *shared;
     xml_msg_hdr_t       msghdr;
     status_t            res;
     boolean             filterpassed;
-    xmlChar             numbuff[NCX_MAX_NUMLEN];
 
     filterpassed = TRUE;
 
     totalstats = ses_get_total_stats();
 
     if (!notif->msg) {
-        /* need to construct the notification msg */
-        topval = val_new_value();
-        if (!topval) {
-            log_error("\nError: malloc failed: cannot send notification");
-            return ERR_INTERNAL_MEM;
-        }
-        val_init_from_template(topval, notificationobj);
-
-        eventTime = val_make_simval_obj(eventTimeobj, notif->eventTime, &res);
-        if (!eventTime) {
-            log_error("\nError: make simval failed (%s): cannot "
-                      "send notification", 
-                      get_error_string(res));
-            val_free_value(topval);
+        res = build_notification_msg(notif, checkfilter);
+        if (res != NO_ERR) {
             return res;
         }
-        val_add_child(eventTime, topval);
-
-        eventType = val_new_value();
-        if (!eventType) {
-            log_error("\nError: malloc failed: cannot send notification");
-            val_free_value(topval);
-            return ERR_INTERNAL_MEM;
-        }
-        val_init_from_template(eventType, notif->notobj);
-        val_add_child(eventType, topval);
-        notif->event = eventType;
-
-        /* move the payloadQ: transfer the memory here */
-        while (!dlq_empty(&notif->payloadQ)) {
-            payloadval = (val_value_t *)dlq_deque(&notif->payloadQ);
-            val_add_child(payloadval, eventType);
-        }
-
-        /* only use a msgid on a real event, not replay
-         * also only use if enabled in the agt_profile
-         */
-        agt_profile_t *profile = agt_get_profile();
-        if (checkfilter && profile->agt_notif_sequence_id) { 
-            snprintf((char *)numbuff, sizeof(numbuff), "%u", notif->msgid);
-            sequenceid = val_make_simval_obj(sequenceidobj, numbuff, &res);
-            if (!sequenceid) {
-                log_error("\nError: malloc failed: cannot "
-                          "add sequence-id");
-            } else {
-                val_add_child(sequenceid, topval);
-            }
-        }
-
-        notif->msg = topval;
     }
 
     /* create an RPC message header struct */
@@ -883,6 +1131,13 @@ static status_t
 
     /* check if any filtering is needed */
     if (checkfilter && sub->filterval) {
+        /* the filter only selects nodes the user can read */
+        res = agt_acm_init_msg_cache(sub->scb, &msghdr);
+        if (res != NO_ERR) {
+            xml_msg_clean_hdr(&msghdr);
+            return res;
+        }
+
         switch (sub->filtertyp) {
         case OP_FILTER_SUBTREE:
             filterpassed = 
@@ -903,6 +1158,7 @@ static status_t
             filterpassed = FALSE;
             SET_ERROR(ERR_INTERNAL_VAL);
         }
+        agt_acm_clear_msg_cache(&msghdr);
 
         if (filterpassed) {
             if (LOGDEBUG2) {
@@ -923,9 +1179,28 @@ static status_t
             xml_msg_clean_hdr(&msghdr);
             return res;
         }
-        xml_wr_full_val(sub->scb, &msghdr, notif->msg, 0);
+
+        /* replay buffer events are encoded once per output
+         * setting and shared by all the subscriptions;
+         * the one-time replayComplete and notificationComplete
+         * events are written directly
+         */
+        shared = (checkfilter) ? get_encoding(notif, sub->scb) : NULL;
+        if (shared) {
+            ses_putshared(sub->scb, shared);
+        } else {
+            xml_wr_full_val(sub->scb, &msghdr, notif->msg, 0);
+        }
         ses_finish_msg(sub->scb);
 
+        /* track the delivery latency of live events only;
+         * replayed events were queued long before
+         */
+        if (checkfilter && sub->state != AGT_NOT_STATE_REPLAY &&
+            notif->queuetime) {
+            ses_msg_stamp_outmsg(sub->scb, notif->queuetime);
+        }
+
         sub->scb->stats.outNotifications++;
         totalstats->stats.outNotifications++;
 
@@ -1048,6 +1323,356 @@ static agt_not_msg_t *
 }  /* new_notification */
 
 
+/********************************************************************
+* FUNCTION log_notification
+*
+* Write a queued notification to the event log
+*
+* INPUTS:
+*   notif == notification to log; notif->msg is built if needed
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    log_notification (agt_not_msg_t *notif)
+{
+    ses_msg_shared_t  *shared;
+    status_t           res;
+
+    if (!notif->msg) {
+        res = build_notification_msg(notif, TRUE);
+        if (res != NO_ERR) {
+            return res;
+        }
+    }
+
+    shared = encode_notification(notif, NULL);
+    if (!shared) {
+        return ERR_INTERNAL_MEM;
+    }
+
+    res = agt_not_log_append(notif->msgid,
+                             notif->eventTime,
+                             notif->notobj,
+                             shared->data,
+                             (uint32)shared->len);
+    ses_msg_release_shared(shared);
+    return res;
+
+}  /* log_notification */
+
+
+/********************************************************************
+* FUNCTION parse_log_event
+*
+* Parse the event element of a logged notification
+* back into a value tree, so a filter can be tested on it
+*
+* INPUTS:
+*   rec == event log record to parse
+*   notobj == event type of the record
+*
+* RETURNS:
+*   malloced notification with msg and event set,
+*   or NULL if some error
+*********************************************************************/
+static agt_not_msg_t *
+    parse_log_event (const agt_not_logrec_t *rec,
+                     obj_template_t *notobj)
+{
+    agt_not_msg_t  *notif;
+    ses_cb_t       *scb;
+    val_value_t    *eventval, *childval;
+    xml_msg_hdr_t   msghdr;
+    xml_node_t      node;
+    status_t        res;
+
+    scb = ses_new_dummy_scb();
+    if (!scb) {
+        return NULL;
+    }
+    res = xml_get_reader_from_memory(rec->xml, rec->xmllen, &scb->reader);
+    if (res != NO_ERR) {
+        ses_free_scb(scb);
+        return NULL;
+    }
+
+    xml_msg_init_hdr(&msghdr);
+    xml_init_node(&node);
+
+    /* skip <notification> and <eventTime> to get
+     * the start node of the event element
+     */
+    for (;;) {
+        res = agt_xml_consume_node(scb, &node, NCX_LAYER_NONE, NULL);
+        if (res != NO_ERR) {
+            break;
+        }
+        if (node.depth == 1 &&
+            (node.nodetyp == XML_NT_START ||
+             node.nodetyp == XML_NT_EMPTY) &&
+            !xml_strcmp(node.elname, obj_get_name(notobj))) {
+            break;
+        }
+        xml_clean_node(&node);
+    }
+
+    notif = NULL;
+    eventval = NULL;
+    if (res == NO_ERR) {
+        eventval = val_new_value();
+        if (!eventval) {
+            res = ERR_INTERNAL_MEM;
+        }
+    }
+    if (res == NO_ERR) {
+        val_init_from_template(eventval, notobj);
+        res = agt_val_parse_nc(scb, &msghdr, notobj, &node,
+                               NCX_DC_STATE, eventval);
+    }
+    if (res == NO_ERR) {
+        notif = new_notification(notobj, FALSE);
+        if (!notif) {
+            res = ERR_INTERNAL_MEM;
+        }
+    }
+    if (res == NO_ERR) {
+        /* the parsed event children become the payload */
+        notif->msgid = rec->msgid;
+        xml_strcpy(notif->eventTime, rec->eventTime);
+        while ((childval = val_get_first_child(eventval)) != NULL) {
+            val_remove_child(childval);
+            agt_not_add_to_payload(notif, childval);
+        }
+        res = build_notification_msg(notif, FALSE);
+        if (res != NO_ERR) {
+            agt_not_free_notification(notif);
+            notif = NULL;
+        }
+    }
+
+    if (eventval) {
+        val_free_value(eventval);
+    }
+    if (res != NO_ERR) {
+        log_error("\nError: parse logged <%s> (%u) failed (%s)",
+                  obj_get_name(notobj),
+                  rec->msgid,
+                  get_error_string(res));
+    }
+    xml_clean_node(&node);
+    xml_msg_clean_hdr(&msghdr);
+    ses_free_scb(scb);
+    return notif;
+
+}  /* parse_log_event */
+
+
+/********************************************************************
+* FUNCTION send_log_record
+*
+* Send a notification from the event log to a subscription
+* The logged bytes are sent as-is; the event is only parsed
+* again if the subscription has a filter
+*
+* INPUTS:
+*   sub == subscription to use
+*   rec == event log record to send
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    send_log_record (agt_not_subscription_t *sub,
+                     const agt_not_logrec_t *rec)
+{
+    ncx_module_t       *mod;
+    obj_template_t     *notobj;
+    agt_not_msg_t      *notif;
+    ses_total_stats_t  *totalstats;
+    xml_msg_hdr_t       msghdr;
+    status_t            res;
+    boolean             filterpassed;
+
+    mod = ncx_find_module(rec->modname, NULL);
+    notobj = (mod) ? 
+        obj_find_template_top(mod, rec->modname, rec->name) : NULL;
+    if (!notobj || notobj->objtype != OBJ_TYP_NOTIF) {
+        log_debug("\nagt_not: Skipping logged <%s> (%u); "
+                  "module '%s' not loaded",
+                  rec->name,
+                  rec->msgid,
+                  rec->modname);
+        return NO_ERR;
+    }
+
+    if (!agt_acm_notif_allowed(sub->scb->username, notobj)) {
+        log_debug("\nAccess denied to user '%s' "
+                  "for notification '%s'",
+                  sub->scb->username,
+                  obj_get_name(notobj));
+        return NO_ERR;
+    }
+
+    if (sub->filterval) {
+        notif = parse_log_event(rec, notobj);
+        if (!notif) {
+            return NO_ERR;
+        }
+
+        xml_msg_init_hdr(&msghdr);
+        res = agt_acm_init_msg_cache(sub->scb, &msghdr);
+        if (res != NO_ERR) {
+            xml_msg_clean_hdr(&msghdr);
+            agt_not_free_notification(notif);
+            return res;
+        }
+
+        switch (sub->filtertyp) {
+        case OP_FILTER_SUBTREE:
+            filterpassed = 
+                agt_tree_test_filter(&msghdr,
+                                     sub->scb,
+                                     sub->filterval,
+                                     notif->event);
+            break;
+        case OP_FILTER_XPATH:
+            filterpassed = 
+                agt_xpath_test_filter(&msghdr,
+                                      sub->scb,
+                                      sub->selectval,
+                                      notif->event);
+            break;
+        case OP_FILTER_NONE:
+        default:
+            filterpassed = FALSE;
+            SET_ERROR(ERR_INTERNAL_VAL);
+        }
+        agt_acm_clear_msg_cache(&msghdr);
+        xml_msg_clean_hdr(&msghdr);
+        agt_not_free_notification(notif);
+
+        if (!filterpassed) {
+            if (LOGDEBUG) {
+                log_debug("\nagt_not: filter failed");
+            }
+            return NO_ERR;
+        }
+    }
+
+    res = ses_start_msg(sub->scb);
+    if (res != NO_ERR) {
+        log_error("\nError: cannot start notification");
+        return res;
+    }
+    ses_putbytes(sub->scb, rec->xml, rec->xmllen);
+    ses_finish_msg(sub->scb);
+
+    totalstats = ses_get_total_stats();
+    sub->scb->stats.outNotifications++;
+    totalstats->stats.outNotifications++;
+
+    if (LOGDEBUG) {
+        log_debug("\nagt_not: Sent logged <%s> (%u) on '%s' stream "
+                  "for session '%u'",
+                  rec->name,
+                  rec->msgid,
+                  sub->stream,
+                  sub->scb->sid);
+    }
+    return NO_ERR;
+
+}  /* send_log_record */
+
+
+/********************************************************************
+* FUNCTION send_log_next
+*
+* Send the next notification from the event log cursor
+* of a subscription, up to sub->logendid
+*
+* INPUTS:
+*   sub == subscription to use; sub->logcur must be set
+*   notcount == address of notification count to update
+*
+* OUTPUTS:
+*   *notcount incremented if a record was processed
+*   sub->logcur is closed and cleared when the end is reached
+*
+* RETURNS:
+*   TRUE if a record was processed; FALSE if the end was reached
+*********************************************************************/
+static boolean
+    send_log_next (agt_not_subscription_t *sub,
+                   uint32 *notcount)
+{
+    const agt_not_logrec_t  *rec;
+    status_t                 res;
+
+    rec = agt_not_log_read(sub->logcur);
+    if (rec && rec->msgid <= sub->logendid &&
+        !(sub->state == AGT_NOT_STATE_REPLAY && sub->stopTime &&
+          !(sub->flags & AGT_NOT_FL_FUTURESTOP) &&
+          xml_strcmp(sub->stopTime, rec->eventTime) < 0)) {
+
+        /* counted even if filtered out, so the ncxserver
+         * loop keeps calling until the replay is done
+         */
+        (*notcount)++;
+        res = send_log_record(sub, rec);
+        if (res != NO_ERR && NEED_EXIT(res)) {
+            /* treat as a fatal error */
+            sub->state = AGT_NOT_STATE_SHUTDOWN;
+        }
+        return TRUE;
+    }
+
+    agt_not_log_close(sub->logcur);
+    sub->logcur = NULL;
+    return FALSE;
+
+}  /* send_log_next */
+
+
+/********************************************************************
+* FUNCTION check_log_catchup
+*
+* Check if a live subscription fell behind the start of the
+* replay buffer, and send the missed events from the event log
+*
+* INPUTS:
+*   sub == subscription to check
+*
+* OUTPUTS:
+*   sub->logcur and sub->logendid set if events were missed
+*********************************************************************/
+static void
+    check_log_catchup (agt_not_subscription_t *sub)
+{
+    agt_not_msg_t  *not;
+
+    if (sub->logcur || sub->lastmsg || !sub->lastmsgid ||
+        !agt_not_log_enabled()) {
+        return;
+    }
+
+    not = get_entry_after(sub->lastmsgid);
+    if (not && not->msgid > sub->lastmsgid + 1) {
+        sub->logcur = agt_not_log_open_id(sub->lastmsgid + 1);
+        sub->logendid = not->msgid - 1;
+        if (LOGDEBUG && sub->logcur) {
+            log_debug("\nagt_not: Session '%u' missed events %u to %u; "
+                      "sending them from the event log",
+                      sub->scb->sid,
+                      sub->lastmsgid + 1,
+                      sub->logendid);
+        }
+    }
+
+}  /* check_log_catchup */
+
+
 /********************************************************************
 * FUNCTION send_replayComplete
 *
@@ -1129,6 +1754,7 @@ static void
     anySubscriptions = FALSE;
     msgid = 0;
     notification_count = 0;
+    logstarttime[0] = 0;
 
 } /* init_static_vars */
 
@@ -1163,6 +1789,7 @@ status_t
 
     dlq_createSQue(&subscriptionQ);
     dlq_createSQue(&notificationQ);
+    dlq_createSQue(&encodingQ);
     init_static_vars();
     agt_not_init_done = TRUE;
 
@@ -1221,6 +1848,18 @@ status_t
         return SET_ERROR(ERR_NCX_DEF_NOT_FOUND);
     }
 
+    /* open the event log before any notification is created
+     * so the sequence-ids continue from the last logged event
+     */
+    if (agt_profile->agt_eventlog_dir) {
+        res = agt_not_log_init(agt_profile->agt_eventlog_dir,
+                               &msgid,
+                               logstarttime);
+        if (res != NO_ERR) {
+            return res;
+        }
+    }
+
     return NO_ERR;
 
 }  /* agt_not_init */
@@ -1382,8 +2021,14 @@ status_t
     }
     val_add_child(childval, streamval);
 
-    /* set replay start time to now */
-    tstamp_datetime(tstampbuff);
+    /* set replay start time to now, or to the oldest
+     * event kept in the event log
+     */
+    if (logstarttime[0]) {
+        xml_strcpy(tstampbuff, logstarttime);
+    } else {
+        tstamp_datetime(tstampbuff);
+    }
 
     /* add /netconf/streams/stream/replayLogCreationTime */
     childval = val_make_simval_obj(replayLogCreationTimeobj,
@@ -1434,6 +2079,10 @@ void
             agt_not_free_notification(msg);
         }
 
+        clean_encodings();
+
+        agt_not_log_cleanup();
+
         agt_not_init_done = FALSE;
     }
 
@@ -1448,9 +2097,11 @@ void
 *
 * Simple design:
 *   go through all the subscriptions and send at most one 
-*   notification to each one if needed.  This will build
-*   in some throttling based on the ncxserver select loop
-*   timeout (or however this function is called).
+*   notification to each one if needed.  The ncxserver loop
+*   calls this function until --maxburst is reached, in between
+*   socket events, so delivery is round-robin across sessions.
+*   Subscriptions whose session still has half a chunk
+*   or more waiting in its outQ are skipped.
 *
 * OUTPUTS:
 *     notifications may be written to some active sessions
@@ -1483,6 +2134,14 @@ uint32
 
         nextsub = (agt_not_subscription_t *)dlq_nextEntry(sub);
 
+        /* a slow subscriber does not hold up the others;
+         * it is retried once its session socket drains
+         */
+        if (sub->state != AGT_NOT_STATE_SHUTDOWN &&
+            subscription_blocked(sub)) {
+            continue;
+        }
+
         switch (sub->state) {
         case AGT_NOT_STATE_NONE:
         case AGT_NOT_STATE_INIT:
@@ -1527,6 +2186,19 @@ uint32
                     notcount++;
                     /* figure out the rest next time through fn */
                 }
+            } else if (sub->logcur) {
+                /* still sending replay notifications
+                 * from the event log
+                 */
+                if (!send_log_next(sub, &notcount)) {
+                    /* log is done; send <replayComplete> now
+                     * and figure out the rest next time through fn
+                     */
+                    sub->flags |= AGT_NOT_FL_RC_READY;
+                    send_replayComplete(sub);
+                    sub->flags |= AGT_NOT_FL_RC_DONE;
+                    notcount++;
+                }
             } else {
                 /* still sending replay notifications
                  * figure out which one to send next
@@ -1648,6 +2320,19 @@ uint32
             } /* else stopTime still in the future */
             break;
         case AGT_NOT_STATE_LIVE:
+            /* events deleted from the replay buffer before
+             * they were sent are read back from the event log
+             */
+            check_log_catchup(sub);
+            if (sub->logcur) {
+                if (send_log_next(sub, &notcount)) {
+                    if (sub->state == AGT_NOT_STATE_LIVE) {
+                        sub->lastmsgid = sub->logcur->rec.msgid;
+                    }
+                    break;
+                }
+                sub->lastmsgid = sub->logendid;
+            }
             if (sub->lastmsg) {
                 not = (agt_not_msg_t *)dlq_nextEntry(sub->lastmsg);
             } else if (sub->lastmsgid) {
@@ -1698,6 +2383,9 @@ uint32
             SET_ERROR(ERR_INTERNAL_VAL);
         }
     }
+
+    clean_encodings();
+
     return notcount;
 
 }  /* agt_not_send_notifications */
@@ -1919,6 +2607,7 @@ void
 *
 * OUTPUTS:
 *   message added to the notificationQ
+*   ncxserver loop woken up to send it
 *
 *********************************************************************/
 void
@@ -1974,8 +2663,18 @@ void
          */
         dlq_enque(notif, &notificationQ);
     }
+    notif->queuetime = ses_msg_get_usec();
     agt_not_queue_notification_cb(notif);
 
+    if (agt_not_log_enabled() && log_notification(notif) != NO_ERR) {
+        log_error("\nError: cannot add notification (id: %u) "
+                  "to the event log",
+                  notif->msgid);
+    }
+
+    /* get the ncxserver loop to send it right away */
+    agt_ncxserver_wakeup();
+
 }  /* agt_not_queue_notification */
 
 
@@ -32,6 +32,10 @@ date             init     comment
 
 #include <xmlstring.h>
 
+#ifndef _H_agt_not_log
+#include "agt_not_log.h"
+#endif
+
 #ifndef _H_dlq
 #include "dlq.h"
 #endif
@@ -138,6 +142,7 @@ typedef struct agt_not_msg_t_ {
     xmlChar                  eventTime[TSTAMP_MIN_SIZE];
     val_value_t             *msg;     /* /notification element */
     val_value_t             *event;  /* ptr inside msg for filter */
+    uint64                   queuetime;   /* usec when queued */
 } agt_not_msg_t;
 
 
@@ -161,6 +166,8 @@ typedef struct agt_not_subscription_t_ {
     uint32                firstreplaymsgid; /* w/firstreplaymsg is deleted */
     uint32                lastreplaymsgid;  /* w/lastreplaymsg is deleted */
     uint32                lastmsgid;        /* w/ lastmsg is deleted */
+    agt_not_log_cursor_t *logcur;     /* replay from --eventlog-dir */
+    uint32                logendid;   /* last msgid to send from logcur */
     agt_not_state_t       state;
 } agt_not_subscription_t;
 
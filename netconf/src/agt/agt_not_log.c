@@ -0,0 +1,1276 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*  FILE: agt_not_log.c
+
+    Persistent notification replay log
+
+    Each segment file is a sequence of records:
+
+       log_hdr_t                 fixed size header
+       modname\0name\0           event type, hdr.namelen bytes
+       <notification>...         encoded message, hdr.xmllen bytes
+
+    Records are only appended to the newest segment.  A new
+    segment is started once the current one is full, and the
+    oldest segments are deleted to limit the disk space used.
+
+*********************************************************************
+*                                                                   *
+*                  C H A N G E   H I S T O R Y                      *
+*                                                                   *
+*********************************************************************
+
+date         init     comment
+----------------------------------------------------------------------
+17oct26               begun
+
+*********************************************************************
+*                                                                   *
+*                     I N C L U D E    F I L E S                    *
+*                                                                   *
+*********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "procdefs.h"
+#include "agt_not_log.h"
+#include "dlq.h"
+#include "log.h"
+#include "ncx.h"
+#include "obj.h"
+#include "status.h"
+#include "tstamp.h"
+#include "xml_util.h"
+
+/********************************************************************
+*                                                                   *
+*                       C O N S T A N T S                           *
+*                                                                   *
+*********************************************************************/
+
+/* 'NLOG' marker at the start of every record header */
+#define LOG_MAGIC          0x4e4c4f47
+
+/* sanity limits checked when a record header is read */
+#define LOG_MAX_NAMELEN    1024
+#define LOG_MAX_XMLLEN     0x4000000
+
+/* sequence-id is printed with 10 digits so the
+ * segment file names sort in sequence-id order
+ */
+#define LOG_ID_FORMAT      "%010u"
+
+
+/********************************************************************
+*                                                                   *
+*                             T Y P E S                             *
+*                                                                   *
+*********************************************************************/
+
+/* record header as written to the segment file */
+typedef struct log_hdr_t_ {
+    uint32           magic;
+    uint32           msgid;
+    uint32           namelen;
+    uint32           xmllen;
+    char             eventTime[TSTAMP_MIN_SIZE];
+} log_hdr_t;
+
+
+/* one sparse index entry; record position in a segment */
+typedef struct log_index_t_ {
+    uint32           msgid;
+    long             offset;
+    xmlChar          eventTime[TSTAMP_MIN_SIZE];
+} log_index_t;
+
+
+/* one segment file */
+typedef struct log_segment_t_ {
+    dlq_hdr_t        qhdr;
+    xmlChar         *filespec;
+    uint32           firstid;          /* from the file name */
+    uint32           count;               /* if indexed set */
+    long             size;                /* if indexed set */
+    xmlChar          firsttime[TSTAMP_MIN_SIZE];
+    log_index_t     *index;              /* malloced array */
+    uint32           indexcnt;
+    uint32           indexmax;
+    boolean          indexed;
+} log_segment_t;
+
+
+/********************************************************************
+*                                                                   *
+*                       V A R I A B L E S                            *
+*                                                                   *
+*********************************************************************/
+
+static boolean agt_not_log_init_done = FALSE;
+
+/* malloced event log directory */
+static xmlChar       *logdir;
+
+/* Q of log_segment_t, oldest first */
+static dlq_hdr_t      segmentQ;
+
+static uint32         segment_count;
+
+/* append stream for the last segment in the segmentQ */
+static FILE          *writefp;
+
+
+/********************************************************************
+* FUNCTION make_filespec
+*
+* Make the file name for a segment
+*
+* INPUTS:
+*   firstid == sequence-id of the first record in the segment
+*
+* RETURNS:
+*   malloced filespec, or NULL if malloc failed
+*********************************************************************/
+static xmlChar *
+    make_filespec (uint32 firstid)
+{
+    xmlChar  *filespec;
+    uint32    len;
+
+    len = xml_strlen(logdir) + 1 + xml_strlen((const xmlChar *)
+                                              AGT_NOT_LOG_PREFIX) +
+        NCX_MAX_NUMLEN + xml_strlen((const xmlChar *)AGT_NOT_LOG_SUFFIX) + 1;
+
+    filespec = m__getMem(len);
+    if (filespec) {
+        snprintf((char *)filespec, len, "%s/%s" LOG_ID_FORMAT "%s",
+                 logdir, AGT_NOT_LOG_PREFIX, firstid, AGT_NOT_LOG_SUFFIX);
+    }
+    return filespec;
+
+}  /* make_filespec */
+
+
+/********************************************************************
+* FUNCTION new_segment
+*
+* Malloc a segment entry
+*
+* INPUTS:
+*   firstid == sequence-id of the first record in the segment
+*
+* RETURNS:
+*   malloced segment, or NULL if malloc failed
+*********************************************************************/
+static log_segment_t *
+    new_segment (uint32 firstid)
+{
+    log_segment_t  *seg;
+
+    seg = m__getObj(log_segment_t);
+    if (!seg) {
+        return NULL;
+    }
+    memset(seg, 0x0, sizeof(log_segment_t));
+
+    seg->filespec = make_filespec(firstid);
+    if (!seg->filespec) {
+        m__free(seg);
+        return NULL;
+    }
+    seg->firstid = firstid;
+    return seg;
+
+}  /* new_segment */
+
+
+/********************************************************************
+* FUNCTION free_segment
+*
+* Free a segment entry
+*
+* INPUTS:
+*   seg == segment to free
+*********************************************************************/
+static void
+    free_segment (log_segment_t *seg)
+{
+    if (seg->index) {
+        free(seg->index);
+    }
+    m__free(seg->filespec);
+    m__free(seg);
+
+}  /* free_segment */
+
+
+/********************************************************************
+* FUNCTION add_index
+*
+* Add a sparse index entry to a segment
+*
+* INPUTS:
+*   seg == segment to use
+*   msgid == sequence-id of the record
+*   eventTime == eventTime of the record
+*   offset == file position of the record
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_index (log_segment_t *seg,
+               uint32 msgid,
+               const xmlChar *eventTime,
+               long offset)
+{
+    log_index_t  *newindex;
+    uint32        newmax;
+
+    if (seg->indexcnt == seg->indexmax) {
+        newmax = (seg->indexmax) ? seg->indexmax * 2 : 64;
+        newindex = (log_index_t *)
+            realloc(seg->index, newmax * sizeof(log_index_t));
+        if (!newindex) {
+            return ERR_INTERNAL_MEM;
+        }
+        seg->index = newindex;
+        seg->indexmax = newmax;
+    }
+
+    seg->index[seg->indexcnt].msgid = msgid;
+    seg->index[seg->indexcnt].offset = offset;
+    xml_strncpy(seg->index[seg->indexcnt].eventTime, eventTime,
+                TSTAMP_MIN_SIZE - 1);
+    seg->indexcnt++;
+    return NO_ERR;
+
+}  /* add_index */
+
+
+/********************************************************************
+* FUNCTION read_hdr
+*
+* Read and check one record header
+*
+* INPUTS:
+*   fp == file positioned at a record
+*   hdr == header to fill in
+*
+* RETURNS:
+*   NO_ERR if a valid header was read
+*   ERR_NCX_EOF if the end of the file was reached
+*   ERR_NCX_INVALID_VALUE if the header is not valid
+*********************************************************************/
+static status_t
+    read_hdr (FILE *fp,
+              log_hdr_t *hdr)
+{
+    if (fread(hdr, sizeof(log_hdr_t), 1, fp) != 1) {
+        return ERR_NCX_EOF;
+    }
+    if (hdr->magic != LOG_MAGIC ||
+        hdr->namelen < 4 || hdr->namelen > LOG_MAX_NAMELEN ||
+        hdr->xmllen > LOG_MAX_XMLLEN ||
+        hdr->eventTime[TSTAMP_MIN_SIZE - 1] != 0) {
+        return ERR_NCX_INVALID_VALUE;
+    }
+    return NO_ERR;
+
+}  /* read_hdr */
+
+
+/********************************************************************
+* FUNCTION index_segment
+*
+* Scan the record headers in a segment file to build
+* the sparse index and get the record count and size
+*
+* INPUTS:
+*   seg == segment to index
+*   dotruncate == TRUE to cut off a partial or bad record
+*               at the end of the file
+*   lastmsgid == address of return last sequence-id
+*
+* OUTPUTS:
+*   *lastmsgid == sequence-id of the last record, 0 if none
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    index_segment (log_segment_t *seg,
+                   boolean dotruncate,
+                   uint32 *lastmsgid)
+{
+    FILE         *fp;
+    struct stat   statbuf;
+    log_hdr_t     hdr;
+    long          offset, reclen;
+    status_t      res;
+
+    *lastmsgid = 0;
+    seg->count = 0;
+    seg->size = 0;
+    seg->indexcnt = 0;
+    seg->firsttime[0] = 0;
+
+    fp = fopen((const char *)seg->filespec, "r");
+    if (!fp) {
+        return errno_to_status();
+    }
+    if (fstat(fileno(fp), &statbuf) != 0) {
+        res = errno_to_status();
+        fclose(fp);
+        return res;
+    }
+
+    res = NO_ERR;
+    offset = 0;
+    while (res == NO_ERR) {
+        if (read_hdr(fp, &hdr) != NO_ERR) {
+            break;
+        }
+        reclen = (long)(sizeof(log_hdr_t) + hdr.namelen + hdr.xmllen);
+        if (offset + reclen > (long)statbuf.st_size) {
+            break;
+        }
+
+        if (seg->count % AGT_NOT_LOG_INDEX_STEP == 0) {
+            res = add_index(seg, hdr.msgid,
+                            (const xmlChar *)hdr.eventTime, offset);
+        }
+        if (seg->count == 0) {
+            xml_strncpy(seg->firsttime, (const xmlChar *)hdr.eventTime,
+                        TSTAMP_MIN_SIZE - 1);
+        }
+        seg->count++;
+        *lastmsgid = hdr.msgid;
+        offset += reclen;
+
+        if (fseek(fp, offset, SEEK_SET) != 0) {
+            res = errno_to_status();
+        }
+    }
+    fclose(fp);
+
+    if (res != NO_ERR) {
+        return res;
+    }
+
+    seg->size = offset;
+    seg->indexed = TRUE;
+
+    if (offset < (long)statbuf.st_size) {
+        if (dotruncate) {
+            log_warn("\nWarning: removing %ld bytes of partial records "
+                     "from event log '%s'",
+                     (long)statbuf.st_size - offset,
+                     seg->filespec);
+            if (truncate(
+                    (const char *)seg->filespec, (off_t)offset) != 0) {
+                return errno_to_status();
+            }
+        } else {
+            log_warn("\nWarning: event log '%s' has %ld bytes "
+                     "of bad records",
+                     seg->filespec,
+                     (long)statbuf.st_size - offset);
+        }
+    }
+    return NO_ERR;
+
+}  /* index_segment */
+
+
+/********************************************************************
+* FUNCTION read_first_time
+*
+* Get the eventTime of the first record in a segment
+* without indexing the whole segment
+*
+* INPUTS:
+*   seg == segment to use
+*
+* RETURNS:
+*   status; ERR_NCX_EOF if the segment has no records
+*********************************************************************/
+static status_t
+    read_first_time (log_segment_t *seg)
+{
+    FILE       *fp;
+    log_hdr_t   hdr;
+    status_t    res;
+
+    fp = fopen((const char *)seg->filespec, "r");
+    if (!fp) {
+        return errno_to_status();
+    }
+    res = read_hdr(fp, &hdr);
+    if (res == NO_ERR) {
+        xml_strncpy(seg->firsttime, (const xmlChar *)hdr.eventTime,
+                    TSTAMP_MIN_SIZE - 1);
+    }
+    fclose(fp);
+    return res;
+
+}  /* read_first_time */
+
+
+/********************************************************************
+* FUNCTION compare_ids
+*
+* qsort compare function for segment sequence-ids
+*
+*********************************************************************/
+static int
+    compare_ids (const void *id1,
+                 const void *id2)
+{
+    uint32  a = *(const uint32 *)id1;
+    uint32  b = *(const uint32 *)id2;
+
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+
+}  /* compare_ids */
+
+
+/********************************************************************
+* FUNCTION load_segments
+*
+* Find the segment files in the log directory and add
+* them to the segmentQ in sequence-id order
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    load_segments (void)
+{
+    DIR            *dp;
+    struct dirent  *ep;
+    log_segment_t  *seg;
+    uint32         *ids, *newids;
+    uint32          idcnt, idmax, id, i, prefixlen, namelen, suffixlen;
+    status_t        res;
+
+    dp = opendir((const char *)logdir);
+    if (!dp) {
+        return errno_to_status();
+    }
+
+    prefixlen = xml_strlen((const xmlChar *)AGT_NOT_LOG_PREFIX);
+    suffixlen = xml_strlen((const xmlChar *)AGT_NOT_LOG_SUFFIX);
+    ids = NULL;
+    idcnt = 0;
+    idmax = 0;
+    res = NO_ERR;
+
+    while (res == NO_ERR && (ep = readdir(dp)) != NULL) {
+        namelen = xml_strlen((const xmlChar *)ep->d_name);
+        if (namelen <= prefixlen + suffixlen ||
+            strncmp(ep->d_name, AGT_NOT_LOG_PREFIX, prefixlen) ||
+            strcmp(&ep->d_name[namelen - suffixlen], AGT_NOT_LOG_SUFFIX) ||
+            sscanf(&ep->d_name[prefixlen], "%u", &id) != 1) {
+            continue;
+        }
+        if (idcnt == idmax) {
+            idmax = (idmax) ? idmax * 2 : 64;
+            newids = (uint32 *)realloc(ids, idmax * sizeof(uint32));
+            if (!newids) {
+                res = ERR_INTERNAL_MEM;
+                continue;
+            }
+            ids = newids;
+        }
+        ids[idcnt++] = id;
+    }
+    (void)closedir(dp);
+
+    if (res == NO_ERR && idcnt) {
+        qsort(ids, idcnt, sizeof(uint32), compare_ids);
+    }
+
+    for (i = 0; i < idcnt && res == NO_ERR; i++) {
+        seg = new_segment(ids[i]);
+        if (!seg) {
+            res = ERR_INTERNAL_MEM;
+            continue;
+        }
+        dlq_enque(seg, &segmentQ);
+        segment_count++;
+    }
+
+    if (ids) {
+        free(ids);
+    }
+    return res;
+
+}  /* load_segments */
+
+
+/********************************************************************
+* FUNCTION remove_segment
+*
+* Delete a segment file and free its segmentQ entry
+* Open cursors keep reading it until they move on
+*
+* INPUTS:
+*   seg == segment to remove; must be in the segmentQ
+*********************************************************************/
+static void
+    remove_segment (log_segment_t *seg)
+{
+    if (LOGDEBUG) {
+        log_debug("\nagt_not_log: removing event log '%s'",
+                  seg->filespec);
+    }
+    if (unlink((const char *)seg->filespec) != 0 && errno != ENOENT) {
+        log_error("\nError: delete event log '%s' failed (%s)",
+                  seg->filespec,
+                  strerror(errno));
+    }
+    dlq_remove(seg);
+    free_segment(seg);
+    segment_count--;
+
+}  /* remove_segment */
+
+
+/********************************************************************
+* FUNCTION start_segment
+*
+* Start a new segment file and delete the oldest
+* segments over the limit
+*
+* INPUTS:
+*   firstid == sequence-id of the first record
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    start_segment (uint32 firstid)
+{
+    log_segment_t  *seg;
+    status_t        res;
+
+    if (writefp) {
+        fclose(writefp);
+        writefp = NULL;
+    }
+
+    seg = new_segment(firstid);
+    if (!seg) {
+        return ERR_INTERNAL_MEM;
+    }
+
+    writefp = fopen((const char *)seg->filespec, "w");
+    if (!writefp) {
+        res = errno_to_status();
+        log_error("\nError: create event log '%s' failed (%s)",
+                  seg->filespec,
+                  strerror(errno));
+        free_segment(seg);
+        return res;
+    }
+    seg->indexed = TRUE;
+    dlq_enque(seg, &segmentQ);
+    segment_count++;
+
+    while (segment_count > AGT_NOT_LOG_MAX_SEGMENTS) {
+        remove_segment((log_segment_t *)dlq_firstEntry(&segmentQ));
+    }
+    return NO_ERR;
+
+}  /* start_segment */
+
+
+/********************************************************************
+* FUNCTION find_offset
+*
+* Use the sparse index of a segment to find the position
+* of a record at or before the requested start point
+*
+* INPUTS:
+*   seg == segment to use
+*   startTime == eventTime to find, or NULL to use msgid
+*   msgid == sequence-id to find, if startTime is NULL
+*
+* RETURNS:
+*   file position to start scanning from
+*********************************************************************/
+static long
+    find_offset (log_segment_t *seg,
+                 const xmlChar *startTime,
+                 uint32 msgid)
+{
+    uint32  lo, hi, mid, lastid;
+    boolean before;
+
+    if (!seg->indexed) {
+        if (index_segment(seg, FALSE, &lastid) != NO_ERR) {
+            return 0;
+        }
+    }
+
+    /* find the last index entry before the start point */
+    lo = 0;
+    hi = seg->indexcnt;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (startTime) {
+            before = xml_strcmp(seg->index[mid].eventTime, startTime) < 0;
+        } else {
+            before = seg->index[mid].msgid < msgid;
+        }
+        if (before) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo) ? seg->index[lo - 1].offset : 0;
+
+}  /* find_offset */
+
+
+/********************************************************************
+* FUNCTION open_segment
+*
+* Point a cursor at a position in a segment file
+*
+* INPUTS:
+*   cursor == cursor to use
+*   seg == segment to open
+*   offset == file position to start reading at
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    open_segment (agt_not_log_cursor_t *cursor,
+                  const log_segment_t *seg,
+                  long offset)
+{
+    if (cursor->fp) {
+        fclose(cursor->fp);
+    }
+    cursor->segid = seg->firstid;
+    cursor->fp = fopen((const char *)seg->filespec, "r");
+    if (!cursor->fp) {
+        return errno_to_status();
+    }
+    if (offset && fseek(cursor->fp, offset, SEEK_SET) != 0) {
+        return errno_to_status();
+    }
+    return NO_ERR;
+
+}  /* open_segment */
+
+
+/********************************************************************
+* FUNCTION next_segment
+*
+* Move a cursor to the start of the next segment file
+*
+* INPUTS:
+*   cursor == cursor to use
+*
+* RETURNS:
+*   TRUE if the cursor moved; FALSE if there is no next segment
+*********************************************************************/
+static boolean
+    next_segment (agt_not_log_cursor_t *cursor)
+{
+    log_segment_t  *seg;
+
+    for (seg = (log_segment_t *)dlq_firstEntry(&segmentQ);
+         seg != NULL;
+         seg = (log_segment_t *)dlq_nextEntry(seg)) {
+        if (seg->firstid > cursor->segid &&
+            open_segment(cursor, seg, 0) == NO_ERR) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+
+}  /* next_segment */
+
+
+/********************************************************************
+* FUNCTION read_record
+*
+* Read the next record in the current segment of a cursor
+* The file position is not changed if no record is read
+*
+* INPUTS:
+*   cursor == cursor to use
+*   res == address of return status
+*
+* OUTPUTS:
+*   *res == ERR_NCX_EOF if the end of the segment is reached
+*
+* RETURNS:
+*   pointer to the record in the cursor, or NULL if none
+*********************************************************************/
+static const agt_not_logrec_t *
+    read_record (agt_not_log_cursor_t *cursor,
+                 status_t *res)
+{
+    log_hdr_t   hdr;
+    xmlChar    *newbuff;
+    uint32      len;
+    long        pos;
+
+    len = 0;
+    pos = ftell(cursor->fp);
+
+    *res = read_hdr(cursor->fp, &hdr);
+    if (*res == NO_ERR) {
+        len = hdr.namelen + hdr.xmllen + 1;
+        if (len > cursor->buffsize) {
+            newbuff = (xmlChar *)realloc(cursor->buff, len);
+            if (!newbuff) {
+                *res = ERR_INTERNAL_MEM;
+            } else {
+                cursor->buff = newbuff;
+                cursor->buffsize = len;
+            }
+        }
+    }
+    if (*res == NO_ERR &&
+        fread(cursor->buff, len - 1, 1, cursor->fp) != 1) {
+        *res = ERR_NCX_EOF;
+    }
+    if (*res == NO_ERR &&
+        (cursor->buff[hdr.namelen - 1] != 0 ||
+         xml_strlen(cursor->buff) + 2 > hdr.namelen)) {
+        *res = ERR_NCX_INVALID_VALUE;
+    }
+
+    if (*res != NO_ERR) {
+        if (*res == ERR_NCX_INVALID_VALUE) {
+            log_error("\nError: bad record in event log at "
+                      "segment %u offset %ld",
+                      cursor->segid,
+                      pos);
+        }
+        /* stay at the record start in case it is still
+         * being written out, and clear the EOF so records
+         * appended later can be read
+         */
+        clearerr(cursor->fp);
+        (void)fseek(cursor->fp, pos, SEEK_SET);
+        return NULL;
+    }
+
+    cursor->rec.msgid = hdr.msgid;
+    memcpy(cursor->rec.eventTime, hdr.eventTime, TSTAMP_MIN_SIZE);
+    cursor->rec.modname = cursor->buff;
+    cursor->rec.name = cursor->buff + xml_strlen(cursor->buff) + 1;
+    cursor->rec.xml = cursor->buff + hdr.namelen;
+    cursor->rec.xmllen = hdr.xmllen;
+    cursor->buff[len - 1] = 0;
+    return &cursor->rec;
+
+}  /* read_record */
+
+
+/********************************************************************
+* FUNCTION open_cursor
+*
+* Open a cursor at the first record at or after
+* a start time or sequence-id
+*
+* INPUTS:
+*   startTime == eventTime to start at, or NULL to use msgid
+*   msgid == sequence-id to start at, if startTime is NULL
+*
+* RETURNS:
+*   malloced cursor, or NULL if no such record or some error
+*********************************************************************/
+static agt_not_log_cursor_t *
+    open_cursor (const xmlChar *startTime,
+                 uint32 msgid)
+{
+    agt_not_log_cursor_t    *cursor;
+    log_segment_t           *seg, *startseg;
+    const agt_not_logrec_t  *rec;
+    status_t                 res;
+    long                     pos;
+
+    if (!agt_not_log_init_done) {
+        return NULL;
+    }
+
+    /* find the last segment that starts before the start point */
+    startseg = (log_segment_t *)dlq_firstEntry(&segmentQ);
+    if (!startseg) {
+        return NULL;
+    }
+    for (seg = (log_segment_t *)dlq_nextEntry(startseg);
+         seg != NULL;
+         seg = (log_segment_t *)dlq_nextEntry(seg)) {
+        if (startTime) {
+            if (!seg->firsttime[0] ||
+                xml_strcmp(seg->firsttime, startTime) >= 0) {
+                break;
+            }
+        } else if (seg->firstid > msgid) {
+            break;
+        }
+        startseg = seg;
+    }
+
+    cursor = m__getObj(agt_not_log_cursor_t);
+    if (!cursor) {
+        return NULL;
+    }
+    memset(cursor, 0x0, sizeof(agt_not_log_cursor_t));
+
+    res = open_segment(cursor, startseg,
+                       find_offset(startseg, startTime, msgid));
+
+    /* scan forward to the first record at the start point */
+    while (res == NO_ERR) {
+        pos = ftell(cursor->fp);
+        rec = read_record(cursor, &res);
+        if (rec) {
+            if ((startTime &&
+                 xml_strcmp(rec->eventTime, startTime) >= 0) ||
+                (!startTime && rec->msgid >= msgid)) {
+                if (fseek(cursor->fp, pos, SEEK_SET) != 0) {
+                    res = errno_to_status();
+                }
+                break;
+            }
+        } else if (next_segment(cursor)) {
+            res = NO_ERR;
+        }
+    }
+
+    if (res != NO_ERR) {
+        agt_not_log_close(cursor);
+        return NULL;
+    }
+    return cursor;
+
+}  /* open_cursor */
+
+
+/************* E X T E R N A L    F U N C T I O N S ***************/
+
+
+/********************************************************************
+* FUNCTION agt_not_log_init
+*
+* Open the event log in the specified directory
+* The directory is created if needed.  A partial record at the
+* end of the last segment, left by a crash, is removed
+*
+* INPUTS:
+*   dirspec == directory to keep the segment files in
+*   lastmsgid == address of return last sequence-id in the log
+*   firsttime == buffer of TSTAMP_MIN_SIZE for the eventTime
+*                of the oldest record in the log
+*
+* OUTPUTS:
+*   *lastmsgid == sequence-id of the newest record, 0 if empty
+*   firsttime[] == eventTime of the oldest record, "" if empty
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    agt_not_log_init (const xmlChar *dirspec,
+                      uint32 *lastmsgid,
+                      xmlChar *firsttime)
+{
+    log_segment_t  *seg, *nextseg;
+    DIR            *dp;
+    status_t        res;
+
+#ifdef DEBUG
+    if (!dirspec || !lastmsgid || !firsttime) {
+        return SET_ERROR(ERR_INTERNAL_PTR);
+    }
+#endif
+
+    if (agt_not_log_init_done) {
+        return SET_ERROR(ERR_INTERNAL_INIT_SEQ);
+    }
+
+    *lastmsgid = 0;
+    firsttime[0] = 0;
+    dlq_createSQue(&segmentQ);
+    segment_count = 0;
+    writefp = NULL;
+
+    res = NO_ERR;
+    logdir = ncx_get_source(dirspec, &res);
+    if (!logdir) {
+        return res;
+    }
+
+    dp = opendir((const char *)logdir);
+    if (dp == NULL) {
+        if (mkdir((const char *)logdir, S_IRWXU) != 0) {
+            res = errno_to_status();
+        }
+    } else {
+        (void)closedir(dp);
+    }
+
+    if (res == NO_ERR) {
+        res = load_segments();
+    }
+
+    /* only the first record of the older segments is read now;
+     * they are indexed the first time a replay needs them
+     */
+    for (seg = (log_segment_t *)dlq_firstEntry(&segmentQ);
+         seg != NULL && res == NO_ERR;
+         seg = nextseg) {
+
+        nextseg = (log_segment_t *)dlq_nextEntry(seg);
+        if (nextseg) {
+            res = read_first_time(seg);
+        } else {
+            res = index_segment(seg, TRUE, lastmsgid);
+            if (res == NO_ERR && seg->count == 0) {
+                res = ERR_NCX_EOF;
+            }
+        }
+
+        if (res == ERR_NCX_EOF || res == ERR_NCX_INVALID_VALUE) {
+            /* empty segment; the previous one stays the last */
+            remove_segment(seg);
+            res = NO_ERR;
+            if (!nextseg) {
+                seg = (log_segment_t *)dlq_lastEntry(&segmentQ);
+                if (seg) {
+                    res = index_segment(seg, TRUE, lastmsgid);
+                }
+            }
+        }
+    }
+
+    if (res == NO_ERR) {
+        seg = (log_segment_t *)dlq_lastEntry(&segmentQ);
+        if (seg) {
+            writefp = fopen((const char *)seg->filespec, "a");
+            if (!writefp) {
+                res = errno_to_status();
+            }
+        }
+    }
+
+    if (res != NO_ERR) {
+        log_error("\nError: open event log '%s' failed (%s)",
+                  logdir,
+                  get_error_string(res));
+        agt_not_log_init_done = TRUE;
+        agt_not_log_cleanup();
+        return res;
+    }
+
+    seg = (log_segment_t *)dlq_firstEntry(&segmentQ);
+    if (seg) {
+        xml_strcpy(firsttime, seg->firsttime);
+    }
+
+    if (LOGINFO) {
+        log_info("\nagt_not_log: using event log '%s' "
+                 "(%u segments, last sequence-id %u)",
+                 logdir,
+                 segment_count,
+                 *lastmsgid);
+    }
+
+    agt_not_log_init_done = TRUE;
+    return NO_ERR;
+
+}  /* agt_not_log_init */
+
+
+/********************************************************************
+* FUNCTION agt_not_log_cleanup
+*
+* Close the event log
+* Cursors must be closed first
+*
+*********************************************************************/
+void
+    agt_not_log_cleanup (void)
+{
+    log_segment_t  *seg;
+
+    if (!agt_not_log_init_done) {
+        return;
+    }
+
+    if (writefp) {
+        fclose(writefp);
+        writefp = NULL;
+    }
+
+    while (!dlq_empty(&segmentQ)) {
+        seg = (log_segment_t *)dlq_deque(&segmentQ);
+        free_segment(seg);
+    }
+    segment_count = 0;
+
+    if (logdir) {
+        m__free(logdir);
+        logdir = NULL;
+    }
+
+    agt_not_log_init_done = FALSE;
+
+}  /* agt_not_log_cleanup */
+
+
+/********************************************************************
+* FUNCTION agt_not_log_enabled
+*
+* Check if the event log is in use
+*
+* RETURNS:
+*   TRUE if agt_not_log_init was called OK; FALSE otherwise
+*********************************************************************/
+boolean
+    agt_not_log_enabled (void)
+{
+    return agt_not_log_init_done;
+
+}  /* agt_not_log_enabled */
+
+
+/********************************************************************
+* FUNCTION agt_not_log_append
+*
+* Append one notification to the event log
+*
+* INPUTS:
+*   msgid == sequence-id of the notification
+*   eventTime == eventTime of the notification
+*   notobj == notification event type
+*   xml == encoded <notification> element
+*   xmllen == number of bytes in xml
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    agt_not_log_append (uint32 msgid,
+                        const xmlChar *eventTime,
+                        const obj_template_t *notobj,
+                        const xmlChar *xml,
+                        uint32 xmllen)
+{
+    log_segment_t  *seg;
+    log_hdr_t       hdr;
+    const xmlChar  *modname, *name;
+    uint32          modlen, namelen;
+    status_t        res;
+
+#ifdef DEBUG
+    if (!eventTime || !notobj || !xml) {
+        return SET_ERROR(ERR_INTERNAL_PTR);
+    }
+#endif
+
+    if (!agt_not_log_init_done) {
+        return SET_ERROR(ERR_INTERNAL_INIT_SEQ);
+    }
+
+    modname = obj_get_mod_name(notobj);
+    name = obj_get_name(notobj);
+    modlen = xml_strlen(modname) + 1;
+    namelen = xml_strlen(name) + 1;
+    if (modlen + namelen > LOG_MAX_NAMELEN || xmllen > LOG_MAX_XMLLEN) {
+        return ERR_NCX_WRONG_LEN;
+    }
+
+    seg = (log_segment_t *)dlq_lastEntry(&segmentQ);
+    if (!seg || !writefp || seg->size >= AGT_NOT_LOG_SEGMENT_SIZE) {
+        res = start_segment(msgid);
+        if (res != NO_ERR) {
+            return res;
+        }
+        seg = (log_segment_t *)dlq_lastEntry(&segmentQ);
+    }
+
+    memset(&hdr, 0x0, sizeof(log_hdr_t));
+    hdr.magic = LOG_MAGIC;
+    hdr.msgid = msgid;
+    hdr.namelen = modlen + namelen;
+    hdr.xmllen = xmllen;
+    strncpy(hdr.eventTime, (const char *)eventTime, TSTAMP_MIN_SIZE - 1);
+
+    if (fwrite(&hdr, sizeof(log_hdr_t), 1, writefp) != 1 ||
+        fwrite(modname, modlen, 1, writefp) != 1 ||
+        fwrite(name, namelen, 1, writefp) != 1 ||
+        (xmllen && fwrite(xml, xmllen, 1, writefp) != 1) ||
+        fflush(writefp) != 0) {
+        res = errno_to_status();
+        log_error("\nError: write event log '%s' failed (%s)",
+                  seg->filespec,
+                  strerror(errno));
+        /* drop the partial record so the segment stays readable */
+        clearerr(writefp);
+        (void)fflush(writefp);
+        (void)ftruncate(fileno(writefp), (off_t)seg->size);
+        return res;
+    }
+
+    if (seg->count % AGT_NOT_LOG_INDEX_STEP == 0) {
+        (void)add_index(seg, msgid, eventTime, seg->size);
+    }
+    if (seg->count == 0) {
+        xml_strncpy(seg->firsttime, eventTime, TSTAMP_MIN_SIZE - 1);
+    }
+    seg->count++;
+    seg->size += (long)(sizeof(log_hdr_t) + hdr.namelen + xmllen);
+
+    return NO_ERR;
+
+}  /* agt_not_log_append */
+
+
+/********************************************************************
+* FUNCTION agt_not_log_open_time
+*
+* Open a cursor at the first record with an eventTime
+* at or after the specified time
+*
+* INPUTS:
+*   startTime == UTC dateTime string to start at
+*
+* RETURNS:
+*   malloced cursor, or NULL if no such record or some error
+*********************************************************************/
+agt_not_log_cursor_t *
+    agt_not_log_open_time (const xmlChar *startTime)
+{
+#ifdef DEBUG
+    if (!startTime) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return NULL;
+    }
+#endif
+
+    return open_cursor(startTime, 0);
+
+}  /* agt_not_log_open_time */
+
+
+/********************************************************************
+* FUNCTION agt_not_log_open_id
+*
+* Open a cursor at the first record with a sequence-id
+* equal to or higher than the specified value
+*
+* INPUTS:
+*   msgid == sequence-id to start at
+*
+* RETURNS:
+*   malloced cursor, or NULL if no such record or some error
+*********************************************************************/
+agt_not_log_cursor_t *
+    agt_not_log_open_id (uint32 msgid)
+{
+    return open_cursor(NULL, msgid);
+
+}  /* agt_not_log_open_id */
+
+
+/********************************************************************
+* FUNCTION agt_not_log_read
+*
+* Read the next record from a cursor
+* Reading can continue after the end of the log is reached,
+* once more records are appended
+*
+* INPUTS:
+*   cursor == cursor to use
+*
+* RETURNS:
+*   pointer to the record in the cursor, or NULL if
+*   the end of the log is reached or some error
+*********************************************************************/
+const agt_not_logrec_t *
+    agt_not_log_read (agt_not_log_cursor_t *cursor)
+{
+    const agt_not_logrec_t  *rec;
+    status_t                 res;
+
+#ifdef DEBUG
+    if (!cursor) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return NULL;
+    }
+#endif
+
+    if (!cursor->fp) {
+        return NULL;
+    }
+
+    for (;;) {
+        rec = read_record(cursor, &res);
+        if (rec) {
+            return rec;
+        }
+        /* a segment is complete once the next one is started */
+        if (!next_segment(cursor)) {
+            return NULL;
+        }
+    }
+
+    /*NOTREACHED*/
+
+}  /* agt_not_log_read */
+
+
+/********************************************************************
+* FUNCTION agt_not_log_close
+*
+* Close and free a cursor
+*
+* INPUTS:
+*   cursor == cursor to free
+*********************************************************************/
+void
+    agt_not_log_close (agt_not_log_cursor_t *cursor)
+{
+    if (!cursor) {
+        return;
+    }
+    if (cursor->fp) {
+        fclose(cursor->fp);
+    }
+    if (cursor->buff) {
+        free(cursor->buff);
+    }
+    m__free(cursor);
+
+}  /* agt_not_log_close */
+
+
+/* END file agt_not_log.c */
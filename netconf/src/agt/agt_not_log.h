@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _H_agt_not_log
+#define _H_agt_not_log
+/*  FILE: agt_not_log.h
+*********************************************************************
+*                                                                   *
+*                         P U R P O S E                             *
+*                                                                   *
+*********************************************************************
+
+   Persistent notification replay log
+
+   Append-only event log stored as a sequence of segment files
+   in the --eventlog-dir directory.  Each record holds the
+   sequence-id, eventTime and event type of one notification
+   and the <notification> element already encoded as XML,
+   so replay can stream the bytes without building value trees.
+
+   Segments are named by the sequence-id of their first record.
+   The segment list is the time and sequence-id index for
+   finding the segment to start a replay in; inside a segment
+   a sparse index of every AGT_NOT_LOG_INDEX_STEP records
+   is used to skip to the right record.
+
+*********************************************************************
+*                                                                   *
+*                   C H A N G E         H I S T O R Y               *
+*                                                                   *
+*********************************************************************
+
+date             init     comment
+----------------------------------------------------------------------
+17-oct-26    agt      Begun.
+*/
+
+#include <stdio.h>
+#include <xmlstring.h>
+
+#ifndef _H_obj
+#include "obj.h"
+#endif
+
+#ifndef _H_status
+#include "status.h"
+#endif
+
+#ifndef _H_tstamp
+#include "tstamp.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/********************************************************************
+*                                                                   *
+*                         C O N S T A N T S                         *
+*                                                                   *
+*********************************************************************/
+
+/* start a new segment file once the current one reaches this size */
+#define AGT_NOT_LOG_SEGMENT_SIZE  0x400000
+
+/* oldest segments are deleted to keep at most this many */
+#define AGT_NOT_LOG_MAX_SEGMENTS  64
+
+/* one sparse index entry is kept for every N records in a segment */
+#define AGT_NOT_LOG_INDEX_STEP  64
+
+/* segment file name is AGT_NOT_LOG_PREFIX<first-sequence-id>
+ * AGT_NOT_LOG_SUFFIX
+ */
+#define AGT_NOT_LOG_PREFIX  "events-"
+#define AGT_NOT_LOG_SUFFIX  ".log"
+
+
+/********************************************************************
+*                                                                   *
+*                             T Y P E S                             *
+*                                                                   *
+*********************************************************************/
+
+/* one record read from the event log; all pointers
+ * point into the cursor record buffer and are valid
+ * until the next read from the same cursor
+ */
+typedef struct agt_not_logrec_t_ {
+    uint32              msgid;
+    xmlChar             eventTime[TSTAMP_MIN_SIZE];
+    const xmlChar      *modname;        /* module of the event type */
+    const xmlChar      *name;                  /* event type name */
+    const xmlChar      *xml;       /* encoded <notification> element */
+    uint32              xmllen;
+} agt_not_logrec_t;
+
+
+/* read position in the event log used by one replay */
+typedef struct agt_not_log_cursor_t_ {
+    FILE               *fp;                    /* open segment file */
+    uint32              segid;     /* first sequence-id of segment */
+    xmlChar            *buff;                /* malloced record buff */
+    uint32              buffsize;
+    agt_not_logrec_t    rec;                 /* last record read */
+} agt_not_log_cursor_t;
+
+
+/********************************************************************
+*                                                                   *
+*                        F U N C T I O N S                          *
+*                                                                   *
+*********************************************************************/
+
+
+/********************************************************************
+* FUNCTION agt_not_log_init
+*
+* Open the event log in the specified directory
+* The directory is created if needed.  A partial record at the
+* end of the last segment, left by a crash, is removed
+*
+* INPUTS:
+*   dirspec == directory to keep the segment files in
+*   lastmsgid == address of return last sequence-id in the log
+*   firsttime == buffer of TSTAMP_MIN_SIZE for the eventTime
+*                of the oldest record in the log
+*
+* OUTPUTS:
+*   *lastmsgid == sequence-id of the newest record, 0 if empty
+*   firsttime[] == eventTime of the oldest record, "" if empty
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    agt_not_log_init (const xmlChar *dirspec,
+                      uint32 *lastmsgid,
+                      xmlChar *firsttime);
+
+
+/********************************************************************
+* FUNCTION agt_not_log_cleanup
+*
+* Close the event log
+* Cursors must be closed first
+*
+*********************************************************************/
+extern void
+    agt_not_log_cleanup (void);
+
+
+/********************************************************************
+* FUNCTION agt_not_log_enabled
+*
+* Check if the event log is in use
+*
+* RETURNS:
+*   TRUE if agt_not_log_init was called OK; FALSE otherwise
+*********************************************************************/
+extern boolean
+    agt_not_log_enabled (void);
+
+
+/********************************************************************
+* FUNCTION agt_not_log_append
+*
+* Append one notification to the event log
+*
+* INPUTS:
+*   msgid == sequence-id of the notification
+*   eventTime == eventTime of the notification
+*   notobj == notification event type
+*   xml == encoded <notification> element
+*   xmllen == number of bytes in xml
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    agt_not_log_append (uint32 msgid,
+                        const xmlChar *eventTime,
+                        const obj_template_t *notobj,
+                        const xmlChar *xml,
+                        uint32 xmllen);
+
+
+/********************************************************************
+* FUNCTION agt_not_log_open_time
+*
+* Open a cursor at the first record with an eventTime
+* at or after the specified time
+*
+* INPUTS:
+*   startTime == UTC dateTime string to start at
+*
+* RETURNS:
+*   malloced cursor, or NULL if no such record or some error
+*********************************************************************/
+extern agt_not_log_cursor_t *
+    agt_not_log_open_time (const xmlChar *startTime);
+
+
+/********************************************************************
+* FUNCTION agt_not_log_open_id
+*
+* Open a cursor at the first record with a sequence-id
+* equal to or higher than the specified value
+*
+* INPUTS:
+*   msgid == sequence-id to start at
+*
+* RETURNS:
+*   malloced cursor, or NULL if no such record or some error
+*********************************************************************/
+extern agt_not_log_cursor_t *
+    agt_not_log_open_id (uint32 msgid);
+
+
+/********************************************************************
+* FUNCTION agt_not_log_read
+*
+* Read the next record from a cursor
+* Reading can continue after the end of the log is reached,
+* once more records are appended
+*
+* INPUTS:
+*   cursor == cursor to use
+*
+* RETURNS:
+*   pointer to the record in the cursor, or NULL if
+*   the end of the log is reached or some error
+*********************************************************************/
+extern const agt_not_logrec_t *
+    agt_not_log_read (agt_not_log_cursor_t *cursor);
+
+
+/********************************************************************
+* FUNCTION agt_not_log_close
+*
+* Close and free a cursor
+*
+* INPUTS:
+*   cursor == cursor to free
+*********************************************************************/
+extern void
+    agt_not_log_close (agt_not_log_cursor_t *cursor);
+
+#ifdef __cplusplus
+}  /* end extern 'C' */
+#endif
+
+#endif            /* _H_agt_not_log */
@@ -0,0 +1,1379 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*  FILE: agt_nvstore.c
+
+    NV-store persistence of the running config
+
+    Journal file layout:
+
+       yuma-nvstore 1 <dev> <ino> <size> <mtime> <mtime-nsec>\n
+       <?xml?><config>...</config>\n]]>]]>\n      record 1
+       <?xml?><config>...</config>\n]]>]]>\n      record 2
+       ...
+
+    The first line is the identity of the snapshot file that
+    the records apply to.  Each record holds the final state of
+    every edit point changed by one transaction, with
+    nc:operation="replace" if the node exists and
+    nc:operation="remove" if it does not.  Replaying a record
+    therefore does not depend on what the edit-config request
+    looked like, and replaying it twice is harmless.
+
+    A record is only counted once it is complete and fdatasync
+    returned; a torn record at the end of the file after a crash
+    is dropped when the journal is replayed.
+
+*********************************************************************
+*                                                                   *
+*                  C H A N G E   H I S T O R Y                      *
+*                                                                   *
+*********************************************************************
+
+date         init     comment
+----------------------------------------------------------------------
+17oct26               begun
+
+*********************************************************************
+*                                                                   *
+*                     I N C L U D E    F I L E S                    *
+*                                                                   *
+*********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "procdefs.h"
+#include "agt.h"
+#include "agt_cfg.h"
+#include "agt_ncx.h"
+#include "agt_nvstore.h"
+#include "agt_timer.h"
+#include "agt_util.h"
+#include "cfg.h"
+#include "dlq.h"
+#include "log.h"
+#include "ncx.h"
+#include "ncxconst.h"
+#include "obj.h"
+#include "op.h"
+#include "status.h"
+#include "val.h"
+#include "val_util.h"
+#include "xml_util.h"
+#include "xml_wr.h"
+#include "xmlns.h"
+
+/********************************************************************
+*                                                                   *
+*                       C O N S T A N T S                           *
+*                                                                   *
+*********************************************************************/
+
+/* first word of the journal header line */
+#define JOURNAL_MAGIC       "yuma-nvstore"
+
+/* journal format version */
+#define JOURNAL_VERSION     1
+
+/* max length of the journal header line */
+#define JOURNAL_HDR_SIZE    128
+
+/* record separator written after each record */
+#define JOURNAL_EOR         NC_SSH_END "\n"
+
+
+/********************************************************************
+*                                                                   *
+*                       V A R I A B L E S                            *
+*                                                                   *
+*********************************************************************/
+
+static boolean agt_nvstore_init_done = FALSE;
+
+/* TRUE if --nvstore-journal is set */
+static boolean        use_journal;
+
+/* malloced journal filespec for the current snapshot */
+static xmlChar       *journal_filespec;
+
+/* TRUE if the journal file is valid for the current snapshot */
+static boolean        journal_ok;
+
+/* append stream for the journal; opened on first use */
+static FILE          *journal_fp;
+
+/* number of records and bytes in the journal */
+static uint32         journal_records;
+static long           journal_size;
+
+/* size of the current snapshot file */
+static long           snapshot_size;
+
+/* txid of the running config held by snapshot + journal */
+static cfg_transaction_id_t saved_txid;
+static boolean        saved_txid_valid;
+
+/* compaction timer ID or 0 if none */
+static uint32         compact_timer_id;
+
+
+/********************************************************************
+* FUNCTION make_filespec
+*
+* Make a file name from a base file name and suffix
+*
+* INPUTS:
+*   filespec == base file name
+*   suffix == suffix to add
+*
+* RETURNS:
+*   malloced filespec, or NULL if malloc failed
+*********************************************************************/
+static xmlChar *
+    make_filespec (const xmlChar *filespec,
+                   const char *suffix)
+{
+    xmlChar  *buff;
+    uint32    len;
+
+    len = xml_strlen(filespec) + strlen(suffix) + 1;
+    buff = m__getMem(len);
+    if (buff) {
+        snprintf((char *)buff, len, "%s%s", filespec, suffix);
+    }
+    return buff;
+
+}  /* make_filespec */
+
+
+/********************************************************************
+* FUNCTION get_real_filespec
+*
+* Resolve a snapshot filespec so the temp file is created
+* in the same directory as the real file, even if the
+* snapshot name is a symlink
+*
+* INPUTS:
+*   filespec == snapshot file name
+*
+* RETURNS:
+*   malloced filespec, or NULL if malloc failed
+*********************************************************************/
+static xmlChar *
+    get_real_filespec (const xmlChar *filespec)
+{
+    char  buff[PATH_MAX];
+
+    if (realpath((const char *)filespec, buff) != NULL) {
+        return xml_strdup((const xmlChar *)buff);
+    }
+    return xml_strdup(filespec);
+
+}  /* get_real_filespec */
+
+
+/********************************************************************
+* FUNCTION sync_dir
+*
+* Flush the directory entry of a file that was just renamed
+*
+* INPUTS:
+*   filespec == file in the directory to sync
+*********************************************************************/
+static void
+    sync_dir (const xmlChar *filespec)
+{
+    xmlChar  *dirname;
+    xmlChar  *str;
+    int       fd;
+
+    dirname = xml_strdup(filespec);
+    if (!dirname) {
+        return;
+    }
+    str = (xmlChar *)strrchr((char *)dirname, '/');
+    if (str == NULL) {
+        xml_strcpy(dirname, (const xmlChar *)".");
+    } else if (str == dirname) {
+        str[1] = 0;
+    } else {
+        *str = 0;
+    }
+
+    fd = open((const char *)dirname, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        (void)fsync(fd);
+        close(fd);
+    }
+    m__free(dirname);
+
+}  /* sync_dir */
+
+
+/********************************************************************
+* FUNCTION make_header
+*
+* Make the journal header line for a snapshot file
+*
+* INPUTS:
+*   filespec == snapshot file
+*   buff == buffer to fill, JOURNAL_HDR_SIZE bytes
+*
+* OUTPUTS:
+*   snapshot_size is set
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    make_header (const xmlChar *filespec,
+                 char *buff)
+{
+    struct stat  statbuf;
+
+    if (stat((const char *)filespec, &statbuf) != 0) {
+        return ERR_FIL_STAT;
+    }
+
+    snapshot_size = (long)statbuf.st_size;
+    snprintf(buff, JOURNAL_HDR_SIZE, "%s %d %llu %llu %lld %lld %ld\n",
+             JOURNAL_MAGIC,
+             JOURNAL_VERSION,
+             (unsigned long long)statbuf.st_dev,
+             (unsigned long long)statbuf.st_ino,
+             (long long)statbuf.st_size,
+             (long long)statbuf.st_mtim.tv_sec,
+             (long)statbuf.st_mtim.tv_nsec);
+    return NO_ERR;
+
+}  /* make_header */
+
+
+/********************************************************************
+* FUNCTION close_journal
+*
+* Close the journal append stream if it is open
+*
+*********************************************************************/
+static void
+    close_journal (void)
+{
+    if (journal_fp) {
+        fclose(journal_fp);
+        journal_fp = NULL;
+    }
+
+}  /* close_journal */
+
+
+/********************************************************************
+* FUNCTION set_journal_filespec
+*
+* Set the journal file name for a snapshot file
+*
+* INPUTS:
+*   realspec == resolved snapshot file name
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    set_journal_filespec (const xmlChar *realspec)
+{
+    xmlChar  *filespec;
+
+    filespec = make_filespec(realspec, AGT_NVSTORE_JOURNAL_SUFFIX);
+    if (!filespec) {
+        return ERR_INTERNAL_MEM;
+    }
+
+    close_journal();
+    if (journal_filespec) {
+        m__free(journal_filespec);
+    }
+    journal_filespec = filespec;
+    return NO_ERR;
+
+}  /* set_journal_filespec */
+
+
+/********************************************************************
+* FUNCTION start_journal
+*
+* Replace the journal with an empty one for a new snapshot
+*
+* INPUTS:
+*   realspec == resolved snapshot file name
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    start_journal (const xmlChar *realspec)
+{
+    xmlChar  *tempspec;
+    FILE     *fp;
+    status_t  res;
+    char      hdr[JOURNAL_HDR_SIZE];
+
+    res = make_header(realspec, hdr);
+    if (res != NO_ERR) {
+        return res;
+    }
+
+    tempspec = make_filespec(journal_filespec, AGT_NVSTORE_TEMP_SUFFIX);
+    if (!tempspec) {
+        return ERR_INTERNAL_MEM;
+    }
+
+    fp = fopen((const char *)tempspec, "w");
+    if (!fp) {
+        m__free(tempspec);
+        return ERR_FIL_OPEN;
+    }
+
+    if (fputs(hdr, fp) == EOF || fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+        res = ERR_FIL_WRITE;
+    }
+    if (fclose(fp) != 0 && res == NO_ERR) {
+        res = ERR_FIL_CLOSE;
+    }
+    if (res == NO_ERR &&
+        rename((const char *)tempspec,
+               (const char *)journal_filespec) != 0) {
+        res = ERR_FIL_WRITE;
+    }
+    if (res == NO_ERR) {
+        sync_dir(journal_filespec);
+        journal_ok = TRUE;
+        journal_records = 0;
+        journal_size = (long)strlen(hdr);
+    } else {
+        (void)unlink((const char *)tempspec);
+    }
+    m__free(tempspec);
+    return res;
+
+}  /* start_journal */
+
+
+/********************************************************************
+* FUNCTION compact_timer_fn
+*
+* Timer callback to fold the journal into a new snapshot
+*
+* INPUTS:
+*   timer_id == timer identifier
+*   cookie == not used
+*
+* RETURNS:
+*   0
+*********************************************************************/
+static int
+    compact_timer_fn (uint32 timer_id,
+                      void *cookie)
+{
+    cfg_template_t  *running;
+    status_t         res;
+
+    (void)timer_id;
+    (void)cookie;
+
+    compact_timer_id = 0;
+    if (!journal_ok || journal_records == 0) {
+        return 0;
+    }
+
+    /* only compact if the running config is what has been saved;
+     * this is not the case while a confirmed commit is pending
+     * or another transaction is in progress;
+     * the next save schedules the compaction again
+     */
+    running = cfg_get_config_id(NCX_CFGID_RUNNING);
+    if (running == NULL || !saved_txid_valid ||
+        running->last_txid != saved_txid ||
+        agt_cfg_txid_in_progress(NCX_CFGID_RUNNING)) {
+        if (LOGDEBUG2) {
+            log_debug2("\nagt_nvstore: compaction deferred");
+        }
+        return 0;
+    }
+
+    if (LOGDEBUG) {
+        log_debug("\nagt_nvstore: compacting %u journal records",
+                  journal_records);
+    }
+    res = agt_ncx_cfg_save(running, FALSE);
+    if (res != NO_ERR) {
+        log_error("\nError: NV-store journal compaction failed (%s)",
+                  get_error_string(res));
+    }
+    return 0;
+
+}  /* compact_timer_fn */
+
+
+/********************************************************************
+* FUNCTION check_compact
+*
+* Schedule a compaction if the journal is too big
+*
+*********************************************************************/
+static void
+    check_compact (void)
+{
+    status_t  res;
+
+    if (compact_timer_id != 0 || !journal_ok) {
+        return;
+    }
+
+    if (journal_records < AGT_NVSTORE_MAX_RECORDS &&
+        (journal_size <= AGT_NVSTORE_MIN_COMPACT ||
+         journal_size <= snapshot_size)) {
+        return;
+    }
+
+    res = agt_timer_create_ms(AGT_NVSTORE_COMPACT_DELAY, FALSE,
+                              compact_timer_fn, NULL, &compact_timer_id);
+    if (res != NO_ERR) {
+        compact_timer_id = 0;
+        log_warn("\nWarning: cannot schedule NV-store journal "
+                 "compaction (%s)", get_error_string(res));
+    }
+
+}  /* check_compact */
+
+
+/********************************************************************
+* FUNCTION append_record
+*
+* Append 1 record to the journal
+*
+* INPUTS:
+*   delta == <config> record to write
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    append_record (val_value_t *delta)
+{
+    agt_profile_t  *profile;
+    xml_attrs_t     attrs;
+    status_t        res;
+    long            newsize;
+
+    if (!journal_fp) {
+        journal_fp = fopen((const char *)journal_filespec, "a");
+        if (!journal_fp) {
+            return ERR_FIL_OPEN;
+        }
+    }
+
+    profile = agt_get_profile();
+    xml_init_attrs(&attrs);
+    res = xml_wr_check_open_file(journal_fp, delta, &attrs, XMLMODE,
+                                 WITHHDR, TRUE, 0, profile->agt_indent,
+                                 agt_check_save);
+    xml_clean_attrs(&attrs);
+
+    if (res == NO_ERR) {
+        if (fputs("\n" JOURNAL_EOR, journal_fp) == EOF ||
+            fflush(journal_fp) != 0 ||
+            fdatasync(fileno(journal_fp)) != 0) {
+            res = ERR_FIL_WRITE;
+        }
+    }
+
+    newsize = (res == NO_ERR) ? ftell(journal_fp) : -1;
+    if (newsize < 0) {
+        /* drop any partial record */
+        close_journal();
+        (void)truncate((const char *)journal_filespec, journal_size);
+        return (res == NO_ERR) ? ERR_FIL_SETPOS : res;
+    }
+
+    journal_size = newsize;
+    journal_records++;
+    return NO_ERR;
+
+}  /* append_record */
+
+
+/********************************************************************
+* FUNCTION strip_edit_attrs
+*
+* Remove the nc:operation attribute and edit variables
+* from 1 value node
+*
+* INPUTS:
+*   val == value node to clean
+*********************************************************************/
+static void
+    strip_edit_attrs (val_value_t *val)
+{
+    val_value_t  *metaval, *nextmeta;
+    xmlns_id_t    nc_id;
+
+    nc_id = xmlns_nc_id();
+    for (metaval = val_get_first_meta(&val->metaQ);
+         metaval != NULL;
+         metaval = nextmeta) {
+        nextmeta = val_get_next_meta(metaval);
+        if (metaval->nsid == nc_id &&
+            !xml_strcmp(metaval->name, NC_OPERATION_ATTR_NAME)) {
+            dlq_remove(metaval);
+            val_free_value(metaval);
+        }
+    }
+    val_free_editvars(val);
+
+}  /* strip_edit_attrs */
+
+
+/********************************************************************
+* FUNCTION add_operation_attr
+*
+* Add the nc:operation attribute to a delta node
+*
+* INPUTS:
+*   val == delta node
+*   editop == operation to set
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_operation_attr (val_value_t *val,
+                        op_editop_t editop)
+{
+    obj_template_t  *operobj;
+    val_value_t     *metaval;
+    status_t         res;
+
+    operobj = ncx_find_object(ncx_find_module(NC_MODULE, NULL),
+                              NC_OPERATION_ATTR_NAME);
+    if (operobj == NULL) {
+        return SET_ERROR(ERR_NCX_DEF_NOT_FOUND);
+    }
+
+    metaval = val_new_value();
+    if (!metaval) {
+        return ERR_INTERNAL_MEM;
+    }
+    val_init_from_template(metaval, operobj);
+
+    res = val_set_simval(metaval,
+                         obj_get_typdef(operobj),
+                         obj_get_nsid(operobj),
+                         obj_get_name(operobj),
+                         op_editop_name(editop));
+    if (res != NO_ERR) {
+        val_free_value(metaval);
+        return res;
+    }
+
+    strip_edit_attrs(val);
+    dlq_enque(metaval, &val->metaQ);
+    val->editop = editop;
+    return NO_ERR;
+
+}  /* add_operation_attr */
+
+
+/********************************************************************
+* FUNCTION new_skeleton
+*
+* Make a delta node that only identifies a data node:
+* the list keys for a list, the value for a leaf or leaf-list,
+* or an empty node for a container
+*
+* INPUTS:
+*   val == data node to identify
+*   res == address of return status
+*
+* OUTPUTS:
+*   *res == return status
+*
+* RETURNS:
+*   malloced delta node, or NULL if error
+*********************************************************************/
+static val_value_t *
+    new_skeleton (val_value_t *val,
+                  status_t *res)
+{
+    val_value_t  *newval, *keyval;
+
+    newval = val_clone_identity(val, res);
+    if (!newval) {
+        return NULL;
+    }
+
+    if (obj_is_leafy(val->obj)) {
+        /* the node may be reset to its default, which would
+         * stop it from being written to the journal */
+        newval->flags &= ~VAL_FL_DEFSET;
+        strip_edit_attrs(newval);
+    } else {
+        for (keyval = val_get_first_child(newval);
+             keyval != NULL;
+             keyval = val_get_next_child(keyval)) {
+            strip_edit_attrs(keyval);
+        }
+    }
+    return newval;
+
+}  /* new_skeleton */
+
+
+/********************************************************************
+* FUNCTION find_delta_parent
+*
+* Find or create the delta node for a running config node,
+* to add an edit point to
+*
+* INPUTS:
+*   droot == delta <config> root
+*   curval == running config node
+*   covered == address of return covered flag
+*   res == address of return status
+*
+* OUTPUTS:
+*   *covered == TRUE if an ancestor is already an edit point
+*               or is being deleted, so the edit is not needed
+*   *res == return status
+*
+* RETURNS:
+*   delta node for curval, or NULL if covered or error
+*********************************************************************/
+static val_value_t *
+    find_delta_parent (val_value_t *droot,
+                       val_value_t *curval,
+                       boolean *covered,
+                       status_t *res)
+{
+    val_value_t  *dparent, *dval;
+
+    if (obj_is_root(curval->obj)) {
+        return droot;
+    }
+    if (curval->parent == NULL) {
+        *res = SET_ERROR(ERR_INTERNAL_VAL);
+        return NULL;
+    }
+    if (VAL_IS_DELETED(curval)) {
+        *covered = TRUE;
+        return NULL;
+    }
+
+    dparent = find_delta_parent(droot, curval->parent, covered, res);
+    if (dparent == NULL) {
+        return NULL;
+    }
+    if (dparent->editop != OP_EDITOP_NONE) {
+        *covered = TRUE;
+        return NULL;
+    }
+
+    dval = val_first_child_match(dparent, curval);
+    if (dval == NULL) {
+        dval = new_skeleton(curval, res);
+        if (dval == NULL) {
+            return NULL;
+        }
+        val_add_child(dval, dparent);
+    }
+    return dval;
+
+}  /* find_delta_parent */
+
+
+/********************************************************************
+* FUNCTION add_edit
+*
+* Add 1 edit point to the delta
+*
+* INPUTS:
+*   droot == delta <config> root
+*   parent == running config parent of the edit point
+*   val == node identifying the edit point; may be
+*          the running node, the removed node or the PDU node
+*
+* RETURNS:
+*   status; an error means the transaction cannot be journaled
+*********************************************************************/
+static status_t
+    add_edit (val_value_t *droot,
+              val_value_t *parent,
+              val_value_t *val)
+{
+    val_value_t  *dparent, *dval, *olddval, *curval;
+    op_editop_t   editop;
+    boolean       covered;
+    status_t      res;
+
+    if (parent == NULL || val == NULL) {
+        return ERR_NCX_OPERATION_NOT_SUPPORTED;
+    }
+
+    /* the order of user-ordered entries is kept by
+     * saving the whole parent of the entry
+     */
+    while ((val->obj->objtype == OBJ_TYP_LIST ||
+            val->obj->objtype == OBJ_TYP_LEAF_LIST) &&
+           !obj_is_system_ordered(val->obj)) {
+        val = parent;
+        parent = val->parent;
+        if (parent == NULL) {
+            return ERR_NCX_OPERATION_NOT_SUPPORTED;
+        }
+    }
+    if (obj_is_root(val->obj)) {
+        return ERR_NCX_OPERATION_NOT_SUPPORTED;
+    }
+
+    covered = FALSE;
+    res = NO_ERR;
+    dparent = find_delta_parent(droot, parent, &covered, &res);
+    if (dparent == NULL) {
+        return (covered) ? NO_ERR : res;
+    }
+
+    curval = val_first_child_match(parent, val);
+    if (curval && !agt_check_save(NCX_DEF_WITHDEF, TRUE, curval)) {
+        curval = NULL;
+    }
+
+    if (curval) {
+        dval = val_clone_config_data(curval, &res);
+        editop = OP_EDITOP_REPLACE;
+    } else {
+        dval = new_skeleton(val, &res);
+        editop = OP_EDITOP_REMOVE;
+    }
+    if (dval == NULL) {
+        return res;
+    }
+
+    res = add_operation_attr(dval, editop);
+    if (res != NO_ERR) {
+        val_free_value(dval);
+        return res;
+    }
+
+    olddval = val_first_child_match(dparent, dval);
+    if (olddval) {
+        val_swap_child(dval, olddval);
+        val_free_value(olddval);
+    } else {
+        val_add_child(dval, dparent);
+    }
+    return NO_ERR;
+
+}  /* add_edit */
+
+
+/********************************************************************
+* FUNCTION clear_delta
+*
+* Clean a delta subtree that is being moved into the config:
+* strip the edit attributes and drop the removed nodes
+*
+* INPUTS:
+*   dval == delta subtree
+*********************************************************************/
+static void
+    clear_delta (val_value_t *dval)
+{
+    val_value_t  *chval, *nextval;
+
+    strip_edit_attrs(dval);
+    dval->editop = OP_EDITOP_NONE;
+
+    for (chval = val_get_first_child(dval);
+         chval != NULL;
+         chval = nextval) {
+        nextval = val_get_next_child(chval);
+        if (chval->editop == OP_EDITOP_DELETE ||
+            chval->editop == OP_EDITOP_REMOVE) {
+            val_remove_child(chval);
+            val_free_value(chval);
+        } else {
+            clear_delta(chval);
+        }
+    }
+
+}  /* clear_delta */
+
+
+/********************************************************************
+* FUNCTION apply_delta
+*
+* Apply the children of a delta node to a config node
+*
+* INPUTS:
+*   dparent == delta node; children are moved or freed
+*   cparent == config node to change
+*********************************************************************/
+static void
+    apply_delta (val_value_t *dparent,
+                 val_value_t *cparent)
+{
+    val_value_t  *dval, *nextval, *curval;
+
+    for (dval = val_get_first_child(dparent);
+         dval != NULL;
+         dval = nextval) {
+        nextval = val_get_next_child(dval);
+        curval = val_first_child_match(cparent, dval);
+
+        switch (dval->editop) {
+        case OP_EDITOP_DELETE:
+        case OP_EDITOP_REMOVE:
+            if (curval) {
+                val_remove_child(curval);
+                val_free_value(curval);
+            }
+            break;
+        case OP_EDITOP_NONE:
+            if (curval) {
+                apply_delta(dval, curval);
+                break;
+            }
+            /* else fall through: parent of an edit is not in
+             * the config, so add the new part of the subtree
+             */
+        default:
+            val_remove_child(dval);
+            clear_delta(dval);
+            if (curval) {
+                val_swap_child(dval, curval);
+                val_free_value(curval);
+            } else {
+                val_add_child(dval, cparent);
+            }
+        }
+    }
+
+}  /* apply_delta */
+
+
+/************** E X T E R N A L   F U N C T I O N S  ***************/
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_init
+*
+* Initialize the NV-store module
+*
+* INPUTS:
+*   usejournal == TRUE if transactions should be journaled
+*
+*********************************************************************/
+void
+    agt_nvstore_init (boolean usejournal)
+{
+    if (agt_nvstore_init_done) {
+        return;
+    }
+
+    use_journal = usejournal;
+    journal_filespec = NULL;
+    journal_ok = FALSE;
+    journal_fp = NULL;
+    journal_records = 0;
+    journal_size = 0;
+    snapshot_size = 0;
+    saved_txid = 0;
+    saved_txid_valid = FALSE;
+    compact_timer_id = 0;
+    agt_nvstore_init_done = TRUE;
+
+}  /* agt_nvstore_init */
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_init2
+*
+* Record the running config as saved, after it has been
+* loaded at boot time
+*
+*********************************************************************/
+void
+    agt_nvstore_init2 (void)
+{
+    cfg_template_t  *running;
+
+    if (!agt_nvstore_init_done) {
+        return;
+    }
+
+    running = cfg_get_config_id(NCX_CFGID_RUNNING);
+    if (running) {
+        saved_txid = running->last_txid;
+        saved_txid_valid = TRUE;
+    }
+
+    if (use_journal) {
+        check_compact();
+    }
+
+}  /* agt_nvstore_init2 */
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_cleanup
+*
+* Cleanup the NV-store module
+*
+*********************************************************************/
+void
+    agt_nvstore_cleanup (void)
+{
+    if (!agt_nvstore_init_done) {
+        return;
+    }
+
+    if (compact_timer_id) {
+        agt_timer_delete(compact_timer_id);
+        compact_timer_id = 0;
+    }
+    close_journal();
+    if (journal_filespec) {
+        m__free(journal_filespec);
+        journal_filespec = NULL;
+    }
+    journal_ok = FALSE;
+    agt_nvstore_init_done = FALSE;
+
+}  /* agt_nvstore_cleanup */
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_journal_enabled
+*
+* Check if transactions are journaled
+*
+* RETURNS:
+*   TRUE if --nvstore-journal is set
+*********************************************************************/
+boolean
+    agt_nvstore_journal_enabled (void)
+{
+    return use_journal;
+
+}  /* agt_nvstore_journal_enabled */
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_make_delta
+*
+* Record the edits of a running config transaction
+* that is being committed, for agt_nvstore_save
+*
+* Must be called after all the SIL commit callbacks accepted
+* the transaction, but before the deleted nodes are freed
+*
+* INPUTS:
+*   txcb == transaction in progress
+*   target == running config being committed
+*
+* OUTPUTS:
+*   txcb->nvdelta is set if the edits could be recorded
+*   txcb->nvbase_txid is set to the txid before this transaction
+*********************************************************************/
+void
+    agt_nvstore_make_delta (agt_cfg_transaction_t *txcb,
+                            cfg_template_t *target)
+{
+    agt_cfg_undo_rec_t  *undo;
+    agt_cfg_nodeptr_t   *nodeptr;
+    val_value_t         *droot, *val, *parent;
+    status_t             res;
+
+    if (!use_journal || target->cfg_id != NCX_CFGID_RUNNING ||
+        target->root == NULL) {
+        return;
+    }
+
+    if (txcb->nvdelta) {
+        val_free_value(txcb->nvdelta);
+        txcb->nvdelta = NULL;
+    }
+    txcb->nvbase_txid = target->last_txid;
+
+    /* a LOAD has no edit records; save the full config */
+    if (dlq_empty(&txcb->undoQ) &&
+        txcb->edit_type != AGT_CFG_EDIT_TYPE_PARTIAL) {
+        return;
+    }
+
+    droot = val_new_value();
+    if (!droot) {
+        return;
+    }
+    val_init_from_template(droot, target->root->obj);
+
+    res = NO_ERR;
+    for (undo = (agt_cfg_undo_rec_t *)dlq_firstEntry(&txcb->undoQ);
+         undo != NULL && res == NO_ERR;
+         undo = (agt_cfg_undo_rec_t *)dlq_nextEntry(undo)) {
+
+        if (undo->editop == OP_EDITOP_LOAD) {
+            res = ERR_NCX_OPERATION_NOT_SUPPORTED;
+            break;
+        }
+
+        /* the current node is preferred because the PDU node
+         * may have a different value for a leaf
+         */
+        if (undo->curnode) {
+            val = undo->curnode;
+        } else if (undo->curnode_clone) {
+            val = undo->curnode_clone;
+        } else {
+            val = undo->newnode;
+        }
+        parent = undo->parentnode;
+        if (parent == NULL && val != NULL) {
+            parent = val->parent;
+        }
+        res = add_edit(droot, parent, val);
+
+        for (nodeptr = (agt_cfg_nodeptr_t *)
+                 dlq_firstEntry(&undo->extra_deleteQ);
+             nodeptr != NULL && res == NO_ERR;
+             nodeptr = (agt_cfg_nodeptr_t *)dlq_nextEntry(nodeptr)) {
+            if (nodeptr->node) {
+                res = add_edit(droot, nodeptr->node->parent, nodeptr->node);
+            }
+        }
+    }
+
+    for (nodeptr = (agt_cfg_nodeptr_t *)dlq_firstEntry(&txcb->deadnodeQ);
+         nodeptr != NULL && res == NO_ERR;
+         nodeptr = (agt_cfg_nodeptr_t *)dlq_nextEntry(nodeptr)) {
+        if (nodeptr->node) {
+            res = add_edit(droot, nodeptr->node->parent, nodeptr->node);
+        }
+    }
+
+    if (res != NO_ERR) {
+        if (LOGDEBUG2) {
+            log_debug2("\nagt_nvstore: transaction %llu not journaled (%s)",
+                       (unsigned long long)txcb->txid,
+                       get_error_string(res));
+        }
+        val_free_value(droot);
+        return;
+    }
+
+    txcb->nvdelta = droot;
+
+}  /* agt_nvstore_make_delta */
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_save
+*
+* Save the running config to NV-store after a transaction
+*
+* Appends the transaction to the journal if possible;
+* otherwise the full config is saved with agt_ncx_cfg_save
+*
+* INPUTS:
+*   cfg == running config
+*   txcb == transaction that was committed (may be NULL)
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    agt_nvstore_save (cfg_template_t *cfg,
+                      agt_cfg_transaction_t *txcb)
+{
+    status_t  res;
+
+    if (!use_journal || !journal_ok || txcb == NULL ||
+        txcb->nvdelta == NULL || cfg->cfg_id != NCX_CFGID_RUNNING ||
+        !saved_txid_valid || txcb->nvbase_txid != saved_txid) {
+        return agt_ncx_cfg_save(cfg, FALSE);
+    }
+
+    if (val_get_first_child(txcb->nvdelta) != NULL) {
+        res = append_record(txcb->nvdelta);
+        if (res != NO_ERR) {
+            log_warn("\nWarning: NV-store journal write failed (%s),"
+                     " saving full config",
+                     get_error_string(res));
+            journal_ok = FALSE;
+            return agt_ncx_cfg_save(cfg, FALSE);
+        }
+        if (LOGDEBUG2) {
+            log_debug2("\nagt_nvstore: journaled transaction %llu"
+                       " (%u records, %ld bytes)",
+                       (unsigned long long)txcb->txid,
+                       journal_records, journal_size);
+        }
+    }
+
+    saved_txid = cfg->last_txid;
+    check_compact();
+    return NO_ERR;
+
+}  /* agt_nvstore_save */
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_write_snapshot
+*
+* Write a full config to the snapshot file
+* The file is replaced atomically, and the journal
+* is restarted for the new snapshot
+*
+* INPUTS:
+*   filespec == snapshot file to write
+*   cfg == config to write
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    agt_nvstore_write_snapshot (const xmlChar *filespec,
+                                cfg_template_t *cfg)
+{
+    agt_profile_t  *profile;
+    xmlChar        *realspec, *tempspec;
+    FILE           *fp;
+    xml_attrs_t     attrs;
+    status_t        res, res2;
+
+    realspec = get_real_filespec(filespec);
+    if (!realspec) {
+        return ERR_INTERNAL_MEM;
+    }
+    tempspec = make_filespec(realspec, AGT_NVSTORE_TEMP_SUFFIX);
+    if (!tempspec) {
+        m__free(realspec);
+        return ERR_INTERNAL_MEM;
+    }
+
+    fp = fopen((const char *)tempspec, "w");
+    if (!fp) {
+        log_error("\nError: Cannot open file '%s' (%s)",
+                  tempspec, strerror(errno));
+        m__free(tempspec);
+        m__free(realspec);
+        return ERR_FIL_OPEN;
+    }
+
+    profile = agt_get_profile();
+    xml_init_attrs(&attrs);
+    res = xml_wr_check_open_file(fp, cfg->root, &attrs, XMLMODE,
+                                 WITHHDR, TRUE, 0, profile->agt_indent,
+                                 agt_check_save);
+    xml_clean_attrs(&attrs);
+
+    if (res == NO_ERR && (fflush(fp) != 0 || fsync(fileno(fp)) != 0)) {
+        res = ERR_FIL_WRITE;
+    }
+    if (fclose(fp) != 0 && res == NO_ERR) {
+        res = ERR_FIL_CLOSE;
+    }
+    if (res == NO_ERR &&
+        rename((const char *)tempspec, (const char *)realspec) != 0) {
+        log_error("\nError: Cannot rename '%s' to '%s' (%s)",
+                  tempspec, realspec, strerror(errno));
+        res = ERR_FIL_WRITE;
+    }
+    if (res != NO_ERR) {
+        (void)unlink((const char *)tempspec);
+        m__free(tempspec);
+        m__free(realspec);
+        return res;
+    }
+    m__free(tempspec);
+    sync_dir(realspec);
+
+    /* the old journal does not apply to the new snapshot */
+    journal_ok = FALSE;
+    journal_records = 0;
+    journal_size = 0;
+    res2 = set_journal_filespec(realspec);
+    if (res2 == NO_ERR) {
+        if (use_journal) {
+            res2 = start_journal(realspec);
+            if (res2 != NO_ERR) {
+                log_warn("\nWarning: cannot start NV-store journal '%s' (%s)",
+                         journal_filespec, get_error_string(res2));
+            }
+        } else if (unlink((const char *)journal_filespec) == 0) {
+            sync_dir(journal_filespec);
+        }
+    }
+
+    if (cfg->cfg_id == NCX_CFGID_RUNNING) {
+        saved_txid = cfg->last_txid;
+        saved_txid_valid = TRUE;
+    } else {
+        saved_txid_valid = FALSE;
+    }
+
+    m__free(realspec);
+    return NO_ERR;
+
+}  /* agt_nvstore_write_snapshot */
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_replay
+*
+* Replay the journal for a snapshot file into the config
+* that was just loaded from it
+*
+* INPUTS:
+*   filespec == snapshot file that was loaded
+*   configval == <config> value parsed from the snapshot
+*   parsefn == function to parse each record
+*   cookie == cookie to pass to parsefn
+*
+* OUTPUTS:
+*   configval has the journal records applied
+*
+* RETURNS:
+*   status; a torn or bad record is not an error,
+*   the records after it are just ignored
+*********************************************************************/
+status_t
+    agt_nvstore_replay (const xmlChar *filespec,
+                        val_value_t *configval,
+                        agt_nvstore_parse_fn_t parsefn,
+                        void *cookie)
+{
+    xmlChar      *realspec, *buff, *pos, *eor;
+    val_value_t  *delta;
+    FILE         *fp;
+    struct stat   statbuf;
+    long          filesize, goodsize;
+    uint32        count, hdrlen;
+    status_t      res;
+    char          hdr[JOURNAL_HDR_SIZE];
+
+    journal_ok = FALSE;
+    journal_records = 0;
+    journal_size = 0;
+
+    realspec = get_real_filespec(filespec);
+    if (!realspec) {
+        return ERR_INTERNAL_MEM;
+    }
+    res = set_journal_filespec(realspec);
+    if (res == NO_ERR) {
+        res = make_header(realspec, hdr);
+    }
+    m__free(realspec);
+    if (res != NO_ERR) {
+        return (res == ERR_INTERNAL_MEM) ? res : NO_ERR;
+    }
+
+    fp = fopen((const char *)journal_filespec, "r");
+    if (!fp) {
+        /* no journal; the first save writes a new snapshot */
+        return NO_ERR;
+    }
+    if (fstat(fileno(fp), &statbuf) != 0) {
+        fclose(fp);
+        return ERR_FIL_STAT;
+    }
+    filesize = (long)statbuf.st_size;
+
+    buff = m__getMem((size_t)filesize + 1);
+    if (!buff) {
+        fclose(fp);
+        return ERR_INTERNAL_MEM;
+    }
+    if (filesize && fread(buff, (size_t)filesize, 1, fp) != 1) {
+        m__free(buff);
+        fclose(fp);
+        return ERR_FIL_READ;
+    }
+    buff[filesize] = 0;
+    fclose(fp);
+
+    hdrlen = (uint32)strlen(hdr);
+    if (filesize < (long)hdrlen || strncmp((const char *)buff, hdr, hdrlen)) {
+        log_warn("\nWarning: NV-store journal '%s' is not for the "
+                 "current snapshot, ignoring it",
+                 journal_filespec);
+        m__free(buff);
+        return NO_ERR;
+    }
+
+    count = 0;
+    pos = buff + hdrlen;
+    goodsize = (long)hdrlen;
+    while ((eor = (xmlChar *)strstr((char *)pos, NC_SSH_END)) != NULL) {
+        res = NO_ERR;
+        delta = (*parsefn)(pos, (uint32)(eor - pos), cookie, &res);
+        if (delta == NULL || res != NO_ERR) {
+            log_error("\nError: NV-store journal '%s' record %u is bad (%s),"
+                      " ignoring the rest of the journal",
+                      journal_filespec, count + 1,
+                      get_error_string(res));
+            if (delta) {
+                val_free_value(delta);
+            }
+            break;
+        }
+
+        apply_delta(delta, configval);
+        val_free_value(delta);
+        count++;
+
+        pos = eor + strlen(NC_SSH_END);
+        if (*pos == '\n') {
+            pos++;
+        }
+        goodsize = (long)(pos - buff);
+    }
+    m__free(buff);
+
+    if (goodsize < filesize) {
+        log_warn("\nWarning: dropping %ld bytes at the end of "
+                 "NV-store journal '%s'",
+                 filesize - goodsize, journal_filespec);
+        if (truncate((const char *)journal_filespec, goodsize) != 0) {
+            return NO_ERR;
+        }
+    }
+
+    journal_ok = TRUE;
+    journal_records = count;
+    journal_size = goodsize;
+
+    if (count && LOGINFO) {
+        log_info("\nReplayed %u NV-store journal records from '%s'",
+                 count, journal_filespec);
+    }
+    return NO_ERR;
+
+}  /* agt_nvstore_replay */
+
+
+/* END file agt_nvstore.c */
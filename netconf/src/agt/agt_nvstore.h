@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _H_agt_nvstore
+#define _H_agt_nvstore
+/*  FILE: agt_nvstore.h
+*********************************************************************
+*                                                                   *
+*                         P U R P O S E                             *
+*                                                                   *
+*********************************************************************
+
+   NV-store persistence of the running config
+
+   The startup XML file is the snapshot.  Every snapshot write
+   goes to a temp file that is fsynced and renamed over the
+   old file, so the file on disk is always complete.
+
+   If --nvstore-journal is set, a running config transaction is
+   not saved by rewriting the snapshot.  Instead, the edits in the
+   transaction are appended to a journal file next to the snapshot,
+   as a <config> element with nc:operation="replace" or "remove"
+   on each changed node.  The journal is replayed into the
+   snapshot when the server boots, and is folded into a new
+   snapshot (compacted) from a timer once it gets too large.
+
+   The first line of the journal identifies the snapshot file
+   it applies to, so a journal left over from an older snapshot
+   is never replayed.
+
+*********************************************************************
+*                                                                   *
+*                   C H A N G E         H I S T O R Y               *
+*                                                                   *
+*********************************************************************
+
+date             init     comment
+----------------------------------------------------------------------
+17-oct-26             Begun.
+*/
+
+#include <xmlstring.h>
+
+#ifndef _H_agt_cfg
+#include "agt_cfg.h"
+#endif
+
+#ifndef _H_cfg
+#include "cfg.h"
+#endif
+
+#ifndef _H_status
+#include "status.h"
+#endif
+
+#ifndef _H_val
+#include "val.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/********************************************************************
+*                                                                   *
+*                         C O N S T A N T S                         *
+*                                                                   *
+*********************************************************************/
+
+/* journal file name is the snapshot file name plus this suffix */
+#define AGT_NVSTORE_JOURNAL_SUFFIX  ".journal"
+
+/* temp file name suffix used while writing a new file */
+#define AGT_NVSTORE_TEMP_SUFFIX     ".tmp"
+
+/* compact the journal after this many records */
+#define AGT_NVSTORE_MAX_RECORDS     1000
+
+/* compact the journal once it is bigger than the snapshot
+ * and bigger than this many bytes
+ */
+#define AGT_NVSTORE_MIN_COMPACT     0x100000
+
+/* milliseconds to wait before a scheduled compaction */
+#define AGT_NVSTORE_COMPACT_DELAY   1000
+
+
+/********************************************************************
+*                                                                   *
+*                             T Y P E S                             *
+*                                                                   *
+*********************************************************************/
+
+/* parse one journal record
+ *
+ * INPUTS:
+ *    buff == record buffer; one complete XML document
+ *    bufflen == number of bytes in buff
+ *    cookie == cookie passed to agt_nvstore_replay
+ *    res == address of return status
+ *
+ * OUTPUTS:
+ *    *res == return status
+ *
+ * RETURNS:
+ *    malloced <config> value with the editop of each edited
+ *    node set, or NULL if error
+ */
+typedef val_value_t *
+    (*agt_nvstore_parse_fn_t) (const xmlChar *buff,
+                               uint32 bufflen,
+                               void *cookie,
+                               status_t *res);
+
+
+/********************************************************************
+*                                                                   *
+*                        F U N C T I O N S                          *
+*                                                                   *
+*********************************************************************/
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_init
+*
+* Initialize the NV-store module
+*
+* INPUTS:
+*   usejournal == TRUE if transactions should be journaled
+*
+*********************************************************************/
+extern void
+    agt_nvstore_init (boolean usejournal);
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_init2
+*
+* Record the running config as saved, after it has been
+* loaded at boot time
+*
+*********************************************************************/
+extern void
+    agt_nvstore_init2 (void);
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_cleanup
+*
+* Cleanup the NV-store module
+*
+*********************************************************************/
+extern void
+    agt_nvstore_cleanup (void);
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_journal_enabled
+*
+* Check if transactions are journaled
+*
+* RETURNS:
+*   TRUE if --nvstore-journal is set
+*********************************************************************/
+extern boolean
+    agt_nvstore_journal_enabled (void);
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_make_delta
+*
+* Record the edits of a running config transaction
+* that is being committed, for agt_nvstore_save
+*
+* Must be called after all the SIL commit callbacks accepted
+* the transaction, but before the deleted nodes are freed
+*
+* INPUTS:
+*   txcb == transaction in progress
+*   target == running config being committed
+*
+* OUTPUTS:
+*   txcb->nvdelta is set if the edits could be recorded
+*   txcb->nvbase_txid is set to the txid before this transaction
+*********************************************************************/
+extern void
+    agt_nvstore_make_delta (agt_cfg_transaction_t *txcb,
+                            cfg_template_t *target);
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_save
+*
+* Save the running config to NV-store after a transaction
+*
+* Appends the transaction to the journal if possible;
+* otherwise the full config is saved with agt_ncx_cfg_save
+*
+* INPUTS:
+*   cfg == running config
+*   txcb == transaction that was committed (may be NULL)
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    agt_nvstore_save (cfg_template_t *cfg,
+                      agt_cfg_transaction_t *txcb);
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_write_snapshot
+*
+* Write a full config to the snapshot file
+* The file is replaced atomically, and the journal
+* is restarted for the new snapshot
+*
+* INPUTS:
+*   filespec == snapshot file to write
+*   cfg == config to write
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    agt_nvstore_write_snapshot (const xmlChar *filespec,
+                                cfg_template_t *cfg);
+
+
+/********************************************************************
+* FUNCTION agt_nvstore_replay
+*
+* Replay the journal for a snapshot file into the config
+* that was just loaded from it
+*
+* INPUTS:
+*   filespec == snapshot file that was loaded
+*   configval == <config> value parsed from the snapshot
+*   parsefn == function to parse each record
+*   cookie == cookie to pass to parsefn
+*
+* OUTPUTS:
+*   configval has the journal records applied
+*
+* RETURNS:
+*   status; a torn or bad record is not an error,
+*   the records after it are just ignored
+*********************************************************************/
+extern status_t
+    agt_nvstore_replay (const xmlChar *filespec,
+                        val_value_t *configval,
+                        agt_nvstore_parse_fn_t parsefn,
+                        void *cookie);
+
+#ifdef __cplusplus
+}  /* end extern 'C' */
+#endif
+
+#endif            /* _H_agt_nvstore */
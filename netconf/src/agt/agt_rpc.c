@@ -37,6 +37,7 @@ date         init     comment
 #include "agt_acm.h"
 #include "agt_cfg.h"
 #include "agt_cli.h"
+#include "agt_nvstore.h"
 #include "agt_rpc.h"
 #include "agt_rpcerr.h"
 #include "agt_ses.h"
@@ -81,7 +82,15 @@ date         init     comment
 *                           T Y P E S                               *
 *                                                                   *
 *********************************************************************/
-    
+
+/* load-config state passed to parse_journal_record */
+typedef struct journal_parse_t_ {
+    ses_cb_t         *scb;
+    rpc_msg_t        *msg;
+    obj_template_t   *rpcobj;
+    xml_node_t       *method;
+} journal_parse_t;
+
 
 /********************************************************************
 *                                                                   *
@@ -818,6 +827,113 @@ static status_t
 }  /* post_psd_state */
 
 
+/********************************************************************
+* FUNCTION parse_journal_record
+*
+* Parse 1 NV-store journal record with the load-config input
+* parser; called by agt_nvstore_replay
+*
+* INPUTS:
+*   buff == record buffer; one complete XML document
+*   bufflen == number of bytes in buff
+*   cookie == journal_parse_t for the load in progress
+*   res == address of return status
+*
+* OUTPUTS:
+*   *res == return status
+*
+* RETURNS:
+*   malloced <config> value or NULL if error
+*********************************************************************/
+static val_value_t *
+    parse_journal_record (const xmlChar *buff,
+                          uint32 bufflen,
+                          void *cookie,
+                          status_t *res)
+{
+    journal_parse_t  *jparse = (journal_parse_t *)cookie;
+    ses_cb_t         *scb = jparse->scb;
+    xmlTextReaderPtr  savereader = scb->reader;
+    val_value_t      *configval = NULL;
+
+    obj_template_t *obj = 
+        obj_find_template(obj_get_datadefQ(jparse->rpcobj), NULL, 
+                          YANG_K_INPUT);
+    if (obj == NULL) {
+        *res = SET_ERROR(ERR_INTERNAL_VAL);
+        return NULL;
+    }
+
+    val_value_t *inputval = val_new_value();
+    if (inputval == NULL) {
+        *res = ERR_INTERNAL_MEM;
+        return NULL;
+    }
+
+    *res = xml_get_reader_from_memory(buff, bufflen, &scb->reader);
+    if (*res == NO_ERR) {
+        *res = agt_val_parse_nc(scb, &jparse->msg->mhdr, obj, 
+                                jparse->method, NCX_DC_CONFIG, inputval);
+        xml_free_reader(scb->reader);
+    }
+    scb->reader = savereader;
+
+    if (*res == NO_ERR) {
+        configval = val_find_child(inputval, NULL, NCX_EL_CONFIG);
+        if (configval) {
+            val_remove_child(configval);
+        } else {
+            *res = ERR_NCX_MISSING_PARM;
+        }
+    }
+    val_free_value(inputval);
+    return configval;
+
+}  /* parse_journal_record */
+
+
+/********************************************************************
+* FUNCTION replay_journal
+*
+* Apply the NV-store journal to the config just parsed
+* from the startup file by load_config_file
+*
+* INPUTS:
+*   filespec == XML config filespec that was parsed
+*   scb == dummy session for the load
+*   msg == dummy load-config message
+*   rpcobj == load-config RPC template
+*   method == dummy method node
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    replay_journal (const xmlChar *filespec,
+                    ses_cb_t *scb,
+                    rpc_msg_t *msg,
+                    obj_template_t *rpcobj,
+                    xml_node_t *method)
+{
+    journal_parse_t  jparse;
+
+    val_value_t *configval = val_find_child(msg->rpc_input, NULL, 
+                                            NCX_EL_CONFIG);
+    if (configval == NULL) {
+        return NO_ERR;
+    }
+
+    jparse.scb = scb;
+    jparse.msg = msg;
+    jparse.rpcobj = rpcobj;
+    jparse.method = method;
+
+    return agt_nvstore_replay(filespec, configval, parse_journal_record,
+                              &jparse);
+
+}  /* replay_journal */
+
+
 /********************************************************************
 * FUNCTION load_config_file
 *
@@ -945,6 +1061,15 @@ static status_t
     if (res != NO_ERR) {
         retres = res;
     }
+
+    /* the startup file is the NV-store snapshot for running;
+     * apply the journal before the defaults are added */
+    if (res == NO_ERR && isload && cfg->cfg_id == NCX_CFGID_RUNNING) {
+        res = replay_journal(filespec, scb, msg, rpcobj, &method);
+        if (res != NO_ERR) {
+            retres = res;
+        }
+    }
     if (!(NEED_EXIT(res) || res==ERR_XML_READER_EOF)) {
         /* keep going if there were errors in the input
          * in case more errors can be found or 
@@ -293,6 +293,12 @@ status_t
     agttotals = ses_get_total_stats();
     memset(agttotals, 0x0, sizeof(ses_total_stats_t));
     tstamp_datetime(agttotals->startTime);
+
+    res = ses_msg_set_buffsize(agt_profile->agt_buffsize,
+                               agt_profile->agt_max_buffsize);
+    if (res != NO_ERR) {
+        return res;
+    }
     (void)uptime(&last_timeout_check);
     agt_ses_init_done = TRUE;
 
@@ -354,6 +360,9 @@ void
 
         free(agtses);
 
+        ses_msg_log_latency("Total notification", 
+                            &ses_get_total_stats()->notif_latency);
+
         next_sesid = 0;
 
         agt_rpc_unregister_method(AGT_SES_MODULE,
@@ -549,6 +558,7 @@ ses_cb_t *
             scb->linesize = agt_profile->agt_linesize;
             scb->withdef = agt_profile->agt_defaultStyleEnum;
             scb->indent = agt_profile->agt_indent;
+            scb->out_chunksize = agt_profile->agt_max_chunksize;
 
             if (ncx_protocol_enabled(NCX_PROTO_NETCONF10)) {
                 scb->protocols_requested |= NCX_FL_PROTO_NETCONF10;
@@ -626,6 +636,7 @@ void
     agt_ses_free_session (ses_cb_t *scb)
 {
     ses_id_t  slot;
+    char      namebuff[48];
 
     assert( scb && "scb is NULL!" );
     assert( agt_ses_init_done && "agt_ses_init_done is false!" );
@@ -665,6 +676,19 @@ void
     ses_msg_unmake_inready(scb);
     ses_msg_unmake_outready(scb);
 
+    if (LOGDEBUG) {
+        log_debug("\nSession %d buffers: peak %llu bytes, "
+                  "%u malloced, %u reused, %u grows",
+                  slot,
+                  (unsigned long long)scb->buffstats.peak_bytes,
+                  scb->buffstats.allocs,
+                  scb->buffstats.reuses,
+                  scb->buffstats.grows);
+        snprintf(namebuff, sizeof(namebuff), "Session %u notification",
+                 slot);
+        ses_msg_log_latency(namebuff, &scb->notif_latency);
+    }
+
     /* this will close the socket if it is still open */
     ses_free_scb(scb);
 
@@ -1053,45 +1077,35 @@ boolean
 }  /* agt_ses_ssh_port_allowed */
 
 /********************************************************************
-* FUNCTION agt_ses_fill_writeset
+* FUNCTION agt_ses_get_next_outready
 *
-* Drain the ses_msg outreadyQ and set the specified fdset
-* Used by agt_ncxserver write_fd_set
-*
-* INPUTS:
-*    fdset == pointer to fd_set to fill
-*    maxfdnum == pointer to max fd int to fill in
+* Dequeue the next session from the ses_msg outreadyQ
+* Used by agt_ncxserver to enable write events for
+* sessions with output pending
 *
-* OUTPUTS:
-*    *fdset is updated in
-*    *maxfdnum may be updated
+* RETURNS:
+*   pointer to the session control block or NULL if none;
+*   sessions that are already closed are skipped
 *********************************************************************/
-void
-    agt_ses_fill_writeset (fd_set *fdset,
-                           int *maxfdnum)
+ses_cb_t *
+    agt_ses_get_next_outready (void)
 {
     ses_ready_t *rdy;
-    ses_cb_t *scb;
-    boolean done;
+    ses_cb_t    *scb;
 
-    FD_ZERO(fdset);
-    done = FALSE;
-    while (!done) {
+    for (;;) {
         rdy = ses_msg_get_first_outready();
         if (!rdy) {
-            done = TRUE;
-        } else {
-            scb = agtses[rdy->sid];
-            if (scb && scb->state <= SES_ST_SHUTDOWN_REQ) {
-                FD_SET(scb->fd, fdset);
-                if (scb->fd > *maxfdnum) {
-                    *maxfdnum = scb->fd;
-                }
-            }
+            return NULL;
+        }
+        scb = agtses[rdy->sid];
+        if (scb && scb->state <= SES_ST_SHUTDOWN_REQ) {
+            return scb;
         }
     }
+    /*NOTREACHED*/
 
-}  /* agt_ses_fill_writeset */
+}  /* agt_ses_get_next_outready */
 
 /********************************************************************
 * FUNCTION agt_ses_get_inSessions
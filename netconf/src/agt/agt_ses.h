@@ -274,22 +274,18 @@ extern boolean
 
 
 /********************************************************************
-* FUNCTION agt_ses_fill_writeset
+* FUNCTION agt_ses_get_next_outready
 *
-* Drain the ses_msg outreadyQ and set the specified fdset
-* Used by agt_ncxserver write_fd_set
+* Dequeue the next session from the ses_msg outreadyQ
+* Used by agt_ncxserver to enable write events for
+* sessions with output pending
 *
-* INPUTS:
-*    fdset == pointer to fd_set to fill
-*    maxfdnum == pointer to max fd int to fill in
-*
-* OUTPUTS:
-*    *fdset is updated in
-*    *maxfdnum may be updated
+* RETURNS:
+*   pointer to the session control block or NULL if none;
+*   sessions that are already closed are skipped
 *********************************************************************/
-extern void
-    agt_ses_fill_writeset (fd_set *fdset,
-			   int *maxfdnum);
+extern ses_cb_t *
+    agt_ses_get_next_outready (void);
 
 
 /********************************************************************
@@ -43,7 +43,6 @@ date         init     comment
 #include "log.h"
 #include "ncx.h"
 #include "status.h"
-#include "uptime.h"
 
 /********************************************************************
 *                                                                   *
@@ -51,7 +50,18 @@ date         init     comment
 *                                                                   *
 *********************************************************************/
 
-#define AGT_TIMER_SKIP_COUNT 1
+/* hierarchical timer wheel with 1 msec ticks;
+ * each level has 64 slots and each slot of level N
+ * covers 64^N ticks, so 4 levels cover about 4.6 hours.
+ * Timers further out are parked in the last slot range
+ * and re-queued when that slot is cascaded
+ */
+#define TW_BITS       6
+#define TW_SLOTS      (1 << TW_BITS)
+#define TW_MASK       (TW_SLOTS - 1)
+#define TW_LEVELS     4
+#define TW_MAX_DELTA  (((uint64)1 << (TW_BITS * TW_LEVELS)) - 1)
+
 
 /********************************************************************
 *                                                                   *
@@ -61,36 +71,158 @@ date         init     comment
 
 static boolean agt_timer_init_done = FALSE;
 
-static dlq_hdr_t   timer_cbQ;
+/* timer wheel slots; Q of agt_timer_cb_t */
+static dlq_hdr_t   wheel[TW_LEVELS][TW_SLOTS];
+
+/* timers popped in the current tick; Q of agt_timer_cb_t */
+static dlq_hdr_t   expiredQ;
+
+/* next wheel tick (msec) to process */
+static uint64      wheel_clk;
+
+/* number of timers in the wheel and expiredQ */
+static uint32      timer_count;
+
+/* timer callback currently running, and any changes
+ * made to that timer by the callback
+ */
+static agt_timer_cb_t *running_cb;
+static boolean         running_deleted;
+static boolean         running_restarted;
 
 static uint32      next_id;
 
-static uint32      skip_count;
 
 /********************************************************************
-* FUNCTION get_timer_id
+* FUNCTION get_msec
 *
-* Allocate a timer ID
+* Get the monotonic time in milliseconds
+*
+* RETURNS:
+*   msec since some unspecified starting point
+*********************************************************************/
+static uint64
+    get_msec (void)
+{
+    struct timespec  ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64)ts.tv_sec * 1000) + (uint64)(ts.tv_nsec / 1000000);
+
+} /* get_msec */
+
+
+/********************************************************************
+* FUNCTION wheel_insert
+*
+* Queue a timer in the wheel slot for its expire time
 *
 * INPUTS:
-*   none
+*   timer_cb == timer control block to queue (not in any Q)
+*********************************************************************/
+static void
+    wheel_insert (agt_timer_cb_t *timer_cb)
+{
+    uint64  expires, delta;
+    uint32  level;
+
+    expires = timer_cb->timer_expires;
+    if (expires < wheel_clk) {
+        /* already expired; pop in the next tick */
+        expires = wheel_clk;
+    }
+
+    delta = expires - wheel_clk;
+    if (delta > TW_MAX_DELTA) {
+        /* park it in the farthest slot; it will be
+         * re-queued with its real expire time later
+         */
+        expires = wheel_clk + TW_MAX_DELTA;
+        delta = TW_MAX_DELTA;
+    }
+
+    for (level = 0; level < TW_LEVELS - 1; level++) {
+        if (delta < ((uint64)1 << (TW_BITS * (level + 1)))) {
+            break;
+        }
+    }
+
+    dlq_enque(timer_cb, 
+              &wheel[level][(expires >> (TW_BITS * level)) & TW_MASK]);
+
+} /* wheel_insert */
+
+
+/********************************************************************
+* FUNCTION wheel_cascade
+*
+* Move all the timers in 1 slot down to the lower levels
+*
+* INPUTS:
+*   level == wheel level (1 .. TW_LEVELS-1)
+*********************************************************************/
+static void
+    wheel_cascade (uint32 level)
+{
+    agt_timer_cb_t *timer_cb;
+    dlq_hdr_t       tempQ;
+    uint32          index;
+
+    index = (uint32)(wheel_clk >> (TW_BITS * level)) & TW_MASK;
+
+    dlq_createSQue(&tempQ);
+    dlq_block_enque(&wheel[level][index], &tempQ);
+
+    while (!dlq_empty(&tempQ)) {
+        timer_cb = (agt_timer_cb_t *)dlq_deque(&tempQ);
+        wheel_insert(timer_cb);
+    }
+
+} /* wheel_cascade */
+
+
+/********************************************************************
+* FUNCTION find_timer_cb
+*
+* Find a timer control block
+*
+* INPUTS:
+*   timer_id == timer ID to find
 * RETURNS:
-*   timer_id or zero if none available
+*   pointer to the timer control block or NULL if not found
 *********************************************************************/
 static agt_timer_cb_t *
     find_timer_cb (uint32 timer_id)
 {
     agt_timer_cb_t *timer_cb;
+    uint32          level, slot;
+
+    if (running_cb && running_cb->timer_id == timer_id &&
+        !running_deleted) {
+        return running_cb;
+    }
 
-    for (timer_cb = (agt_timer_cb_t *)
-             dlq_firstEntry(&timer_cbQ);
+    for (timer_cb = (agt_timer_cb_t *)dlq_firstEntry(&expiredQ);
          timer_cb != NULL;
-         timer_cb = (agt_timer_cb_t *)
-             dlq_nextEntry(timer_cb)) {
+         timer_cb = (agt_timer_cb_t *)dlq_nextEntry(timer_cb)) {
         if (timer_cb->timer_id == timer_id) {
             return timer_cb;
         }
     }
+
+    for (level = 0; level < TW_LEVELS; level++) {
+        for (slot = 0; slot < TW_SLOTS; slot++) {
+            for (timer_cb = (agt_timer_cb_t *)
+                     dlq_firstEntry(&wheel[level][slot]);
+                 timer_cb != NULL;
+                 timer_cb = (agt_timer_cb_t *)
+                     dlq_nextEntry(timer_cb)) {
+                if (timer_cb->timer_id == timer_id) {
+                    return timer_cb;
+                }
+            }
+        }
+    }
     return NULL;
 
 }  /* find_timer_cb */
@@ -116,7 +248,7 @@ static uint32
         return next_id++;
     }
 
-    if (dlq_empty(&timer_cbQ)) {
+    if (timer_count == 0) {
         next_id = 1;
         return next_id++;
     }
@@ -177,6 +309,154 @@ static void
 } /* free_timer_cb */
 
 
+/********************************************************************
+* FUNCTION run_timer
+*
+* Invoke the callback for an expired timer and then
+* re-queue or delete the timer
+*
+* INPUTS:
+*   timer_cb == expired timer (not in any Q)
+*   now == current msec time
+*********************************************************************/
+static void
+    run_timer (agt_timer_cb_t *timer_cb,
+               uint64 now)
+{
+    int  retval;
+
+    if (LOGDEBUG3) {
+        log_debug3("\nagt_timer: timer %u popped",
+                   timer_cb->timer_id);
+    }
+
+    running_cb = timer_cb;
+    running_deleted = FALSE;
+    running_restarted = FALSE;
+
+    retval = (*timer_cb->timer_cbfn)(timer_cb->timer_id,
+                                     timer_cb->timer_cookie);
+
+    running_cb = NULL;
+
+    if (running_deleted || retval != 0 || 
+        (!timer_cb->timer_periodic && !running_restarted)) {
+        /* destroy this timer */
+        timer_count--;
+        free_timer_cb(timer_cb);
+        return;
+    }
+
+    /* reset this periodic timer; restart already set
+     * the new expire time
+     */
+    if (!running_restarted) {
+        timer_cb->timer_expires = now + timer_cb->timer_duration;
+    }
+    wheel_insert(timer_cb);
+
+} /* run_timer */
+
+
+/********************************************************************
+* FUNCTION start_timer
+*
+* Create and queue a new timer
+*
+* INPUTS:
+*   msec == number of milliseconds to wait between polls
+*   is_periodic == TRUE if periodic timer
+*                  FALSE if a 1-event timer
+*   timer_fn == address of callback function
+*   cookie == address of user cookie to pass to the timer_fn
+*   ret_timer_id == address of return timer ID
+*
+* OUTPUTS:
+*  *ret_timer_id == timer ID for the allocated timer, 
+*    if the return value is NO_ERR
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    start_timer (uint32 msec,
+                 boolean is_periodic,
+                 agt_timer_fn_t  timer_fn,
+                 void *cookie,
+                 uint32 *ret_timer_id)
+{
+    agt_timer_cb_t *timer_cb;
+    uint32          timer_id;
+
+    *ret_timer_id = 0;
+    timer_id = get_timer_id();
+    if (timer_id == 0) {
+        return ERR_NCX_RESOURCE_DENIED;
+    }
+
+    timer_cb = new_timer_cb();
+    if (timer_cb == NULL) {
+        return ERR_INTERNAL_MEM;
+    }
+
+    *ret_timer_id = timer_id;
+    timer_cb->timer_id = timer_id;
+    timer_cb->timer_periodic = is_periodic;
+    timer_cb->timer_cbfn = timer_fn;
+    timer_cb->timer_duration = msec;
+    timer_cb->timer_expires = get_msec() + msec;
+    timer_cb->timer_cookie = cookie;
+
+    if (timer_count == 0 && running_cb == NULL) {
+        /* nothing in the wheel; skip the idle ticks */
+        wheel_clk = get_msec();
+    }
+
+    wheel_insert(timer_cb);
+    timer_count++;
+    return NO_ERR;
+
+} /* start_timer */
+
+
+/********************************************************************
+* FUNCTION restart_timer
+*
+* Restart a timer with a new timeout value
+*
+* INPUTS:
+*   timer_id == timer ID to reset
+*   msec == new timeout value in milliseconds
+*
+* RETURNS:
+*   status, NO_ERR if all okay,
+*********************************************************************/
+static status_t
+    restart_timer (uint32 timer_id,
+                   uint32 msec)
+{
+    agt_timer_cb_t *timer_cb;
+
+    timer_cb = find_timer_cb(timer_id);
+    if (timer_cb == NULL) {
+        return ERR_NCX_NOT_FOUND;
+    }
+
+    timer_cb->timer_duration = msec;
+    timer_cb->timer_expires = get_msec() + msec;
+
+    if (timer_cb == running_cb) {
+        /* run_timer will re-queue it */
+        running_restarted = TRUE;
+    } else {
+        dlq_remove(timer_cb);
+        wheel_insert(timer_cb);
+    }
+    return NO_ERR;
+
+} /* restart_timer */
+
+
 /********************************************************************
 * FUNCTION agt_timer_init
 *
@@ -190,10 +470,19 @@ static void
 void
     agt_timer_init (void)
 {
+    uint32  level, slot;
+
     if (!agt_timer_init_done) {
-        dlq_createSQue(&timer_cbQ);
+        for (level = 0; level < TW_LEVELS; level++) {
+            for (slot = 0; slot < TW_SLOTS; slot++) {
+                dlq_createSQue(&wheel[level][slot]);
+            }
+        }
+        dlq_createSQue(&expiredQ);
+        wheel_clk = get_msec();
+        timer_count = 0;
+        running_cb = NULL;
         next_id = 1;
-        skip_count = 0;
         agt_timer_init_done = TRUE;
     }
 
@@ -210,12 +499,23 @@ void
     agt_timer_cleanup (void)
 {
     agt_timer_cb_t *timer_cb;
+    uint32          level, slot;
 
     if (agt_timer_init_done) {
-        while (!dlq_empty(&timer_cbQ)) {
-            timer_cb = (agt_timer_cb_t *)dlq_deque(&timer_cbQ);
+        for (level = 0; level < TW_LEVELS; level++) {
+            for (slot = 0; slot < TW_SLOTS; slot++) {
+                while (!dlq_empty(&wheel[level][slot])) {
+                    timer_cb = (agt_timer_cb_t *)
+                        dlq_deque(&wheel[level][slot]);
+                    free_timer_cb(timer_cb);
+                }
+            }
+        }
+        while (!dlq_empty(&expiredQ)) {
+            timer_cb = (agt_timer_cb_t *)dlq_deque(&expiredQ);
             free_timer_cb(timer_cb);
         }
+        timer_count = 0;
         agt_timer_init_done = FALSE;
     }
 
@@ -225,56 +525,115 @@ void
 /********************************************************************
 * FUNCTION agt_timer_handler
 *
-* Handle an incoming agent timer polling interval
-* main routine called by agt_signal_handler
+* Advance the timer wheel to the current time and
+* invoke the callback for each timer that expired
+* Called from the ncxserver loop on every iteration
 *
 *********************************************************************/
 void 
     agt_timer_handler (void)
 {
-    agt_timer_cb_t  *timer_cb, *next_timer_cb;
-    time_t           timenow;
-    double           timediff;
-    int              retval;
+    agt_timer_cb_t  *timer_cb;
+    uint64           now;
+    uint32           level;
 
-    if (skip_count < AGT_TIMER_SKIP_COUNT) {
-        skip_count++;
+    if (!agt_timer_init_done) {
         return;
-    } else {
-        skip_count = 0;
     }
 
-    (void)uptime(&timenow);
+    now = get_msec();
+    if (timer_count == 0) {
+        wheel_clk = now + 1;
+        return;
+    }
 
-    for (timer_cb = (agt_timer_cb_t *)dlq_firstEntry(&timer_cbQ);
-         timer_cb != NULL;
-         timer_cb = next_timer_cb) {
+    while (wheel_clk <= now) {
+        /* cascade the higher levels each time a lower
+         * level wraps around
+         */
+        for (level = 1; level < TW_LEVELS; level++) {
+            if ((wheel_clk & 
+                 (((uint64)1 << (TW_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            wheel_cascade(level);
+        }
 
-        next_timer_cb = (agt_timer_cb_t *)dlq_nextEntry(timer_cb);
+        dlq_block_enque(&wheel[0][wheel_clk & TW_MASK], &expiredQ);
+        wheel_clk++;
 
-        timediff = difftime(timenow, timer_cb->timer_start_time);
-        if (timediff >= (double)timer_cb->timer_duration) {
-            if (LOGDEBUG3) {
-                log_debug3("\nagt_timer: timer %u popped",
-                           timer_cb->timer_id);
-            }
+        while (!dlq_empty(&expiredQ)) {
+            timer_cb = (agt_timer_cb_t *)dlq_deque(&expiredQ);
+            run_timer(timer_cb, now);
+        }
 
-            retval = (*timer_cb->timer_cbfn)(timer_cb->timer_id,
-                                             timer_cb->timer_cookie);
-            if (retval != 0 || !timer_cb->timer_periodic) {
-                /* destroy this timer */
-                dlq_remove(timer_cb);
-                free_timer_cb(timer_cb);
-            } else {
-                /* reset this periodic timer */
-                (void)uptime(&timer_cb->timer_start_time);
-            }
+        if (timer_count == 0) {
+            wheel_clk = now + 1;
         }
     }
 
 } /* agt_timer_handler */
 
 
+/********************************************************************
+* FUNCTION agt_timer_get_timeout
+*
+* Get the number of milliseconds until the timer wheel needs
+* to be serviced by agt_timer_handler
+*
+* INPUTS:
+*   maxwait == maximum value to return
+*
+* RETURNS:
+*   number of msec to wait (0 .. maxwait)
+*********************************************************************/
+uint32
+    agt_timer_get_timeout (uint32 maxwait)
+{
+    uint64   now, next, base;
+    uint32   level, k, index;
+
+    if (timer_count == 0) {
+        return maxwait;
+    }
+
+    now = get_msec();
+    next = wheel_clk + TW_MAX_DELTA;
+
+    /* level 0 slots hold the exact expire time;
+     * higher levels are due when the slot is cascaded.
+     * The current slot of a higher level is only pending
+     * if wheel_clk is on its cascade boundary
+     */
+    for (level = 0; level < TW_LEVELS; level++) {
+        base = wheel_clk >> (TW_BITS * level);
+        k = 0;
+        if (level && (wheel_clk & 
+                      (((uint64)1 << (TW_BITS * level)) - 1)) != 0) {
+            k = 1;
+        }
+        for (; k <= TW_SLOTS; k++) {
+            index = (uint32)((base + k) & TW_MASK);
+            if (!dlq_empty(&wheel[level][index])) {
+                if (((base + k) << (TW_BITS * level)) < next) {
+                    next = (base + k) << (TW_BITS * level);
+                }
+                break;
+            }
+        }
+    }
+
+    if (next <= now) {
+        return 0;
+    }
+    if ((next - now) > maxwait) {
+        return maxwait;
+    }
+    return (uint32)(next - now);
+
+} /* agt_timer_get_timeout */
+
+
 /********************************************************************
 * FUNCTION agt_timer_create
 *
@@ -303,9 +662,6 @@ status_t
                       void *cookie,
                       uint32 *ret_timer_id)
 {
-    agt_timer_cb_t *timer_cb;
-    uint32          timer_id;
-
 #ifdef DEBUG
     if (timer_fn == NULL || ret_timer_id == NULL) {
         return SET_ERROR(ERR_INTERNAL_PTR);
@@ -315,29 +671,64 @@ status_t
     }
 #endif
 
-    *ret_timer_id = 0;
-    timer_id = get_timer_id();
-    if (timer_id == 0) {
-        return ERR_NCX_RESOURCE_DENIED;
+    if (seconds > NCX_MAX_UINT / 1000) {
+        return ERR_NCX_INVALID_VALUE;
     }
 
-    timer_cb = new_timer_cb();
-    if (timer_cb == NULL) {
-        return ERR_INTERNAL_MEM;
-    }
+    return start_timer(seconds * 1000,
+                       is_periodic,
+                       timer_fn,
+                       cookie,
+                       ret_timer_id);
 
-    *ret_timer_id = timer_id;
-    timer_cb->timer_id = timer_id;
-    timer_cb->timer_periodic = is_periodic;
-    timer_cb->timer_cbfn = timer_fn;
-    (void)uptime(&timer_cb->timer_start_time);
-    timer_cb->timer_duration = seconds;
-    timer_cb->timer_cookie = cookie;
+} /* agt_timer_create */
 
-    dlq_enque(timer_cb, &timer_cbQ);
-    return NO_ERR;
 
-} /* agt_timer_create */
+/********************************************************************
+* FUNCTION agt_timer_create_ms
+*
+* Malloc and start a new timer control block
+* Same as agt_timer_create except the interval is in milliseconds
+*
+* INPUTS:
+*   msec == number of milliseconds to wait between polls
+*   is_periodic == TRUE if periodic timer
+*                  FALSE if a 1-event timer
+*   timer_fn == address of callback function to invoke when
+*               the timer poll event occurs
+*   cookie == address of user cookie to pass to the timer_fn
+*   ret_timer_id == address of return timer ID
+*
+* OUTPUTS:
+*  *ret_timer_id == timer ID for the allocated timer, 
+*    if the return value is NO_ERR
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    agt_timer_create_ms (uint32 msec,
+                         boolean is_periodic,
+                         agt_timer_fn_t  timer_fn,
+                         void *cookie,
+                         uint32 *ret_timer_id)
+{
+#ifdef DEBUG
+    if (timer_fn == NULL || ret_timer_id == NULL) {
+        return SET_ERROR(ERR_INTERNAL_PTR);
+    }
+    if (msec == 0) {
+        return SET_ERROR(ERR_INTERNAL_VAL);
+    }
+#endif
+
+    return start_timer(msec,
+                       is_periodic,
+                       timer_fn,
+                       cookie,
+                       ret_timer_id);
+
+} /* agt_timer_create_ms */
 
 
 /********************************************************************
@@ -359,26 +750,49 @@ status_t
     agt_timer_restart (uint32 timer_id,
                        uint32 seconds)
 {
-    agt_timer_cb_t *timer_cb;
-
 #ifdef DEBUG
     if (seconds == 0) {
         return SET_ERROR(ERR_INTERNAL_VAL);
     }
 #endif
 
-    timer_cb = find_timer_cb(timer_id);
-    if (timer_cb == NULL) {
-        return ERR_NCX_NOT_FOUND;
+    if (seconds > NCX_MAX_UINT / 1000) {
+        return ERR_NCX_INVALID_VALUE;
     }
 
-    (void)uptime(&timer_cb->timer_start_time);
-    timer_cb->timer_duration = seconds;
-    return NO_ERR;
+    return restart_timer(timer_id, seconds * 1000);
 
 } /* agt_timer_restart */
 
 
+/********************************************************************
+* FUNCTION agt_timer_restart_ms
+*
+* Restart a timer with a new timeout value in milliseconds
+* Same as agt_timer_restart except for the time units
+*
+* INPUTS:
+*   timer_id == timer ID to reset
+*   msec == new timeout value
+*
+* RETURNS:
+*   status, NO_ERR if all okay,
+*********************************************************************/
+status_t
+    agt_timer_restart_ms (uint32 timer_id,
+                          uint32 msec)
+{
+#ifdef DEBUG
+    if (msec == 0) {
+        return SET_ERROR(ERR_INTERNAL_VAL);
+    }
+#endif
+
+    return restart_timer(timer_id, msec);
+
+} /* agt_timer_restart_ms */
+
+
 /********************************************************************
 * FUNCTION agt_timer_delete
 *
@@ -403,12 +817,17 @@ void
         return;
     }
 
+    if (timer_cb == running_cb) {
+        /* run_timer will free it */
+        running_deleted = TRUE;
+        return;
+    }
+
     dlq_remove(timer_cb);
+    timer_count--;
     free_timer_cb(timer_cb);
 
 } /* agt_timer_delete */
 
 
 /* END file agt_timer.c */
-
-
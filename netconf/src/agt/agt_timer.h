@@ -76,8 +76,8 @@ typedef struct agt_timer_cb_t_ {
     boolean         timer_periodic;
     uint32          timer_id;
     agt_timer_fn_t  timer_cbfn;
-    time_t          timer_start_time;
-    uint32          timer_duration;   /* seconds */
+    uint64          timer_expires;    /* monotonic msec */
+    uint32          timer_duration;   /* msec */
     void           *timer_cookie;
 } agt_timer_cb_t;
 
@@ -116,14 +116,31 @@ extern void
 /********************************************************************
 * FUNCTION agt_timer_handler
 *
-* Handle an incoming server timer polling interval
-* main routine called by agt_signal_handler
+* Advance the timer wheel to the current time and
+* invoke the callback for each timer that expired
+* Called from the ncxserver loop on every iteration
 *
 *********************************************************************/
 extern void
     agt_timer_handler (void);
 
 
+/********************************************************************
+* FUNCTION agt_timer_get_timeout
+*
+* Get the number of milliseconds until the timer wheel needs
+* to be serviced by agt_timer_handler
+*
+* INPUTS:
+*   maxwait == maximum value to return
+*
+* RETURNS:
+*   number of msec to wait (0 .. maxwait)
+*********************************************************************/
+extern uint32
+    agt_timer_get_timeout (uint32 maxwait);
+
+
 /********************************************************************
 * FUNCTION agt_timer_create
 *
@@ -153,6 +170,36 @@ extern status_t
                       uint32 *ret_timer_id);
 
 
+/********************************************************************
+* FUNCTION agt_timer_create_ms
+*
+* Malloc and start a new timer control block
+* Same as agt_timer_create except the interval is in milliseconds
+*
+* INPUTS:
+*   msec == number of milliseconds to wait between polls
+*   is_periodic == TRUE if periodic timer
+*                  FALSE if a 1-event timer
+*   timer_fn == address of callback function to invoke when
+*               the timer poll event occurs
+*   cookie == address of user cookie to pass to the timer_fn
+*   ret_timer_id == address of return timer ID
+*
+* OUTPUTS:
+*  *ret_timer_id == timer ID for the allocated timer, 
+*    if the return value is NO_ERR
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    agt_timer_create_ms (uint32 msec,
+                         boolean is_periodic,
+                         agt_timer_fn_t  timer_fn,
+                         void *cookie,
+                         uint32 *ret_timer_id);
+
+
 /********************************************************************
 * FUNCTION agt_timer_restart
 *
@@ -173,6 +220,24 @@ extern status_t
                        uint32 seconds);
 
 
+/********************************************************************
+* FUNCTION agt_timer_restart_ms
+*
+* Restart a timer with a new timeout value in milliseconds
+* Same as agt_timer_restart except for the time units
+*
+* INPUTS:
+*   timer_id == timer ID to reset
+*   msec == new timeout value
+*
+* RETURNS:
+*   status, NO_ERR if all okay,
+*********************************************************************/
+extern status_t
+    agt_timer_restart_ms (uint32 timer_id,
+                          uint32 msec);
+
+
 /********************************************************************
 * FUNCTION agt_timer_delete
 *
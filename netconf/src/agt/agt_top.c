@@ -178,8 +178,11 @@ void
         *ppscb=NULL;
 
     } else if (profile->agt_stream_output &&
-               scb->state == SES_ST_SHUTDOWN_REQ) {
-        /* session was closed */
+               scb->state == SES_ST_SHUTDOWN_REQ &&
+               dlq_empty(&scb->outQ)) {
+        /* session was closed; if the reply is still being sent
+         * then the session is killed from the select loop
+         */
         agt_ses_kill_session(scb,
                              scb->killedbysid,
                              scb->termreason);
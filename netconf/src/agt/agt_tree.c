@@ -68,6 +68,7 @@
 date         init     comment
 ----------------------------------------------------------------------
 16jun06      abb      begun; split out from agt_util.c
+17oct26               pass the filter to subtree get callbacks
 
 *********************************************************************
 *                                                                   *
@@ -91,6 +92,7 @@ date         init     comment
 #include "cfg.h"
 #include "def_reg.h"
 #include "dlq.h"
+#include "getcb.h"
 #include "log.h"
 #include "ncx.h"
 #include "ncx_num.h"
@@ -187,6 +189,37 @@ static ncx_filptr_t *
 } /* find_filptr */
 
 
+/********************************************************************
+* FUNCTION filter_selects_children
+*
+* Check if a filter node selects only some of the
+* child nodes of the matching target node
+*
+* INPUTS:
+*    filval == filter node value
+*
+* RETURNS:
+*    TRUE if there are any selection or containment nodes
+*    FALSE if the entire target node is selected
+*********************************************************************/
+static boolean
+    filter_selects_children (const val_value_t *filval)
+{
+    const val_value_t  *filchild;
+
+    for (filchild = val_get_first_child(filval);
+         filchild != NULL;
+         filchild = val_get_next_child(filchild)) {
+        if (filchild->btyp == NCX_BT_EMPTY ||
+            filchild->btyp == NCX_BT_CONTAINER) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+
+} /* filter_selects_children */
+
+
 /********************************************************************
 * FUNCTION attr_test
 *
@@ -421,6 +454,7 @@ static status_t
     val_value_t      *filchild, *curchild, *useval, *virtualval;
     val_index_t      *valindex;
     ncx_filptr_t     *filptr;
+    getcb_select_t    select;
     boolean           test, anycon, anysel, mykeepempty;
     xmlns_id_t        ncid, wildid;
     status_t          res;
@@ -457,13 +491,26 @@ static status_t
     anycon = FALSE;
     anysel = FALSE;
 
-    /* check if this is a real or a virtual value */
+    /* check if this is a real or a virtual value
+     * a subtree get callback is told the filter if only
+     * some of the child nodes are selected; a partial
+     * result is owned by the result filptr
+     */
     res = NO_ERR;
     virtualval = NULL;
     if (val_is_virtual(curval)) {
-        virtualval = val_get_virtual_value(scb,
-                                           curval,
-                                           &res);
+        if (filter_selects_children(filval)) {
+            select.filval = filval;
+            select.depth = 0;
+            virtualval = val_get_virtual_subtree(scb,
+                                                 &select,
+                                                 curval,
+                                                 &res);
+        } else {
+            virtualval = val_get_virtual_value(scb,
+                                               curval,
+                                               &res);
+        }
         if (virtualval == NULL) {
             return res;
         } else {
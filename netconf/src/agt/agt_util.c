@@ -2494,6 +2494,53 @@ status_t
 }  /* agt_add_top_virtual */
 
 
+/********************************************************************
+* FUNCTION agt_add_top_virtual_subtree
+*
+* make a val_value_t struct for a specified virtual
+* top-level container or list that is filled in by
+* one subtree get callback
+*
+INPUTS:
+*   obj == object node of the virtual data node to create
+*   callbackfn == subtree get callback function to install
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    agt_add_top_virtual_subtree (obj_template_t *obj,
+                                 getcb_subtree_fn_t callbackfn)
+{
+    val_value_t     *rootval, *nodeval;
+
+#ifdef DEBUG
+    if (obj == NULL || callbackfn == NULL) {
+        return SET_ERROR(ERR_INTERNAL_PTR);
+    }
+#endif
+
+    if (!(obj->objtype == OBJ_TYP_CONTAINER ||
+          obj->objtype == OBJ_TYP_LIST)) {
+        return ERR_NCX_WRONG_TYPE;
+    }
+
+    rootval = cfg_get_root(NCX_CFGID_RUNNING);
+    if (rootval == NULL) {
+        return ERR_NCX_OPERATION_FAILED;
+    }
+
+    nodeval = val_new_value();
+    if (!nodeval) {
+        return ERR_INTERNAL_MEM;
+    }
+    val_init_virtual_subtree(nodeval, callbackfn, obj);
+    val_add_child_sorted(nodeval, rootval);
+    return NO_ERR;
+
+}  /* agt_add_top_virtual_subtree */
+
+
 /********************************************************************
 * FUNCTION agt_add_top_container
 *
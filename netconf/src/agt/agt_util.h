@@ -871,6 +871,25 @@ extern status_t
                          getcb_fn_t callbackfn);
 
 
+/********************************************************************
+* FUNCTION agt_add_top_virtual_subtree
+*
+* make a val_value_t struct for a specified virtual
+* top-level container or list that is filled in by
+* one subtree get callback
+*
+INPUTS:
+*   obj == object node of the virtual data node to create
+*   callbackfn == subtree get callback function to install
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    agt_add_top_virtual_subtree (obj_template_t *obj,
+                                 getcb_subtree_fn_t callbackfn);
+
+
 /********************************************************************
 * FUNCTION agt_add_top_container
 *
@@ -30,6 +30,7 @@ date         init     comment
 *                                                                   *
 *********************************************************************/
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <memory.h>
 #include <assert.h>
@@ -42,9 +43,12 @@ date         init     comment
 #include "agt_cfg.h"
 #include "agt_commit_complete.h"
 #include "agt_ncx.h"
+#include "agt_nvstore.h"
 #include "agt_util.h"
 #include "agt_val.h"
 #include "agt_val_parse.h"
+#include "agt_val_pool.h"
+#include "bobhash.h"
 #include "cap.h"
 #include "cfg.h"
 #include "dlq.h"
@@ -57,6 +61,7 @@ date         init     comment
 #include "rpc.h"
 #include "rpc_err.h"
 #include "status.h"
+#include "tk.h"
 #include "typ.h"
 #include "tstamp.h"
 #include "val.h"
@@ -74,6 +79,18 @@ date         init     comment
 *                                                                   *
 *********************************************************************/
 
+/* max number of data nodes in a unique-stmt component path that
+ * will be resolved directly instead of through XPath */
+#define AGT_VAL_UNIQUE_MAX_DEPTH   16
+
+/* min number of changed nodes in a commit before the commit
+ * tests are run on the validation threads; tests that check
+ * every instance of an object always use the threads */
+#define AGT_VAL_POOL_MIN_EDITS     256
+
+/* end of a root_check_test_t list */
+#define AGT_VAL_NO_TEST            0xffffffff
+
 /* recursive callback function forward decls */
 static status_t
     invoke_btype_cb (agt_cbtyp_t cbtyp,
@@ -114,9 +131,112 @@ typedef struct unique_set_t_ {
     dlq_hdr_t  qhdr;
     dlq_hdr_t  uniqueQ;   /* Q of val_unique_t */
     val_value_t *valnode;  /* value tree back-ptr */
+
+    /* used by the hashed unique-stmt test only */
+    struct unique_set_t_ *next;    /* hash bucket chain */
+    struct unique_set_t_ *group;   /* first set with the same tuple */
+    uint32       grpcnt;   /* unchecked sets in group (first set only) */
+    uint32       hash;
+    uint32       keylen;
+    xmlChar     *key;      /* EOS-separated component values */
 } unique_set_t;
 
 
+/* direct path from the list to one unique-stmt component leaf */
+typedef struct unique_path_t_ {
+    obj_template_t *objs[AGT_VAL_UNIQUE_MAX_DEPTH];  /* leaf first */
+    uint32          depth;
+} unique_path_t;
+
+
+/* one changed node in the config being validated */
+typedef struct commit_edit_node_t_ {
+    val_value_t    *val;
+    boolean         subtree;   /* FALSE: a child of val was deleted */
+} commit_edit_node_t;
+
+
+/* one edited instance of a commit test object */
+typedef struct commit_edit_inst_t_ {
+    val_value_t    *val;
+    uint32          seq;       /* order the instance was found in */
+} commit_edit_inst_t;
+
+
+/* the changes since the running config was last validated,
+ * used to select the commit tests that need to be run
+ */
+typedef struct commit_edits_t_ {
+    boolean             known;       /* edits cover every change */
+    boolean             nodesvalid;  /* nodes cover every change */
+    obj_template_t    **objs;        /* distinct changed objects */
+    uint32              numobjs;
+    uint32              maxobjs;
+    const xmlChar     **subnames;    /* changed objects + descendants */
+    uint32              numsubnames;
+    uint32              maxsubnames;
+    const xmlChar     **ancnames;    /* ancestors of changed objects */
+    uint32              numancnames;
+    uint32              maxancnames;
+    commit_edit_node_t *nodes;
+    uint32              numnodes;
+    uint32              maxnodes;
+    commit_edit_inst_t *insts;       /* edited instances of one test */
+    uint32              numinsts;
+    uint32              maxinsts;
+} commit_edits_t;
+
+
+/* one commit test selected when the root check is run
+ * on the validation threads */
+typedef struct root_check_test_t_ {
+    agt_cfg_commit_test_t *ct;
+    uint32          tests;       /* tests to run */
+    boolean         allinst;     /* FALSE: edited instances only */
+    boolean         mainonly;    /* changes the tree while testing */
+    uint32          group;       /* first test in the same group */
+    uint32          next;        /* next test in the same group */
+    status_t        res;
+    boolean         errors;      /* a test failed */
+    boolean         hdrdone;     /* mhdr is initialized */
+    xml_msg_hdr_t   mhdr;        /* errors and prefixes of this test */
+} root_check_test_t;
+
+
+/* one inherited or choice/case when-stmt that the instance
+ * tests of a selected test evaluate; the XPath pcb is shared
+ * by all the objects it applies to */
+typedef struct root_check_when_t_ {
+    xpath_pcb_t    *pcb;
+    uint32          test;        /* index of the selected test */
+} root_check_when_t;
+
+
+/* a group of tests that can set the res of the same nodes
+ * or share other state, and must run in commit test order
+ * in one thread */
+typedef struct root_check_group_t_ {
+    uint32          first;       /* first test in the group */
+    boolean         mainonly;    /* run in the main thread only */
+} root_check_group_t;
+
+
+/* the selected commit tests of one root check */
+typedef struct root_check_t_ {
+    agt_profile_t          *profile;
+    ses_cb_t               *scb;
+    xml_msg_hdr_t          *msghdr;
+    agt_cfg_transaction_t  *txcb;
+    commit_edits_t         *edits;
+    val_value_t            *root;
+    root_check_test_t      *tests;
+    uint32                  numtests;
+    root_check_group_t     *groups;
+    uint32                  numgroups;
+    uint32                  numjobs;     /* groups run on the pool */
+} root_check_t;
+
+
 /********************************************************************
 *                                                                   *
 *                       V A R I A B L E S                           *
@@ -857,7 +977,7 @@ static status_t
             testval = val_find_child(parent, val_get_mod_name(child),
                                      child->name);
             if (testval) {
-                dlq_insertAhead(child, testval);
+                val_insert_child_before(child, testval, parent);
             } else {
                 val_add_child_sorted(child, parent);
             }
@@ -878,9 +998,9 @@ static status_t
                 if (editvars && editvars->insertval) {
                     testval = editvars->insertval;
                     if (editvars->insertop == OP_INSOP_BEFORE) {
-                        dlq_insertAhead(child, testval);
+                        val_insert_child_before(child, testval, parent);
                     } else {
-                        dlq_insertAfter(child, testval);
+                        val_insert_child(child, testval, parent);
                     }
                 } else {
                     SET_ERROR(ERR_NCX_INSERT_MISSING_INSTANCE);
@@ -1055,6 +1175,59 @@ static status_t
 }  /* move_mergedlist_node */
 
 
+/********************************************************************
+* FUNCTION order_commit_child
+*
+* Put a user-ordered list entry that a <commit> added to
+* the running config in the same position as in the candidate:
+* after the running entry matching the nearest candidate entry
+* before it, or ahead of all the entries if there is none
+*
+* INPUTS:
+*   child == list entry just added to parent
+*   marker == newval marker left in its place in the candidate
+*   parent == running config parent of child
+*
+* OUTPUTS:
+*    child moved within parent->v.childQ
+*********************************************************************/
+static void
+    order_commit_child (val_value_t  *child,
+                        val_value_t  *marker,
+                        val_value_t  *parent)
+{
+    if (child->obj->objtype != OBJ_TYP_LIST ||
+        obj_is_system_ordered(child->obj) ||
+        marker == NULL || marker->parent == NULL) {
+        return;
+    }
+
+    val_value_t *insertval = NULL;
+    val_value_t *prev = (val_value_t *)dlq_prevEntry(marker);
+    for (; prev != NULL && insertval == NULL;
+         prev = (val_value_t *)dlq_prevEntry(prev)) {
+        if (prev->obj == child->obj && !VAL_IS_DELETED(prev)) {
+            insertval = val_first_child_match(parent, prev);
+        }
+    }
+
+    val_remove_child(child);
+    if (insertval) {
+        val_insert_child(child, insertval, parent);
+    } else {
+        val_value_t *firstval = val_find_child(parent,
+                                               val_get_mod_name(child),
+                                               child->name);
+        if (firstval) {
+            val_insert_child_before(child, firstval, parent);
+        } else {
+            val_add_child_sorted(child, parent);
+        }
+    }
+
+}  /* order_commit_child */
+
+
 /********************************************************************
 * FUNCTION restore_newnode
 * 
@@ -1150,6 +1323,132 @@ static void
 }  /* restore_curnode */
 
 
+/********************************************************************
+* FUNCTION find_edit_node
+* 
+* Find or create the node in the candidate edit tree that
+* identifies a candidate (or running) config node
+*
+* INPUTS:
+*   editroot == root of the candidate edit tree
+*   val == config node to find
+*   covered == address of return covered flag
+*   res == address of return status
+*
+* OUTPUTS:
+*   *covered == TRUE if an ancestor is already an edit point
+*   *res == return status
+*
+* RETURNS:
+*   edit tree node for val, or NULL if covered or error
+*********************************************************************/
+static val_value_t *
+    find_edit_node (val_value_t *editroot,
+                    val_value_t *val,
+                    boolean *covered,
+                    status_t *res)
+{
+    if (obj_is_root(val->obj)) {
+        return editroot;
+    }
+    if (val->parent == NULL) {
+        /* node is no longer in the config tree */
+        *res = ERR_NCX_OPERATION_FAILED;
+        return NULL;
+    }
+
+    val_value_t *eparent = find_edit_node(editroot, val->parent, covered, 
+                                          res);
+    if (eparent == NULL) {
+        return NULL;
+    }
+    if (val_get_dirty_flag(eparent)) {
+        *covered = TRUE;
+        return NULL;
+    }
+
+    val_value_t *eval = val_first_child_match(eparent, val);
+    if (eval == NULL) {
+        eval = val_clone_identity(val, res);
+        if (eval == NULL) {
+            return NULL;
+        }
+        val_add_child(eval, eparent);
+    }
+    return eval;
+
+}  /* find_edit_node */
+
+
+/********************************************************************
+* FUNCTION record_candidate_edit
+* 
+* Record a changed node as an edit point in the candidate
+* edit tree, so <commit> only has to visit the edited subtrees
+* If the edit cannot be recorded the next commit will
+* compare the whole candidate config instead
+*
+* INPUTS:
+*   val == candidate node that was changed, or is about
+*          to be removed from the candidate
+*********************************************************************/
+static void
+    record_candidate_edit (val_value_t *val)
+{
+    cfg_template_t *candidate = cfg_get_config_id(NCX_CFGID_CANDIDATE);
+    if (candidate == NULL || candidate->root == NULL ||
+        cfg_get_full_compare(candidate)) {
+        return;
+    }
+
+    status_t res = NO_ERR;
+    if (candidate->editroot == NULL) {
+        candidate->editroot = val_new_value();
+        if (candidate->editroot == NULL) {
+            res = ERR_INTERNAL_MEM;
+        } else {
+            val_init_from_template(candidate->editroot, 
+                                   candidate->root->obj);
+        }
+    }
+
+    boolean covered = FALSE;
+    val_value_t *eval = NULL;
+    if (res == NO_ERR) {
+        eval = find_edit_node(candidate->editroot, val, &covered, &res);
+    }
+
+    if (res != NO_ERR) {
+        if (LOGDEBUG) {
+            log_debug("\nCandidate edit to %s not recorded (%s);"
+                      " next commit will compare the full config",
+                      val->name, get_error_string(res));
+        }
+        cfg_set_full_compare(candidate);
+        return;
+    }
+
+    if (eval == NULL || covered) {
+        return;
+    }
+
+    /* the whole subtree is applied at commit time, so drop
+     * any edit points recorded below this node; the list
+     * key nodes are never marked */
+    val_value_t *chval = val_get_first_child(eval);
+    val_value_t *nextval = NULL;
+    for (; chval != NULL; chval = nextval) {
+        nextval = val_get_next_child(chval);
+        if (val_dirty_subtree(chval)) {
+            val_remove_child(chval);
+            val_free_value(chval);
+        }
+    }
+    val_set_dirty_flag(eval);
+
+}  /* record_candidate_edit */
+
+
 /********************************************************************
 * FUNCTION restore_extra_deletes
 * 
@@ -1198,6 +1497,7 @@ static void
                 val_clear_dirty_flag(nodeptr->node);
             } else {
                 val_set_dirty_flag(nodeptr->node);
+                record_candidate_edit(nodeptr->node);
             }
             val_remove_child(nodeptr->node);
             val_free_value(nodeptr->node);
@@ -1739,7 +2039,7 @@ static status_t
         case OP_EDITOP_COMMIT:
             if (curval) {
                  if (newval && newval->editvars && 
-                     newval->editvars->insertstr) {
+                     newval->editvars->insertop != OP_INSOP_NONE) {
                      res = move_child_node(newval, newval_marker, curval,
                                            parent, msg, cur_editop);
                  } else if (newval) {
@@ -1762,6 +2062,10 @@ static status_t
                          VAL_MARK_DELETED(curval);
                          undo->edit_action = AGT_CFG_EDIT_ACTION_REPLACE;
                          undo->free_curnode = TRUE;
+                         if (cur_editop == OP_EDITOP_COMMIT) {
+                             order_commit_child(newval, newval_marker, 
+                                                parent);
+                         }
                      }
                  } else {
                      res = SET_ERROR(ERR_INTERNAL_VAL);
@@ -1769,6 +2073,9 @@ static status_t
             } else if (newval) {
                  res = add_child_node(newval, newval_marker, parent, msg,
                                       cur_editop);
+                 if (res == NO_ERR && cur_editop == OP_EDITOP_COMMIT) {
+                     order_commit_child(newval, newval_marker, parent);
+                 }
             } else {
                 res = SET_ERROR(ERR_INTERNAL_VAL);
             }
@@ -2588,14 +2895,14 @@ static void
 
     /* check if the newval marker was placed in the source tree */
     if (undo->newnode_marker) {
-        dlq_remove(undo->newnode_marker);
+        val_remove_child(undo->newnode_marker);
         val_free_value(undo->newnode_marker);
         undo->newnode_marker = NULL;
     }
 
     /* check if the curval marker was placed in the target tree */
     if (undo->curnode_marker) {
-        dlq_remove(undo->curnode_marker);
+        val_remove_child(undo->curnode_marker);
         val_free_value(undo->curnode_marker);
         undo->curnode_marker = NULL;
     }
@@ -2622,6 +2929,7 @@ static void
             val_clear_dirty_flag(undo->newnode);
         } else {
             val_set_dirty_flag(undo->newnode);
+            record_candidate_edit(undo->newnode);
         }
     }
 
@@ -2630,6 +2938,7 @@ static void
             val_clear_dirty_flag(undo->curnode);
         } else {
             val_set_dirty_flag(undo->curnode);
+            record_candidate_edit(undo->curnode);
         }
         if (undo->free_curnode) {
             if (VAL_IS_DELETED(undo->curnode)) {
@@ -3013,6 +3322,13 @@ static status_t
         }
     }
 
+    /* record the edits for the NV-store journal while the
+     * deleted nodes are still available */
+    if (target->cfg_id == NCX_CFGID_RUNNING &&
+        agt_nvstore_journal_enabled()) {
+        agt_nvstore_make_delta(txcb, target);
+    }
+
     /* all SIL commit callbacks accepted and finalized the commit
      * now go through and finalize the edit; this step should not fail 
      * first, finish deleting any false when-stmt nodes then commit edits */
@@ -3021,6 +3337,12 @@ static status_t
             dlq_deque(&txcb->deadnodeQ);
         if (nodeptr && nodeptr->node) {
             /* mark ancestor nodes dirty before deleting this node */
+            if (target->cfg_id == NCX_CFGID_CANDIDATE) {
+                val_set_dirty_flag(nodeptr->node);
+            }
+            /* the candidate has to drop this node too when it
+             * is synced from running after a commit */
+            record_candidate_edit(nodeptr->node);
             val_remove_child(nodeptr->node);
             val_free_value(nodeptr->node);
         } else {
@@ -3304,6 +3626,227 @@ static status_t
 }   /* apply_commit_deletes */
 
 
+/********************************************************************
+* FUNCTION diff_candidate_edits
+* 
+* Compare the candidate config to the running config and
+* record every difference as an edit point in the candidate
+* edit tree, after the candidate was filled without
+* recording its edits (e.g., <copy-config>)
+*
+* INPUTS:
+*   candval == node from the candidate config
+*   runval == matching node from the running config
+*
+* OUTPUTS:
+*   candidate nodes that differ have the dirty flag set
+*********************************************************************/
+static void
+    diff_candidate_edits (val_value_t *candval,
+                          val_value_t *runval)
+{
+    val_value_t *chval = val_get_first_child(candval);
+    for (; chval != NULL; chval = val_get_next_child(chval)) {
+
+        /* check only database config nodes */
+        if (!obj_is_data_db(chval->obj) || !obj_is_config(chval->obj)) {
+            continue;
+        }
+
+        val_value_t *matchval = val_first_child_match(runval, chval);
+        if (matchval == NULL ||
+            ((typ_is_simple(chval->btyp) || val_is_virtual(matchval) ||
+              chval->btyp == NCX_BT_ANYXML || 
+              chval->btyp == NCX_BT_ANYDATA) &&
+             val_compare_ex(chval, matchval, TRUE))) {
+            val_set_dirty_flag(chval);
+            record_candidate_edit(chval);
+        } else if (!typ_is_simple(chval->btyp)) {
+            diff_candidate_edits(chval, matchval);
+        }
+    }
+
+    /* record the running nodes that are not in the candidate */
+    chval = val_get_first_child(runval);
+    for (; chval != NULL; chval = val_get_next_child(chval)) {
+        if (obj_is_data_db(chval->obj) && obj_is_config(chval->obj) &&
+            val_first_child_match(candval, chval) == NULL) {
+            record_candidate_edit(chval);
+        }
+    }
+
+}   /* diff_candidate_edits */
+
+
+/********************************************************************
+* FUNCTION invoke_commit_edits
+* 
+* Invoke the callbacks for a <commit> on the edited subtrees only,
+* by following the candidate edit tree down to each edit point
+*
+* At an edit point, the candidate and running subtrees are
+* handled the same as in a walk of the full config;
+* an edit point that is not in the candidate is deleted
+* from the running config
+*
+* INPUTS:
+*   cbtyp == AGT_CB_VALIDATE or AGT_CB_APPLY
+*   editop == parent node edit operation
+*   scb == session control block
+*   msg == incoming commit rpc_msg_t in progress
+*   target == running config
+*   editval == node from the candidate edit tree
+*   candval == matching node from the candidate config
+*   runval == matching node from the running config
+*
+* OUTPUTS:
+*   rpc_err_rec_t structs may be malloced and added 
+*   to the msg->mhdr.errQ
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    invoke_commit_edits (agt_cbtyp_t cbtyp,
+                         op_editop_t editop,
+                         ses_cb_t  *scb,
+                         rpc_msg_t  *msg,
+                         cfg_template_t *target,
+                         val_value_t *editval,
+                         val_value_t *candval,
+                         val_value_t *runval)
+{
+    status_t res = NO_ERR, retres = NO_ERR;
+
+    val_value_t *eval = val_get_first_child(editval);
+    for (; eval != NULL && retres == NO_ERR; 
+         eval = val_get_next_child(eval)) {
+
+        if (!val_dirty_subtree(eval)) {
+            /* list key identifying the parent */
+            continue;
+        }
+
+        val_value_t *candch = val_first_child_match(candval, eval);
+        val_value_t *runch = val_first_child_match(runval, eval);
+
+        if (candch == NULL) {
+            /* deleted in the candidate, or created and deleted again */
+            if (runch == NULL || !obj_is_data_db(runch->obj) ||
+                !obj_is_config(runch->obj)) {
+                continue;
+            }
+
+            if (cbtyp == AGT_CB_VALIDATE) {
+                res = commit_delete_allowed(scb, msg, runch, TRUE);
+            } else {
+                /* prevent the agt_val code from ignoring this node */
+                val_set_dirty_flag(runch);
+                res = handle_callback(AGT_CB_APPLY, OP_EDITOP_DELETE, 
+                                      scb, msg, target, NULL, runch, runval);
+            }
+            CHK_EXIT(res, retres);
+            continue;
+        }
+
+        op_editop_t cur_editop = candch->editop;
+        if (cur_editop == OP_EDITOP_NONE) {
+            cur_editop = editop;
+        }
+
+        if (val_get_dirty_flag(eval) || runch == NULL || 
+            val_is_virtual(runch)) {
+            /* edit point; let the regular code compare this subtree */
+            res = invoke_btype_cb(cbtyp, cur_editop, scb, msg, target,
+                                  candch, runch, runval);
+        } else {
+            res = invoke_commit_edits(cbtyp, cur_editop, scb, msg, target,
+                                      eval, candch, runch);
+        }
+        CHK_EXIT(res, retres);
+    }
+
+    return retres;
+
+}   /* invoke_commit_edits */
+
+
+/********************************************************************
+* FUNCTION handle_commit_edits
+* 
+* Invoke the callbacks for a <commit> from the candidate
+* to the running config on the edited subtrees
+*
+* The edit tree recorded in the candidate is used if it is
+* complete; otherwise it is first rebuilt by comparing the
+* whole candidate and running configs
+*
+* INPUTS:
+*   cbtyp == AGT_CB_VALIDATE or AGT_CB_APPLY
+*   scb == session control block
+*   msg == incoming commit rpc_msg_t in progress
+*   source == candidate config
+*   target == running config
+*
+* OUTPUTS:
+*   rpc_err_rec_t structs may be malloced and added 
+*   to the msg->mhdr.errQ
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    handle_commit_edits (agt_cbtyp_t cbtyp,
+                         ses_cb_t  *scb,
+                         rpc_msg_t  *msg,
+                         cfg_template_t *source,
+                         cfg_template_t *target)
+{
+    agt_cfg_transaction_t *txcb = msg->rpc_txcb;
+    status_t res = NO_ERR;
+
+    /* the edit tree only covers the changes from the running
+     * config that the candidate was copied from */
+    if (source->src_txid != target->last_txid) {
+        cfg_set_full_compare(source);
+    }
+
+    if (cfg_get_full_compare(source)) {
+        if (LOGDEBUG2) {
+            log_debug2("\nagt_val: comparing full %s config for commit",
+                       source->name);
+        }
+        cfg_clear_edits(source);
+        diff_candidate_edits(source->root, target->root);
+        if (!cfg_get_full_compare(source)) {
+            source->src_txid = target->last_txid;
+        }
+    }
+
+    if (cfg_get_full_compare(source)) {
+        /* diff could not be recorded; walk the whole config */
+        res = handle_callback(cbtyp, OP_EDITOP_COMMIT, scb, msg, target, 
+                              source->root, target->root, target->root);
+    } else if (source->editroot) {
+        if (LOGDEBUG2) {
+            log_debug2("\n\n***** start %s callback phase on edited "
+                       "subtrees for session %d, transaction %llu *****\n",
+                       agt_cbtype_name(cbtyp), scb ? SES_MY_SID(scb) : 0,
+                       (unsigned long long)txcb->txid);
+        }
+        res = invoke_commit_edits(cbtyp, OP_EDITOP_COMMIT, scb, msg, target,
+                                  source->editroot, source->root, 
+                                  target->root);
+        if (cbtyp == AGT_CB_APPLY) {
+            txcb->apply_res = res;
+        }
+    }
+
+    return res;
+
+}   /* handle_commit_edits */
+
+
 /********************************************************************
 * FUNCTION compare_unique_testsets
 * 
@@ -3382,6 +3925,9 @@ static void free_unique_set (unique_set_t *uset)
         unival = (val_unique_t *)dlq_deque(&uset->uniqueQ);
         val_free_unique(unival);
     }
+    if (uset->key) {
+        m__free(uset->key);
+    }
     m__free(uset);
 
 }   /* free_unique_set */
@@ -3480,52 +4026,422 @@ static status_t
 
 
 /********************************************************************
-* FUNCTION one_unique_stmt_check
+* FUNCTION get_unique_path
 * 
-* Run the unique-stmt test for the specified list object type
+* Get the chain of data nodes from a list object to the leaf
+* named by a unique-stmt component, so the leaf can be found
+* in each list entry without evaluating the component XPath
 *
 * INPUTS:
-*   scb == session control block (may be NULL; no session stats)
-*   msg == xml_msg_hdr t from msg in progress 
-*       == NULL MEANS NO RPC-ERRORS ARE RECORDED
-*   ct == commit test record to use
-*   root == XPath docroot to use
-*   unidef == obj_unique_t to process
-*   uninum == ordinal ID for this unique-stmt
+*   listobj == list object containing the unique-stmt
+*   unicomp == unique-stmt component to resolve
+*   path == path struct to fill in
 *
 * OUTPUTS:
-*   if msg not NULL:
-*      msg->msg_errQ may have rpc_err_rec_t structs added to it 
-*      which must be freed by the called with the 
-*      rpc_err_free_record function
+*   *path filled in if TRUE returned
 *
 * RETURNS:
-*   status of the operation, NO_ERR if no validation errors found
+*   TRUE if the leaf can be found directly
+*   FALSE if the component needs the XPath evaluation
 *********************************************************************/
-static status_t 
-    one_unique_stmt_check (ses_cb_t *scb,
-                           xml_msg_hdr_t *msg,
-                           agt_cfg_commit_test_t *ct,
-                           val_value_t *root,
-                           obj_unique_t *unidef,
-                           uint32 uninum)
+static boolean
+    get_unique_path (obj_template_t *listobj,
+                     obj_unique_comp_t *unicomp,
+                     unique_path_t *path)
 {
-    dlq_hdr_t        uniQ, freeQ, usetQ;
-    val_unique_t    *unival;
-    unique_set_t    *uset;
-
-    assert( ct && "ct is NULL!" );
-    assert( ct->result && "result is NULL!" );
-    assert( unidef && "unidef is NULL!" );
-    assert( unidef->xpath && "xpath is NULL!" );
+    obj_template_t *obj = NULL;
+    status_t res = xpath_find_obj_unique(listobj, listobj->tkerr.mod,
+                                         unicomp->xpath, FALSE, &obj);
 
-    status_t retres = NO_ERR;
-    dlq_createSQue(&uniQ);   // Q of val_unique_t 
-    dlq_createSQue(&freeQ);  // Q of val_unique_t
-    dlq_createSQue(&usetQ);  // Q of unique_set_t
+    path->depth = 0;
+    if (res != NO_ERR || obj->objtype != OBJ_TYP_LEAF ||
+        obj_is_password(obj)) {
+        return FALSE;
+    }
 
-    if (LOGDEBUG3) {
-        log_debug3("\nunique_chk: %s:%s start unique # %u (%s)", 
+    /* only containers, choices and cases are allowed between
+     * the list and the leaf, so there is at most 1 leaf instance
+     * per list entry and the test set is a single node */
+    path->objs[path->depth++] = obj;
+    for (obj = obj->parent; obj != listobj; obj = obj->parent) {
+        if (obj == NULL) {
+            return FALSE;
+        }
+        switch (obj->objtype) {
+        case OBJ_TYP_CONTAINER:
+            if (path->depth == AGT_VAL_UNIQUE_MAX_DEPTH) {
+                return FALSE;
+            }
+            path->objs[path->depth++] = obj;
+            break;
+        case OBJ_TYP_CHOICE:
+        case OBJ_TYP_CASE:
+            break;
+        default:
+            return FALSE;
+        }
+    }
+    return TRUE;
+
+} /* get_unique_path */
+
+
+/********************************************************************
+* FUNCTION find_unique_leaf
+* 
+* Find the unique-stmt component leaf within one list entry
+*
+* INPUTS:
+*   valnode == list entry to check
+*   path == path from get_unique_path
+*   retleaf == address of return leaf
+*
+* OUTPUTS:
+*   *retleaf == leaf node found or NULL if it is not present
+*
+* RETURNS:
+*   TRUE if the search is complete
+*   FALSE if a virtual node was found and the XPath evaluation
+*      is needed instead
+*********************************************************************/
+static boolean
+    find_unique_leaf (val_value_t *valnode,
+                      const unique_path_t *path,
+                      val_value_t **retleaf)
+{
+    val_value_t *curval = valnode;
+    uint32 i = path->depth;
+
+    *retleaf = NULL;
+    while (i > 0 && curval != NULL) {
+        if (val_is_virtual(curval)) {
+            return FALSE;
+        }
+        const obj_template_t *obj = path->objs[--i];
+        curval = val_find_child(curval, obj_get_mod_name(obj),
+                                obj_get_name(obj));
+    }
+    if (curval != NULL && val_is_virtual(curval)) {
+        return FALSE;
+    }
+    *retleaf = curval;
+    return TRUE;
+
+} /* find_unique_leaf */
+
+
+/********************************************************************
+* FUNCTION add_unique_key_comp
+* 
+* Append the string value of a unique-stmt component leaf to
+* the key of a unique test set.  This is the same string the
+* XPath node-set compare uses, followed by an EOS separator
+*
+* INPUTS:
+*   uset == unique test set to update
+*   leaf == component leaf
+*   keymax == address of the allocated size of uset->key
+*
+* OUTPUTS:
+*   uset->key, uset->keylen and *keymax are updated
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_unique_key_comp (unique_set_t *uset,
+                         const val_value_t *leaf,
+                         uint32 *keymax)
+{
+    const xmlChar *str = NULL;
+    uint32 len = 0;
+
+    if (typ_is_string(leaf->btyp)) {
+        str = VAL_STR(leaf);
+        len = (str) ? xml_strlen(str) : 0;
+    } else {
+        status_t res = val_sprintf_simval_nc(NULL, leaf, &len);
+        if (res != NO_ERR) {
+            return res;
+        }
+    }
+
+    if (uset->keylen + len + 1 > *keymax) {
+        uint32 newmax = (uset->keylen + len + 1) * 2;
+        xmlChar *newkey = m__getMem(newmax);
+        if (newkey == NULL) {
+            return ERR_INTERNAL_MEM;
+        }
+        if (uset->key) {
+            memcpy(newkey, uset->key, uset->keylen);
+            m__free(uset->key);
+        }
+        uset->key = newkey;
+        *keymax = newmax;
+    }
+
+    if (str) {
+        memcpy(&uset->key[uset->keylen], str, len);
+    } else if (len) {
+        status_t res = val_sprintf_simval_nc(&uset->key[uset->keylen],
+                                             leaf, &len);
+        if (res != NO_ERR) {
+            return res;
+        }
+    }
+    uset->keylen += len;
+    uset->key[uset->keylen++] = 0;
+    return NO_ERR;
+
+} /* add_unique_key_comp */
+
+
+/********************************************************************
+* FUNCTION hash_unique_stmt_check
+* 
+* Run the unique-stmt test for the specified list object type
+* by hashing the tuple of component values of each list instance.
+* Only used if every component leaf can be found without XPath;
+* the error records are the same as one_unique_stmt_check
+* generates with the pairwise compare.
+*
+* INPUTS:
+*   scb == session control block (may be NULL; no session stats)
+*   msg == xml_msg_hdr t from msg in progress 
+*       == NULL MEANS NO RPC-ERRORS ARE RECORDED
+*   ct == commit test record to use
+*   root == XPath docroot to use
+*   unidef == obj_unique_t to process
+*   done == address of return done flag
+*
+* OUTPUTS:
+*   *done == TRUE if the test was run
+*            FALSE if one_unique_stmt_check needs to be used
+*   if msg not NULL:
+*      msg->msg_errQ may have rpc_err_rec_t structs added to it 
+*      which must be freed by the called with the 
+*      rpc_err_free_record function
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t 
+    hash_unique_stmt_check (ses_cb_t *scb,
+                            xml_msg_hdr_t *msg,
+                            agt_cfg_commit_test_t *ct,
+                            val_value_t *root,
+                            obj_unique_t *unidef,
+                            boolean *done)
+{
+    dlq_hdr_t        usetQ, freeQ;
+    unique_path_t   *paths = NULL;
+    unique_set_t   **buckets = NULL;
+    unique_set_t    *uset;
+    uint32           numcomps = 0, numsets = 0, numbuckets, i;
+
+    *done = FALSE;
+
+    /* resolve each component leaf once for all list entries */
+    obj_unique_comp_t *unicomp = obj_first_unique_comp(unidef);
+    for (; unicomp; unicomp = obj_next_unique_comp(unicomp)) {
+        numcomps++;
+    }
+    if (numcomps == 0) {
+        return NO_ERR;
+    }
+
+    paths = m__getMem(numcomps * sizeof(unique_path_t));
+    if (paths == NULL) {
+        return NO_ERR;
+    }
+
+    i = 0;
+    unicomp = obj_first_unique_comp(unidef);
+    for (; unicomp; unicomp = obj_next_unique_comp(unicomp), i++) {
+        if (unicomp->isduplicate) {
+            paths[i].depth = 0;
+        } else if (!get_unique_path(ct->obj, unicomp, &paths[i])) {
+            m__free(paths);
+            return NO_ERR;
+        }
+    }
+
+    status_t retres = NO_ERR;
+    dlq_createSQue(&usetQ);  // Q of unique_set_t
+    dlq_createSQue(&freeQ);  // Q of val_unique_t
+
+    /* create a key for each list instance that has a complete
+     * tuple to test; skip all instances with partial tuples and
+     * the instances already flagged by another unique-stmt */
+    xpath_resnode_t *resnode = xpath_get_first_resnode(ct->result);
+    for (; resnode && retres == NO_ERR; 
+         resnode = xpath_get_next_resnode(resnode)) {
+
+        val_value_t *valnode = xpath_get_resnode_valptr(resnode);
+        if (valnode->res == ERR_NCX_UNIQUE_TEST_FAILED) {
+            continue;
+        }
+
+        uset = new_unique_set();
+        if (uset == NULL) {
+            retres = ERR_INTERNAL_MEM;
+            continue;
+        }
+        uset->valnode = valnode;
+
+        boolean complete = TRUE;
+        uint32 keymax = 0;
+        for (i = 0; i < numcomps && complete && retres == NO_ERR; i++) {
+            if (paths[i].depth == 0) {
+                continue;
+            }
+            val_value_t *leaf = NULL;
+            if (!find_unique_leaf(valnode, &paths[i], &leaf)) {
+                retres = ERR_NCX_SKIPPED;
+            } else if (leaf == NULL) {
+                complete = FALSE;
+            } else {
+                retres = add_unique_key_comp(uset, leaf, &keymax);
+            }
+        }
+
+        if (retres == NO_ERR && complete) {
+            uset->hash = bobhash(uset->key, uset->keylen, 0);
+            dlq_enque(uset, &usetQ);
+            numsets++;
+        } else {
+            free_unique_set(uset);
+        }
+    }
+
+    if (retres == ERR_NCX_SKIPPED) {
+        /* found a virtual node; use the XPath test instead */
+        retres = NO_ERR;
+    } else if (retres == NO_ERR) {
+        *done = TRUE;
+        for (numbuckets = 16; numbuckets < numsets; numbuckets <<= 1) {
+            ;
+        }
+        buckets = m__getMem(numbuckets * sizeof(unique_set_t *));
+        if (buckets == NULL) {
+            retres = ERR_INTERNAL_MEM;
+        } else {
+            memset(buckets, 0x0, numbuckets * sizeof(unique_set_t *));
+        }
+    }
+
+    if (*done && retres == NO_ERR) {
+        /* group the sets with equal tuples in 1 pass */
+        for (uset = (unique_set_t *)dlq_firstEntry(&usetQ); uset;
+             uset = (unique_set_t *)dlq_nextEntry(uset)) {
+
+            unique_set_t **bucket = &buckets[uset->hash & (numbuckets - 1)];
+            unique_set_t *head = *bucket;
+            for (; head; head = head->next) {
+                if (head->hash == uset->hash &&
+                    head->keylen == uset->keylen &&
+                    !memcmp(head->key, uset->key, uset->keylen)) {
+                    break;
+                }
+            }
+            if (head) {
+                uset->group = head;
+                head->grpcnt++;
+            } else {
+                uset->grpcnt = 1;
+                uset->next = *bucket;
+                *bucket = uset;
+            }
+        }
+
+        /* each set would have matched every later set in its group
+         * in the pairwise compare, so record that many errors   */
+        for (uset = (unique_set_t *)dlq_firstEntry(&usetQ); uset;
+             uset = (unique_set_t *)dlq_nextEntry(uset)) {
+
+            unique_set_t *head = (uset->group) ? uset->group : uset;
+            uint32 dupcnt = --head->grpcnt;
+            if (dupcnt == 0) {
+                continue;
+            }
+
+            /* get the XPath test set for the error-info */
+            status_t res = make_unique_testset(uset->valnode, unidef, root,
+                                               &uset->uniqueQ, &freeQ);
+            if (res != NO_ERR && res != ERR_NCX_CANCELED) {
+                retres = res;
+                break;
+            }
+            for (; dupcnt > 0; dupcnt--) {
+                agt_record_unique_error(scb, msg, uset->valnode,
+                                        &uset->uniqueQ);
+            }
+            uset->valnode->res = ERR_NCX_UNIQUE_TEST_FAILED;
+            retres = ERR_NCX_UNIQUE_TEST_FAILED;
+        }
+    }
+
+    while (!dlq_empty(&usetQ)) {
+        uset = (unique_set_t *)dlq_deque(&usetQ);
+        free_unique_set(uset);
+    }
+    if (buckets) {
+        m__free(buckets);
+    }
+    m__free(paths);
+
+    return retres;
+
+} /* hash_unique_stmt_check */
+
+
+/********************************************************************
+* FUNCTION one_unique_stmt_check
+* 
+* Run the unique-stmt test for the specified list object type
+*
+* INPUTS:
+*   scb == session control block (may be NULL; no session stats)
+*   msg == xml_msg_hdr t from msg in progress 
+*       == NULL MEANS NO RPC-ERRORS ARE RECORDED
+*   ct == commit test record to use
+*   root == XPath docroot to use
+*   unidef == obj_unique_t to process
+*   uninum == ordinal ID for this unique-stmt
+*
+* OUTPUTS:
+*   if msg not NULL:
+*      msg->msg_errQ may have rpc_err_rec_t structs added to it 
+*      which must be freed by the called with the 
+*      rpc_err_free_record function
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t 
+    one_unique_stmt_check (ses_cb_t *scb,
+                           xml_msg_hdr_t *msg,
+                           agt_cfg_commit_test_t *ct,
+                           val_value_t *root,
+                           obj_unique_t *unidef,
+                           uint32 uninum)
+{
+    dlq_hdr_t        uniQ, freeQ, usetQ;
+    val_unique_t    *unival;
+    unique_set_t    *uset;
+
+    assert( ct && "ct is NULL!" );
+    assert( ct->result && "result is NULL!" );
+    assert( unidef && "unidef is NULL!" );
+    assert( unidef->xpath && "xpath is NULL!" );
+
+    status_t retres = NO_ERR;
+    dlq_createSQue(&uniQ);   // Q of val_unique_t 
+    dlq_createSQue(&freeQ);  // Q of val_unique_t
+    dlq_createSQue(&usetQ);  // Q of unique_set_t
+
+    if (LOGDEBUG3) {
+        log_debug3("\nunique_chk: %s:%s start unique # %u (%s)", 
                    obj_get_mod_name(ct->obj), obj_get_name(ct->obj),
                    uninum, unidef->xpath);
     }
@@ -3646,8 +4562,13 @@ static status_t
         ++uninum;
 
         if (unidef->isconfig) {
-            status_t res = one_unique_stmt_check(scb, msg, ct, root,
-                                                 unidef, uninum);
+            boolean done = FALSE;
+            status_t res = hash_unique_stmt_check(scb, msg, ct, root,
+                                                  unidef, &done);
+            if (!done) {
+                res = one_unique_stmt_check(scb, msg, ct, root,
+                                            unidef, uninum);
+            }
             CHK_EXIT(res, retres);
         }
 
@@ -4632,700 +5553,2605 @@ static status_t
 
 
 /********************************************************************
- * 
- * Delete all the nodes that have false when-stmt exprs
- * Also delete empty NP-containers
- *
- * \param scb session control block (may be NULL)
- * \param msghdr XML message header in progress
- * \param txcb transaction control block to use
- * \param root root from the target database to use
- * \param retcount address of return deletecount
- * \return status
- *********************************************************************/
-static status_t delete_dead_nodes ( ses_cb_t  *scb,
-                                    xml_msg_hdr_t *msghdr,
-                                    agt_cfg_transaction_t *txcb,
-                                    val_value_t *root,
-                                    uint32 *retcount )
+* FUNCTION grow_edit_array
+* 
+* Double the size of one of the commit_edits_t arrays
+*
+* INPUTS:
+*   arr == array to grow (may be NULL)
+*   maxcnt == address of the array size
+*   entsize == size of one array entry
+*
+* OUTPUTS:
+*   *maxcnt is updated if the array is replaced
+*
+* RETURNS:
+*   malloced array with the old entries copied, which
+*   replaces 'arr', or NULL if ERR_INTERNAL_MEM
+*********************************************************************/
+static void *
+    grow_edit_array (void *arr,
+                     uint32 *maxcnt,
+                     uint32 entsize)
 {
-    *retcount = 0;
+    uint32 newmax = (*maxcnt) ? (*maxcnt * 2) : 16;
+    void *newarr = m__getMem(newmax * entsize);
+    if (newarr == NULL) {
+        return NULL;
+    }
+    if (arr) {
+        memcpy(newarr, arr, *maxcnt * entsize);
+        m__free(arr);
+    }
+    *maxcnt = newmax;
+    return newarr;
 
-    agt_profile_t *profile = agt_get_profile();
-    agt_cfg_commit_test_t *ct = (agt_cfg_commit_test_t *)
-        dlq_firstEntry(&profile->agt_commit_testQ);
+}  /* grow_edit_array */
 
-    for (; ct != NULL; ct = (agt_cfg_commit_test_t *)dlq_nextEntry(ct)) {
-        uint32  tests = ct->testflags & AGT_TEST_FL_WHEN;
-        if (tests == 0) {
-            /* no when-stmt tests needed for this node */
-            continue;
-        }
 
-        status_t res = prep_commit_test_node(scb, msghdr, txcb, ct, root);
-        if (res != NO_ERR) {
-            return res;
-        }
-
-        /* run all relevant tests on each node in the result set */
-        xpath_resnode_t *resnode = xpath_get_first_resnode(ct->result);
-        xpath_resnode_t *nextnode = NULL;
-        for (; resnode != NULL; resnode = nextnode) {
-            nextnode = xpath_get_next_resnode(resnode);
-
-            val_value_t *valnode = xpath_get_resnode_valptr(resnode);
-            res = run_when_stmt_check(scb, msghdr, txcb, root, valnode);
-            if (res != NO_ERR) {
-                /* treat any when delete error as terminate transaction */
-                return res;
-            } else if (VAL_IS_DELETED(valnode)) {
-                /* this node has just been flagged when=FALSE so
-                 * remove this resnode from the result so it will
-                 * not be reused by a commit test   */
-                xpath_delete_resnode(resnode);
-                (*retcount)++;
-            }
-        }
+/********************************************************************
+* FUNCTION clean_commit_edits
+* 
+* Free the arrays in a commit_edits_t struct
+*
+* INPUTS:
+*   edits == struct to clean
+*********************************************************************/
+static void
+    clean_commit_edits (commit_edits_t *edits)
+{
+    if (edits->objs) {
+        m__free(edits->objs);
     }
+    if (edits->subnames) {
+        m__free(edits->subnames);
+    }
+    if (edits->ancnames) {
+        m__free(edits->ancnames);
+    }
+    if (edits->nodes) {
+        m__free(edits->nodes);
+    }
+    if (edits->insts) {
+        m__free(edits->insts);
+    }
+    memset(edits, 0x0, sizeof(commit_edits_t));
 
-    return NO_ERR;
-
-}  /* delete_dead_nodes */
+}  /* clean_commit_edits */
 
 
 /********************************************************************
-* FUNCTION check_parent_tests
+* FUNCTION add_edit_name
 * 
-* Check if the specified object has any commit tests
-* to record in the parent node
+* Add a schema node name to one of the commit_edits_t name arrays
 *
 * INPUTS:
-*  obj == object to check
-*  flags == address of return testflags
-*
-* OUTPUTS:
-*   *flags is set if any tests are needed
+*   names == address of the name array
+*   numnames == address of the name count
+*   maxnames == address of the array size
+*   name == name to add
 *
+* RETURNS:
+*   status
 *********************************************************************/
-static void
-    check_parent_tests (obj_template_t *obj,
-                        uint32 *flags)
+static status_t
+    add_edit_name (const xmlChar ***names,
+                   uint32 *numnames,
+                   uint32 *maxnames,
+                   const xmlChar *name)
 {
-    uint32 numelems = 0;
-    switch (obj->objtype) {
-    case OBJ_TYP_LEAF_LIST:
-    case OBJ_TYP_LIST:
-        if (obj_get_min_elements(obj, &numelems)) {
-            if (numelems > 1) {
-                *flags |= AGT_TEST_FL_MIN_ELEMS;
-            } // else AGT_TEST_FL_MANDATORY will check for 1 instance
-        }
-        numelems = 0;
-        if (obj_get_max_elements(obj, &numelems)) {
-            *flags |= AGT_TEST_FL_MAX_ELEMS;
+    if (*numnames == *maxnames) {
+        const xmlChar **newnames = 
+            grow_edit_array((void *)*names, maxnames, sizeof(xmlChar *));
+        if (newnames == NULL) {
+            return ERR_INTERNAL_MEM;
         }
-        break;
-    case OBJ_TYP_LEAF:
-    case OBJ_TYP_CONTAINER:
-        *flags |= AGT_TEST_FL_MAX_ELEMS;
-        break;       
-    case OBJ_TYP_CHOICE:
-        *flags |= AGT_TEST_FL_CHOICE;
-        break;
-    default:
-        ;
-    }
-    if (obj_is_mandatory(obj) && !obj_is_key(obj)) {
-        *flags |= AGT_TEST_FL_MANDATORY;
+        *names = newnames;
     }
+    (*names)[(*numnames)++] = name;
+    return NO_ERR;
 
-}  /* check_parent_tests */
+}  /* add_edit_name */
 
 
 /********************************************************************
-* FUNCTION add_obj_commit_tests
+* FUNCTION add_edit_subnames
 * 
-* Check if the specified object and all its descendants 
-* have any commit tests to record in the commit_testQ
-* Tests are added in top-down order
-* TBD: cascade XPath lookup results to nested commmit tests
-*
-* Tests done in the parent node:
-*   AGT_TEST_FL_MIN_ELEMS
-*   AGT_TEST_FL_MAX_ELEMS
-*   AGT_TEST_FL_MANDATORY
-*
-* Tests done in the object node:
-*   AGT_TEST_FL_MUST
-*   AGT_TEST_FL_UNIQUE
-*   AGT_TEST_FL_XPATH_TYPE
-*   AGT_TEST_FL_WHEN  (part of delete_dead_nodes, not this fn)
+* Add the names of a changed object and all its schema
+* descendants, since the whole subtree may have changed
 *
 * INPUTS:
-*  obj == object to check
-*  commit_testQ == address of queue to use to fill with
-*                  agt_cfg_commit_test_t structs
-*  rootflags == address of return root node testflags
+*   edits == commit edits in progress
+*   obj == changed object
 *
-* OUTPUTS:
-*  commit_testQ will contain an agt_cfg_commit_test_t struct
-*  for each descendant-or-self object found with 
-*  commit-time validation tests
-*  *rootflags will be altered if node is top-level and
-*   needs instance testing
 * RETURNS:
-*  status of the operation, NO_ERR unless internal errors found
-*  or malloc error
+*   status
 *********************************************************************/
 static status_t
-    add_obj_commit_tests (obj_template_t *obj,
-			  dlq_hdr_t *commit_testQ,
-                          uint32 *rootflags)
+    add_edit_subnames (commit_edits_t *edits,
+                       obj_template_t *obj)
 {
-    if (skip_obj_commit_test(obj)) {
-        return NO_ERR;
+    status_t res = add_edit_name(&edits->subnames, &edits->numsubnames,
+                                 &edits->maxsubnames, obj_get_name(obj));
+
+    obj_template_t *chobj = obj_first_child(obj);
+    for (; chobj != NULL && res == NO_ERR; chobj = obj_next_child(chobj)) {
+        res = add_edit_subnames(edits, chobj);
     }
+    return res;
 
-    status_t res = NO_ERR;
+}  /* add_edit_subnames */
 
-    /* check for tests in active config nodes, bottom-up traversal */
-    uint32 testflags = 0;
-    dlq_hdr_t *mustQ = obj_get_mustQ(obj);
-    ncx_btype_t btyp = obj_get_basetype(obj);
-    obj_template_t *chobj;
 
-    if (!(obj->objtype == OBJ_TYP_CHOICE || obj->objtype == OBJ_TYP_CASE)) {
-        if (mustQ && !dlq_empty(mustQ)) {
-            testflags |= AGT_TEST_FL_MUST;
-        }
-    
-        if (obj_has_when_stmts(obj)) {
-            testflags |= AGT_TEST_FL_WHEN;
+/********************************************************************
+* FUNCTION add_edit_obj
+* 
+* Add a changed object to the commit edits, if not already added
+*
+* INPUTS:
+*   edits == commit edits in progress
+*   obj == changed object
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_edit_obj (commit_edits_t *edits,
+                  obj_template_t *obj)
+{
+    uint32 i;
+    for (i = 0; i < edits->numobjs; i++) {
+        if (edits->objs[i] == obj) {
+            return NO_ERR;
         }
     }
 
-    obj_unique_t *unidef = obj_first_unique(obj);
-    boolean done = FALSE;
-    for (; unidef && !done; unidef = obj_next_unique(unidef)) {
-        if (unidef->isconfig) {
-            testflags |= AGT_TEST_FL_UNIQUE;
-            done = TRUE;
+    if (edits->numobjs == edits->maxobjs) {
+        obj_template_t **newobjs = 
+            grow_edit_array(edits->objs, &edits->maxobjs,
+                            sizeof(obj_template_t *));
+        if (newobjs == NULL) {
+            return ERR_INTERNAL_MEM;
         }
+        edits->objs = newobjs;
     }
+    edits->objs[edits->numobjs++] = obj;
+    return NO_ERR;
 
-    if (obj_is_top(obj)) {
-        /* need to check if this is a top-level node that
-         * has instance requirements (mandatory/min/max)
-         */
-        check_parent_tests(obj, rootflags);
-    }
+}  /* add_edit_obj */
 
-    if (obj->objtype == OBJ_TYP_CHOICE || obj->objtype == OBJ_TYP_CASE) {
-        /* do not create a commit test record for a choice or case
-         * since they will never be in the data tree, so XPath
-         * will never find them */
-        testflags = 0;
-    } else {
-        /* set the instance or MANDATORY test bits in the parent,
-         * not in the child nodes for each commit test
-         * check all child nodes to determine if parent needs
-         * to run instance_check
-         */
-        for (chobj = obj_first_child(obj); 
-             chobj != NULL; 
-             chobj = obj_next_child(chobj)) {
 
-            if (skip_obj_commit_test(chobj)) {
-                continue;
-            }
-            check_parent_tests(chobj, &testflags);
-        }
-    
-        typ_def_t *typdef = obj_get_typdef(obj);
-        if (btyp == NCX_BT_LEAFREF || 
-            (btyp == NCX_BT_INSTANCE_ID && typ_get_constrained(typdef))) {
-            /* need to check XPath-based leaf to see that the referenced
-             * instance exists in the target data tree
-             */
-            testflags |= AGT_TEST_FL_XPATH_TYPE;
+/********************************************************************
+* FUNCTION add_edit_node
+* 
+* Add a changed node to the commit edits
+*
+* INPUTS:
+*   edits == commit edits in progress
+*   val == changed node
+*   subtree == TRUE if the whole subtree of val has changed
+*              FALSE if only a child of val was deleted
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_edit_node (commit_edits_t *edits,
+                   val_value_t *val,
+                   boolean subtree)
+{
+    if (edits->numnodes == edits->maxnodes) {
+        commit_edit_node_t *newnodes = 
+            grow_edit_array(edits->nodes, &edits->maxnodes,
+                            sizeof(commit_edit_node_t));
+        if (newnodes == NULL) {
+            return ERR_INTERNAL_MEM;
         }
+        edits->nodes = newnodes;
     }
+    edits->nodes[edits->numnodes].val = val;
+    edits->nodes[edits->numnodes].subtree = subtree;
+    edits->numnodes++;
+    return NO_ERR;
 
-    if (testflags) {
-        /* need a commit test record for this object */
-        agt_cfg_commit_test_t *ct = agt_cfg_new_commit_test();
-        if (ct == NULL) {
-            return ERR_INTERNAL_MEM;
-        } 
+}  /* add_edit_node */
 
-        ct->objpcb = xpath_new_pcb(NULL, NULL);
-        if (ct->objpcb == NULL) {
-            agt_cfg_free_commit_test(ct);
-            return ERR_INTERNAL_MEM;
-        }
 
-        res = obj_gen_object_id_xpath(obj, &ct->objpcb->exprstr);
-        if (res != NO_ERR) {
-            agt_cfg_free_commit_test(ct);
-            return res;
-        }
+/********************************************************************
+* FUNCTION add_edit_tree
+* 
+* Add the edit points in the candidate edit tree to the commit edits
+*
+* INPUTS:
+*   edits == commit edits in progress
+*   editval == node in the candidate edit tree
+*   curval == matching candidate config node
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_edit_tree (commit_edits_t *edits,
+                   val_value_t *editval,
+                   val_value_t *curval)
+{
+    status_t res = NO_ERR;
+    val_value_t *editchild = val_get_first_child(editval);
+    for (; editchild != NULL && res == NO_ERR;
+         editchild = val_get_next_child(editchild)) {
 
-        ct->obj = obj;
-        ct->btyp = btyp;
-        ct->testflags = testflags;
-        dlq_enque(ct, commit_testQ);
-        if (LOGDEBUG4) {
-            log_debug4("\nAdded commit_test record for %s testflags=0x%08X",
-                       ct->objpcb->exprstr, testflags);
+        boolean editpoint = val_get_dirty_flag(editchild);
+        if (!editpoint && obj_is_leafy(editchild->obj)) {
+            /* list key in the path to an edit point */
+            continue;
         }
-    }
 
-    for (chobj = obj_first_child(obj);
-         chobj != NULL;
-         chobj = obj_next_child(chobj)) {
-        res = add_obj_commit_tests(chobj, commit_testQ, rootflags);
-        if (res != NO_ERR) {
-            return res;
+        val_value_t *curchild = val_first_child_match(curval, editchild);
+        if (editpoint || curchild == NULL) {
+            res = add_edit_obj(edits, editchild->obj);
+            if (res == NO_ERR) {
+                res = add_edit_node(edits, (curchild) ? curchild : curval,
+                                    (curchild != NULL));
+            }
+        } else {
+            res = add_edit_tree(edits, editchild, curchild);
         }
     }
-
     return res;
 
-} /* add_obj_commit_tests */
+}  /* add_edit_tree */
 
 
 /********************************************************************
-* FUNCTION check_prune_obj
+* FUNCTION add_edit_delete
 * 
-* Check if the specified object test can be reduced or eliminated
-* from the current commit test
+* Add a node deleted from the target config to the commit edits
 *
 * INPUTS:
-*    obj == commit test object to check; must not be root!
-*    rootval == config root to check
-*    curflags == current test flags
+*   edits == commit edits in progress
+*   val == deleted node
+*
 * RETURNS:
-*  new testflags or unchanged test flags
+*   status
 *********************************************************************/
-static uint32
-    check_prune_obj (obj_template_t *obj,
-                     val_value_t *rootval,
-                     uint32 curflags)
+static status_t
+    add_edit_delete (commit_edits_t *edits,
+                     val_value_t *val)
 {
-    /* for now just check the top level object to see if
-     * this subtree could have possibly changed;
-     * TBD: come up with fast way to check more, that does
-     * take as much time as just using XPath to get these objects  */
-    boolean done = FALSE;
-    obj_template_t *testobj = obj;
-    while (!done) {
-        if (testobj->parent && !obj_is_root(testobj->parent)) {
-            testobj = testobj->parent;
+    status_t res = add_edit_obj(edits, val->obj);
+    if (res == NO_ERR) {
+        if (val->parent) {
+            res = add_edit_node(edits, val->parent, FALSE);
         } else {
-            done = TRUE;
+            edits->nodesvalid = FALSE;
         }
     }
+    return res;
 
-    /* find this object in the rootval */
-    val_value_t *testval = val_find_child(rootval, obj_get_mod_name(testobj),
-                                          obj_get_name(testobj));
-    if (testval) {
-        switch (testobj->objtype) {
-        case OBJ_TYP_LEAF:
-        case OBJ_TYP_ANYXML:
-        case OBJ_TYP_CONTAINER:
-            if (val_dirty_subtree(testval)) {
-                /* do not skip this node */
-                return curflags;
+}  /* add_edit_delete */
+
+
+/********************************************************************
+* FUNCTION add_edit_undo
+* 
+* Add the nodes changed by the edits in the undo records
+*
+* INPUTS:
+*   edits == commit edits in progress
+*   txcb == transaction control block to use
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_edit_undo (commit_edits_t *edits,
+                   agt_cfg_transaction_t *txcb)
+{
+    status_t res = NO_ERR;
+    agt_cfg_undo_rec_t *undo = (agt_cfg_undo_rec_t *)
+        dlq_firstEntry(&txcb->undoQ);
+    for (; undo != NULL && res == NO_ERR; 
+         undo = (agt_cfg_undo_rec_t *)dlq_nextEntry(undo)) {
+
+        if (undo->newnode) {
+            res = add_edit_obj(edits, undo->newnode->obj);
+        }
+        if (undo->curnode && res == NO_ERR) {
+            res = add_edit_obj(edits, undo->curnode->obj);
+        }
+
+        /* find the changed node in the target config */
+        if (res == NO_ERR) {
+            if (undo->parentnode == NULL) {
+                edits->nodesvalid = FALSE;
+            } else if (undo->editop == OP_EDITOP_DELETE ||
+                       undo->editop == OP_EDITOP_REMOVE) {
+                res = add_edit_node(edits, undo->parentnode, FALSE);
+            } else if (undo->newnode && 
+                       undo->newnode->parent == undo->parentnode) {
+                res = add_edit_node(edits, undo->newnode, TRUE);
+            } else if (undo->curnode && 
+                       undo->curnode->parent == undo->parentnode &&
+                       !VAL_IS_DELETED(undo->curnode)) {
+                res = add_edit_node(edits, undo->curnode, TRUE);
+            } else {
+                edits->nodesvalid = FALSE;
             }
-            break;
-        default:
-            done = FALSE;
-            while (!done) {
-                if (val_dirty_subtree(testval)) {
-                    /* do not skip this node */
-                    return curflags;
-                } else {
-                    testval = 
-                        val_find_next_child(rootval, obj_get_mod_name(testobj),
-                                            obj_get_name(testobj), testval);
-                    if (testval == NULL) {
-                        done = TRUE;
-                    }
-                }
+        }
+
+        agt_cfg_nodeptr_t *nodeptr = (agt_cfg_nodeptr_t *)
+            dlq_firstEntry(&undo->extra_deleteQ);
+        for (; nodeptr != NULL && res == NO_ERR;
+             nodeptr = (agt_cfg_nodeptr_t *)dlq_nextEntry(nodeptr)) {
+            if (nodeptr->node) {
+                res = add_edit_delete(edits, nodeptr->node);
+            }
+        }
+    }
+    return res;
+
+}  /* add_edit_undo */
+
+
+/********************************************************************
+* FUNCTION compare_edit_names
+* 
+* qsort and bsearch compare function for the edit name arrays
+*********************************************************************/
+static int
+    compare_edit_names (const void *name1,
+                        const void *name2)
+{
+    return xml_strcmp(*(const xmlChar * const *)name1,
+                      *(const xmlChar * const *)name2);
+
+}  /* compare_edit_names */
+
+
+/********************************************************************
+* FUNCTION find_edit_name
+* 
+* Check if a name is in one of the sorted edit name arrays
+*
+* INPUTS:
+*   names == sorted name array
+*   numnames == number of names
+*   name == name to find
+*
+* RETURNS:
+*   TRUE if found
+*********************************************************************/
+static boolean
+    find_edit_name (const xmlChar **names,
+                    uint32 numnames,
+                    const xmlChar *name)
+{
+    if (numnames == 0) {
+        return FALSE;
+    }
+    return (bsearch(&name, names, numnames, sizeof(xmlChar *),
+                    compare_edit_names) != NULL) ? TRUE : FALSE;
+
+}  /* find_edit_name */
+
+
+/********************************************************************
+* FUNCTION get_commit_edits
+* 
+* Get the changes that a root check has to validate
+* The running config is valid when agt_config_state is OK, so
+* only the commit tests that can see a change need to be run.
+*
+*   <commit>: the candidate edit tree holds every change
+*     from the running config
+*   <validate> on the candidate: same as <commit>
+*   <edit-config> on the candidate: the edit tree plus the
+*     current edits in the txcb->undoQ
+*   <edit-config> on the running config: the current edits
+*
+* Nodes deleted for false when-stmts are always added.
+* For all other operations the edits are not known.
+*
+* INPUTS:
+*   txcb == transaction control block to use
+*   root == config root being validated
+*   edits == commit edits struct to fill in
+*
+* OUTPUTS:
+*   edits->known == TRUE if the edits cover every change
+*   edits->nodesvalid == TRUE if the changed nodes are also known
+*
+* RETURNS:
+*   status; edits->known is FALSE if any error
+*********************************************************************/
+static status_t
+    get_commit_edits (agt_cfg_transaction_t *txcb,
+                      val_value_t *root,
+                      commit_edits_t *edits)
+{
+    memset(edits, 0x0, sizeof(commit_edits_t));
+
+    agt_profile_t *profile = agt_get_profile();
+    if (profile->agt_config_state != AGT_CFG_STATE_OK) {
+        return NO_ERR;
+    }
+
+    boolean usetree = FALSE, useundo = FALSE;
+    if (txcb->cfg_id == NCX_CFGID_RUNNING) {
+        if (txcb->commitcheck) {
+            usetree = TRUE;
+        } else if (txcb->edit_type == AGT_CFG_EDIT_TYPE_PARTIAL) {
+            useundo = TRUE;
+        }
+    } else if (txcb->cfg_id == NCX_CFGID_CANDIDATE) {
+        if (txcb->edit_type == AGT_CFG_EDIT_TYPE_PARTIAL) {
+            usetree = TRUE;
+            useundo = TRUE;
+        } else if (txcb->edit_type == AGT_CFG_EDIT_TYPE_FULL &&
+                   dlq_empty(&txcb->undoQ)) {
+            usetree = TRUE;
+        }
+    }
+    if (!usetree && !useundo) {
+        return NO_ERR;
+    }
+
+    status_t res = NO_ERR;
+    if (usetree) {
+        cfg_template_t *candidate = cfg_get_config_id(NCX_CFGID_CANDIDATE);
+        cfg_template_t *running = cfg_get_config_id(NCX_CFGID_RUNNING);
+        if (candidate == NULL || running == NULL || 
+            candidate->root != root || cfg_get_full_compare(candidate) ||
+            candidate->src_txid != running->last_txid) {
+            /* candidate edit tree does not cover all the changes */
+            return NO_ERR;
+        }
+        if (candidate->editroot) {
+            res = add_edit_tree(edits, candidate->editroot, root);
+        }
+    }
+    edits->nodesvalid = TRUE;
+
+    if (useundo && res == NO_ERR) {
+        res = add_edit_undo(edits, txcb);
+    }
+
+    agt_cfg_nodeptr_t *nodeptr = (agt_cfg_nodeptr_t *)
+        dlq_firstEntry(&txcb->deadnodeQ);
+    for (; nodeptr != NULL && res == NO_ERR;
+         nodeptr = (agt_cfg_nodeptr_t *)dlq_nextEntry(nodeptr)) {
+        if (nodeptr->node) {
+            res = add_edit_delete(edits, nodeptr->node);
+        }
+    }
+
+    uint32 i;
+    for (i = 0; i < edits->numobjs && res == NO_ERR; i++) {
+        obj_template_t *obj = edits->objs[i];
+        if (obj_is_root(obj)) {
+            /* the whole config was replaced */
+            clean_commit_edits(edits);
+            return NO_ERR;
+        }
+        res = add_edit_subnames(edits, obj);
+
+        obj_template_t *testobj = obj->parent;
+        for (; testobj != NULL && !obj_is_root(testobj) && res == NO_ERR;
+             testobj = testobj->parent) {
+            res = add_edit_name(&edits->ancnames, &edits->numancnames,
+                                &edits->maxancnames, obj_get_name(testobj));
+        }
+    }
+
+    if (res != NO_ERR) {
+        clean_commit_edits(edits);
+        return res;
+    }
+
+    if (edits->numsubnames) {
+        qsort(edits->subnames, edits->numsubnames, sizeof(xmlChar *),
+              compare_edit_names);
+    }
+    if (edits->numancnames) {
+        qsort(edits->ancnames, edits->numancnames, sizeof(xmlChar *),
+              compare_edit_names);
+    }
+    edits->known = TRUE;
+
+    if (LOGDEBUG3) {
+        log_debug3("\nCommit tests selected from %u changed objects"
+                   " (%u changed nodes%s)", edits->numobjs, edits->numnodes,
+                   (edits->nodesvalid) ? "" : ", incomplete");
+    }
+    return NO_ERR;
+
+}  /* get_commit_edits */
+
+
+/********************************************************************
+* FUNCTION check_commit_test_edits
+* 
+* Check which tests in a commit test record can see the changes
+*
+* A test can see a change if the commit test object and a changed
+* object are in the same subtree, or if one of the XPath
+* expressions of the test references the name of a changed node
+* or a changed descendant of a node whose value it uses.
+*
+* INPUTS:
+*   edits == commit edits to check
+*   ct == commit test record to check
+*   curflags == current test flags
+*   allinst == address of return all instances flag
+*
+* OUTPUTS:
+*   *allinst == FALSE if the tests only need to be run on the
+*               instances that are in a changed subtree, or
+*               that are ancestors of a changed node
+*
+* RETURNS:
+*   new (or unchanged) test flags
+*********************************************************************/
+static uint32
+    check_commit_test_edits (const commit_edits_t *edits,
+                             agt_cfg_commit_test_t *ct,
+                             uint32 curflags,
+                             boolean *allinst)
+{
+    *allinst = TRUE;
+
+    uint32 depflags = curflags & (AGT_TEST_FL_MUST | 
+                                  AGT_TEST_FL_XPATH_TYPE |
+                                  AGT_TEST_FL_WHEN);
+    uint32 hitflags = ct->depallflags & depflags;
+
+    agt_cfg_commit_dep_t *dep = (agt_cfg_commit_dep_t *)
+        dlq_firstEntry(&ct->depQ);
+    for (; dep != NULL && hitflags != depflags;
+         dep = (agt_cfg_commit_dep_t *)dlq_nextEntry(dep)) {
+
+        uint32 testflags = dep->testflags & depflags & ~hitflags;
+        if (testflags == 0) {
+            continue;
+        }
+        if (find_edit_name(edits->subnames, edits->numsubnames, dep->name) ||
+            (dep->isvalue && 
+             find_edit_name(edits->ancnames, edits->numancnames, 
+                            dep->name))) {
+            hitflags |= testflags;
+        }
+    }
+
+    /* check if the changed object is the test object, or an
+     * ancestor or a descendant of the test object */
+    boolean samesubtree = FALSE;
+    uint32 i;
+    for (i = 0; i < edits->numobjs && !samesubtree; i++) {
+        obj_template_t *testobj = ct->obj;
+        for (; testobj != NULL && !obj_is_root(testobj) && !samesubtree;
+             testobj = testobj->parent) {
+            if (testobj == edits->objs[i]) {
+                samesubtree = TRUE;
+            }
+        }
+
+        testobj = edits->objs[i]->parent;
+        for (; testobj != NULL && !obj_is_root(testobj) && !samesubtree;
+             testobj = testobj->parent) {
+            if (testobj == ct->obj) {
+                samesubtree = TRUE;
+            }
+        }
+    }
+
+    if (hitflags) {
+        return (samesubtree) ? curflags : hitflags;
+    }
+    if (samesubtree) {
+        *allinst = FALSE;
+        return curflags;
+    }
+    return 0;
+
+}  /* check_commit_test_edits */
+
+
+/********************************************************************
+ * 
+ * Delete all the nodes that have false when-stmt exprs
+ * Also delete empty NP-containers
+ *
+ * \param scb session control block (may be NULL)
+ * \param msghdr XML message header in progress
+ * \param txcb transaction control block to use
+ * \param root root from the target database to use
+ * \param retcount address of return deletecount
+ * \return status
+ *********************************************************************/
+static status_t delete_dead_nodes ( ses_cb_t  *scb,
+                                    xml_msg_hdr_t *msghdr,
+                                    agt_cfg_transaction_t *txcb,
+                                    val_value_t *root,
+                                    uint32 *retcount )
+{
+    *retcount = 0;
+
+    /* only the when-stmts that can see a change can become false */
+    commit_edits_t edits;
+    status_t res = get_commit_edits(txcb, root, &edits);
+
+    agt_profile_t *profile = agt_get_profile();
+    agt_cfg_commit_test_t *ct = (agt_cfg_commit_test_t *)
+        dlq_firstEntry(&profile->agt_commit_testQ);
+
+    for (; ct != NULL && res == NO_ERR; 
+         ct = (agt_cfg_commit_test_t *)dlq_nextEntry(ct)) {
+        uint32  tests = ct->testflags & AGT_TEST_FL_WHEN;
+        if (tests && edits.known) {
+            boolean allinst = TRUE;
+            tests = check_commit_test_edits(&edits, ct, tests, &allinst);
+        }
+        if (tests == 0) {
+            /* no when-stmt tests needed for this node */
+            continue;
+        }
+
+        res = prep_commit_test_node(scb, msghdr, txcb, ct, root);
+        if (res != NO_ERR) {
+            continue;
+        }
+
+        /* run all relevant tests on each node in the result set */
+        xpath_resnode_t *resnode = xpath_get_first_resnode(ct->result);
+        xpath_resnode_t *nextnode = NULL;
+        for (; resnode != NULL && res == NO_ERR; resnode = nextnode) {
+            nextnode = xpath_get_next_resnode(resnode);
+
+            val_value_t *valnode = xpath_get_resnode_valptr(resnode);
+            res = run_when_stmt_check(scb, msghdr, txcb, root, valnode);
+            if (res != NO_ERR) {
+                /* treat any when delete error as terminate transaction */
+                continue;
+            } else if (VAL_IS_DELETED(valnode)) {
+                /* this node has just been flagged when=FALSE so
+                 * remove this resnode from the result so it will
+                 * not be reused by a commit test   */
+                xpath_delete_resnode(resnode);
+                (*retcount)++;
+            }
+        }
+    }
+
+    clean_commit_edits(&edits);
+    return res;
+
+}  /* delete_dead_nodes */
+
+
+/********************************************************************
+* FUNCTION check_parent_tests
+* 
+* Check if the specified object has any commit tests
+* to record in the parent node
+*
+* INPUTS:
+*  obj == object to check
+*  flags == address of return testflags
+*
+* OUTPUTS:
+*   *flags is set if any tests are needed
+*
+*********************************************************************/
+static void
+    check_parent_tests (obj_template_t *obj,
+                        uint32 *flags)
+{
+    uint32 numelems = 0;
+    switch (obj->objtype) {
+    case OBJ_TYP_LEAF_LIST:
+    case OBJ_TYP_LIST:
+        if (obj_get_min_elements(obj, &numelems)) {
+            if (numelems > 1) {
+                *flags |= AGT_TEST_FL_MIN_ELEMS;
+            } // else AGT_TEST_FL_MANDATORY will check for 1 instance
+        }
+        numelems = 0;
+        if (obj_get_max_elements(obj, &numelems)) {
+            *flags |= AGT_TEST_FL_MAX_ELEMS;
+        }
+        break;
+    case OBJ_TYP_LEAF:
+    case OBJ_TYP_CONTAINER:
+        *flags |= AGT_TEST_FL_MAX_ELEMS;
+        break;       
+    case OBJ_TYP_CHOICE:
+        *flags |= AGT_TEST_FL_CHOICE;
+        break;
+    default:
+        ;
+    }
+    if (obj_is_mandatory(obj) && !obj_is_key(obj)) {
+        *flags |= AGT_TEST_FL_MANDATORY;
+    }
+
+}  /* check_parent_tests */
+
+
+/********************************************************************
+* FUNCTION add_commit_dep
+* 
+* Add a schema node name referenced by a commit test
+*
+* INPUTS:
+*   ct == commit test record to use
+*   name == referenced node name
+*   testflag == AGT_TEST_FL_FOO bit for the test using the name
+*   isvalue == TRUE if the node value is used, not just
+*              the node-set selected by the name
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_commit_dep (agt_cfg_commit_test_t *ct,
+                    const xmlChar *name,
+                    uint32 testflag,
+                    boolean isvalue)
+{
+    agt_cfg_commit_dep_t *dep = (agt_cfg_commit_dep_t *)
+        dlq_firstEntry(&ct->depQ);
+    for (; dep != NULL; dep = (agt_cfg_commit_dep_t *)dlq_nextEntry(dep)) {
+        if (!xml_strcmp(dep->name, name)) {
+            dep->testflags |= testflag;
+            if (isvalue) {
+                dep->isvalue = TRUE;
+            }
+            return NO_ERR;
+        }
+    }
+
+    dep = agt_cfg_new_commit_dep(name);
+    if (dep == NULL) {
+        return ERR_INTERNAL_MEM;
+    }
+    dep->testflags = testflag;
+    dep->isvalue = isvalue;
+    dlq_enque(dep, &ct->depQ);
+    return NO_ERR;
+
+}  /* add_commit_dep */
+
+
+/********************************************************************
+* FUNCTION is_path_token
+* 
+* Check if an XPath token continues a location path
+*
+* INPUTS:
+*   tk == token after a step, after its predicates (may be NULL)
+*
+* RETURNS:
+*   TRUE if '/' or '//'
+*********************************************************************/
+static boolean
+    is_path_token (const tk_token_t *tk)
+{
+    return (tk && (tk->typ == TK_TT_FSLASH || tk->typ == TK_TT_DBLFSLASH))
+        ? TRUE : FALSE;
+
+}  /* is_path_token */
+
+
+/********************************************************************
+* FUNCTION skip_xpath_predicates
+* 
+* Skip over any predicates that follow a step in an XPath expression
+*
+* INPUTS:
+*   tk == token after the step (may be NULL)
+*
+* RETURNS:
+*   first token after the predicates (may be NULL)
+*********************************************************************/
+static tk_token_t *
+    skip_xpath_predicates (tk_token_t *tk)
+{
+    while (tk && tk->typ == TK_TT_LBRACK) {
+        uint32 depth = 1;
+        tk = (tk_token_t *)dlq_nextEntry(tk);
+        for (; tk && depth; tk = (tk_token_t *)dlq_nextEntry(tk)) {
+            if (tk->typ == TK_TT_LBRACK) {
+                depth++;
+            } else if (tk->typ == TK_TT_RBRACK) {
+                depth--;
+            }
+        }
+    }
+    return tk;
+
+}  /* skip_xpath_predicates */
+
+
+/********************************************************************
+* FUNCTION check_xpath_fn_dep
+* 
+* Check if an XPath function call or node type test only
+* depends on the nodes named in its arguments
+*
+* INPUTS:
+*   tk == function name token (followed by '(')
+*   iswhen == TRUE if this is a when-stmt expression
+*
+* RETURNS:
+*   TRUE if the named nodes cover the call
+*   FALSE if it can depend on any node
+*********************************************************************/
+static boolean
+    check_xpath_fn_dep (tk_token_t *tk,
+                        boolean iswhen)
+{
+    const xmlChar *fname = tk->val;
+    if (!xml_strcmp(fname, (const xmlChar *)"node") ||
+        !xml_strcmp(fname, (const xmlChar *)"text") ||
+        !xml_strcmp(fname, (const xmlChar *)"comment") ||
+        !xml_strcmp(fname, (const xmlChar *)"processing-instruction") ||
+        !xml_strcmp(fname, (const xmlChar *)"deref")) {
+        return FALSE;
+    }
+
+    tk_token_t *closetk = (tk_token_t *)dlq_nextEntry(tk);
+    if (closetk) {
+        closetk = (tk_token_t *)dlq_nextEntry(closetk);
+    }
+    if (!iswhen || closetk == NULL || closetk->typ != TK_TT_RPAREN) {
+        return TRUE;
+    }
+
+    /* a when-stmt can use the value of its context node, which
+     * is not in the commit test subtree; only allow the
+     * functions that do not use the context node value   */
+    if (!xml_strcmp(fname, (const xmlChar *)"current")) {
+        return is_path_token(skip_xpath_predicates((tk_token_t *)
+                                                   dlq_nextEntry(closetk)));
+    }
+    if (!xml_strcmp(fname, (const xmlChar *)"true") ||
+        !xml_strcmp(fname, (const xmlChar *)"false") ||
+        !xml_strcmp(fname, (const xmlChar *)"last") ||
+        !xml_strcmp(fname, (const xmlChar *)"position") ||
+        !xml_strcmp(fname, (const xmlChar *)"name") ||
+        !xml_strcmp(fname, (const xmlChar *)"local-name") ||
+        !xml_strcmp(fname, (const xmlChar *)"namespace-uri")) {
+        return TRUE;
+    }
+    return FALSE;
+
+}  /* check_xpath_fn_dep */
+
+
+/********************************************************************
+* FUNCTION add_xpath_deps
+* 
+* Add the schema node names referenced by an XPath expression
+* to the commit test dependencies
+*
+* Each name test in a location path is a dependency.
+* The last step of a path uses the node value; an inner step
+* only uses the node-set, so changes in descendant nodes
+* only matter for the last step.
+* Wildcards, variables, node type tests, deref() and the
+* value of the parent or (for when-stmts) context node can
+* reference any node, so the test is not pruned by name.
+*
+* INPUTS:
+*   ct == commit test record to use
+*   pcb == XPath control block for the expression (may be NULL)
+*   testflag == AGT_TEST_FL_FOO bit for the test using the expression
+*
+* OUTPUTS:
+*   ct->depQ and ct->depallflags may be updated
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_xpath_deps (agt_cfg_commit_test_t *ct,
+                    xpath_pcb_t *pcb,
+                    uint32 testflag)
+{
+    if (pcb == NULL || pcb->tkc == NULL) {
+        ct->depallflags |= testflag;
+        return NO_ERR;
+    }
+
+    boolean iswhen = (testflag == AGT_TEST_FL_WHEN);
+    status_t res = NO_ERR;
+    tk_token_t *tk = (tk_token_t *)dlq_firstEntry(&pcb->tkc->tkQ);
+    for (; tk != NULL && res == NO_ERR && !(ct->depallflags & testflag);
+         tk = (tk_token_t *)dlq_nextEntry(tk)) {
+
+        tk_token_t *nexttk = (tk_token_t *)dlq_nextEntry(tk);
+        switch (tk->typ) {
+        case TK_TT_STAR:
+        case TK_TT_NCNAME_STAR:
+        case TK_TT_VARBIND:
+        case TK_TT_QVARBIND:
+            ct->depallflags |= testflag;
+            break;
+        case TK_TT_RANGESEP:
+            if (!is_path_token(nexttk)) {
+                ct->depallflags |= testflag;
+            }
+            break;
+        case TK_TT_PERIOD:
+            if (iswhen && !is_path_token(nexttk)) {
+                ct->depallflags |= testflag;
+            }
+            break;
+        case TK_TT_TSTRING:
+        case TK_TT_MSTRING:
+            if (nexttk && nexttk->typ == TK_TT_DBLCOLON) {
+                /* axis name */
+                break;
+            }
+            if (nexttk && nexttk->typ == TK_TT_LPAREN) {
+                if (!check_xpath_fn_dep(tk, iswhen)) {
+                    ct->depallflags |= testflag;
+                }
+                break;
+            }
+            res = add_commit_dep(ct, tk->val, testflag,
+                                 !is_path_token(skip_xpath_predicates(nexttk)));
+            break;
+        default:
+            ;
+        }
+    }
+    return res;
+
+}  /* add_xpath_deps */
+
+
+/********************************************************************
+* FUNCTION add_commit_test_deps
+* 
+* Precompute the schema node names referenced by the must-stmt,
+* when-stmt and leafref tests of a commit test, so a root check
+* can skip the tests that cannot see any change
+*
+* INPUTS:
+*   ct == commit test record to use; obj and testflags are set
+*
+* OUTPUTS:
+*   ct->depQ and ct->depallflags are filled in
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_commit_test_deps (agt_cfg_commit_test_t *ct)
+{
+    status_t res = NO_ERR;
+
+    if (ct->testflags & AGT_TEST_FL_MUST) {
+        xpath_pcb_t *must = (xpath_pcb_t *)
+            dlq_firstEntry(obj_get_mustQ(ct->obj));
+        for (; must != NULL && res == NO_ERR; 
+             must = (xpath_pcb_t *)dlq_nextEntry(must)) {
+            res = add_xpath_deps(ct, must, AGT_TEST_FL_MUST);
+        }
+    }
+
+    if ((ct->testflags & AGT_TEST_FL_XPATH_TYPE) && res == NO_ERR) {
+        if (ct->btyp == NCX_BT_LEAFREF) {
+            res = add_xpath_deps(ct, 
+                                 typ_get_leafref_pcb(obj_get_typdef(ct->obj)),
+                                 AGT_TEST_FL_XPATH_TYPE);
+        } else {
+            /* instance-identifier can point at any node */
+            ct->depallflags |= AGT_TEST_FL_XPATH_TYPE;
+        }
+    }
+
+    /* same when-stmts as val_check_obj_when */
+    obj_template_t *testobj = ct->obj;
+    boolean done = !(ct->testflags & AGT_TEST_FL_WHEN);
+    while (!done && res == NO_ERR) {
+        if (testobj->when) {
+            res = add_xpath_deps(ct, testobj->when, AGT_TEST_FL_WHEN);
+        }
+
+        obj_xpath_ptr_t *xptr = obj_first_xpath_ptr(testobj);
+        for (; xptr != NULL && res == NO_ERR; 
+             xptr = obj_next_xpath_ptr(xptr)) {
+            res = add_xpath_deps(ct, xptr->xpath, AGT_TEST_FL_WHEN);
+        }
+
+        testobj = testobj->parent;
+        if (testobj == NULL || 
+            !(testobj->objtype == OBJ_TYP_CHOICE ||
+              testobj->objtype == OBJ_TYP_CASE)) {
+            done = TRUE;
+        }
+    }
+
+    return res;
+
+}  /* add_commit_test_deps */
+
+
+/********************************************************************
+* FUNCTION add_obj_commit_tests
+* 
+* Check if the specified object and all its descendants 
+* have any commit tests to record in the commit_testQ
+* Tests are added in top-down order
+* TBD: cascade XPath lookup results to nested commmit tests
+*
+* Tests done in the parent node:
+*   AGT_TEST_FL_MIN_ELEMS
+*   AGT_TEST_FL_MAX_ELEMS
+*   AGT_TEST_FL_MANDATORY
+*
+* Tests done in the object node:
+*   AGT_TEST_FL_MUST
+*   AGT_TEST_FL_UNIQUE
+*   AGT_TEST_FL_XPATH_TYPE
+*   AGT_TEST_FL_WHEN  (part of delete_dead_nodes, not this fn)
+*
+* INPUTS:
+*  obj == object to check
+*  commit_testQ == address of queue to use to fill with
+*                  agt_cfg_commit_test_t structs
+*  rootflags == address of return root node testflags
+*
+* OUTPUTS:
+*  commit_testQ will contain an agt_cfg_commit_test_t struct
+*  for each descendant-or-self object found with 
+*  commit-time validation tests
+*  *rootflags will be altered if node is top-level and
+*   needs instance testing
+* RETURNS:
+*  status of the operation, NO_ERR unless internal errors found
+*  or malloc error
+*********************************************************************/
+static status_t
+    add_obj_commit_tests (obj_template_t *obj,
+			  dlq_hdr_t *commit_testQ,
+                          uint32 *rootflags)
+{
+    if (skip_obj_commit_test(obj)) {
+        return NO_ERR;
+    }
+
+    status_t res = NO_ERR;
+
+    /* check for tests in active config nodes, bottom-up traversal */
+    uint32 testflags = 0;
+    dlq_hdr_t *mustQ = obj_get_mustQ(obj);
+    ncx_btype_t btyp = obj_get_basetype(obj);
+    obj_template_t *chobj;
+
+    if (!(obj->objtype == OBJ_TYP_CHOICE || obj->objtype == OBJ_TYP_CASE)) {
+        if (mustQ && !dlq_empty(mustQ)) {
+            testflags |= AGT_TEST_FL_MUST;
+        }
+    
+        if (obj_has_when_stmts(obj)) {
+            testflags |= AGT_TEST_FL_WHEN;
+        }
+    }
+
+    obj_unique_t *unidef = obj_first_unique(obj);
+    boolean done = FALSE;
+    for (; unidef && !done; unidef = obj_next_unique(unidef)) {
+        if (unidef->isconfig) {
+            testflags |= AGT_TEST_FL_UNIQUE;
+            done = TRUE;
+        }
+    }
+
+    if (obj_is_top(obj)) {
+        /* need to check if this is a top-level node that
+         * has instance requirements (mandatory/min/max)
+         */
+        check_parent_tests(obj, rootflags);
+    }
+
+    if (obj->objtype == OBJ_TYP_CHOICE || obj->objtype == OBJ_TYP_CASE) {
+        /* do not create a commit test record for a choice or case
+         * since they will never be in the data tree, so XPath
+         * will never find them */
+        testflags = 0;
+    } else {
+        /* set the instance or MANDATORY test bits in the parent,
+         * not in the child nodes for each commit test
+         * check all child nodes to determine if parent needs
+         * to run instance_check
+         */
+        for (chobj = obj_first_child(obj); 
+             chobj != NULL; 
+             chobj = obj_next_child(chobj)) {
+
+            if (skip_obj_commit_test(chobj)) {
+                continue;
+            }
+            check_parent_tests(chobj, &testflags);
+        }
+    
+        typ_def_t *typdef = obj_get_typdef(obj);
+        if (btyp == NCX_BT_LEAFREF || 
+            (btyp == NCX_BT_INSTANCE_ID && typ_get_constrained(typdef))) {
+            /* need to check XPath-based leaf to see that the referenced
+             * instance exists in the target data tree
+             */
+            testflags |= AGT_TEST_FL_XPATH_TYPE;
+        }
+    }
+
+    if (testflags) {
+        /* need a commit test record for this object */
+        agt_cfg_commit_test_t *ct = agt_cfg_new_commit_test();
+        if (ct == NULL) {
+            return ERR_INTERNAL_MEM;
+        } 
+
+        ct->objpcb = xpath_new_pcb(NULL, NULL);
+        if (ct->objpcb == NULL) {
+            agt_cfg_free_commit_test(ct);
+            return ERR_INTERNAL_MEM;
+        }
+
+        res = obj_gen_object_id_xpath(obj, &ct->objpcb->exprstr);
+        if (res != NO_ERR) {
+            agt_cfg_free_commit_test(ct);
+            return res;
+        }
+
+        ct->obj = obj;
+        ct->btyp = btyp;
+        ct->testflags = testflags;
+        res = add_commit_test_deps(ct);
+        if (res != NO_ERR) {
+            agt_cfg_free_commit_test(ct);
+            return res;
+        }
+
+        dlq_enque(ct, commit_testQ);
+        if (LOGDEBUG4) {
+            log_debug4("\nAdded commit_test record for %s testflags=0x%08X"
+                       " depall=0x%08X", ct->objpcb->exprstr, testflags,
+                       ct->depallflags);
+            agt_cfg_commit_dep_t *dep = (agt_cfg_commit_dep_t *)
+                dlq_firstEntry(&ct->depQ);
+            for (; dep; dep = (agt_cfg_commit_dep_t *)dlq_nextEntry(dep)) {
+                log_debug4("\n   depends on %s%s", dep->name,
+                           (dep->isvalue) ? " (value)" : "");
+            }
+        }
+    }
+
+    for (chobj = obj_first_child(obj);
+         chobj != NULL;
+         chobj = obj_next_child(chobj)) {
+        res = add_obj_commit_tests(chobj, commit_testQ, rootflags);
+        if (res != NO_ERR) {
+            return res;
+        }
+    }
+
+    return res;
+
+} /* add_obj_commit_tests */
+
+
+/********************************************************************
+* FUNCTION check_prune_obj
+* 
+* Check if the specified object test can be reduced or eliminated
+* from the current commit test
+*
+* INPUTS:
+*    obj == commit test object to check; must not be root!
+*    rootval == config root to check
+*    curflags == current test flags
+* RETURNS:
+*  new testflags or unchanged test flags
+*********************************************************************/
+static uint32
+    check_prune_obj (obj_template_t *obj,
+                     val_value_t *rootval,
+                     uint32 curflags)
+{
+    /* for now just check the top level object to see if
+     * this subtree could have possibly changed;
+     * TBD: come up with fast way to check more, that does
+     * take as much time as just using XPath to get these objects  */
+    boolean done = FALSE;
+    obj_template_t *testobj = obj;
+    while (!done) {
+        if (testobj->parent && !obj_is_root(testobj->parent)) {
+            testobj = testobj->parent;
+        } else {
+            done = TRUE;
+        }
+    }
+
+    /* find this object in the rootval */
+    val_value_t *testval = val_find_child(rootval, obj_get_mod_name(testobj),
+                                          obj_get_name(testobj));
+    if (testval) {
+        switch (testobj->objtype) {
+        case OBJ_TYP_LEAF:
+        case OBJ_TYP_ANYXML:
+        case OBJ_TYP_CONTAINER:
+            if (val_dirty_subtree(testval)) {
+                /* do not skip this node */
+                return curflags;
+            }
+            break;
+        default:
+            done = FALSE;
+            while (!done) {
+                if (val_dirty_subtree(testval)) {
+                    /* do not skip this node */
+                    return curflags;
+                } else {
+                    testval = 
+                        val_find_next_child(rootval, obj_get_mod_name(testobj),
+                                            obj_get_name(testobj), testval);
+                    if (testval == NULL) {
+                        done = TRUE;
+                    }
+                }
+            }
+        }
+    }
+
+    /* skip this node for all tests, since no instances of
+     * the top-level object exist which might have been changed
+     * Relying on the fact that the root-check is always done for
+     * the root node (on the top-level YANG data nodes, so
+     * any instance or mandatory tests on the top-node will
+     * always be done     */
+    //return 0;
+
+    /* xpath tests can depend on any top level container */
+    return (curflags & AGT_TEST_FL_XPATH_TYPE);
+
+} /* check_prune_obj */
+
+
+/********************************************************************
+* FUNCTION check_no_prune_curedit
+* 
+* Check if the specified object test is needed from the current 
+* commit test, based on the current edit in the undo record
+*
+* INPUTS:
+*   undo == edit operation to check
+*   obj == commit test object to check; must not be root!
+* RETURNS:
+*  TRUE if found and test needed; FALSE if not found
+*********************************************************************/
+static boolean
+    check_no_prune_curedit (agt_cfg_undo_rec_t *undo,
+                            obj_template_t *obj)
+{
+    obj_template_t *editobj = (undo->newnode) ? undo->newnode->obj :
+        ((undo->curnode) ? undo->curnode->obj : NULL);
+    if (editobj == NULL) {
+        return FALSE;
+    }
+
+    /* see if the commit test object is a descendant of
+     * the edit object, but only if not deleting the edit
+     * object; do not trigger descendant test on a delete  */
+    boolean done = (undo->editop == OP_EDITOP_DELETE);
+    obj_template_t *testobj = obj;
+    while (!done) {
+        if (editobj == testobj) {
+            return TRUE;   // do not prune this object test
+        }
+
+        if (testobj->parent && !obj_is_root(testobj->parent)) {
+            testobj = testobj->parent;
+        } else {
+            done = TRUE;
+        }
+    }
+
+    /* see if the edit object is a descendant of the commit test object */
+    done = FALSE;
+    while (!done) {
+        if (editobj == obj) {
+            return TRUE;   // do not prune this object test
+        }
+
+        if (editobj->parent && !obj_is_root(editobj->parent)) {
+            editobj = editobj->parent;
+        } else {
+            done = TRUE;
+        }
+    }
+
+    return FALSE;
+
+} /* check_no_prune_curedit */
+
+
+/********************************************************************
+* FUNCTION prune_obj_commit_tests
+* 
+* Check if the specified object test can be reduced or elimated
+* from the current commit test
+*
+* INPUTS:
+*
+* OUTPUTS:
+*  *testflags will be altered
+* RETURNS:
+*  new (or unchanged) test flags
+*********************************************************************/
+static uint32
+    prune_obj_commit_tests (agt_cfg_transaction_t *txcb,
+                            agt_cfg_commit_test_t *ct,
+                            val_value_t *rootval,
+                            uint32 curflags)
+{
+    if (curflags & AGT_TEST_FL_MUST) {
+        /* do not prune a must-stmt test since the XPath expression
+         * may reference any arbitrary data node    */
+        return curflags;
+    }
+
+    agt_cfg_undo_rec_t *undo = NULL;
+    if (txcb->cfg_id == NCX_CFGID_RUNNING) {
+        if (txcb->commitcheck) {
+            /* called from <commit> 
+             * look for dirty or subtree dirty flags in the rootval
+             * this rootval is reallt candidate->root, so it is
+             * OK to check the dirty flags    */
+            curflags = check_prune_obj(ct->obj, rootval, curflags);
+        } else {
+            if (txcb->edit_type == AGT_CFG_EDIT_TYPE_FULL) {
+                /* called from <validate> on external <config> element;
+                 * <copy-config> is not supported on the running config
+                 * so there is nothing to do for now; do not prune;
+                 * force a full test for <validate>   */
+            } else if (txcb->edit_type == AGT_CFG_EDIT_TYPE_PARTIAL) {
+                /* called from <edit-config> on running config;
+                 * check the edit list; only nodes that have been
+                 * edited need to run a commit test   */
+                undo = (agt_cfg_undo_rec_t *)dlq_firstEntry(&txcb->undoQ);
+                while (undo) {
+                    if (check_no_prune_curedit(undo, ct->obj)) {
+                        return curflags;
+                    }
+                    undo = (agt_cfg_undo_rec_t *)dlq_nextEntry(undo);
+                }
+                curflags = 0;
+            } // else unknown edit-type! do not prune
+        }
+    } else if (txcb->cfg_id == NCX_CFGID_CANDIDATE) {
+        if (txcb->edit_type == AGT_CFG_EDIT_TYPE_FULL) {
+            /* called from <validate> operation on the <candidate> config */
+            curflags = check_prune_obj(ct->obj, rootval, curflags);
+        } else if (txcb->edit_type == AGT_CFG_EDIT_TYPE_PARTIAL) {
+            /* called from <edit-config> with test-option=set-then-test
+             * first check all the current edits; because the dirty flags
+             * for any edits from this <rpc> have not been set yet */
+            undo = (agt_cfg_undo_rec_t *)dlq_firstEntry(&txcb->undoQ);
+            while (undo) {
+                if (check_no_prune_curedit(undo, ct->obj)) {
+                    return curflags;
+                }
+                undo = (agt_cfg_undo_rec_t *)dlq_nextEntry(undo);
+            }
+
+            /* did not find the object in the current edits so check
+             * pending edits (dirty flags) on the candidate->root target */
+            curflags = check_prune_obj(ct->obj, rootval, curflags);
+        } // else unknown edit-type! do not prune!
+    } // else unknown config target! do not prune!
+
+    return curflags;
+
+} /* prune_obj_commit_tests */
+
+
+/********************************************************************
+* FUNCTION run_instance_check
+* 
+* Check for the proper number of object instances for
+* the specified value struct.
+* 
+* The top-level value set passed cannot represent a choice
+* or a case within a choice.
+*
+* This function is intended for validating PDUs (RPC requests)
+* during the PDU processing.  It does not check the instance
+* count or must-stmt expressions for any <config> (ncx:root)
+* container.  This must be done with the agt_val_root_check function.
+*
+* INPUTS:
+*   scb == session control block (may be NULL; no session stats)
+*   msg == xml_msg_hdr t from msg in progress 
+*       == NULL MEANS NO RPC-ERRORS ARE RECORDED
+*   valset == val_value_t list, leaf-list, or container to check
+*   valroot == root node of the database
+*   layer == NCX layer calling this function (for error purposes only)
+*   all_levels == TRUE to recurse for all levels
+*              == FALSE to just check the curent level
+* OUTPUTS:
+*   if msg not NULL:
+*      msg->msg_errQ may have rpc_err_rec_t structs added to it 
+*      which must be freed by the called with the 
+*      rpc_err_free_record function
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t 
+    run_instance_check (ses_cb_t *scb,
+                        xml_msg_hdr_t *msg,
+                        val_value_t *valset,
+                        val_value_t *valroot,
+                        ncx_layer_t layer,
+                        boolean all_levels)
+{
+    assert( valset && "valset is NULL!" );
+
+    if (LOGDEBUG4) {
+        log_debug4("\nrun_instance_check: %s:%s start", 
+                   obj_get_mod_name(valset->obj),
+                   valset->name);
+    }
+
+    status_t res = NO_ERR, retres = NO_ERR;
+    obj_template_t *obj = valset->obj;
+
+    if (skip_obj_commit_test(obj)) {
+        return NO_ERR;
+    }
+
+    if (all_levels && val_child_cnt(valset)) {
+        val_value_t *chval = val_get_first_child(valset);
+        for (; chval != NULL; chval = val_get_next_child(chval)) {
+
+            if (!(obj_is_root(chval->obj) || obj_is_leafy(chval->obj))) {
+                /* recurse for all object types except root, leaf, leaf-list */
+                res = run_instance_check(scb, msg, chval, valroot, 
+                                         layer, all_levels);
+                CHK_EXIT(res, retres);
+            }
+        }
+    }
+
+    /* check all the child nodes for correct number of instances */
+    obj_template_t *chobj = obj_first_child(obj);
+    for (; chobj != NULL; chobj = obj_next_child(chobj)) {
+        
+        if (obj_is_root(chobj)) {
+            continue;
+        }
+
+        if (chobj->objtype == OBJ_TYP_CHOICE) {
+            res = choice_check_agt(scb, msg, chobj, valset, valroot, layer);
+        } else {
+            res = instance_check(scb, msg, chobj, valset, valroot, layer);
+        }
+        if (res != NO_ERR && valset->res == NO_ERR) {
+            valset->res = res;
+        }
+        CHK_EXIT(res, retres);
+    }
+
+    return retres;
+    
+}  /* run_instance_check */
+
+
+/********************************************************************
+* FUNCTION run_obj_commit_tests
+* 
+* Run selected validation tests from section 8 of RFC 6020
+*
+* INPUTS:
+*   profile == agt_profile pointer
+*   scb == session control block (may be NULL; no session stats)
+*   msghdr == XML message header in progress 
+*          == NULL MEANS NO RPC-ERRORS ARE RECORDED
+*   ct == commit test record to use (NULL == root test)
+*   val == context node in data tree to use
+*   root == root of the data tree to use
+*   testmask == bitmask of the tests that are requested
+*
+* OUTPUTS:
+*   if msghdr not NULL:
+*      msghdr->msg_errQ may have rpc_err_rec_t 
+*      structs added to it which must be freed by the 
+*      caller with the rpc_err_free_record function
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t 
+    run_obj_commit_tests (agt_profile_t *profile,
+                          ses_cb_t *scb,
+                          xml_msg_hdr_t *msghdr,
+                          agt_cfg_commit_test_t *ct,
+                          val_value_t *val,
+                          val_value_t *root,
+                          uint32 testmask)
+{
+    status_t res, retres = NO_ERR;
+    uint32   testflags = (ct) ? ct->testflags : profile->agt_rootflags;
+    
+    testflags &= testmask;
+
+    if (testflags) {
+        if (LOGDEBUG2) {
+            log_debug2("\nrun obj_commit_tests for %s", 
+                       (ct) ? ct->objpcb->exprstr : (const xmlChar *)"/");
+        }
+    } else {
+        if (LOGDEBUG4) {
+            log_debug4("\nskip obj_commit_tests for %s", 
+                       (ct) ? ct->objpcb->exprstr : (const xmlChar *)"/");
+        }
+        return NO_ERR;
+    }
+
+    /* go through all the commit test objects that might need
+     * to be checked for this object
+     */
+    if (testflags & AGT_TEST_INSTANCE_MASK) {
+
+        /* need to run the instance tests on the 'val' node */
+        if (ct) {
+            res = run_instance_check(scb, msghdr, val, root,
+                                     NCX_LAYER_CONTENT, FALSE);
+            CHK_EXIT(res, retres);
+        } else {
+            /* TBD: figure out how to use the gen_root object
+             * by moving all the data_db nodes into gen_root datadefQ
+             * This requires moving them from mod->datadefQ so that
+             * these 2 functions below will no longer work
+             * Too much code uses this for-loop search approach
+             * so this change is still TBD */
+            ncx_module_t *mod = ncx_get_first_module();
+            for (; mod != NULL; mod = ncx_get_next_module(mod)) {
+                obj_template_t *obj = ncx_get_first_data_object(mod);
+                for (; obj != NULL; obj = ncx_get_next_data_object(mod, obj)) {
+
+                    if (skip_obj_commit_test(obj)) {
+                        continue;
+                    }
+
+                    /* just run instance check on the top level object */
+                    if (obj->objtype == OBJ_TYP_CHOICE) {
+                        res = choice_check_agt(scb, msghdr, obj, val, root,
+                                               NCX_LAYER_CONTENT);
+                    } else {
+                        res = instance_check(scb, msghdr, obj, val, root,
+                                             NCX_LAYER_CONTENT);
+                    }
+                    CHK_EXIT(res, retres);
+                }
+            }
+        }
+    }
+
+    if (testflags & AGT_TEST_FL_XPATH_TYPE) {
+        res = instance_xpath_check(scb, msghdr, val, root, NCX_LAYER_CONTENT);
+        if (res != NO_ERR) {
+            CHK_EXIT(res, retres);
+        }
+    }
+
+    if (testflags & AGT_TEST_FL_MUST) {
+        res = must_stmt_check(scb, msghdr, root, val);
+        if (res != NO_ERR) {
+            CHK_EXIT(res, retres);
+        }
+    }
+
+    // defer AGT_TEST_FL_UNIQUE and process entire resnode list at once
+
+    return retres;
+    
+}  /* run_obj_commit_tests */
+
+
+/********************************************************************
+* FUNCTION run_obj_unique_tests
+* 
+* Run unique-stmt tests from section 7.8.3 of RFC 6020
+*
+* INPUTS:
+*   scb == session control block (may be NULL; no session stats)
+*   msghdr == XML message header in progress 
+*          == NULL MEANS NO RPC-ERRORS ARE RECORDED
+*   ct == commit test record to use (NULL == root test)
+*   root == docroot for XPath
+* OUTPUTS:
+*   if msghdr not NULL:
+*      msghdr->msg_errQ may have rpc_err_rec_t 
+*      structs added to it which must be freed by the 
+*      caller with the rpc_err_free_record function
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t 
+    run_obj_unique_tests (ses_cb_t *scb,
+                          xml_msg_hdr_t *msghdr,
+                          agt_cfg_commit_test_t *ct,
+                          val_value_t *root)
+{
+    status_t res = NO_ERR;
+
+    if (ct->testflags & AGT_TEST_FL_UNIQUE) {
+        log_debug2("\nrun unique tests for %s", ct->objpcb->exprstr);
+        res = unique_stmt_check(scb, msghdr, ct, root);
+    }
+
+    return res;
+    
+}  /* run_obj_unique_tests */
+
+
+/********************************************************************
+* FUNCTION run_commit_test_instance
+* 
+* Run the commit tests for one instance of a commit test object
+*
+* INPUTS:
+*   profile == agt_profile_t to use
+*   scb == session control block (may be NULL; no session stats)
+*   msghdr == XML message header in progress 
+*   ct == commit test record to use
+*   valnode == instance to test
+*   root == root of the data tree to use
+*   tests == bitmask of the tests that are requested
+*
+* OUTPUTS:
+*   *errors set to TRUE if a test failed
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t 
+    run_commit_test_instance (agt_profile_t *profile,
+                              ses_cb_t *scb,
+                              xml_msg_hdr_t *msghdr,
+                              agt_cfg_commit_test_t *ct,
+                              val_value_t *valnode,
+                              val_value_t *root,
+                              uint32 tests,
+                              boolean *errors)
+{
+    valnode->res = NO_ERR;
+    status_t res = run_obj_commit_tests(profile, scb, msghdr, ct, valnode, 
+                                        root, tests);
+    if (res != NO_ERR) {
+        valnode->res = res;
+        *errors = TRUE;
+    }
+    return res;
+
+}  /* run_commit_test_instance */
+
+
+/********************************************************************
+* FUNCTION add_edit_inst
+* 
+* Add an edited instance of a commit test object to the commit edits
+*
+* INPUTS:
+*   edits == commit edits in progress
+*   val == edited instance
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_edit_inst (commit_edits_t *edits,
+                   val_value_t *val)
+{
+    if (edits->numinsts == edits->maxinsts) {
+        commit_edit_inst_t *newinsts = 
+            grow_edit_array(edits->insts, &edits->maxinsts,
+                            sizeof(commit_edit_inst_t));
+        if (newinsts == NULL) {
+            return ERR_INTERNAL_MEM;
+        }
+        edits->insts = newinsts;
+    }
+    edits->insts[edits->numinsts].val = val;
+    edits->insts[edits->numinsts].seq = edits->numinsts;
+    edits->numinsts++;
+    return NO_ERR;
+
+}  /* add_edit_inst */
+
+
+/********************************************************************
+* FUNCTION add_subtree_insts
+* 
+* Add all instances of a commit test object in a changed subtree
+*
+* INPUTS:
+*   edits == commit edits in progress
+*   ct == commit test record to use
+*   val == changed subtree to check
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    add_subtree_insts (commit_edits_t *edits,
+                       agt_cfg_commit_test_t *ct,
+                       val_value_t *val)
+{
+    status_t res = NO_ERR;
+    val_value_t *chval = val_get_first_child(val);
+    for (; chval != NULL && res == NO_ERR; 
+         chval = val_get_next_child(chval)) {
+        if (chval->obj == ct->obj) {
+            res = add_edit_inst(edits, chval);
+        } else if (!typ_is_simple(chval->btyp)) {
+            res = add_subtree_insts(edits, ct, chval);
+        }
+    }
+    return res;
+
+}  /* add_subtree_insts */
+
+
+/********************************************************************
+* FUNCTION compare_edit_insts
+* 
+* qsort compare function to group the same instances together
+*********************************************************************/
+static int
+    compare_edit_insts (const void *p1,
+                        const void *p2)
+{
+    const commit_edit_inst_t *i1 = (const commit_edit_inst_t *)p1;
+    const commit_edit_inst_t *i2 = (const commit_edit_inst_t *)p2;
+    if (i1->val != i2->val) {
+        return ((uintptr_t)i1->val < (uintptr_t)i2->val) ? -1 : 1;
+    }
+    return (i1->seq < i2->seq) ? -1 : (i1->seq > i2->seq);
+
+}  /* compare_edit_insts */
+
+
+/********************************************************************
+* FUNCTION compare_edit_inst_seq
+* 
+* qsort compare function to restore the order instances were found in
+*********************************************************************/
+static int
+    compare_edit_inst_seq (const void *p1,
+                           const void *p2)
+{
+    const commit_edit_inst_t *i1 = (const commit_edit_inst_t *)p1;
+    const commit_edit_inst_t *i2 = (const commit_edit_inst_t *)p2;
+    return (i1->seq < i2->seq) ? -1 : (i1->seq > i2->seq);
+
+}  /* compare_edit_inst_seq */
+
+
+/********************************************************************
+* FUNCTION get_edited_insts
+* 
+* Get the instances of a commit test object that are in a
+* changed subtree, or that are ancestors of a changed node.
+* The other instances were valid in the running config and
+* none of their tests can see a change.
+*
+* Each instance is listed once, in the order it was first found
+*
+* INPUTS:
+*   edits == commit edits with the changed nodes
+*   ct == commit test record to use
+*
+* OUTPUTS:
+*   edits->insts, edits->numinsts set to the edited instances
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    get_edited_insts (commit_edits_t *edits,
+                      agt_cfg_commit_test_t *ct)
+{
+    status_t res = NO_ERR;
+    uint32 i, j;
+
+    edits->numinsts = 0;
+    for (i = 0; i < edits->numnodes && res == NO_ERR; i++) {
+        const commit_edit_node_t *node = &edits->nodes[i];
+
+        /* find the ancestor-or-self instance of the changed node;
+         * skip nodes that are no longer in the config tree */
+        val_value_t *inst = NULL;
+        val_value_t *val = node->val;
+        for (; val != NULL && !obj_is_root(val->obj); val = val->parent) {
+            if (VAL_IS_DELETED(val)) {
+                break;
+            }
+            if (inst == NULL && val->obj == ct->obj) {
+                inst = val;
+            }
+        }
+        if (val == NULL || !obj_is_root(val->obj)) {
+            continue;
+        }
+
+        if (inst) {
+            res = add_edit_inst(edits, inst);
+        } else if (node->subtree && !typ_is_simple(node->val->btyp)) {
+            res = add_subtree_insts(edits, ct, node->val);
+        }
+    }
+
+    if (res != NO_ERR || edits->numinsts < 2) {
+        return res;
+    }
+
+    /* remove the duplicates, keeping the first one found */
+    qsort(edits->insts, edits->numinsts, sizeof(commit_edit_inst_t),
+          compare_edit_insts);
+    for (i = 1, j = 1; i < edits->numinsts; i++) {
+        if (edits->insts[i].val != edits->insts[j-1].val) {
+            edits->insts[j++] = edits->insts[i];
+        }
+    }
+    edits->numinsts = j;
+    qsort(edits->insts, edits->numinsts, sizeof(commit_edit_inst_t),
+          compare_edit_inst_seq);
+    return NO_ERR;
+
+}  /* get_edited_insts */
+
+
+/********************************************************************
+* FUNCTION run_edited_commit_tests
+* 
+* Run the commit tests only for the edited instances of a
+* commit test object
+*
+* INPUTS:
+*   profile == agt_profile_t to use
+*   scb == session control block (may be NULL; no session stats)
+*   msghdr == XML message header in progress 
+*   edits == commit edits with the changed nodes
+*   ct == commit test record to use
+*   root == root of the data tree to use
+*   tests == bitmask of the tests that are requested
+*
+* OUTPUTS:
+*   *errors set to TRUE if a test failed
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t 
+    run_edited_commit_tests (agt_profile_t *profile,
+                             ses_cb_t *scb,
+                             xml_msg_hdr_t *msghdr,
+                             commit_edits_t *edits,
+                             agt_cfg_commit_test_t *ct,
+                             val_value_t *root,
+                             uint32 tests,
+                             boolean *errors)
+{
+    status_t res = get_edited_insts(edits, ct);
+    if (res != NO_ERR) {
+        return res;
+    }
+
+    status_t retres = NO_ERR;
+    uint32 i;
+    for (i = 0; i < edits->numinsts; i++) {
+        res = run_commit_test_instance(profile, scb, msghdr, ct,
+                                       edits->insts[i].val, root, tests,
+                                       errors);
+        CHK_EXIT(res, retres);
+    }
+    return retres;
+
+}  /* run_edited_commit_tests */
+
+
+/********************************************************************
+* FUNCTION select_commit_test
+* 
+* Get the tests of one commit test record that need to be run
+* for this root check
+*
+* INPUTS:
+*   profile == agt_profile_t to use
+*   txcb == transaction control block
+*   edits == commit edits with the changed nodes
+*   ct == commit test record to check
+*   root == root of the data tree to use
+*   allinst == address of return all instances flag
+*
+* OUTPUTS:
+*   *allinst == FALSE if only the edited instances need the tests
+*
+* RETURNS:
+*   bitmask of the tests to run; 0 if none
+*********************************************************************/
+static uint32
+    select_commit_test (agt_profile_t *profile,
+                        agt_cfg_transaction_t *txcb,
+                        commit_edits_t *edits,
+                        agt_cfg_commit_test_t *ct,
+                        val_value_t *root,
+                        boolean *allinst)
+{
+    uint32 tests = ct->testflags & AGT_TEST_ALL_COMMIT_MASK;
+
+    *allinst = TRUE;
+
+    /* prune entry that has not changed in a valid config
+     * use the commit test dependencies if all the edits
+     * are known; otherwise this will only work for <commit>
+     * and <edit-config> on the running config, because 
+     * otherwise there will not be any edits recorded in
+     * the txcb->undoQ or any nodes marked dirty in val->flags */
+    if (edits->known) {
+        tests = check_commit_test_edits(edits, ct, tests, allinst);
+    } else if (profile->agt_config_state == AGT_CFG_STATE_OK) {
+        tests = prune_obj_commit_tests(txcb, ct, root, tests);
+    }
+
+    if (tests == 0) {
+        /* no commit tests needed for this node */
+        if (LOGDEBUG3) {
+            log_debug3("\nrun_root_check: skip commit test %s:%s",
+                       obj_get_mod_name(ct->obj),
+                       obj_get_name(ct->obj));
+        }
+    }
+    return tests;
+
+}  /* select_commit_test */
+
+
+/********************************************************************
+* FUNCTION run_root_check_test
+* 
+* Run the selected tests of one commit test record
+*
+* INPUTS:
+*   profile == agt_profile_t to use
+*   scb == session control block (may be NULL; no session stats)
+*   msghdr == XML message header in progress 
+*          == NULL MEANS NO RPC-ERRORS ARE RECORDED
+*   txcb == transaction control block
+*   edits == commit edits with the changed nodes
+*   ct == commit test record to use
+*   root == root of the data tree to use
+*   tests == bitmask of the tests to run
+*   allinst == FALSE to run the tests on the edited instances only
+*
+* OUTPUTS:
+*   *errors set to TRUE if a test failed
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t
+    run_root_check_test (agt_profile_t *profile,
+                         ses_cb_t *scb,
+                         xml_msg_hdr_t *msghdr,
+                         agt_cfg_transaction_t *txcb,
+                         commit_edits_t *edits,
+                         agt_cfg_commit_test_t *ct,
+                         val_value_t *root,
+                         uint32 tests,
+                         boolean allinst,
+                         boolean *errors)
+{
+    status_t res = NO_ERR, retres = NO_ERR;
+    xpath_resnode_t *resnode = NULL;
+
+    if (!allinst && edits->nodesvalid) {
+        if (tests & AGT_TEST_FL_UNIQUE) {
+            /* the unique-stmt test uses all the instances */
+            res = prep_commit_test_node(scb, msghdr, txcb, ct, root);
+            if (res != NO_ERR) {
+                return res;
             }
+            for (resnode = xpath_get_first_resnode(ct->result);
+                 resnode != NULL;
+                 resnode = xpath_get_next_resnode(resnode)) {
+                xpath_get_resnode_valptr(resnode)->res = NO_ERR;
+            }
+        }
+
+        /* run the tests on the edited instances only */
+        res = run_edited_commit_tests(profile, scb, msghdr, edits, ct,
+                                      root, tests, errors);
+        CHK_EXIT(res, retres);
+    } else {
+        res = prep_commit_test_node(scb, msghdr, txcb, ct, root);
+        if (res != NO_ERR) {
+            return res;
+        }
+
+        /* run all relevant tests on each node in the result set */
+        resnode = xpath_get_first_resnode(ct->result);
+        for (; resnode != NULL; 
+             resnode = xpath_get_next_resnode(resnode)) {
+
+            val_value_t *valnode = xpath_get_resnode_valptr(resnode);
+            res = run_commit_test_instance(profile, scb, msghdr, ct, 
+                                           valnode, root, tests, errors);
+            CHK_EXIT(res, retres);
         }
     }
 
-    /* skip this node for all tests, since no instances of
-     * the top-level object exist which might have been changed
-     * Relying on the fact that the root-check is always done for
-     * the root node (on the top-level YANG data nodes, so
-     * any instance or mandatory tests on the top-node will
-     * always be done     */
-    //return 0;
+    /* check if any unique tests, which are handled all at once
+     * instead of one instance at a time  */
+    res = run_obj_unique_tests(scb, msghdr, ct, root);
+    if (res != NO_ERR) {
+        *errors = TRUE;
+        CHK_EXIT(res, retres);
+    }
 
-    /* xpath tests can depend on any top level container */
-    return (curflags & AGT_TEST_FL_XPATH_TYPE);
+    return retres;
 
-} /* check_prune_obj */
+}  /* run_root_check_test */
 
 
 /********************************************************************
-* FUNCTION check_no_prune_curedit
+* FUNCTION has_child_when
 * 
-* Check if the specified object test is needed from the current 
-* commit test, based on the current edit in the undo record
+* Check if any child of an object, or any object in a choice
+* that is a child, has a when-stmt.  The instance tests add
+* a temporary child node to the parent while checking such
+* a when-stmt for a child that is not present
+*
+* Inherited and choice/case when-stmts are checked without
+* a temporary node, so they are not checked here; see
+* add_child_shared_whens
 *
 * INPUTS:
-*   undo == edit operation to check
-*   obj == commit test object to check; must not be root!
+*   obj == object to check
+*
 * RETURNS:
-*  TRUE if found and test needed; FALSE if not found
+*   TRUE if a child has a when-stmt
 *********************************************************************/
 static boolean
-    check_no_prune_curedit (agt_cfg_undo_rec_t *undo,
-                            obj_template_t *obj)
+    has_child_when (obj_template_t *obj)
 {
-    obj_template_t *editobj = (undo->newnode) ? undo->newnode->obj :
-        ((undo->curnode) ? undo->curnode->obj : NULL);
-    if (editobj == NULL) {
-        return FALSE;
+    obj_template_t *chobj = obj_first_child(obj);
+    for (; chobj != NULL; chobj = obj_next_child(chobj)) {
+        if (chobj->when) {
+            return TRUE;
+        }
+        if ((chobj->objtype == OBJ_TYP_CHOICE ||
+             chobj->objtype == OBJ_TYP_CASE) && has_child_when(chobj)) {
+            return TRUE;
+        }
     }
+    return FALSE;
 
-    /* see if the commit test object is a descendant of
-     * the edit object, but only if not deleting the edit
-     * object; do not trigger descendant test on a delete  */
-    boolean done = (undo->editop == OP_EDITOP_DELETE);
+}  /* has_child_when */
+
+
+/********************************************************************
+* FUNCTION add_shared_whens
+* 
+* Add the when-stmts of an object that val_check_obj_when
+* evaluates with an XPath pcb shared with other objects:
+* the inherited uses and augment when-stmts, and the when-stmts
+* of the choice and case nodes above the object
+*
+* INPUTS:
+*   obj == object to check
+*   testnum == index of the selected test that checks obj
+*   whens == array to add the when-stmts to
+*         == NULL to count them only
+*   numwhens == address of the number of when-stmts so far
+*
+* OUTPUTS:
+*   *numwhens incremented for each when-stmt
+*   whens[] set if not NULL
+*********************************************************************/
+static void
+    add_shared_whens (obj_template_t *obj,
+                      uint32 testnum,
+                      root_check_when_t *whens,
+                      uint32 *numwhens)
+{
     obj_template_t *testobj = obj;
-    while (!done) {
-        if (editobj == testobj) {
-            return TRUE;   // do not prune this object test
+    while (testobj) {
+        if (testobj != obj && testobj->when) {
+            if (whens) {
+                whens[*numwhens].pcb = testobj->when;
+                whens[*numwhens].test = testnum;
+            }
+            (*numwhens)++;
         }
 
-        if (testobj->parent && !obj_is_root(testobj->parent)) {
-            testobj = testobj->parent;
-        } else {
-            done = TRUE;
+        obj_xpath_ptr_t *xptr = obj_first_xpath_ptr(testobj);
+        for (; xptr != NULL; xptr = obj_next_xpath_ptr(xptr)) {
+            if (whens) {
+                whens[*numwhens].pcb = xptr->xpath;
+                whens[*numwhens].test = testnum;
+            }
+            (*numwhens)++;
         }
-    }
 
-    /* see if the edit object is a descendant of the commit test object */
-    done = FALSE;
-    while (!done) {
-        if (editobj == obj) {
-            return TRUE;   // do not prune this object test
+        testobj = testobj->parent;
+        if (testobj &&
+            testobj->objtype != OBJ_TYP_CHOICE &&
+            testobj->objtype != OBJ_TYP_CASE) {
+            testobj = NULL;
         }
+    }
 
-        if (editobj->parent && !obj_is_root(editobj->parent)) {
-            editobj = editobj->parent;
-        } else {
-            done = TRUE;
+}  /* add_shared_whens */
+
+
+/********************************************************************
+* FUNCTION add_child_shared_whens
+* 
+* Add the shared when-stmts of the child objects the instance
+* tests of an object check, including the objects in a choice
+*
+* INPUTS:
+*   obj == object with the instance tests
+*   testnum == index of the selected test for obj
+*   whens == array to add the when-stmts to
+*         == NULL to count them only
+*   numwhens == address of the number of when-stmts so far
+*
+* OUTPUTS:
+*   *numwhens incremented for each when-stmt
+*   whens[] set if not NULL
+*********************************************************************/
+static void
+    add_child_shared_whens (obj_template_t *obj,
+                            uint32 testnum,
+                            root_check_when_t *whens,
+                            uint32 *numwhens)
+{
+    obj_template_t *chobj = obj_first_child(obj);
+    for (; chobj != NULL; chobj = obj_next_child(chobj)) {
+        add_shared_whens(chobj, testnum, whens, numwhens);
+        if (chobj->objtype == OBJ_TYP_CHOICE ||
+            chobj->objtype == OBJ_TYP_CASE) {
+            add_child_shared_whens(chobj, testnum, whens, numwhens);
         }
     }
 
-    return FALSE;
+}  /* add_child_shared_whens */
 
-} /* check_no_prune_curedit */
+
+/********************************************************************
+* FUNCTION compare_test_whens
+* 
+* qsort compare function to sort shared when-stmts by XPath pcb
+*********************************************************************/
+static int
+    compare_test_whens (const void *p1,
+                        const void *p2)
+{
+    const root_check_when_t *w1 = (const root_check_when_t *)p1;
+    const root_check_when_t *w2 = (const root_check_when_t *)p2;
+    if (w1->pcb != w2->pcb) {
+        return ((uintptr_t)w1->pcb < (uintptr_t)w2->pcb) ? -1 : 1;
+    }
+    return 0;
+
+}  /* compare_test_whens */
 
 
 /********************************************************************
-* FUNCTION prune_obj_commit_tests
+* FUNCTION compare_test_objs
 * 
-* Check if the specified object test can be reduced or elimated
-* from the current commit test
+* qsort compare function to sort selected tests by object
+*********************************************************************/
+static int
+    compare_test_objs (const void *p1,
+                       const void *p2)
+{
+    const root_check_test_t *t1 = *(const root_check_test_t * const *)p1;
+    const root_check_test_t *t2 = *(const root_check_test_t * const *)p2;
+    if (t1->ct->obj != t2->ct->obj) {
+        return ((uintptr_t)t1->ct->obj < (uintptr_t)t2->ct->obj) ? -1 : 1;
+    }
+    return 0;
+
+}  /* compare_test_objs */
+
+
+/********************************************************************
+* FUNCTION find_test_group
+* 
+* Find the first test in the group of a selected test
 *
 * INPUTS:
+*   tests == selected tests
+*   testnum == index of the test to check
 *
-* OUTPUTS:
-*  *testflags will be altered
 * RETURNS:
-*  new (or unchanged) test flags
+*   index of the first test in the group
 *********************************************************************/
 static uint32
-    prune_obj_commit_tests (agt_cfg_transaction_t *txcb,
-                            agt_cfg_commit_test_t *ct,
-                            val_value_t *rootval,
-                            uint32 curflags)
+    find_test_group (root_check_test_t *tests,
+                     uint32 testnum)
 {
-    if (curflags & AGT_TEST_FL_MUST) {
-        /* do not prune a must-stmt test since the XPath expression
-         * may reference any arbitrary data node    */
-        return curflags;
+    while (tests[testnum].group != testnum) {
+        tests[testnum].group = tests[tests[testnum].group].group;
+        testnum = tests[testnum].group;
     }
+    return testnum;
 
-    agt_cfg_undo_rec_t *undo = NULL;
-    if (txcb->cfg_id == NCX_CFGID_RUNNING) {
-        if (txcb->commitcheck) {
-            /* called from <commit> 
-             * look for dirty or subtree dirty flags in the rootval
-             * this rootval is reallt candidate->root, so it is
-             * OK to check the dirty flags    */
-            curflags = check_prune_obj(ct->obj, rootval, curflags);
-        } else {
-            if (txcb->edit_type == AGT_CFG_EDIT_TYPE_FULL) {
-                /* called from <validate> on external <config> element;
-                 * <copy-config> is not supported on the running config
-                 * so there is nothing to do for now; do not prune;
-                 * force a full test for <validate>   */
-            } else if (txcb->edit_type == AGT_CFG_EDIT_TYPE_PARTIAL) {
-                /* called from <edit-config> on running config;
-                 * check the edit list; only nodes that have been
-                 * edited need to run a commit test   */
-                undo = (agt_cfg_undo_rec_t *)dlq_firstEntry(&txcb->undoQ);
-                while (undo) {
-                    if (check_no_prune_curedit(undo, ct->obj)) {
-                        return curflags;
-                    }
-                    undo = (agt_cfg_undo_rec_t *)dlq_nextEntry(undo);
-                }
-                curflags = 0;
-            } // else unknown edit-type! do not prune
-        }
-    } else if (txcb->cfg_id == NCX_CFGID_CANDIDATE) {
-        if (txcb->edit_type == AGT_CFG_EDIT_TYPE_FULL) {
-            /* called from <validate> operation on the <candidate> config */
-            curflags = check_prune_obj(ct->obj, rootval, curflags);
-        } else if (txcb->edit_type == AGT_CFG_EDIT_TYPE_PARTIAL) {
-            /* called from <edit-config> with test-option=set-then-test
-             * first check all the current edits; because the dirty flags
-             * for any edits from this <rpc> have not been set yet */
-            undo = (agt_cfg_undo_rec_t *)dlq_firstEntry(&txcb->undoQ);
-            while (undo) {
-                if (check_no_prune_curedit(undo, ct->obj)) {
-                    return curflags;
-                }
-                undo = (agt_cfg_undo_rec_t *)dlq_nextEntry(undo);
-            }
+}  /* find_test_group */
 
-            /* did not find the object in the current edits so check
-             * pending edits (dirty flags) on the candidate->root target */
-            curflags = check_prune_obj(ct->obj, rootval, curflags);
-        } // else unknown edit-type! do not prune!
-    } // else unknown config target! do not prune!
 
-    return curflags;
+/********************************************************************
+* FUNCTION join_test_groups
+* 
+* Put two selected tests and their groups in the same group
+*
+* INPUTS:
+*   tests == selected tests
+*   test1 == index of the first test
+*   test2 == index of the second test
+*********************************************************************/
+static void
+    join_test_groups (root_check_test_t *tests,
+                      uint32 test1,
+                      uint32 test2)
+{
+    test1 = find_test_group(tests, test1);
+    test2 = find_test_group(tests, test2);
+    if (test1 < test2) {
+        tests[test2].group = test1;
+    } else if (test2 < test1) {
+        tests[test1].group = test2;
+    }
 
-} /* prune_obj_commit_tests */
+}  /* join_test_groups */
 
 
 /********************************************************************
-* FUNCTION run_instance_check
-* 
-* Check for the proper number of object instances for
-* the specified value struct.
+* FUNCTION group_root_check_tests
 * 
-* The top-level value set passed cannot represent a choice
-* or a case within a choice.
-*
-* This function is intended for validating PDUs (RPC requests)
-* during the PDU processing.  It does not check the instance
-* count or must-stmt expressions for any <config> (ncx:root)
-* container.  This must be done with the agt_val_root_check function.
+* Divide the selected tests into groups that can run at the
+* same time.  The tests in one group run in the same thread
+* in commit test order.  The groups run on the pool come first.
+*
+*   - the instance tests of a parent node set the res of the
+*     child nodes, so they are in the same group as the
+*     tests of the child objects
+*   - the instance-identifier tests all parse with the
+*     session reader, so they are all in one group
+*   - the instance tests that evaluate the same inherited or
+*     choice/case when-stmt of a child object are in one group,
+*     because the XPath evaluation changes the shared pcb
+*   - a group with instance tests that add a temporary child
+*     node for a when-stmt is run in the main thread after
+*     the pool is done
 *
 * INPUTS:
-*   scb == session control block (may be NULL; no session stats)
-*   msg == xml_msg_hdr t from msg in progress 
-*       == NULL MEANS NO RPC-ERRORS ARE RECORDED
-*   valset == val_value_t list, leaf-list, or container to check
-*   valroot == root node of the database
-*   layer == NCX layer calling this function (for error purposes only)
-*   all_levels == TRUE to recurse for all levels
-*              == FALSE to just check the curent level
+*   rc == root check with the selected tests
+*
 * OUTPUTS:
-*   if msg not NULL:
-*      msg->msg_errQ may have rpc_err_rec_t structs added to it 
-*      which must be freed by the called with the 
-*      rpc_err_free_record function
+*   rc->groups, rc->numgroups, rc->numjobs set
+*   rc->tests[i].group, next set
 *
 * RETURNS:
-*   status of the operation, NO_ERR if no validation errors found
+*   status
 *********************************************************************/
-static status_t 
-    run_instance_check (ses_cb_t *scb,
-                        xml_msg_hdr_t *msg,
-                        val_value_t *valset,
-                        val_value_t *valroot,
-                        ncx_layer_t layer,
-                        boolean all_levels)
+static status_t
+    group_root_check_tests (root_check_t *rc)
 {
-    assert( valset && "valset is NULL!" );
+    root_check_test_t  *tests = rc->tests, **byobj;
+    root_check_when_t  *whens;
+    uint32              i, lo, hi, mid, idtest = AGT_VAL_NO_TEST;
+    uint32              numwhens;
 
-    if (LOGDEBUG4) {
-        log_debug4("\nrun_instance_check: %s:%s start", 
-                   obj_get_mod_name(valset->obj),
-                   valset->name);
+    byobj = m__getMem(rc->numtests * sizeof(root_check_test_t *));
+    if (byobj == NULL) {
+        return ERR_INTERNAL_MEM;
+    }
+    rc->groups = m__getMem(rc->numtests * sizeof(root_check_group_t));
+    if (rc->groups == NULL) {
+        m__free(byobj);
+        return ERR_INTERNAL_MEM;
     }
 
-    status_t res = NO_ERR, retres = NO_ERR;
-    obj_template_t *obj = valset->obj;
-
-    if (skip_obj_commit_test(obj)) {
-        return NO_ERR;
+    for (i = 0; i < rc->numtests; i++) {
+        tests[i].group = i;
+        tests[i].next = AGT_VAL_NO_TEST;
+        byobj[i] = &tests[i];
     }
+    qsort(byobj, rc->numtests, sizeof(root_check_test_t *),
+          compare_test_objs);
 
-    if (all_levels && val_child_cnt(valset)) {
-        val_value_t *chval = val_get_first_child(valset);
-        for (; chval != NULL; chval = val_get_next_child(chval)) {
+    for (i = 0; i < rc->numtests; i++) {
+        root_check_test_t *test = &tests[i];
 
-            if (!(obj_is_root(chval->obj) || obj_is_leafy(chval->obj))) {
-                /* recurse for all object types except root, leaf, leaf-list */
-                res = run_instance_check(scb, msg, chval, valroot, 
-                                         layer, all_levels);
-                CHK_EXIT(res, retres);
+        if (test->tests & AGT_TEST_INSTANCE_MASK) {
+            test->mainonly = has_child_when(test->ct->obj);
+        }
+
+        /* find the selected test of the parent object */
+        obj_template_t *parent = obj_get_real_parent(test->ct->obj);
+        if (parent && !obj_is_root(parent)) {
+            lo = 0;
+            hi = rc->numtests;
+            while (lo < hi) {
+                mid = lo + (hi - lo) / 2;
+                if ((uintptr_t)byobj[mid]->ct->obj < (uintptr_t)parent) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo < rc->numtests && byobj[lo]->ct->obj == parent &&
+                (byobj[lo]->tests & AGT_TEST_INSTANCE_MASK)) {
+                join_test_groups(tests, i, (uint32)(byobj[lo] - tests));
+            }
+        }
+
+        if ((test->tests & AGT_TEST_FL_XPATH_TYPE) &&
+            obj_get_basetype(test->ct->obj) == NCX_BT_INSTANCE_ID) {
+            if (idtest == AGT_VAL_NO_TEST) {
+                idtest = i;
+            } else {
+                join_test_groups(tests, idtest, i);
+            }
+        }
+    }
+    m__free(byobj);
+
+    /* join the tests that evaluate the same shared when-stmt */
+    numwhens = 0;
+    for (i = 0; i < rc->numtests; i++) {
+        if (tests[i].tests & AGT_TEST_INSTANCE_MASK) {
+            add_child_shared_whens(tests[i].ct->obj, i, NULL, &numwhens);
+        }
+    }
+    if (numwhens > 1) {
+        whens = m__getMem(numwhens * sizeof(root_check_when_t));
+        if (whens == NULL) {
+            return ERR_INTERNAL_MEM;
+        }
+        numwhens = 0;
+        for (i = 0; i < rc->numtests; i++) {
+            if (tests[i].tests & AGT_TEST_INSTANCE_MASK) {
+                add_child_shared_whens(tests[i].ct->obj, i, whens,
+                                       &numwhens);
             }
         }
+        qsort(whens, numwhens, sizeof(root_check_when_t),
+              compare_test_whens);
+        for (i = 1; i < numwhens; i++) {
+            if (whens[i].pcb == whens[i-1].pcb) {
+                join_test_groups(tests, whens[i-1].test, whens[i].test);
+            }
+        }
+        m__free(whens);
     }
 
-    /* check all the child nodes for correct number of instances */
-    obj_template_t *chobj = obj_first_child(obj);
-    for (; chobj != NULL; chobj = obj_next_child(chobj)) {
-        
-        if (obj_is_root(chobj)) {
-            continue;
+    /* link the tests of each group in commit test order */
+    for (i = rc->numtests; i > 0; i--) {
+        root_check_test_t *test = &tests[i-1];
+        uint32 first = find_test_group(tests, i-1);
+        test->group = first;
+        if (first != i-1) {
+            test->next = tests[first].next;
+            tests[first].next = i-1;
+            if (test->mainonly) {
+                tests[first].mainonly = TRUE;
+            }
         }
+    }
 
-        if (chobj->objtype == OBJ_TYP_CHOICE) {
-            res = choice_check_agt(scb, msg, chobj, valset, valroot, layer);
-        } else {
-            res = instance_check(scb, msg, chobj, valset, valroot, layer);
+    /* the pool groups first, then the main thread groups */
+    rc->numgroups = 0;
+    for (i = 0; i < rc->numtests; i++) {
+        if (tests[i].group == i && !tests[i].mainonly) {
+            rc->groups[rc->numgroups].first = i;
+            rc->groups[rc->numgroups].mainonly = FALSE;
+            rc->numgroups++;
         }
-        if (res != NO_ERR && valset->res == NO_ERR) {
-            valset->res = res;
+    }
+    rc->numjobs = rc->numgroups;
+    for (i = 0; i < rc->numtests; i++) {
+        if (tests[i].group == i && tests[i].mainonly) {
+            rc->groups[rc->numgroups].first = i;
+            rc->groups[rc->numgroups].mainonly = TRUE;
+            rc->numgroups++;
         }
-        CHK_EXIT(res, retres);
     }
+    return NO_ERR;
 
-    return retres;
-    
-}  /* run_instance_check */
+}  /* group_root_check_tests */
 
 
 /********************************************************************
-* FUNCTION run_obj_commit_tests
+* FUNCTION init_test_hdr
 * 
-* Run selected validation tests from section 8 of RFC 6020
+* Set up the message header for the errors of one selected test
+* It starts with the same prefixes as the message in progress,
+* so the error paths use the prefixes they would use there
 *
 * INPUTS:
-*   profile == agt_profile pointer
-*   scb == session control block (may be NULL; no session stats)
-*   msghdr == XML message header in progress 
-*          == NULL MEANS NO RPC-ERRORS ARE RECORDED
-*   ct == commit test record to use (NULL == root test)
-*   val == context node in data tree to use
-*   root == root of the data tree to use
-*   testmask == bitmask of the tests that are requested
-*
-* OUTPUTS:
-*   if msghdr not NULL:
-*      msghdr->msg_errQ may have rpc_err_rec_t 
-*      structs added to it which must be freed by the 
-*      caller with the rpc_err_free_record function
+*   test == selected test
+*   msghdr == XML message header in progress
 *
 * RETURNS:
-*   status of the operation, NO_ERR if no validation errors found
+*   status
 *********************************************************************/
-static status_t 
-    run_obj_commit_tests (agt_profile_t *profile,
-                          ses_cb_t *scb,
-                          xml_msg_hdr_t *msghdr,
-                          agt_cfg_commit_test_t *ct,
-                          val_value_t *val,
-                          val_value_t *root,
-                          uint32 testmask)
+static status_t
+    init_test_hdr (root_check_test_t *test,
+                   xml_msg_hdr_t *msghdr)
 {
-    status_t res, retres = NO_ERR;
-    uint32   testflags = (ct) ? ct->testflags : profile->agt_rootflags;
-    
-    testflags &= testmask;
+    if (test->hdrdone) {
+        xml_msg_clean_hdr(&test->mhdr);
+    }
+    xml_msg_init_hdr(&test->mhdr);
+    test->hdrdone = TRUE;
+    test->mhdr.useprefix = msghdr->useprefix;
+    test->mhdr.withdef = msghdr->withdef;
+    return xml_msg_copy_prefix_map(&test->mhdr, msghdr);
 
-    if (testflags) {
-        if (LOGDEBUG2) {
-            log_debug2("\nrun obj_commit_tests for %s", 
-                       (ct) ? ct->objpcb->exprstr : (const xmlChar *)"/");
-        }
-    } else {
-        if (LOGDEBUG4) {
-            log_debug4("\nskip obj_commit_tests for %s", 
-                       (ct) ? ct->objpcb->exprstr : (const xmlChar *)"/");
+}  /* init_test_hdr */
+
+
+/********************************************************************
+* FUNCTION run_root_check_group
+* 
+* Run the tests of one group in commit test order
+* The errors of each test are recorded in the test->mhdr
+*
+* INPUTS:
+*   rc == root check in progress
+*   first == index of the first test in the group
+*********************************************************************/
+static void
+    run_root_check_group (root_check_t *rc,
+                          uint32 first)
+{
+    /* the commit edits are only read, except for the list of
+     * edited instances, so each group gets its own list */
+    commit_edits_t edits = *rc->edits;
+    edits.insts = NULL;
+    edits.numinsts = 0;
+    edits.maxinsts = 0;
+
+    uint32 i;
+    for (i = first; i != AGT_VAL_NO_TEST; i = rc->tests[i].next) {
+        root_check_test_t *test = &rc->tests[i];
+        xml_msg_hdr_t *testhdr = NULL;
+
+        test->errors = FALSE;
+        test->res = NO_ERR;
+        if (rc->msghdr) {
+            testhdr = &test->mhdr;
+            test->res = init_test_hdr(test, rc->msghdr);
+        }
+        if (test->res == NO_ERR) {
+            test->res = run_root_check_test(rc->profile, rc->scb, testhdr,
+                                            rc->txcb, &edits, test->ct,
+                                            rc->root, test->tests,
+                                            test->allinst, &test->errors);
+        }
+        if (terminate_parse(test->res)) {
+            break;
         }
-        return NO_ERR;
     }
 
-    /* go through all the commit test objects that might need
-     * to be checked for this object
-     */
-    if (testflags & AGT_TEST_INSTANCE_MASK) {
+    if (edits.insts) {
+        m__free(edits.insts);
+    }
 
-        /* need to run the instance tests on the 'val' node */
-        if (ct) {
-            res = run_instance_check(scb, msghdr, val, root,
-                                     NCX_LAYER_CONTENT, FALSE);
-            CHK_EXIT(res, retres);
-        } else {
-            /* TBD: figure out how to use the gen_root object
-             * by moving all the data_db nodes into gen_root datadefQ
-             * This requires moving them from mod->datadefQ so that
-             * these 2 functions below will no longer work
-             * Too much code uses this for-loop search approach
-             * so this change is still TBD */
-            ncx_module_t *mod = ncx_get_first_module();
-            for (; mod != NULL; mod = ncx_get_next_module(mod)) {
-                obj_template_t *obj = ncx_get_first_data_object(mod);
-                for (; obj != NULL; obj = ncx_get_next_data_object(mod, obj)) {
+}  /* run_root_check_group */
 
-                    if (skip_obj_commit_test(obj)) {
-                        continue;
-                    }
 
-                    /* just run instance check on the top level object */
-                    if (obj->objtype == OBJ_TYP_CHOICE) {
-                        res = choice_check_agt(scb, msghdr, obj, val, root,
-                                               NCX_LAYER_CONTENT);
-                    } else {
-                        res = instance_check(scb, msghdr, obj, val, root,
-                                             NCX_LAYER_CONTENT);
-                    }
-                    CHK_EXIT(res, retres);
-                }
-            }
-        }
-    }
+/********************************************************************
+* FUNCTION root_check_job
+* 
+* Validation pool job: run the tests of one group
+*
+* INPUTS:
+*   cookie == root_check_t in progress
+*   jobnum == index of the group to run
+*********************************************************************/
+static void
+    root_check_job (void *cookie,
+                    uint32 jobnum)
+{
+    root_check_t *rc = (root_check_t *)cookie;
+    run_root_check_group(rc, rc->groups[jobnum].first);
 
-    if (testflags & AGT_TEST_FL_XPATH_TYPE) {
-        res = instance_xpath_check(scb, msghdr, val, root, NCX_LAYER_CONTENT);
-        if (res != NO_ERR) {
-            CHK_EXIT(res, retres);
+}  /* root_check_job */
+
+
+/********************************************************************
+* FUNCTION merge_root_check_tests
+* 
+* Move the errors of the tests into the message in progress
+* in commit test order, as if the tests were run one by one
+*
+* A test that generated a prefix for its error paths that an
+* earlier test also generated for a different namespace is
+* run again, with its group, using the prefixes in use now
+*
+* INPUTS:
+*   rc == root check that is done
+*
+* RETURNS:
+*   status of the operation, NO_ERR if no validation errors found
+*********************************************************************/
+static status_t
+    merge_root_check_tests (root_check_t *rc)
+{
+    status_t res, retres = NO_ERR;
+    uint32   i;
+
+    for (i = 0; i < rc->numtests; i++) {
+        root_check_test_t *test = &rc->tests[i];
+
+        if (rc->msghdr && test->hdrdone) {
+            res = xml_msg_merge_prefix_map(rc->msghdr, &test->mhdr);
+            if (res == ERR_NCX_DUP_PREFIX) {
+                log_debug3("\nrun_root_check: rerun tests for %s:%s",
+                           obj_get_mod_name(test->ct->obj),
+                           obj_get_name(test->ct->obj));
+                run_root_check_group(rc, test->group);
+                res = xml_msg_merge_prefix_map(rc->msghdr, &test->mhdr);
+            }
+            if (res != NO_ERR) {
+                return res;
+            }
+            dlq_block_enque(&test->mhdr.errQ, &rc->msghdr->errQ);
         }
-    }
 
-    if (testflags & AGT_TEST_FL_MUST) {
-        res = must_stmt_check(scb, msghdr, root, val);
-        if (res != NO_ERR) {
-            CHK_EXIT(res, retres);
+        if (test->errors) {
+            rc->profile->agt_load_rootcheck_errors = TRUE;
         }
+        CHK_EXIT(test->res, retres);
     }
-
-    // defer AGT_TEST_FL_UNIQUE and process entire resnode list at once
-
     return retres;
-    
-}  /* run_obj_commit_tests */
+
+}  /* merge_root_check_tests */
 
 
 /********************************************************************
-* FUNCTION run_obj_unique_tests
+* FUNCTION run_root_check_pool
 * 
-* Run unique-stmt tests from section 7.8.3 of RFC 6020
+* Select the commit tests for agt_val_root_check and run them
+* on the validation threads.  The config tree is not changed
+* while the tests run, and each group of tests that shares
+* any state is run by one thread.  Small commits are tested
+* in the calling thread.
 *
 * INPUTS:
+*   profile == agt_profile_t to use
 *   scb == session control block (may be NULL; no session stats)
-*   msghdr == XML message header in progress 
-*          == NULL MEANS NO RPC-ERRORS ARE RECORDED
-*   ct == commit test record to use (NULL == root test)
-*   root == docroot for XPath
+*   msghdr == XML message header in progress
+*        == NULL MEANS NO RPC-ERRORS ARE RECORDED
+*   txcb == transaction control block
+*   edits == commit edits with the changed nodes
+*   root == root of the data tree to use
+*
 * OUTPUTS:
-*   if msghdr not NULL:
+*   if mshdr not NULL:
 *      msghdr->msg_errQ may have rpc_err_rec_t 
 *      structs added to it which must be freed by the 
 *      caller with the rpc_err_free_record function
@@ -5333,22 +8159,106 @@ static status_t
 * RETURNS:
 *   status of the operation, NO_ERR if no validation errors found
 *********************************************************************/
-static status_t 
-    run_obj_unique_tests (ses_cb_t *scb,
-                          xml_msg_hdr_t *msghdr,
-                          agt_cfg_commit_test_t *ct,
-                          val_value_t *root)
+static status_t
+    run_root_check_pool (agt_profile_t *profile,
+                         ses_cb_t *scb,
+                         xml_msg_hdr_t *msghdr,
+                         agt_cfg_transaction_t *txcb,
+                         commit_edits_t *edits,
+                         val_value_t *root)
 {
-    status_t res = NO_ERR;
+    root_check_t  rc;
+    status_t      res = NO_ERR, retres = NO_ERR;
+    uint32        i, maxtests;
+    boolean       bigjob;
 
-    if (ct->testflags & AGT_TEST_FL_UNIQUE) {
-        log_debug2("\nrun unique tests for %s", ct->objpcb->exprstr);
-        res = unique_stmt_check(scb, msghdr, ct, root);
+    maxtests = dlq_count(&profile->agt_commit_testQ);
+    if (maxtests == 0) {
+        return NO_ERR;
     }
 
-    return res;
-    
-}  /* run_obj_unique_tests */
+    memset(&rc, 0x0, sizeof(root_check_t));
+    rc.profile = profile;
+    rc.scb = scb;
+    rc.msghdr = msghdr;
+    rc.txcb = txcb;
+    rc.edits = edits;
+    rc.root = root;
+    rc.tests = m__getMem(maxtests * sizeof(root_check_test_t));
+    if (rc.tests == NULL) {
+        return ERR_INTERNAL_MEM;
+    }
+    memset(rc.tests, 0x0, maxtests * sizeof(root_check_test_t));
+
+    bigjob = !edits->nodesvalid || edits->numnodes >= AGT_VAL_POOL_MIN_EDITS;
+
+    agt_cfg_commit_test_t *ct = (agt_cfg_commit_test_t *)
+        dlq_firstEntry(&profile->agt_commit_testQ);
+    for (; ct != NULL; ct = (agt_cfg_commit_test_t *)dlq_nextEntry(ct)) {
+        root_check_test_t *test = &rc.tests[rc.numtests];
+        test->tests = select_commit_test(profile, txcb, edits, ct, root,
+                                         &test->allinst);
+        if (test->tests == 0) {
+            continue;
+        }
+        test->ct = ct;
+        if (test->allinst) {
+            bigjob = TRUE;
+        }
+        rc.numtests++;
+    }
+
+    if (bigjob && rc.numtests > 1) {
+        res = group_root_check_tests(&rc);
+    }
+
+    if (res != NO_ERR) {
+        retres = res;
+    } else if (rc.numjobs > 1) {
+        log_debug3("\nrun_root_check: %u tests in %u groups",
+                   rc.numtests, rc.numgroups);
+
+        /* nothing changes the config tree until the pool is done */
+        val_freeze_child_index(TRUE);
+        agt_val_pool_run(rc.numjobs, root_check_job, &rc);
+        val_freeze_child_index(FALSE);
+
+        for (i = rc.numjobs; i < rc.numgroups; i++) {
+            run_root_check_group(&rc, rc.groups[i].first);
+        }
+        retres = merge_root_check_tests(&rc);
+    } else {
+        /* not worth the threads; run the tests one by one */
+        for (i = 0; i < rc.numtests; i++) {
+            root_check_test_t *test = &rc.tests[i];
+            boolean errors = FALSE;
+            res = run_root_check_test(profile, scb, msghdr, txcb, edits,
+                                      test->ct, root, test->tests,
+                                      test->allinst, &errors);
+            if (errors) {
+                profile->agt_load_rootcheck_errors = TRUE;
+            }
+            if (res != NO_ERR) {
+                retres = res;
+                if (terminate_parse(res)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < rc.numtests; i++) {
+        if (rc.tests[i].hdrdone) {
+            xml_msg_clean_hdr(&rc.tests[i].mhdr);
+        }
+    }
+    if (rc.groups) {
+        m__free(rc.groups);
+    }
+    m__free(rc.tests);
+    return retres;
+
+}  /* run_root_check_pool */
 
 
 /******************* E X T E R N   F U N C T I O N S ***************/
@@ -5519,6 +8429,17 @@ status_t
 *         attempted and it failed; running config is not valid!
 *         The server will shutdown if
 *   The target nodes in the undoQ records
+*
+*   If the config state is OK and all the edits since the running
+*   config was validated are known, only the tests that reference
+*   a changed node (the ct->depQ built from the XPath expressions)
+*   or are in a changed subtree are run. A test that is only
+*   affected through its subtree is only run on the edited instances.
+*
+*   If --validate-threads is more than 1, the type (B) and (C)
+*   tests of a full validation or a large commit are run on the
+*   validation threads.  The errors are added to msghdr in the
+*   same order as when the tests are run one by one.
 * INPUTS:
 *   scb == session control block (may be NULL; no session stats)
 *   msghdr == XML message header in progress
@@ -5562,63 +8483,49 @@ status_t
         CHK_EXIT(res, retres);
     }
 
-    /* go through all the commit test objects that might need
-     * to be checked for this commit    */
-    agt_cfg_commit_test_t *ct = (agt_cfg_commit_test_t *)
-        dlq_firstEntry(&profile->agt_commit_testQ);
-    for (; ct != NULL; ct = (agt_cfg_commit_test_t *)dlq_nextEntry(ct)) {
-
-        uint32  tests = ct->testflags & AGT_TEST_ALL_COMMIT_MASK;
-
-        /* prune entry that has not changed in a valid config
-         * this will only work for <commit> and <edit-config>
-         * on the running config, because otherwise there will
-         * not be any edits recorded in the txcb->undoQ or any
-         * nodes marked dirty in val->flags     */
-        if (profile->agt_config_state == AGT_CFG_STATE_OK) {
-            tests = prune_obj_commit_tests(txcb, ct, root, tests);
-        }
-
-        if (tests == 0) {
-            /* no commit tests needed for this node */
-            if (LOGDEBUG3) {
-                log_debug3("\nrun_root_check: skip commit test %s:%s",
-                           obj_get_mod_name(ct->obj),
-                           obj_get_name(ct->obj));
-            }
-            continue;
-        }
+    /* get the changes made since the running config was validated */
+    commit_edits_t edits;
+    res = get_commit_edits(txcb, root, &edits);
+    if (res != NO_ERR) {
+        return res;
+    }
 
-        res = prep_commit_test_node(scb, msghdr, txcb, ct, root);
+    if (agt_val_pool_enabled()) {
+        /* run the commit tests on the validation threads */
+        res = run_root_check_pool(profile, scb, msghdr, txcb, &edits, root);
         if (res != NO_ERR) {
-            CHK_EXIT(res, retres);
-            continue;
+            retres = res;
         }
+    } else {
+        /* go through all the commit test objects that might need
+         * to be checked for this commit    */
+        agt_cfg_commit_test_t *ct = (agt_cfg_commit_test_t *)
+            dlq_firstEntry(&profile->agt_commit_testQ);
+        for (; ct != NULL; ct = (agt_cfg_commit_test_t *)dlq_nextEntry(ct)) {
+
+            boolean allinst = TRUE, errors = FALSE;
+            uint32  tests = select_commit_test(profile, txcb, &edits, ct,
+                                               root, &allinst);
+            if (tests == 0) {
+                continue;
+            }
 
-        /* run all relevant tests on each node in the result set */
-        xpath_resnode_t *resnode = xpath_get_first_resnode(ct->result);
-        for (; resnode != NULL; resnode = xpath_get_next_resnode(resnode)) {
-
-            val_value_t *valnode = xpath_get_resnode_valptr(resnode);
-            valnode->res = NO_ERR;
-            res = run_obj_commit_tests(profile, scb, msghdr, ct, valnode, 
-                                       root, tests);
-            if (res != NO_ERR) {
-                valnode->res = res;
+            res = run_root_check_test(profile, scb, msghdr, txcb, &edits,
+                                      ct, root, tests, allinst, &errors);
+            if (errors) {
                 profile->agt_load_rootcheck_errors = TRUE;
-                CHK_EXIT(res, retres);
             }
-        }
-
-        /* check if any unique tests, which are handled all at once
-         * instead of one instance at a time  */
-        res = run_obj_unique_tests(scb, msghdr, ct, root);
-        if (res != NO_ERR) {
-            profile->agt_load_rootcheck_errors = TRUE;
-            CHK_EXIT(res, retres);
+            if (res != NO_ERR) {
+                retres = res;
+                if (terminate_parse(res)) {
+                    break;
+                }
+            }
         }
     }
 
+    clean_commit_edits(&edits);
+
     log_debug3("\nagt_val_root_check: end");
 
     return retres;
@@ -5876,13 +8783,8 @@ status_t
     }
 #endif
 
-    /* check any top-level deletes */
-    //res = apply_commit_deletes(scb, msg, target, source->root, target->root);
-    if (res == NO_ERR) {
-        /* apply all the new and modified nodes */
-        res = handle_callback(AGT_CB_APPLY, OP_EDITOP_COMMIT, scb, msg, 
-                              target, source->root, target->root, target->root);
-    }
+    /* apply all the new, modified and deleted nodes */
+    res = handle_commit_edits(AGT_CB_APPLY, scb, msg, source, target);
 
     if (res==NO_ERR) {
         /* complete the transaction */
@@ -5890,6 +8792,9 @@ status_t
                               target, source->root, target->root, target->root);
 
         if ( NO_ERR == res ) {
+            /* running now only differs from the candidate in the
+             * edited subtrees, which were moved into running */
+            source->src_txid = target->last_txid;
             res = agt_commit_complete();
         }
     } else {
@@ -5905,7 +8810,7 @@ status_t
 
     if (res == NO_ERR && !profile->agt_has_startup) {
         if (save_nvstore) {
-            res = agt_ncx_cfg_save(target, FALSE);
+            res = agt_nvstore_save(target, msg->rpc_txcb);
             if (res != NO_ERR) {
                 /* write to NV-store failed */
                 agt_record_error(scb,&msg->mhdr, NCX_LAYER_OPERATION, res, 
@@ -5937,8 +8842,8 @@ status_t
 * source and target and write operation
 *
 * !!! Only works for the <commit> operation for applying
-* !!! the candidate to the running config; relies on value
-* !!! flags VAL_FL_SUBTREE_DIRTY and VAL_FL_DIRTY
+* !!! the candidate to the running config; relies on the
+* !!! candidate edit tree and the VAL_FL_DIRTY value flags
 *
 * INPUTS:
 *   scb == session control block
@@ -5967,14 +8872,13 @@ status_t
     assert( target && "target is NULL!" );
 
     /* usually only save if the source config was touched */
-    if (!cfg_get_dirty_flag(source)) {
+    if (!cfg_get_dirty_flag(source) && !cfg_get_full_compare(source)) {
         /* no need to check for partial-lock violations */
         return NO_ERR;
     }
 
-    status_t res = handle_callback(AGT_CB_VALIDATE, OP_EDITOP_COMMIT, 
-                                   scb, msg, target, source->root, 
-                                   target->root, target->root);
+    status_t res = handle_commit_edits(AGT_CB_VALIDATE, scb, msg, 
+                                       source, target);
     return res;
 
 }  /* agt_val_check_commit_edits */
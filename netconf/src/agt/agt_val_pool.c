@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*  FILE: agt_val_pool.c
+
+    Worker thread pool for parallel commit validation
+
+    Each batch gets a new generation number.  A worker wakes up
+    when the generation changes, takes job numbers from a shared
+    counter until they run out, and then counts itself finished.
+    The thread that started the batch takes jobs the same way,
+    and waits until every worker is finished, so no worker still
+    looks at the batch after agt_val_pool_run returns.
+
+*********************************************************************
+*                                                                   *
+*                  C H A N G E   H I S T O R Y                      *
+*                                                                   *
+*********************************************************************
+
+date         init     comment
+----------------------------------------------------------------------
+17oct26               begun
+
+*********************************************************************
+*                                                                   *
+*                     I N C L U D E    F I L E S                    *
+*                                                                   *
+*********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "procdefs.h"
+#include "agt_val_pool.h"
+#include "log.h"
+#include "status.h"
+
+
+/********************************************************************
+*                                                                   *
+*                       V A R I A B L E S                            *
+*                                                                   *
+*********************************************************************/
+
+static boolean agt_val_pool_init_done = FALSE;
+
+/* total number of threads to use, including the caller */
+static uint32           pool_numthreads;
+
+/* worker threads that are running */
+static pthread_t       *pool_threads;
+static uint32           pool_started;
+
+/* TRUE if starting the workers failed; do not try again */
+static boolean          pool_start_failed;
+
+/* pool_lock protects the batch and worker state below */
+static pthread_mutex_t  pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* signaled when a new batch is started or the pool is stopped */
+static pthread_cond_t   pool_cond = PTHREAD_COND_INITIALIZER;
+
+/* signaled when the last worker is finished with a batch */
+static pthread_cond_t   pool_donecond = PTHREAD_COND_INITIALIZER;
+
+static boolean          pool_stop;
+
+/* current batch */
+static uint32             pool_gen;
+static agt_val_pool_fn_t  pool_jobfn;
+static void              *pool_cookie;
+static uint32             pool_numjobs;
+static uint32             pool_finished;
+
+/* next job number to take; updated atomically */
+static uint32             pool_nextjob;
+
+
+/********************************************************************
+* FUNCTION run_jobs
+*
+* Take jobs from the current batch until there are none left
+*
+* INPUTS:
+*   jobfn == function to run each job
+*   cookie == cookie to pass to jobfn
+*   numjobs == number of jobs in the batch
+*********************************************************************/
+static void
+    run_jobs (agt_val_pool_fn_t jobfn,
+              void *cookie,
+              uint32 numjobs)
+{
+    uint32 jobnum = __atomic_fetch_add(&pool_nextjob, 1, __ATOMIC_RELAXED);
+    while (jobnum < numjobs) {
+        (*jobfn)(cookie, jobnum);
+        jobnum = __atomic_fetch_add(&pool_nextjob, 1, __ATOMIC_RELAXED);
+    }
+
+}  /* run_jobs */
+
+
+/********************************************************************
+* FUNCTION pool_worker
+*
+* Worker thread main loop
+*
+* INPUTS:
+*   arg == batch generation number when the thread was started
+*
+* RETURNS:
+*   NULL
+*********************************************************************/
+static void *
+    pool_worker (void *arg)
+{
+    uint32 mygen = (uint32)(uintptr_t)arg;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (!pool_stop && pool_gen == mygen) {
+            pthread_cond_wait(&pool_cond, &pool_lock);
+        }
+        if (pool_stop) {
+            break;
+        }
+
+        mygen = pool_gen;
+        agt_val_pool_fn_t jobfn = pool_jobfn;
+        void *cookie = pool_cookie;
+        uint32 numjobs = pool_numjobs;
+        pthread_mutex_unlock(&pool_lock);
+
+        run_jobs(jobfn, cookie, numjobs);
+
+        pthread_mutex_lock(&pool_lock);
+        if (++pool_finished == pool_started) {
+            pthread_cond_signal(&pool_donecond);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+
+}  /* pool_worker */
+
+
+/********************************************************************
+* FUNCTION start_workers
+*
+* Start the worker threads
+* Signals are blocked in the workers so they are
+* always handled by the main server thread
+*
+*********************************************************************/
+static void
+    start_workers (void)
+{
+    sigset_t  allsigs, oldsigs;
+    uint32    i, numworkers = pool_numthreads - 1;
+
+    pool_threads = m__getMem(numworkers * sizeof(pthread_t));
+    if (pool_threads == NULL) {
+        pool_start_failed = TRUE;
+        return;
+    }
+
+    sigfillset(&allsigs);
+    pthread_sigmask(SIG_SETMASK, &allsigs, &oldsigs);
+
+    for (i = 0; i < numworkers; i++) {
+        if (pthread_create(&pool_threads[i], NULL, pool_worker,
+                           (void *)(uintptr_t)pool_gen) != 0) {
+            break;
+        }
+    }
+    pool_started = i;
+
+    pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+    if (pool_started < numworkers) {
+        log_warn("\nWarning: started %u of %u validation threads",
+                 pool_started, numworkers);
+        pool_start_failed = TRUE;
+    } else if (LOGDEBUG) {
+        log_debug("\nStarted %u validation threads", pool_started);
+    }
+
+}  /* start_workers */
+
+
+/************** E X T E R N A L   F U N C T I O N S  ***************/
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_init
+*
+* Set the number of threads to validate with
+* No threads are started until the first batch is run
+*
+* INPUTS:
+*   numthreads == total number of threads, including the
+*                 thread that runs a batch; 1 disables the pool
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    agt_val_pool_init (uint32 numthreads)
+{
+    if (agt_val_pool_init_done) {
+        return SET_ERROR(ERR_INTERNAL_INIT_SEQ);
+    }
+
+    if (numthreads == 0) {
+        numthreads = 1;
+    } else if (numthreads > AGT_VAL_POOL_MAX_THREADS) {
+        numthreads = AGT_VAL_POOL_MAX_THREADS;
+    }
+
+    pool_numthreads = numthreads;
+    pool_threads = NULL;
+    pool_started = 0;
+    pool_start_failed = FALSE;
+    pool_stop = FALSE;
+    pool_gen = 0;
+    pool_finished = 0;
+    pool_nextjob = 0;
+    agt_val_pool_init_done = TRUE;
+    return NO_ERR;
+
+}  /* agt_val_pool_init */
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_cleanup
+*
+* Stop the worker threads
+*
+*********************************************************************/
+void
+    agt_val_pool_cleanup (void)
+{
+    uint32 i;
+
+    if (!agt_val_pool_init_done) {
+        return;
+    }
+
+    if (pool_started) {
+        pthread_mutex_lock(&pool_lock);
+        pool_stop = TRUE;
+        pthread_cond_broadcast(&pool_cond);
+        pthread_mutex_unlock(&pool_lock);
+
+        for (i = 0; i < pool_started; i++) {
+            pthread_join(pool_threads[i], NULL);
+        }
+    }
+    if (pool_threads) {
+        m__free(pool_threads);
+        pool_threads = NULL;
+    }
+    pool_started = 0;
+    agt_val_pool_init_done = FALSE;
+
+}  /* agt_val_pool_cleanup */
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_enabled
+*
+* Check if batches can be run by more than one thread
+*
+* RETURNS:
+*   TRUE if the pool has more than one thread
+*********************************************************************/
+boolean
+    agt_val_pool_enabled (void)
+{
+    if (!agt_val_pool_init_done || pool_numthreads < 2) {
+        return FALSE;
+    }
+    return (pool_started > 0 || !pool_start_failed);
+
+}  /* agt_val_pool_enabled */
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_run
+*
+* Run a batch of jobs on the pool and the calling thread
+* The jobs are started in job number order, but finish
+* in any order.  Returns after all of them are done.
+*
+* INPUTS:
+*   numjobs == number of jobs in the batch
+*   jobfn == function to run each job
+*   cookie == cookie to pass to jobfn
+*
+*********************************************************************/
+void
+    agt_val_pool_run (uint32 numjobs,
+                      agt_val_pool_fn_t jobfn,
+                      void *cookie)
+{
+    uint32 i;
+
+    if (agt_val_pool_enabled() && pool_started == 0 && numjobs > 1) {
+        start_workers();
+    }
+
+    if (pool_started == 0 || numjobs < 2) {
+        for (i = 0; i < numjobs; i++) {
+            (*jobfn)(cookie, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_jobfn = jobfn;
+    pool_cookie = cookie;
+    pool_numjobs = numjobs;
+    pool_finished = 0;
+    __atomic_store_n(&pool_nextjob, 0, __ATOMIC_RELAXED);
+    pool_gen++;
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    run_jobs(jobfn, cookie, numjobs);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_finished < pool_started) {
+        pthread_cond_wait(&pool_donecond, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+}  /* agt_val_pool_run */
+
+
+/* END file agt_val_pool.c */
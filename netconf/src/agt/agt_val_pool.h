@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _H_agt_val_pool
+#define _H_agt_val_pool
+/*  FILE: agt_val_pool.h
+*********************************************************************
+*                                                                   *
+*                         P U R P O S E                             *
+*                                                                   *
+*********************************************************************
+
+   Worker thread pool for parallel commit validation
+
+   The pool runs a batch of numbered jobs with one job callback.
+   The calling thread takes jobs too, and agt_val_pool_run
+   returns when every job is done.  The threads are started the
+   first time a batch is run and are kept until agt_val_pool_cleanup.
+
+   The jobs only read the shared data, so the caller has to make
+   sure nothing they share is changed while the batch runs.
+
+*********************************************************************
+*                                                                   *
+*                   C H A N G E         H I S T O R Y               *
+*                                                                   *
+*********************************************************************
+
+date             init     comment
+----------------------------------------------------------------------
+17-oct-26             Begun.
+*/
+
+#ifndef _H_status
+#include "status.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/********************************************************************
+*                                                                   *
+*                         C O N S T A N T S                         *
+*                                                                   *
+*********************************************************************/
+
+/* default for the --validate-threads parameter */
+#define AGT_VAL_POOL_DEF_THREADS   1
+
+/* upper limit for the --validate-threads parameter */
+#define AGT_VAL_POOL_MAX_THREADS   64
+
+
+/********************************************************************
+*                                                                   *
+*                             T Y P E S                             *
+*                                                                   *
+*********************************************************************/
+
+/* run one job of a batch
+ *
+ * INPUTS:
+ *    cookie == cookie passed to agt_val_pool_run
+ *    jobnum == job number, 0 .. numjobs - 1
+ */
+typedef void (*agt_val_pool_fn_t) (void *cookie,
+                                   uint32 jobnum);
+
+
+/********************************************************************
+*                                                                   *
+*                        F U N C T I O N S                          *
+*                                                                   *
+*********************************************************************/
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_init
+*
+* Set the number of threads to validate with
+* No threads are started until the first batch is run
+*
+* INPUTS:
+*   numthreads == total number of threads, including the
+*                 thread that runs a batch; 1 disables the pool
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    agt_val_pool_init (uint32 numthreads);
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_cleanup
+*
+* Stop the worker threads
+*
+*********************************************************************/
+extern void
+    agt_val_pool_cleanup (void);
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_enabled
+*
+* Check if batches can be run by more than one thread
+*
+* RETURNS:
+*   TRUE if the pool has more than one thread
+*********************************************************************/
+extern boolean
+    agt_val_pool_enabled (void);
+
+
+/********************************************************************
+* FUNCTION agt_val_pool_run
+*
+* Run a batch of jobs on the pool and the calling thread
+* The jobs are started in job number order, but finish
+* in any order.  Returns after all of them are done.
+*
+* INPUTS:
+*   numjobs == number of jobs in the batch
+*   jobfn == function to run each job
+*   cookie == cookie to pass to jobfn
+*
+*********************************************************************/
+extern void
+    agt_val_pool_run (uint32 numjobs,
+                      agt_val_pool_fn_t jobfn,
+                      void *cookie);
+
+#ifdef __cplusplus
+}  /* end extern 'C' */
+#endif
+
+#endif            /* _H_agt_val_pool */
@@ -680,6 +680,34 @@ static int
 }  /* check_channel_eof */
 
 
+/********************************************************************
+* FUNCTION deque_outbuff
+*
+* Remove the first buffer from the session outQ
+*
+* INPUTS:
+*   scb == session control block to use
+*
+* OUTPUTS:
+*   scb->outq_bytes is reduced by the bytes in the buffer
+*
+* RETURNS:
+*   first buffer in the outQ or NULL if the outQ is empty
+*********************************************************************/
+static ses_msg_buff_t *
+    deque_outbuff (ses_cb_t *scb)
+{
+    ses_msg_buff_t *buff;
+
+    buff = (ses_msg_buff_t *)dlq_deque(&scb->outQ);
+    if (buff != NULL) {
+        scb->outq_bytes -= buff->bufflen - buff->buffpos;
+    }
+    return buff;
+
+}  /* deque_outbuff */
+
+
 /************ E X T E R N A L   F U N C T I O N S *****************/
 
 
@@ -1504,7 +1532,7 @@ status_t
     res = NO_ERR;
 
     /* go through buffer outQ */
-    buff = (ses_msg_buff_t *)dlq_deque(&scb->outQ);
+    buff = deque_outbuff(scb);
 
     if (!buff) {
         if (LOGINFO) {
@@ -1573,7 +1601,7 @@ status_t
         ses_msg_free_buff(scb, buff);
 
         if (res == NO_ERR) {
-            buff = (ses_msg_buff_t *)dlq_deque(&scb->outQ);
+            buff = deque_outbuff(scb);
         } else {
             buff = NULL;
         }
@@ -55,6 +55,7 @@ date         init     comment
 #include "ncx_num.h"
 #include "ncxconst.h"
 #include "ncxmod.h"
+#include "obj.h"
 #include "plock.h"
 #include "plock_cb.h"
 #include "rpc.h"
@@ -152,6 +153,10 @@ static void
         val_free_value(cfg->root);
     }
 
+    if (cfg->editroot) {
+        val_free_value(cfg->editroot);
+    }
+
     if (cfg->name) {
         m__free(cfg->name);
     }
@@ -242,6 +247,221 @@ static cfg_template_t *
 } /* new_template */
 
 
+/********************************************************************
+* FUNCTION sync_insert_child
+*
+* Insert a clone of a running node into the candidate
+* parent, in the same place among its siblings as the
+* running node
+*
+* INPUTS:
+*    newval == clone of runval to insert
+*    runval == running node that was cloned
+*    candparent == candidate parent node to insert into
+*
+*********************************************************************/
+static void
+    sync_insert_child (val_value_t *newval,
+                       val_value_t *runval,
+                       val_value_t *candparent)
+{
+    val_value_t *sibval, *candsib;
+
+    /* look for the closest earlier instance of the same object
+     * that is already in the candidate; instances that are
+     * also being synced are usually inserted in the same
+     * order, so this almost always stops at the first one */
+    for (sibval = (val_value_t *)dlq_prevEntry(runval);
+         sibval != NULL && sibval->obj == runval->obj;
+         sibval = (val_value_t *)dlq_prevEntry(sibval)) {
+        candsib = val_first_child_match(candparent, sibval);
+        if (candsib != NULL) {
+            val_insert_child(newval, candsib, candparent);
+            return;
+        }
+    }
+
+    sibval = (val_value_t *)dlq_nextEntry(runval);
+    if (sibval != NULL && sibval->obj == runval->obj) {
+        candsib = val_first_child_match(candparent, sibval);
+        if (candsib != NULL) {
+            val_insert_child_before(newval, candsib, candparent);
+            return;
+        }
+    }
+
+    val_add_child_sorted(newval, candparent);
+
+}  /* sync_insert_child */
+
+
+/********************************************************************
+* FUNCTION sync_edit_point
+*
+* Replace one edited candidate subtree with a copy
+* of the running subtree
+*
+* INPUTS:
+*    candparent == candidate parent node
+*    candval == candidate node to replace (may be NULL)
+*    runval == running node to copy (may be NULL)
+*
+* RETURNS:
+*    status
+*********************************************************************/
+static status_t
+    sync_edit_point (val_value_t *candparent,
+                     val_value_t *candval,
+                     val_value_t *runval)
+{
+    val_value_t *newval = NULL;
+    status_t     res = NO_ERR;
+
+    if (runval != NULL && val_is_config_data(runval)) {
+        newval = val_clone_config_data(runval, &res);
+        if (newval == NULL) {
+            return (res == NO_ERR) ? ERR_INTERNAL_MEM : res;
+        }
+    }
+
+    if (candval != NULL) {
+        if (newval != NULL) {
+            val_swap_child(newval, candval);
+        } else {
+            val_remove_child(candval);
+        }
+        val_free_value(candval);
+    } else if (newval != NULL) {
+        sync_insert_child(newval, runval, candparent);
+    }
+
+    return NO_ERR;
+
+}  /* sync_edit_point */
+
+
+/********************************************************************
+* FUNCTION sync_child_order
+*
+* Put the candidate instances of a user-ordered list or
+* leaf-list in the same order as the running instances
+* after their edit points have been synced; moved entries
+* keep their candidate place when they are swapped
+*
+* INPUTS:
+*    candval == candidate parent node
+*    runval == running parent node
+*    obj == user-ordered list or leaf-list object
+*
+*********************************************************************/
+static void
+    sync_child_order (val_value_t *candval,
+                      val_value_t *runval,
+                      obj_template_t *obj)
+{
+    val_value_t *runch, *candch, *prevch = NULL, *firstch = NULL;
+
+    for (candch = val_get_first_child(candval);
+         candch != NULL && firstch == NULL;
+         candch = val_get_next_child(candch)) {
+        if (candch->obj == obj) {
+            firstch = candch;
+        }
+    }
+
+    for (runch = val_get_first_child(runval);
+         runch != NULL;
+         runch = val_get_next_child(runch)) {
+
+        if (runch->obj != obj) {
+            continue;
+        }
+        candch = val_first_child_match(candval, runch);
+        if (candch == NULL) {
+            continue;
+        }
+
+        if (prevch == NULL) {
+            if (candch != firstch) {
+                val_remove_child(candch);
+                val_insert_child_before(candch, firstch, candval);
+            }
+        } else if ((val_value_t *)dlq_nextEntry(prevch) != candch) {
+            val_remove_child(candch);
+            val_insert_child(candch, prevch, candval);
+        }
+        prevch = candch;
+    }
+
+}  /* sync_child_order */
+
+
+/********************************************************************
+* FUNCTION sync_edit_tree
+*
+* Make the edited subtrees of a candidate node the same
+* as the corresponding running node
+*
+* INPUTS:
+*    editval == candidate edit tree node for candval
+*    candval == candidate node
+*    runval == running node
+*
+* RETURNS:
+*    status
+*********************************************************************/
+static status_t
+    sync_edit_tree (val_value_t *editval,
+                    val_value_t *candval,
+                    val_value_t *runval)
+{
+    val_value_t    *editch, *candch, *runch;
+    obj_template_t *lastobj = NULL;
+    status_t        res = NO_ERR;
+
+    candval->flags &= ~(VAL_FL_DIRTY | VAL_FL_SUBTREE_DIRTY);
+
+    for (editch = val_get_first_child(editval);
+         editch != NULL && res == NO_ERR;
+         editch = val_get_next_child(editch)) {
+
+        /* the list key nodes in the edit tree are never edit points */
+        if (!val_get_dirty_flag(editch) && obj_is_leafy(editch->obj)) {
+            continue;
+        }
+
+        candch = val_first_child_match(candval, editch);
+        runch = val_first_child_match(runval, editch);
+
+        if (candch == NULL && runch == NULL) {
+            continue;
+        }
+
+        if (val_get_dirty_flag(editch) || candch == NULL || runch == NULL) {
+            res = sync_edit_point(candval, candch, runch);
+        } else {
+            res = sync_edit_tree(editch, candch, runch);
+        }
+    }
+
+    /* edit points of user-ordered entries may be moves */
+    for (editch = val_get_first_child(editval);
+         editch != NULL && res == NO_ERR;
+         editch = val_get_next_child(editch)) {
+        if ((editch->obj->objtype == OBJ_TYP_LIST ||
+             editch->obj->objtype == OBJ_TYP_LEAF_LIST) &&
+            !obj_is_system_ordered(editch->obj) &&
+            val_get_dirty_flag(editch) && editch->obj != lastobj) {
+            sync_child_order(candval, runval, editch->obj);
+            lastobj = editch->obj;
+        }
+    }
+
+    return res;
+
+}  /* sync_edit_tree */
+
+
 
 
 /***************** E X P O R T E D    F U N C T I O N S  ***********/
@@ -620,13 +840,75 @@ status_t
     res = NO_ERR;
     candidate->root = val_clone_config_data(running->root, &res);
     candidate->flags &= ~CFG_FL_DIRTY;
+    cfg_clear_edits(candidate);
     candidate->last_txid = running->last_txid;
+    candidate->src_txid = running->last_txid;
     candidate->cur_txid = 0;
     return res;
 
 } /* cfg_fill_candidate_from_running */
 
 
+/********************************************************************
+* FUNCTION cfg_sync_candidate_from_running
+*
+* Make the <candidate> config the same as the <running> config
+*
+* Only the subtrees recorded in the candidate edit tree are
+* copied from running, if the candidate was copied from the
+* current running config and the edit tree is complete.
+* Otherwise the whole candidate is filled from running.
+*
+* RETURNS:
+*    status
+*********************************************************************/
+status_t
+    cfg_sync_candidate_from_running (void)
+{
+    cfg_template_t  *running, *candidate;
+    status_t         res;
+
+#ifdef DEBUG
+    if (!cfg_arr[NCX_CFGID_RUNNING] ||
+        !cfg_arr[NCX_CFGID_CANDIDATE]) {
+        return SET_ERROR(ERR_INTERNAL_VAL);
+    }
+#endif
+
+    running = cfg_arr[NCX_CFGID_RUNNING];
+    candidate = cfg_arr[NCX_CFGID_CANDIDATE];
+
+    if (!running->root) {
+        return ERR_NCX_DATA_MISSING;
+    }
+
+    if (candidate->root == NULL || cfg_get_full_compare(candidate) ||
+        candidate->src_txid != running->last_txid) {
+        return cfg_fill_candidate_from_running();
+    }
+
+    res = NO_ERR;
+    if (candidate->editroot) {
+        res = sync_edit_tree(candidate->editroot, candidate->root,
+                             running->root);
+        if (res != NO_ERR) {
+            /* the candidate is partly synced; start over */
+            log_debug("\nSync candidate edits failed (%s); "
+                      "filling candidate from running",
+                      get_error_string(res));
+            return cfg_fill_candidate_from_running();
+        }
+    }
+
+    candidate->flags &= ~CFG_FL_DIRTY;
+    cfg_clear_edits(candidate);
+    candidate->last_txid = running->last_txid;
+    candidate->cur_txid = 0;
+    return res;
+
+} /* cfg_sync_candidate_from_running */
+
+
 /********************************************************************
 * FUNCTION cfg_fill_candidate_from_startup
 *
@@ -666,7 +948,10 @@ status_t
     if (candidate->root == NULL) {
         res = ERR_INTERNAL_MEM;
     }
-    candidate->flags &= ~CFG_FL_DIRTY;
+
+    /* the candidate may now differ from running */
+    candidate->flags |= CFG_FL_DIRTY;
+    cfg_set_full_compare(candidate);
     candidate->last_txid = startup->last_txid;
     candidate->cur_txid = 0;
 
@@ -712,6 +997,7 @@ status_t
     res = NO_ERR;
     candidate->root = val_clone_config_data(newroot, &res);
     candidate->flags &= ~CFG_FL_DIRTY;
+    cfg_set_full_compare(candidate);
 
     return res;
 
@@ -766,6 +1052,91 @@ boolean
 }  /* cfg_get_dirty_flag */
 
 
+/********************************************************************
+* FUNCTION cfg_clear_edits
+*
+* Forget the recorded edits for the config, after it
+* has been made the same as the running config
+*
+* INPUTS:
+*    cfg == configuration template to clear
+*
+*********************************************************************/
+void
+    cfg_clear_edits (cfg_template_t *cfg)
+{
+#ifdef DEBUG
+    if (!cfg) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return;
+    }
+#endif
+
+    if (cfg->editroot) {
+        val_free_value(cfg->editroot);
+        cfg->editroot = NULL;
+    }
+    cfg->flags &= ~CFG_FL_FULL_COMPARE;
+
+}  /* cfg_clear_edits */
+
+
+/********************************************************************
+* FUNCTION cfg_set_full_compare
+*
+* Forget the recorded edits for the config, after its
+* contents were replaced without recording the edits,
+* so the next commit compares the whole config
+*
+* INPUTS:
+*    cfg == configuration template to set
+*
+*********************************************************************/
+void
+    cfg_set_full_compare (cfg_template_t *cfg)
+{
+#ifdef DEBUG
+    if (!cfg) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return;
+    }
+#endif
+
+    if (cfg->editroot) {
+        val_free_value(cfg->editroot);
+        cfg->editroot = NULL;
+    }
+    cfg->flags |= CFG_FL_FULL_COMPARE;
+
+}  /* cfg_set_full_compare */
+
+
+/********************************************************************
+* FUNCTION cfg_get_full_compare
+*
+* Check if the recorded edits for the config are incomplete
+*
+* INPUTS:
+*    cfg == configuration template to check
+*
+* RETURNS:
+*    TRUE if the next commit has to compare the whole config
+*********************************************************************/
+boolean
+    cfg_get_full_compare (const cfg_template_t *cfg)
+{
+#ifdef DEBUG
+    if (!cfg) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return FALSE;
+    }
+#endif
+
+    return (cfg->flags & CFG_FL_FULL_COMPARE) ? TRUE : FALSE;
+
+}  /* cfg_get_full_compare */
+
+
 /********************************************************************
 * FUNCTION cfg_ok_to_lock
 *
@@ -1175,7 +1546,7 @@ status_t
          * when a lock is released on the candidate
          */
         if (cfg->cfg_id == NCX_CFGID_CANDIDATE) {
-            res = cfg_fill_candidate_from_running();
+            res = cfg_sync_candidate_from_running();
         }
     }
 
@@ -1227,7 +1598,7 @@ void
              * when a lock is released on the candidate
              */
             if (cfg->cfg_id == NCX_CFGID_CANDIDATE) {
-                res = cfg_fill_candidate_from_running();
+                res = cfg_sync_candidate_from_running();
                 if (res != NO_ERR) {
                     log_error("\nError: discard-changes failed (%s)",
                               get_error_string(res));
@@ -127,6 +127,11 @@ extern "C" {
 #define CFG_FL_TARGET       bit0
 #define CFG_FL_DIRTY        bit1
 
+/* the editroot does not cover every change in the config,
+ * so the next commit has to compare the whole config
+ */
+#define CFG_FL_FULL_COMPARE bit2
+
 #define CFG_INITIAL_TXID (cfg_transaction_id_t)0
 
 /********************************************************************
@@ -191,6 +196,17 @@ typedef struct cfg_template_t_ {
     dlq_hdr_t      load_errQ;    /* Q of rpc_err_rec_t */
     dlq_hdr_t      plockQ;          /* Q of plock_cb_t */
     val_value_t   *root;          /* btyp == NCX_BT_CONTAINER */
+
+    /* candidate only: tree of identity nodes for the subtrees
+     * edited since the candidate was last filled from running;
+     * nodes with VAL_FL_DIRTY set are the edit points
+     */
+    val_value_t   *editroot;
+
+    /* candidate only: last_txid of the running config that the
+     * candidate is the same as, except for the editroot subtrees
+     */
+    cfg_transaction_id_t src_txid;
 } cfg_template_t;
 
 
@@ -373,6 +389,23 @@ extern status_t
     cfg_fill_candidate_from_running (void);
 
 
+/********************************************************************
+* FUNCTION cfg_sync_candidate_from_running
+*
+* Make the <candidate> config the same as the <running> config
+*
+* Only the subtrees recorded in the candidate edit tree are
+* copied from running, if the candidate was copied from the
+* current running config and the edit tree is complete.
+* Otherwise the whole candidate is filled from running.
+*
+* RETURNS:
+*    status
+*********************************************************************/
+extern status_t
+    cfg_sync_candidate_from_running (void);
+
+
 /********************************************************************
 * FUNCTION cfg_fill_candidate_from_startup
 *
@@ -428,6 +461,50 @@ extern boolean
     cfg_get_dirty_flag (const cfg_template_t *cfg);
 
 
+/********************************************************************
+* FUNCTION cfg_clear_edits
+*
+* Forget the recorded edits for the config, after it
+* has been made the same as the running config
+*
+* INPUTS:
+*    cfg == configuration template to clear
+*
+*********************************************************************/
+extern void
+    cfg_clear_edits (cfg_template_t *cfg);
+
+
+/********************************************************************
+* FUNCTION cfg_set_full_compare
+*
+* Forget the recorded edits for the config, after its
+* contents were replaced without recording the edits,
+* so the next commit compares the whole config
+*
+* INPUTS:
+*    cfg == configuration template to set
+*
+*********************************************************************/
+extern void
+    cfg_set_full_compare (cfg_template_t *cfg);
+
+
+/********************************************************************
+* FUNCTION cfg_get_full_compare
+*
+* Check if the recorded edits for the config are incomplete
+*
+* INPUTS:
+*    cfg == configuration template to check
+*
+* RETURNS:
+*    TRUE if the next commit has to compare the whole config
+*********************************************************************/
+extern boolean
+    cfg_get_full_compare (const cfg_template_t *cfg);
+
+
 /********************************************************************
 * FUNCTION cfg_ok_to_lock
 *
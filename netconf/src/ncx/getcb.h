@@ -40,6 +40,20 @@
       Retrieve the simple value contents of a virtual value leaf node
 
 
+    Subtree callbacks: getcb_subtree_fn_t
+
+      Fill in a complete virtual container or list in one call,
+      given the selection the retrieval engine is evaluating
+
+
+    Iterator callbacks: getcb_iter_fn_t
+
+      Return the child nodes of a virtual container one at a
+      time, so large operational lists can be written to the
+      session without building the whole subtree first
+
+
+
 *********************************************************************
 *								    *
 *		   C H A N G E	 H I S T O R Y			    *
@@ -49,6 +63,8 @@
 date	     init     comment
 ----------------------------------------------------------------------
 16-apr-07    abb      Begun; split out from agt_ps.h
+17-oct-26             Add subtree get callbacks
+17-oct-26             Add iterator get callbacks
 
 */
 
@@ -85,13 +101,46 @@ extern "C" {
 *								    *
 *********************************************************************/
 
+/* selection passed to a subtree get callback
+ * All fields are hints; the callback may always return
+ * the complete subtree.  If it leaves out nodes that were
+ * not selected, it MUST return at least every selected node
+ * (and the list keys) and mark dstval with
+ * val_set_virtual_partial.  A partial result is not cached;
+ * it belongs to the retrieval that asked for it.
+ */
+typedef struct getcb_select_t_ {
+    /* subtree filter node that matched the virtual node;
+     * the child nodes are the content match (key values),
+     * selection and containment nodes for this level
+     */
+    const val_value_t   *filval;
+
+    /* number of levels below the virtual node
+     * that will be used; 0 == all levels
+     */
+    uint32               depth;
+} getcb_select_t;
+
+
 /* placeholder for expansion modes */
 typedef enum getcb_mode_t_ {
     GETCB_NONE,
-    GETCB_GET_VALUE
+    GETCB_GET_VALUE,
+    GETCB_GET_NEXT,            /* iterator: fill in the next child */
+    GETCB_GET_DONE               /* iterator: release the cursor */
 } getcb_mode_t;
 
 
+/* iterator state for a getcb_iter_fn_t callback
+ * Set to all zeros before the first GETCB_GET_NEXT call
+ */
+typedef struct getcb_iter_t_ {
+    void                *cursor;    /* owned by the callback */
+    uint32               count;   /* child nodes returned so far */
+} getcb_iter_t;
+
+
 /* getcb_fn_t
  *
  * Callback function for agent node get handler 
@@ -117,6 +166,74 @@ typedef status_t
 		   const val_value_t *virval,
 		   val_value_t *dstval);
 
+
+/* getcb_subtree_fn_t
+ *
+ * Callback function for agent subtree get handler
+ * Installed with val_init_virtual_subtree on a container
+ * or list node; fills in the entire subtree in one call
+ * so the SIL code can get all the state from its backend
+ * with one request
+ *
+ * INPUTS:
+ *   scb    == session that issued the get (may be NULL)
+ *             can be used for access control purposes
+ *   select == selection being evaluated for the retrieval
+ *             NULL if the entire subtree is requested;
+ *             XPath and full <get> output always use NULL
+ *   virval == place-holder node in the data model for
+ *              this virtual value node
+ *   dstval == pointer to value output struct
+ *
+ * OUTPUTS:
+ *  *dstval should be filled in with the child nodes
+ *  of the virtual node
+ *
+ * RETURNS:
+ *    status:
+ */
+typedef status_t
+    (*getcb_subtree_fn_t) (ses_cb_t *scb,
+                           const getcb_select_t *select,
+                           const val_value_t *virval,
+                           val_value_t *dstval);
+
+
+/* getcb_iter_fn_t
+ *
+ * Callback function for agent iterator get handler
+ * Installed with val_init_virtual_stream on a container node;
+ * each call returns one child node (e.g., one list entry)
+ * of the container.  The XML and JSON writers free each
+ * child node after it is written, so memory use does not
+ * grow with the number of entries.
+ *
+ * INPUTS:
+ *   scb    == session that issued the get (may be NULL)
+ *             can be used for access control purposes
+ *   cbmode == GETCB_GET_NEXT to get the next child node
+ *             GETCB_GET_DONE to release iter->cursor;
+ *             always called once at the end, even if the
+ *             caller stopped before the last child node
+ *   iter == iterator state for this retrieval
+ *   virval == place-holder node in the data model for
+ *              this virtual container
+ *   dstval == GETCB_GET_NEXT: empty value struct to initialize
+ *             (val_init_from_template) and fill in
+ *             GETCB_GET_DONE: NULL
+ *
+ * RETURNS:
+ *    status:
+ *      NO_ERR if *dstval is the next child node
+ *      ERR_NCX_NO_INSTANCE if there are no more child nodes
+ */
+typedef status_t
+    (*getcb_iter_fn_t) (ses_cb_t *scb,
+                        getcb_mode_t cbmode,
+                        getcb_iter_t *iter,
+                        const val_value_t *virval,
+                        val_value_t *dstval);
+
 #ifdef __cplusplus
 }  /* end extern 'C' */
 #endif
@@ -33,6 +33,7 @@ date         init     comment
 
 #include  "procdefs.h"
 #include  "dlq.h"
+#include  "getcb.h"
 #include  "ncx.h"
 #include  "ncx_num.h"
 #include  "ncxconst.h"
@@ -86,6 +87,98 @@ static status_t
 } /* write_json_string_value */
 
 
+static status_t
+    write_full_check_val (ses_cb_t *scb,
+                          xml_msg_hdr_t *msg,
+                          val_value_t *val,
+                          int32  startindent,
+                          val_nodetest_fn_t testfn,
+                          boolean justone,
+                          boolean isfirst,
+                          boolean isfirstchild);
+
+
+/********************************************************************
+* FUNCTION write_stream_children
+*
+* Write the child nodes of a virtual container with an
+* iterator get callback.  Each child node is written and freed
+* before the one after the next is retrieved; one node of
+* lookahead is kept to decide the array and comma output
+*
+* INPUTS:
+*   scb == session control block
+*   msg == xml_msg_hdr_t in progress
+*   val == virtual container to write
+*   indent == indent amount for the child nodes
+*   testcb == callback function to use, NULL if not used
+*
+*********************************************************************/
+static void
+    write_stream_children (ses_cb_t *scb,
+                           xml_msg_hdr_t *msg,
+                           val_value_t *val,
+                           int32  indent,
+                           val_nodetest_fn_t testfn)
+{
+    val_value_t       *chval, *nextch;
+    getcb_iter_t       iter;
+    dlq_hdr_t          windowQ;
+    boolean            firstchild, lastchild;
+    status_t           res;
+
+    memset(&iter, 0x0, sizeof(getcb_iter_t));
+    dlq_createSQue(&windowQ);
+    firstchild = TRUE;
+    res = NO_ERR;
+
+    /* the window holds the current and the next child node
+     * so val_get_next_child works while writing an array
+     */
+    chval = val_get_virtual_next(scb, val, &iter, &res);
+    if (chval) {
+        dlq_enque(chval, &windowQ);
+    }
+
+    while (chval) {
+        nextch = val_get_virtual_next(scb, val, &iter, &res);
+        if (nextch) {
+            dlq_enque(nextch, &windowQ);
+        }
+
+        lastchild = (nextch && !xml_strcmp(nextch->name, chval->name))
+            ? FALSE : TRUE;
+
+        res = write_full_check_val(scb,
+                                   msg,
+                                   chval,
+                                   indent,
+                                   testfn,
+                                   firstchild && lastchild,
+                                   FALSE,
+                                   firstchild);
+
+        if (res == NO_ERR && nextch) {
+            ses_putchar(scb, ',');
+            if (indent >= 0 &&
+                (typ_is_simple(nextch->btyp) ||
+                 xml_strcmp(nextch->name, chval->name))) {
+                ses_indent(scb, indent);
+                ses_putchar(scb, ' ');
+            }
+        }
+
+        firstchild = lastchild;
+        dlq_remove(chval);
+        val_free_value(chval);
+        chval = nextch;
+    }
+
+    val_get_virtual_done(scb, val, &iter);
+
+}  /* write_stream_children */
+
+
 /********************************************************************
 * FUNCTION write_full_check_val
 * 
@@ -120,7 +213,13 @@ static status_t
     boolean            malloced = FALSE;
     status_t           res = NO_ERR;
 
-    out = val_get_value(scb, msg, val, testfn, TRUE, &malloced, &res);
+    if (val_is_virtual_stream(val)) {
+        /* the child nodes are written as they are retrieved */
+        out = (val_output_allowed(scb, msg, val, testfn, TRUE))
+            ? val : NULL;
+    } else {
+        out = val_get_value(scb, msg, val, testfn, TRUE, &malloced, &res);
+    }
 
     if (!out || res != NO_ERR) {
         if (res == ERR_NCX_SKIPPED) {
@@ -143,8 +242,7 @@ static status_t
             /* write the name of the node */
             ses_putchar(scb, '"');
             ses_putjstr(scb, out->name, -1);
-            ses_putchar(scb, '"');
-            ses_putchar(scb, ':');
+            ses_putbytes(scb, (const xmlChar *)"\":", 2);
 
             switch (out->btyp) {
             case NCX_BT_EXTERN:
@@ -196,8 +294,7 @@ static status_t
         if (isfirstchild) {
             ses_putchar(scb, '"');
             ses_putjstr(scb, out->name, -1);
-            ses_putchar(scb, '"');
-            ses_putchar(scb, ':');
+            ses_putbytes(scb, (const xmlChar *)"\":", 2);
 
             if (!justone) {
                 ses_putchar(scb, '[');
@@ -208,9 +305,14 @@ static status_t
         ses_indent(scb, indent);
         ses_putchar(scb, '{');
 
-        for (chval = val_get_first_child(out); 
-             chval != NULL; 
-             chval = nextch) {
+        if (val_is_virtual_stream(out)) {
+            write_stream_children(scb, msg, out, indent, testfn);
+            chval = NULL;
+        } else {
+            chval = val_get_first_child(out);
+        }
+
+        for (; chval != NULL; chval = nextch) {
 
             /* JSON ignores XML namespaces, so foo:a and bar:a
              * are both encoded in the same array
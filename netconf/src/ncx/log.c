@@ -20,6 +20,7 @@
 date         init     comment
 ----------------------------------------------------------------------
 08jan06      abb      begun, borrowed from openssh code
+17oct26               add async logging mode
 
 *********************************************************************
 *                                                                   *
@@ -27,6 +28,10 @@ date         init     comment
 *                                                                   *
 *********************************************************************/
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "procdefs.h"
 #include "log.h"
@@ -44,6 +49,48 @@ date         init     comment
 
 /* #define LOG_DEBUG_TRACE 1 */
 
+/* destinations of the records in an async log ring */
+#define LOG_DEST_LOG     0          /* logfile, or STDOUT if not open */
+#define LOG_DEST_AUDIT   1
+#define LOG_DEST_ALT     2
+
+/* record header length in marker for skipping to the ring start */
+#define LOG_REC_WRAP     0xffffffff
+
+/* ring records are aligned to the header size */
+#define LOG_REC_ALIGN(L) (((L) + 7) & ~7)
+
+/* formatted messages up to this size use a stack buffer */
+#define LOG_FMT_BUFFSIZE  512
+
+
+/********************************************************************
+*                                                                   *
+*                             T Y P E S                             *
+*                                                                   *
+*********************************************************************/
+
+/* header of one message in an async log ring */
+typedef struct log_rec_t_ {
+    uint32   len;                   /* message length or LOG_REC_WRAP */
+    uint32   dest;                            /* LOG_DEST_* value */
+} log_rec_t;
+
+
+/* per-thread async log ring
+ * The thread that owns the ring is the only producer and
+ * moves head; the consumer holds async_lock and moves tail.
+ * Both are free-running counters; offset is (pos % size)
+ */
+typedef struct log_ring_t_ {
+    struct log_ring_t_  *next;
+    uint32               head;               /* producer position */
+    uint32               tail;               /* consumer position */
+    uint32               dropped;      /* messages dropped if full */
+    uint32               reported;    /* dropped count already logged */
+    unsigned char       *buff;              /* LOG_ASYNC_RING_SIZE */
+} log_ring_t;
+
 /********************************************************************
 *                                                                   *
 *                       V A R I A B L E S                           *
@@ -65,6 +112,357 @@ static FILE *altlogfile = NULL;
 
 static FILE *auditlogfile = NULL;
 
+/* async logging mode state; async_lock is held by the
+ * writer thread while it drains the rings, and by any
+ * other thread that drains them synchronously
+ */
+static boolean          async_active;
+
+static boolean          async_stop;
+
+static uint32           async_gen;
+
+static log_ring_t      *async_ringQ;
+
+static pthread_t        async_thread;
+
+static pthread_mutex_t  async_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t   async_cond = PTHREAD_COND_INITIALIZER;
+
+/* ring of the current thread, valid if my_ring_gen == async_gen */
+static __thread log_ring_t  *my_ring;
+
+static __thread uint32       my_ring_gen;
+
+
+/********************************************************************
+* FUNCTION get_my_ring
+*
+* Get the async log ring of the calling thread
+* A new ring is added to async_ringQ the first time
+*
+* RETURNS:
+*   pointer to the ring, or NULL if malloc failed
+*********************************************************************/
+static log_ring_t *
+    get_my_ring (void)
+{
+    log_ring_t  *ring;
+
+    if (my_ring && my_ring_gen == async_gen) {
+        return my_ring;
+    }
+
+    /* plain malloc: the ring may be freed by another thread */
+    ring = calloc(1, sizeof(log_ring_t));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->buff = malloc(LOG_ASYNC_RING_SIZE);
+    if (ring->buff == NULL) {
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&async_lock);
+    ring->next = async_ringQ;
+    async_ringQ = ring;
+    pthread_mutex_unlock(&async_lock);
+
+    my_ring = ring;
+    my_ring_gen = async_gen;
+    return ring;
+
+}  /* get_my_ring */
+
+
+/********************************************************************
+* FUNCTION async_put
+*
+* Format a message into the async log ring of this thread
+* The message is dropped and counted if the ring is full
+*
+* INPUTS:
+*   dest == LOG_DEST_* destination
+*   fstr == format string in printf format
+*   args == additional arguments for printf
+*
+*********************************************************************/
+static void
+    async_put (uint32 dest,
+               const char *fstr,
+               va_list args)
+{
+    log_ring_t     *ring;
+    log_rec_t      *rec;
+    char            fmtbuff[LOG_FMT_BUFFSIZE];
+    char           *msg;
+    va_list         args2;
+    uint32          head, tail, offset, endlen, reclen, used;
+    int             len;
+
+    ring = get_my_ring();
+    if (ring == NULL) {
+        return;
+    }
+
+    va_copy(args2, args);
+    len = vsnprintf(fmtbuff, sizeof(fmtbuff), fstr, args);
+    msg = fmtbuff;
+    if (len >= (int)sizeof(fmtbuff) &&
+        len < LOG_ASYNC_RING_SIZE / 2) {
+        msg = malloc(len + 1);
+        if (msg != NULL) {
+            vsnprintf(msg, len + 1, fstr, args2);
+        }
+    }
+    va_end(args2);
+
+    if (len <= 0) {
+        return;
+    }
+    if (msg == NULL || len >= LOG_ASYNC_RING_SIZE / 2) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1,
+                         __ATOMIC_RELAXED);
+        return;
+    }
+
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    used = head - tail;
+    offset = head % LOG_ASYNC_RING_SIZE;
+    endlen = LOG_ASYNC_RING_SIZE - offset;
+    reclen = LOG_REC_ALIGN(sizeof(log_rec_t) + (uint32)len);
+
+    if (reclen > endlen) {
+        /* skip the rest of the ring and start over */
+        if (used + endlen + reclen > LOG_ASYNC_RING_SIZE) {
+            __atomic_store_n(&ring->dropped, ring->dropped + 1,
+                             __ATOMIC_RELAXED);
+            if (msg != fmtbuff) {
+                free(msg);
+            }
+            return;
+        }
+        rec = (log_rec_t *)&ring->buff[offset];
+        rec->len = LOG_REC_WRAP;
+        rec->dest = dest;
+        head += endlen;
+        used += endlen;
+        offset = 0;
+    } else if (used + reclen > LOG_ASYNC_RING_SIZE) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1,
+                         __ATOMIC_RELAXED);
+        if (msg != fmtbuff) {
+            free(msg);
+        }
+        return;
+    }
+
+    rec = (log_rec_t *)&ring->buff[offset];
+    rec->len = (uint32)len;
+    rec->dest = dest;
+    memcpy(&ring->buff[offset + sizeof(log_rec_t)], msg, len);
+    if (msg != fmtbuff) {
+        free(msg);
+    }
+
+    __atomic_store_n(&ring->head, head + reclen, __ATOMIC_RELEASE);
+
+    /* wake up the writer early if the ring is getting full */
+    if (used < LOG_ASYNC_RING_SIZE / 2 &&
+        used + reclen >= LOG_ASYNC_RING_SIZE / 2) {
+        pthread_cond_signal(&async_cond);
+    }
+
+}  /* async_put */
+
+
+/********************************************************************
+* FUNCTION get_dest_file
+*
+* Get the FILE for an async log record destination
+*
+* INPUTS:
+*   dest == LOG_DEST_* destination
+*
+* RETURNS:
+*   pointer to the open FILE, or NULL if it is closed
+*********************************************************************/
+static FILE *
+    get_dest_file (uint32 dest)
+{
+    switch (dest) {
+    case LOG_DEST_LOG:
+        return (logfile) ? logfile : stdout;
+    case LOG_DEST_AUDIT:
+        return auditlogfile;
+    case LOG_DEST_ALT:
+        return altlogfile;
+    default:
+        return NULL;
+    }
+
+}  /* get_dest_file */
+
+
+/********************************************************************
+* FUNCTION async_drain
+*
+* Write all the queued async log records and flush the files
+* async_lock must be held by the caller
+*
+*********************************************************************/
+static void
+    async_drain (void)
+{
+    log_ring_t     *ring;
+    log_rec_t      *rec;
+    FILE           *fp;
+    uint32          head, tail, offset, dropped;
+    boolean         dirty[LOG_DEST_ALT+1];
+    uint32          dest;
+
+    memset(dirty, 0x0, sizeof(dirty));
+
+    for (ring = async_ringQ; ring != NULL; ring = ring->next) {
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        tail = ring->tail;
+
+        while (tail != head) {
+            offset = tail % LOG_ASYNC_RING_SIZE;
+            rec = (log_rec_t *)&ring->buff[offset];
+            if (rec->len == LOG_REC_WRAP) {
+                tail += LOG_ASYNC_RING_SIZE - offset;
+                continue;
+            }
+            fp = get_dest_file(rec->dest);
+            if (fp != NULL) {
+                fwrite(&ring->buff[offset + sizeof(log_rec_t)],
+                       1, rec->len, fp);
+                dirty[rec->dest] = TRUE;
+            }
+            tail += LOG_REC_ALIGN(sizeof(log_rec_t) + rec->len);
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        if (dropped != ring->reported) {
+            fp = get_dest_file(LOG_DEST_LOG);
+            fprintf(fp, "\n*** log: %u messages dropped ***\n",
+                    dropped - ring->reported);
+            dirty[LOG_DEST_LOG] = TRUE;
+            ring->reported = dropped;
+        }
+    }
+
+    for (dest = 0; dest <= LOG_DEST_ALT; dest++) {
+        if (dirty[dest]) {
+            fp = get_dest_file(dest);
+            if (fp != NULL) {
+                fflush(fp);
+            }
+        }
+    }
+
+}  /* async_drain */
+
+
+/********************************************************************
+* FUNCTION async_sync
+*
+* Write out all queued async log records now
+* Used before a log file is closed or used directly
+*
+*********************************************************************/
+static void
+    async_sync (void)
+{
+    if (!async_active) {
+        return;
+    }
+
+    pthread_mutex_lock(&async_lock);
+    async_drain();
+    pthread_mutex_unlock(&async_lock);
+
+}  /* async_sync */
+
+
+/********************************************************************
+* FUNCTION async_writer
+*
+* Background thread that writes the async log rings to the files
+* The rings are drained in one batch each time, every
+* LOG_ASYNC_FLUSH_MSEC or when a ring is half full
+*
+* INPUTS:
+*   arg == not used
+*
+* RETURNS:
+*   NULL
+*********************************************************************/
+static void *
+    async_writer (void *arg)
+{
+    struct timespec  ts;
+
+    (void)arg;
+
+    pthread_mutex_lock(&async_lock);
+    while (!async_stop) {
+        async_drain();
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += (long)LOG_ASYNC_FLUSH_MSEC * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec += ts.tv_nsec / 1000000000L;
+            ts.tv_nsec %= 1000000000L;
+        }
+        pthread_cond_timedwait(&async_cond, &async_lock, &ts);
+    }
+    async_drain();
+    pthread_mutex_unlock(&async_lock);
+
+    return NULL;
+
+}  /* async_writer */
+
+
+/********************************************************************
+* FUNCTION log_output
+*
+* Write a log message to a destination
+* In async mode the message is queued for the writer thread;
+* otherwise it is written and flushed right away
+*
+* INPUTS:
+*   dest == LOG_DEST_* destination
+*   fstr == format string in printf format
+*   args == additional arguments for printf
+*
+*********************************************************************/
+static void
+    log_output (uint32 dest,
+                const char *fstr,
+                va_list args)
+{
+    FILE  *fp;
+
+    if (async_active) {
+        async_put(dest, fstr, args);
+        return;
+    }
+
+    fp = get_dest_file(dest);
+    if (fp != NULL) {
+        vfprintf(fp, fstr, args);
+        fflush(fp);
+    }
+
+}  /* log_output */
+
 
 /********************************************************************
 * FUNCTION log_open
@@ -137,6 +535,8 @@ void
 {
     xmlChar buff[TSTAMP_MIN_SIZE];
 
+    log_async_stop();
+
     if (!logfile) {
         return;
     }
@@ -227,6 +627,9 @@ void
         return;
     }
 
+    async_sync();
+    pthread_mutex_lock(&async_lock);
+
     if (use_audit_tstamps) {
         tstamp_datetime(buff);
         fprintf(auditlogfile, "\n*** audit log close at %s ***\n", buff);
@@ -234,6 +637,7 @@ void
 
     fclose(auditlogfile);
     auditlogfile = NULL;
+    pthread_mutex_unlock(&async_lock);
 
 }  /* log_audit_close */
 
@@ -309,8 +713,11 @@ void
         return;
     }
 
+    async_sync();
+    pthread_mutex_lock(&async_lock);
     fclose(altlogfile);
     altlogfile = NULL;
+    pthread_mutex_unlock(&async_lock);
 
 }  /* log_alt_close */
 
@@ -336,6 +743,8 @@ void
         return;
     }
 
+    async_sync();
+
     va_start(args, fstr);
     vprintf(fstr, args);
     fflush(stdout);
@@ -365,13 +774,7 @@ void
 
     va_start(args, fstr);
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    log_output(LOG_DEST_LOG, fstr, args);
 
     va_end(args);
 
@@ -396,8 +799,7 @@ void
     va_start(args, fstr);
 
     if (auditlogfile != NULL) {
-        vfprintf(auditlogfile, fstr, args);
-        fflush(auditlogfile);
+        log_output(LOG_DEST_AUDIT, fstr, args);
     }
 
     va_end(args);
@@ -423,8 +825,7 @@ void
     va_start(args, fstr);
 
     if (altlogfile) {
-        vfprintf(altlogfile, fstr, args);
-        fflush(altlogfile);
+        log_output(LOG_DEST_ALT, fstr, args);
     }
 
     va_end(args);
@@ -472,13 +873,14 @@ void vlog_error (const char *fstr, va_list args )
         return;
     }
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    /* errors are never dropped or left queued in async mode:
+     * make room in the ring first, then write it out right away
+     * in case the server is about to crash
+     */
+    async_sync();
+    log_output(LOG_DEST_LOG, fstr, args);
+    async_sync();
+
 }  /* log_error */
 
 /********************************************************************
@@ -523,13 +925,7 @@ void
 
     va_start(args, fstr);
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    log_output(LOG_DEST_LOG, fstr, args);
 
     va_end(args);
 
@@ -557,13 +953,7 @@ void
 
     va_start(args, fstr);
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    log_output(LOG_DEST_LOG, fstr, args);
 
     va_end(args);
 
@@ -591,13 +981,7 @@ void
 
     va_start(args, fstr);
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    log_output(LOG_DEST_LOG, fstr, args);
 
     va_end(args);
 
@@ -625,13 +1009,7 @@ void
 
     va_start(args, fstr);
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    log_output(LOG_DEST_LOG, fstr, args);
 
     va_end(args);
 
@@ -659,13 +1037,7 @@ void
 
     va_start(args, fstr);
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    log_output(LOG_DEST_LOG, fstr, args);
 
     va_end(args);
 
@@ -693,13 +1065,7 @@ void
 
     va_start(args, fstr);
 
-    if (logfile) {
-        vfprintf(logfile, fstr, args);
-        fflush(logfile);
-    } else {
-        vprintf(fstr, args);
-        fflush(stdout);
-    }
+    log_output(LOG_DEST_LOG, fstr, args);
 
     va_end(args);
 
@@ -931,9 +1297,99 @@ void
 FILE *
     log_get_logfile (void)
 {
+    /* the caller writes to the file directly */
+    async_sync();
     return logfile;
 
 }  /* log_get_logfile */
 
 
+/********************************************************************
+* FUNCTION log_async_start
+* 
+* Switch to async logging mode
+* The log messages are formatted into a ring buffer of the
+* calling thread and written out by a background thread
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    log_async_start (void)
+{
+    int  ret;
+
+    if (async_active) {
+        return NO_ERR;
+    }
+
+    async_gen++;
+    async_stop = FALSE;
+    if (get_my_ring() == NULL) {
+        return ERR_INTERNAL_MEM;
+    }
+
+    ret = pthread_create(&async_thread, NULL, async_writer, NULL);
+    if (ret != 0) {
+        log_async_stop();
+        return ERR_NCX_OPERATION_FAILED;
+    }
+
+    async_active = TRUE;
+    return NO_ERR;
+
+}  /* log_async_start */
+
+
+/********************************************************************
+* FUNCTION log_async_stop
+* 
+* Write out all queued messages and go back to
+* synchronous logging mode
+* No other threads may be logging at this time
+*
+*********************************************************************/
+void
+    log_async_stop (void)
+{
+    log_ring_t  *ring;
+
+    if (async_active) {
+        pthread_mutex_lock(&async_lock);
+        async_stop = TRUE;
+        pthread_cond_signal(&async_cond);
+        pthread_mutex_unlock(&async_lock);
+        pthread_join(async_thread, NULL);
+        async_active = FALSE;
+    }
+
+    pthread_mutex_lock(&async_lock);
+    while (async_ringQ != NULL) {
+        ring = async_ringQ;
+        async_ringQ = ring->next;
+        free(ring->buff);
+        free(ring);
+    }
+    async_gen++;
+    pthread_mutex_unlock(&async_lock);
+
+}  /* log_async_stop */
+
+
+/********************************************************************
+* FUNCTION log_async_is_active
+* 
+* Check if async logging mode is active
+*
+* RETURNS:
+*   TRUE if async logging is active; FALSE otherwise
+*********************************************************************/
+boolean
+    log_async_is_active (void)
+{
+    return async_active;
+
+}  /* log_async_is_active */
+
+
 /* END file log.c */
@@ -28,6 +28,7 @@
 date	     init     comment
 ----------------------------------------------------------------------
 08-jan-06    abb      begun
+17-oct-26             add async logging mode
 */
 
 #include <stdio.h>
@@ -65,6 +66,16 @@ extern "C" {
 #define LOG_DEBUG_STR_DEBUG3  (const xmlChar *)"debug3"
 #define LOG_DEBUG_STR_DEBUG4  (const xmlChar *)"debug4"
 
+/* async logging mode: size of the ring buffer of each thread;
+ * must be a power of 2; messages are dropped if it is full
+ */
+#define LOG_ASYNC_RING_SIZE   0x100000
+
+/* async logging mode: the writer thread writes out
+ * and flushes the queued messages this often
+ */
+#define LOG_ASYNC_FLUSH_MSEC  100
+
 /********************************************************************
 *                                                                   *
 *                            T Y P E S                              *
@@ -514,6 +525,44 @@ extern void
 extern FILE *
     log_get_logfile (void);
 
+
+/********************************************************************
+* FUNCTION log_async_start
+* 
+* Switch to async logging mode
+* The log messages are formatted into a ring buffer of the
+* calling thread and written out by a background thread
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    log_async_start (void);
+
+
+/********************************************************************
+* FUNCTION log_async_stop
+* 
+* Write out all queued messages and go back to
+* synchronous logging mode
+* No other threads may be logging at this time
+*
+*********************************************************************/
+extern void
+    log_async_stop (void);
+
+
+/********************************************************************
+* FUNCTION log_async_is_active
+* 
+* Check if async logging mode is active
+*
+* RETURNS:
+*   TRUE if async logging is active; FALSE otherwise
+*********************************************************************/
+extern boolean
+    log_async_is_active (void);
+
 #ifdef __cplusplus
 }  /* end extern 'C' */
 #endif
@@ -22,6 +22,7 @@ date         init     comment
 30oct05      abb      begun
 30oct07      abb      change identifier separator from '.' to '/'
                       and change valid identifier chars to match YANG
+17oct26               init and cleanup the ncx_regex pattern cache
 
 *********************************************************************
 *                                                                   *
@@ -64,6 +65,7 @@ date         init     comment
 #include "ncx_feature.h"
 #include "ncx_list.h"
 #include "ncx_num.h"
+#include "ncx_regex.h"
 #include "ncxconst.h"
 #include "ncxmod.h"
 #include "obj.h"
@@ -930,6 +932,7 @@ status_t
     warn_idlen = NCX_DEF_WARN_IDLEN;
     warn_linelen = NCX_DEF_WARN_LINELEN;
     ncx_feature_init();
+    ncx_regex_init();
 
     mod_load_callback = NULL;
     log_set_debug_level(dlevel);
@@ -1206,6 +1209,7 @@ void
     top_cleanup();
     runstack_cleanup();
     ncxmod_cleanup();
+    ncx_regex_cleanup();
     xmlCleanupParser();
     status_cleanup();
 
@@ -3496,6 +3500,12 @@ void
         ncx_free_filptr(fp);
     }
 
+    /* a partial subtree get result is owned by the filter */
+    if (filptr->virtualnode &&
+        val_is_virtual_partial(filptr->virtualnode)) {
+        val_free_value(filptr->virtualnode);
+    }
+
     /* check if this entry should be put in the cache */
     if (ncx_cur_filptrs < ncx_max_filptrs) {
         memset(filptr, 0x0, sizeof(ncx_filptr_t));
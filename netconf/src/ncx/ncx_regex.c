@@ -0,0 +1,588 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*  FILE: ncx_regex.c
+
+
+*********************************************************************
+*                                                                   *
+*                  C H A N G E   H I S T O R Y                      *
+*                                                                   *
+*********************************************************************
+
+date         init     comment
+----------------------------------------------------------------------
+17oct26               begun
+
+*********************************************************************
+*                                                                   *
+*                     I N C L U D E    F I L E S                    *
+*                                                                   *
+*********************************************************************/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmlstring.h>
+#include <xmlregexp.h>
+
+#ifdef WITH_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#endif
+
+#include "procdefs.h"
+#include "bobhash.h"
+#include "dlq.h"
+#include "log.h"
+#include "ncx_regex.h"
+#include "status.h"
+#include "xml_util.h"
+
+
+/********************************************************************
+*                                                                   *
+*                       V A R I A B L E S                           *
+*                                                                   *
+*********************************************************************/
+
+static boolean          ncx_regex_init_done = FALSE;
+
+static ncx_regex_t     *regex_buckets[NCX_REGEX_HASHSIZE];
+
+/* Q of ncx_regex_t with refcnt == 0, oldest first */
+static dlq_hdr_t        idleQ;
+
+static uint32           idlecnt;
+
+static pthread_mutex_t  regex_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef WITH_PCRE2
+/* match data for the calling thread; only the start and end
+ * offsets of the whole match are ever used
+ */
+static __thread pcre2_match_data  *my_match_data;
+#endif
+
+
+#ifdef WITH_PCRE2
+/********************************************************************
+* FUNCTION translate_pattern
+*
+* Translate an XSD regex into an equivalent PCRE2 pattern
+* The XSD regex must already have been compiled OK by libxml2
+*
+* Only the constructs that mean the same thing in both syntaxes
+* are translated.  Anything else, such as character class
+* subtraction, \i, \c, \w or \p{IsBlock}, returns NULL so
+* the pattern only uses libxml2
+*
+* INPUTS:
+*    pat_str == XSD regex pattern string
+*
+* RETURNS:
+*    malloced PCRE2 pattern or NULL if not translated
+*********************************************************************/
+static xmlChar *
+    translate_pattern (const xmlChar *pat_str)
+{
+    const xmlChar  *p;
+    xmlChar        *buff, *q;
+    boolean         inclass;
+
+    /* the longest output for 1 input char is 9 bytes */
+    buff = m__getMem(xml_strlen(pat_str) * 9 + 16);
+    if (!buff) {
+        return NULL;
+    }
+
+    q = buff;
+    q += xml_strcpy(q, (const xmlChar *)"(?:");
+    inclass = FALSE;
+
+    for (p = pat_str; *p; p++) {
+        if (*p == '\\') {
+            p++;
+            switch (*p) {
+            case '\0':
+                m__free(buff);
+                return NULL;
+            case 's':
+                q += xml_strcpy(q, (inclass) ?
+                                (const xmlChar *)" \\t\\n\\r" :
+                                (const xmlChar *)"[ \\t\\n\\r]");
+                continue;
+            case 'S':
+                if (inclass) {
+                    m__free(buff);
+                    return NULL;
+                }
+                q += xml_strcpy(q, (const xmlChar *)"[^ \\t\\n\\r]");
+                continue;
+            case 'w':
+            case 'W':
+            case 'i':
+            case 'I':
+            case 'c':
+            case 'C':
+                m__free(buff);
+                return NULL;
+            case 'p':
+            case 'P':
+                /* general categories are the same; blocks are not */
+                if (p[1] == '{' && p[2] == 'I' && p[3] == 's') {
+                    m__free(buff);
+                    return NULL;
+                }
+                break;
+            default:
+                ;
+            }
+            *q++ = '\\';
+            *q++ = *p;
+            continue;
+        }
+
+        if (inclass) {
+            switch (*p) {
+            case '-':
+                if (p[1] == '[') {
+                    /* XSD class subtraction */
+                    m__free(buff);
+                    return NULL;
+                }
+                *q++ = *p;
+                break;
+            case '[':
+                /* keep PCRE2 from seeing a [:posix:] class */
+                *q++ = '\\';
+                *q++ = *p;
+                break;
+            case ']':
+                inclass = FALSE;
+                *q++ = *p;
+                break;
+            default:
+                *q++ = *p;
+            }
+            continue;
+        }
+
+        switch (*p) {
+        case '[':
+            inclass = TRUE;
+            *q++ = *p;
+            if (p[1] == '^') {
+                *q++ = *++p;
+            }
+            break;
+        case '^':
+        case '$':
+            /* anchors in PCRE2, plain chars in XSD */
+            *q++ = '\\';
+            *q++ = *p;
+            break;
+        case '.':
+            q += xml_strcpy(q, (const xmlChar *)"[^\\n\\r]");
+            break;
+        case '*':
+        case '+':
+        case '?':
+        case '}':
+            if (p[1] == '+') {
+                /* possessive quantifier in PCRE2 */
+                m__free(buff);
+                return NULL;
+            }
+            *q++ = *p;
+            break;
+        default:
+            *q++ = *p;
+        }
+    }
+
+    q += xml_strcpy(q, (const xmlChar *)")\\z");
+    return buff;
+
+}  /* translate_pattern */
+
+
+/********************************************************************
+* FUNCTION compile_fastregex
+*
+* Compile the PCRE2 version of a pattern if possible
+*
+* INPUTS:
+*    regex == pattern entry to fill in
+*
+* OUTPUTS:
+*    regex->fastregex set if the pattern could be translated
+*********************************************************************/
+static void
+    compile_fastregex (ncx_regex_t *regex)
+{
+    pcre2_code   *code;
+    xmlChar      *pcre_str;
+    PCRE2_SIZE    erroffset;
+    int           errcode;
+
+    pcre_str = translate_pattern(regex->pat_str);
+    if (!pcre_str) {
+        if (LOGDEBUG3) {
+            log_debug3("\nncx_regex: libxml2 only for '%s'",
+                       regex->pat_str);
+        }
+        return;
+    }
+
+    code = pcre2_compile((PCRE2_SPTR)pcre_str, PCRE2_ZERO_TERMINATED,
+                         PCRE2_ANCHORED | PCRE2_UTF | PCRE2_UCP,
+                         &errcode, &erroffset, NULL);
+    if (code) {
+        /* the interpreter is still used if JIT is not available */
+        (void)pcre2_jit_compile(code, PCRE2_JIT_COMPLETE);
+        regex->fastregex = code;
+    } else if (LOGDEBUG3) {
+        log_debug3("\nncx_regex: PCRE2 error %d for '%s'",
+                   errcode, pcre_str);
+    }
+
+    m__free(pcre_str);
+
+}  /* compile_fastregex */
+#endif
+
+
+/********************************************************************
+* FUNCTION free_regex
+*
+* Free a compiled pattern entry
+*
+* INPUTS:
+*    regex == entry to free; must not be in any Q or hash chain
+*********************************************************************/
+static void
+    free_regex (ncx_regex_t *regex)
+{
+#ifdef WITH_PCRE2
+    if (regex->fastregex) {
+        pcre2_code_free((pcre2_code *)regex->fastregex);
+    }
+#endif
+    if (regex->xmlregex) {
+        xmlRegFreeRegexp(regex->xmlregex);
+    }
+    if (regex->pat_str) {
+        m__free(regex->pat_str);
+    }
+    m__free(regex);
+
+}  /* free_regex */
+
+
+/********************************************************************
+* FUNCTION new_regex
+*
+* Compile a pattern into a new entry
+*
+* INPUTS:
+*    pat_str == XSD regex pattern string
+*    hash == hash value for pat_str
+*    res == address of return status
+*
+* OUTPUTS:
+*    *res == return status
+*
+* RETURNS:
+*    malloced entry or NULL if error
+*********************************************************************/
+static ncx_regex_t *
+    new_regex (const xmlChar *pat_str,
+               uint32 hash,
+               status_t *res)
+{
+    ncx_regex_t  *regex;
+
+    regex = m__getObj(ncx_regex_t);
+    if (!regex) {
+        *res = ERR_INTERNAL_MEM;
+        return NULL;
+    }
+    memset(regex, 0x0, sizeof(ncx_regex_t));
+    regex->hash = hash;
+
+    regex->pat_str = xml_strdup(pat_str);
+    if (!regex->pat_str) {
+        free_regex(regex);
+        *res = ERR_INTERNAL_MEM;
+        return NULL;
+    }
+
+    regex->xmlregex = xmlRegexpCompile(pat_str);
+    if (!regex->xmlregex) {
+        free_regex(regex);
+        *res = ERR_NCX_INVALID_PATTERN;
+        return NULL;
+    }
+
+#ifdef WITH_PCRE2
+    compile_fastregex(regex);
+#endif
+
+    *res = NO_ERR;
+    return regex;
+
+}  /* new_regex */
+
+
+/********************************************************************
+* FUNCTION unlink_regex
+*
+* Remove an entry from its hash chain
+*
+* INPUTS:
+*    regex == entry to remove
+*********************************************************************/
+static void
+    unlink_regex (ncx_regex_t *regex)
+{
+    ncx_regex_t  **prev;
+
+    for (prev = &regex_buckets[regex->hash & (NCX_REGEX_HASHSIZE - 1)];
+         *prev != NULL;
+         prev = &(*prev)->hashnext) {
+        if (*prev == regex) {
+            *prev = regex->hashnext;
+            regex->hashnext = NULL;
+            return;
+        }
+    }
+
+}  /* unlink_regex */
+
+
+/**************    E X T E R N A L   F U N C T I O N S  ************/
+
+
+/********************************************************************
+* FUNCTION ncx_regex_init
+*
+* Initialize the compiled pattern cache
+*
+*********************************************************************/
+void
+    ncx_regex_init (void)
+{
+    if (ncx_regex_init_done) {
+        return;
+    }
+    memset(regex_buckets, 0x0, sizeof(regex_buckets));
+    dlq_createSQue(&idleQ);
+    idlecnt = 0;
+    ncx_regex_init_done = TRUE;
+
+}  /* ncx_regex_init */
+
+
+/********************************************************************
+* FUNCTION ncx_regex_cleanup
+*
+* Free all the compiled patterns in the cache
+*
+*********************************************************************/
+void
+    ncx_regex_cleanup (void)
+{
+    ncx_regex_t  *regex;
+    uint32        i;
+
+    if (!ncx_regex_init_done) {
+        return;
+    }
+
+    for (i = 0; i < NCX_REGEX_HASHSIZE; i++) {
+        while (regex_buckets[i] != NULL) {
+            regex = regex_buckets[i];
+            regex_buckets[i] = regex->hashnext;
+            if (regex->refcnt) {
+                log_debug2("\nncx_regex: '%s' still in use",
+                           regex->pat_str);
+            }
+            free_regex(regex);
+        }
+    }
+    dlq_createSQue(&idleQ);
+    idlecnt = 0;
+
+#ifdef WITH_PCRE2
+    if (my_match_data) {
+        pcre2_match_data_free(my_match_data);
+        my_match_data = NULL;
+    }
+#endif
+
+    ncx_regex_init_done = FALSE;
+
+}  /* ncx_regex_cleanup */
+
+
+/********************************************************************
+* FUNCTION ncx_regex_get
+*
+* Get the compiled pattern for a pattern string
+* The pattern is compiled and added to the cache if needed
+* Each call must be matched by a call to ncx_regex_release
+*
+* INPUTS:
+*    pat_str == XSD regex pattern string
+*    res == address of return status
+*
+* OUTPUTS:
+*    *res == NO_ERR, ERR_NCX_INVALID_PATTERN or ERR_INTERNAL_MEM
+*
+* RETURNS:
+*    pointer to the shared compiled pattern or NULL if error
+*********************************************************************/
+ncx_regex_t *
+    ncx_regex_get (const xmlChar *pat_str,
+                   status_t *res)
+{
+    ncx_regex_t  *regex;
+    uint32        hash, bucket;
+
+#ifdef DEBUG
+    if (!pat_str || !res) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return NULL;
+    }
+#endif
+
+    if (!ncx_regex_init_done) {
+        ncx_regex_init();
+    }
+
+    hash = bobhash((const ub1 *)pat_str, xml_strlen(pat_str), 0);
+    bucket = hash & (NCX_REGEX_HASHSIZE - 1);
+
+    pthread_mutex_lock(&regex_lock);
+
+    for (regex = regex_buckets[bucket];
+         regex != NULL;
+         regex = regex->hashnext) {
+        if (regex->hash == hash && !xml_strcmp(regex->pat_str, pat_str)) {
+            if (regex->refcnt++ == 0) {
+                dlq_remove(regex);
+                idlecnt--;
+            }
+            pthread_mutex_unlock(&regex_lock);
+            *res = NO_ERR;
+            return regex;
+        }
+    }
+
+    /* invalid patterns are not cached */
+    regex = new_regex(pat_str, hash, res);
+    if (regex) {
+        regex->refcnt = 1;
+        regex->hashnext = regex_buckets[bucket];
+        regex_buckets[bucket] = regex;
+    }
+
+    pthread_mutex_unlock(&regex_lock);
+    return regex;
+
+}  /* ncx_regex_get */
+
+
+/********************************************************************
+* FUNCTION ncx_regex_release
+*
+* Release a compiled pattern from ncx_regex_get
+* The pattern stays cached for a while after the last
+* user releases it
+*
+* INPUTS:
+*    regex == compiled pattern to release
+*********************************************************************/
+void
+    ncx_regex_release (ncx_regex_t *regex)
+{
+    ncx_regex_t  *oldest;
+
+#ifdef DEBUG
+    if (!regex || regex->refcnt == 0) {
+        SET_ERROR(ERR_INTERNAL_VAL);
+        return;
+    }
+#endif
+
+    pthread_mutex_lock(&regex_lock);
+
+    if (--regex->refcnt == 0) {
+        dlq_enque(regex, &idleQ);
+        if (++idlecnt > NCX_REGEX_IDLE_MAX) {
+            oldest = (ncx_regex_t *)dlq_deque(&idleQ);
+            idlecnt--;
+            unlink_regex(oldest);
+            free_regex(oldest);
+        }
+    }
+
+    pthread_mutex_unlock(&regex_lock);
+
+}  /* ncx_regex_release */
+
+
+/********************************************************************
+* FUNCTION ncx_regex_match
+*
+* Check if an entire string matches a compiled pattern
+*
+* INPUTS:
+*    regex == compiled pattern to use
+*    strval == string to check
+*
+* RETURNS:
+*    1 if the string matches
+*    0 if the string does not match
+*    < 0 if the match could not be executed
+*********************************************************************/
+int
+    ncx_regex_match (const ncx_regex_t *regex,
+                     const xmlChar *strval)
+{
+#ifdef WITH_PCRE2
+    int  ret;
+
+    if (regex->fastregex) {
+        if (!my_match_data) {
+            my_match_data = pcre2_match_data_create(1, NULL);
+        }
+        if (my_match_data) {
+            ret = pcre2_match((const pcre2_code *)regex->fastregex,
+                              (PCRE2_SPTR)strval, PCRE2_ZERO_TERMINATED,
+                              0, 0, my_match_data, NULL);
+            if (ret >= 0) {
+                return 1;
+            } else if (ret == PCRE2_ERROR_NOMATCH) {
+                return 0;
+            }
+            /* bad UTF-8 or a PCRE2 limit; let libxml2 decide */
+        }
+    }
+#endif
+
+    return xmlRegexpExec(regex->xmlregex, strval);
+
+}  /* ncx_regex_match */
+
+
+/* END ncx_regex.c */
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _H_ncx_regex
+#define _H_ncx_regex
+
+/*  FILE: ncx_regex.h
+*********************************************************************
+*								    *
+*			 P U R P O S E				    *
+*								    *
+*********************************************************************
+
+    Compiled regular expression cache for YANG patterns
+    and the XPath re-match() function
+
+    Each pattern string is compiled once and shared by every
+    user of the same string.  libxml2 is always used to compile
+    and check the XSD regex.  If built WITH_PCRE2, patterns that
+    can be translated exactly are also compiled with PCRE2 (JIT)
+    and matched with that; libxml2 is the fallback.
+
+*********************************************************************
+*								    *
+*		   C H A N G E	 H I S T O R Y			    *
+*								    *
+*********************************************************************
+
+date	     init     comment
+----------------------------------------------------------------------
+17-oct-26             Begun
+*/
+
+#include <xmlstring.h>
+#include <xmlregexp.h>
+
+#ifndef _H_dlq
+#include "dlq.h"
+#endif
+
+#ifndef _H_status
+#include "status.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/********************************************************************
+*								    *
+*			 C O N S T A N T S			    *
+*								    *
+*********************************************************************/
+
+/* number of hash buckets for the pattern table; power of 2 */
+#define NCX_REGEX_HASHSIZE     512
+
+/* max number of unused patterns kept compiled in the cache */
+#define NCX_REGEX_IDLE_MAX     128
+
+
+/********************************************************************
+*								    *
+*			     T Y P E S				    *
+*								    *
+*********************************************************************/
+
+/* 1 compiled pattern, shared by all users of the same string */
+typedef struct ncx_regex_t_ {
+    dlq_hdr_t              qhdr;       /* idle Q entry if refcnt == 0 */
+    struct ncx_regex_t_   *hashnext;
+    xmlChar               *pat_str;
+    uint32                 hash;
+    uint32                 refcnt;
+    xmlRegexpPtr           xmlregex;
+    void                  *fastregex;  /* pcre2_code * or NULL */
+} ncx_regex_t;
+
+
+/********************************************************************
+*								    *
+*			F U N C T I O N S			    *
+*								    *
+*********************************************************************/
+
+
+/********************************************************************
+* FUNCTION ncx_regex_init
+*
+* Initialize the compiled pattern cache
+*
+*********************************************************************/
+extern void
+    ncx_regex_init (void);
+
+
+/********************************************************************
+* FUNCTION ncx_regex_cleanup
+*
+* Free all the compiled patterns in the cache
+*
+*********************************************************************/
+extern void
+    ncx_regex_cleanup (void);
+
+
+/********************************************************************
+* FUNCTION ncx_regex_get
+*
+* Get the compiled pattern for a pattern string
+* The pattern is compiled and added to the cache if needed
+* Each call must be matched by a call to ncx_regex_release
+*
+* INPUTS:
+*    pat_str == XSD regex pattern string
+*    res == address of return status
+*
+* OUTPUTS:
+*    *res == NO_ERR, ERR_NCX_INVALID_PATTERN or ERR_INTERNAL_MEM
+*
+* RETURNS:
+*    pointer to the shared compiled pattern or NULL if error
+*********************************************************************/
+extern ncx_regex_t *
+    ncx_regex_get (const xmlChar *pat_str,
+                   status_t *res);
+
+
+/********************************************************************
+* FUNCTION ncx_regex_release
+*
+* Release a compiled pattern from ncx_regex_get
+* The pattern stays cached for a while after the last
+* user releases it
+*
+* INPUTS:
+*    regex == compiled pattern to release
+*********************************************************************/
+extern void
+    ncx_regex_release (ncx_regex_t *regex);
+
+
+/********************************************************************
+* FUNCTION ncx_regex_match
+*
+* Check if an entire string matches a compiled pattern
+*
+* INPUTS:
+*    regex == compiled pattern to use
+*    strval == string to check
+*
+* RETURNS:
+*    1 if the string matches
+*    0 if the string does not match
+*    < 0 if the match could not be executed
+*********************************************************************/
+extern int
+    ncx_regex_match (const ncx_regex_t *regex,
+                     const xmlChar *strval);
+
+#ifdef __cplusplus
+}  /* end extern 'C' */
+#endif
+
+#endif	    /* _H_ncx_regex */
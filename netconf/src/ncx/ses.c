@@ -66,6 +66,17 @@ date         init     comment
 #define AMPSTR    (const xmlChar *)"&amp;"
 #define QSTR      (const xmlChar *)"&quot;"
 
+#define LTSTR_LEN     4
+#define GTSTR_LEN     4
+#define AMPSTR_LEN    5
+#define QSTR_LEN      6
+
+/* max indent written by ses_indent */
+#define MAX_INDENT    255
+
+/* read size used by ses_put_extern */
+#define EXTERN_BUFFSIZE  1024
+
 /* used by yangcli to read in between stdin polling */
 #define MAX_READ_TRIES   500
 
@@ -149,7 +160,7 @@ static status_t
 
     /* make sure there is a current buffer to use */
     buff = (ses_msg_buff_t *)dlq_lastEntry(&msg->buffQ);
-    if (buff == NULL || buff->bufflen == SES_MSG_BUFFSIZE) {
+    if (buff == NULL || buff->bufflen == buff->buffsize) {
         /* need a new buffer */
         res = ses_msg_new_buff(scb,
                                FALSE,  /* outbuff */
@@ -196,10 +207,10 @@ static status_t
                 return res;
             }
             dlq_enque(buff, &msg->buffQ);
-        } else if (buff->buffpos == SES_MSG_BUFFSIZE) {
+        } else if (buff->buffpos == buff->buffsize) {
             /* current buffer is full; get a new one */
             buff->buffpos = 0;
-            buff->bufflen = SES_MSG_BUFFSIZE;
+            buff->bufflen = buff->buffsize;
             res = ses_msg_new_buff(scb,
                                    FALSE,  /* outbuff */
                                    &buff);
@@ -418,7 +429,7 @@ static status_t
 
     /* make sure there is a current buffer to use */
     buff = (ses_msg_buff_t *)dlq_lastEntry(&msg->buffQ);
-    if (buff == NULL || buff->bufflen == SES_MSG_BUFFSIZE) {
+    if (buff == NULL || buff->bufflen == buff->buffsize) {
         /* need a new buffer */
         res = ses_msg_new_buff(scb,
                                FALSE,  /* outbuff */
@@ -450,10 +461,10 @@ static status_t
                 return res;
             }
             dlq_enque(buff, &msg->buffQ);
-        } else if (buff->buffpos == SES_MSG_BUFFSIZE) {
+        } else if (buff->buffpos == buff->buffsize) {
             /* current buffer is full; get a new one */
             buff->buffpos = 0;
-            buff->bufflen = SES_MSG_BUFFSIZE;
+            buff->bufflen = buff->buffsize;
             res = ses_msg_new_buff(scb,
                                    FALSE,  /* outbuff */
                                    &buff);
@@ -571,7 +582,7 @@ static status_t
             count--;   /* back up count */
             chunkleft = msg->expchunksize - msg->curchunksize;
             inbuffleft = len - count;
-            outbuffleft = SES_MSG_BUFFSIZE - buff->buffpos;
+            outbuffleft = buff->buffsize - buff->buffpos;
             copylen = min(inbuffleft, chunkleft);
 
             /* account for the amount copied above */
@@ -599,7 +610,7 @@ static status_t
                             &scb->readbuff[count],
                             outbuffleft);
                 buff->buffpos = 0;
-                buff->bufflen = SES_MSG_BUFFSIZE;
+                buff->bufflen = buff->buffsize;
                 copylen -= outbuffleft;
                 count += outbuffleft;
 
@@ -618,7 +629,7 @@ static status_t
                     }
                     dlq_enque(buff, &msg->buffQ);
 
-                    copy2len = min(SES_MSG_BUFFSIZE, copylen);
+                    copy2len = min(buff->buffsize, copylen);
                     xml_strncpy(&buff->buff[buff->buffpos],
                                 &scb->readbuff[count],
                                 copy2len);
@@ -752,6 +763,37 @@ static status_t
 }  /* accept_buffer_ssh_v11 */
 
 
+/********************************************************************
+* FUNCTION set_out_line
+*
+* Update the current output line length after a span
+* of bytes has been written to the session
+*
+* INPUTS:
+*   scb == session control block that was written
+*   buff == start of the span that was written
+*   len == number of bytes in the span
+*
+*********************************************************************/
+static void
+    set_out_line (ses_cb_t *scb,
+                  const xmlChar *buff,
+                  size_t len)
+{
+    const xmlChar *p;
+
+    /* bytes since the last newline in the span, if any */
+    for (p = &buff[len]; p > buff; p--) {
+        if (p[-1] == '\n') {
+            scb->stats.out_line = (uint32)(&buff[len] - p);
+            return;
+        }
+    }
+    scb->stats.out_line += (uint32)len;
+
+}  /* set_out_line */
+
+
 /********************************************************************
 * FUNCTION put_char_entity
 *
@@ -766,14 +808,13 @@ static void
     put_char_entity (ses_cb_t *scb,
                      xmlChar ch)
 {
-    xmlChar     numbuff[NCX_MAX_NUMLEN];
+    xmlChar     numbuff[NCX_MAX_NUMLEN+3];
+    int         len;
 
-    snprintf((char *)numbuff, NCX_MAX_NUMLEN, "%u", (uint32)ch);
-
-    ses_putchar(scb, '&');
-    ses_putchar(scb, '#');
-    ses_putstr(scb, numbuff);
-    ses_putchar(scb, ';');
+    len = snprintf((char *)numbuff, sizeof(numbuff), "&#%u;", (uint32)ch);
+    if (len > 0) {
+        ses_putbytes(scb, numbuff, (size_t)len);
+    }
 
 }  /* put_char_entity */
 
@@ -970,6 +1011,7 @@ ses_cb_t *
     scb->withdef = NCX_DEF_WITHDEF;
     scb->indent = NCX_DEF_INDENT;
     scb->cache_timeout = NCX_DEF_VTIMEOUT;
+    scb->out_chunksize = SES_DEF_OUT_CHUNKSIZE;
     return scb;
 
 }  /* ses_new_scb */
@@ -1065,10 +1107,7 @@ void ses_free_scb (ses_cb_t *scb)
      * the normal free buffer action is to move it to
      * the scb->freeQ
      */
-    while (!dlq_empty(&scb->freeQ)) {
-        buff = (ses_msg_buff_t *)dlq_deque(&scb->freeQ);
-        ses_msg_free_buff(scb, buff);
-    }
+    ses_msg_free_cache(scb);
 
     if (scb->readbuff != NULL) {
         m__free(scb->readbuff);
@@ -1151,6 +1190,119 @@ void
 }  /* ses_putchar */
 
 
+/********************************************************************
+* FUNCTION ses_putbytes
+*
+* Write a span of chars to the session, without any translation
+*
+* THIS FUNCTION DOES NOT CHECK ANY PARAMETERS TO SAVE TIME
+*
+* Same as calling ses_putchar for each char in the span,
+* except the chars are copied into the output buffers in runs
+* and the session statistics are updated once per span
+*
+* INPUTS:
+*   scb == session control block to write
+*   buff == start of the span to write
+*   len == number of bytes to write
+*
+*********************************************************************/
+void
+    ses_putbytes (ses_cb_t *scb,
+                  const xmlChar *buff,
+                  size_t len)
+{
+    size_t   written, cnt;
+    status_t res;
+
+    if (len == 0) {
+        return;
+    }
+
+    if (scb->fd) {
+        /* Normal NETCONF session mode: */
+        res = NO_ERR;
+        written = 0;
+        if (scb->outbuff == NULL) {
+            res = ses_msg_new_buff(scb, TRUE, &scb->outbuff);
+        }
+        while (res == NO_ERR && written < len) {
+            if (scb->outbuff == NULL) {
+                res = ERR_NCX_OPERATION_FAILED;
+                continue;
+            }
+            cnt = ses_msg_write_bytes(scb, 
+                                      scb->outbuff, 
+                                      &buff[written],
+                                      len - written);
+            written += cnt;
+            if (written < len) {
+                res = ses_msg_new_output_buff(scb);
+            }
+        }
+
+        scb->stats.out_bytes += (uint32)written;
+        totals.stats.out_bytes += (uint32)written;
+    } else if (scb->fp) {
+        /* debug session, sending output to a file */
+        fwrite(buff, 1, len, scb->fp);
+    } else {
+        /* debug session, sending output to the screen */
+        fwrite(buff, 1, len, stdout);
+    }
+
+    set_out_line(scb, buff, len);
+
+}  /* ses_putbytes */
+
+
+/********************************************************************
+* FUNCTION ses_putshared
+*
+* Write a span of shared output bytes to the session
+*
+* THIS FUNCTION DOES NOT CHECK ANY PARAMETERS TO SAVE TIME
+*
+* Same as calling ses_putbytes for the shared bytes, except
+* that a normal session queues a reference to the shared
+* buffer in its outQ instead of copying the bytes
+*
+* INPUTS:
+*   scb == session control block to write
+*   shared == shared bytes to write; a reference is held
+*             until the bytes are sent or the outQ is discarded
+*
+*********************************************************************/
+void
+    ses_putshared (ses_cb_t *scb,
+                   ses_msg_shared_t *shared)
+{
+    status_t res;
+
+    if (shared->len == 0) {
+        return;
+    }
+
+    if (scb->fd == 0) {
+        /* debug session; there is no outQ to share */
+        ses_putbytes(scb, shared->data, shared->len);
+        return;
+    }
+
+    res = ses_msg_enque_shared(scb, shared);
+    if (res != NO_ERR) {
+        /* no reference could be queued, so copy the bytes */
+        ses_putbytes(scb, shared->data, shared->len);
+        return;
+    }
+
+    scb->stats.out_bytes += (uint32)shared->len;
+    totals.stats.out_bytes += (uint32)shared->len;
+    set_out_line(scb, shared->data, shared->len);
+
+}  /* ses_putshared */
+
+
 /********************************************************************
 * FUNCTION ses_putstr
 *
@@ -1167,9 +1319,7 @@ void
     ses_putstr (ses_cb_t *scb,
                 const xmlChar *str)
 {
-    while (*str) {
-        ses_putchar(scb, *str++);
-    }
+    ses_putbytes(scb, str, xml_strlen(str));
 
 }  /* ses_putstr */
 
@@ -1194,19 +1344,23 @@ void
                        const xmlChar *str,
                        int32 indent)
 {
+    const xmlChar *start;
+
     ses_indent(scb, indent);
-    while (*str) {
+    if (indent < 0) {
+        ses_putstr(scb, str);
+        return;
+    }
+
+    for (start = str; *str; str++) {
         if (*str == '\n') {
-            if (indent < 0) {
-                ses_putchar(scb, *str++);
-            } else {
-                ses_indent(scb, indent);
-                str++;
-            }
-        } else {
-            ses_putchar(scb, *str++);
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_indent(scb, indent);
+            start = str + 1;
         }
     }
+    ses_putbytes(scb, start, (size_t)(str - start));
+
 }  /* ses_putstr_indent */
 
 
@@ -1230,28 +1384,44 @@ void
                  const xmlChar *str,
                  int32 indent)
 {
-    while (*str) {
-        if (*str == '<') {
-            ses_putstr(scb, LTSTR);
-            str++;
-        } else if (*str == '>') {
-            ses_putstr(scb, GTSTR);
-            str++;
-        } else if (*str == '&') {
-            ses_putstr(scb, AMPSTR);
-            str++;
-        } else if ((scb->mode == SES_MODE_XMLDOC
-                    || scb->mode == SES_MODE_TEXT) && *str == '\n') {
-            if (indent < 0) {
-                ses_putchar(scb, *str++);
-            } else {
-                ses_indent(scb, indent);
-                str++;
+    const xmlChar *start;
+    boolean        indentnl;
+
+    indentnl = (indent >= 0 &&
+                (scb->mode == SES_MODE_XMLDOC ||
+                 scb->mode == SES_MODE_TEXT));
+
+    /* copy runs of safe chars in one span; flush the run
+     * before each char that needs to be translated
+     */
+    for (start = str; *str; str++) {
+        switch (*str) {
+        case '<':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, LTSTR, LTSTR_LEN);
+            break;
+        case '>':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, GTSTR, GTSTR_LEN);
+            break;
+        case '&':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, AMPSTR, AMPSTR_LEN);
+            break;
+        case '\n':
+            if (!indentnl) {
+                continue;
             }
-        } else {
-            ses_putchar(scb, *str++);
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_indent(scb, indent);
+            break;
+        default:
+            continue;
         }
+        start = str + 1;
     }
+    ses_putbytes(scb, start, (size_t)(str - start));
+
 }  /* ses_putcstr */
 
 
@@ -1273,20 +1443,29 @@ void
     ses_puthstr (ses_cb_t *scb,
                  const xmlChar *str)
 {
-    while (*str) {
-        if (*str == '<') {
-            ses_putstr(scb, LTSTR);
-            str++;
-        } else if (*str == '>') {
-            ses_putstr(scb, GTSTR);
-            str++;
-        } else if (*str == '&') {
-            ses_putstr(scb, AMPSTR);
-            str++;
-        } else {
-            ses_putchar(scb, *str++);
+    const xmlChar *start;
+
+    for (start = str; *str; str++) {
+        switch (*str) {
+        case '<':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, LTSTR, LTSTR_LEN);
+            break;
+        case '>':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, GTSTR, GTSTR_LEN);
+            break;
+        case '&':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, AMPSTR, AMPSTR_LEN);
+            break;
+        default:
+            continue;
         }
+        start = str + 1;
     }
+    ses_putbytes(scb, start, (size_t)(str - start));
+
 }  /* ses_puthstr */
 
 
@@ -1313,11 +1492,11 @@ void
 {
     if (ch) {
         if (ch == '<') {
-            ses_putstr(scb, LTSTR);
+            ses_putbytes(scb, LTSTR, LTSTR_LEN);
         } else if (ch == '>') {
-            ses_putstr(scb, GTSTR);
+            ses_putbytes(scb, GTSTR, GTSTR_LEN);
         } else if (ch == '&') {
-            ses_putstr(scb, AMPSTR);
+            ses_putbytes(scb, AMPSTR, AMPSTR_LEN);
         } else if ((scb->mode == SES_MODE_XMLDOC
                     || scb->mode == SES_MODE_TEXT) && 
                    ch == '\n') {
@@ -1354,37 +1533,52 @@ void
                  const xmlChar *str,
                  int32 indent)
 {
-    while (*str) {
-        if (*str == '<') {
-            ses_putstr(scb, LTSTR);
-            str++;
-        } else if (*str == '>') {
-            ses_putstr(scb, GTSTR);
-            str++;
-        } else if (*str == '&') {
-            ses_putstr(scb, AMPSTR);
-            str++;
-        } else if (*str == '"') {
-            ses_putstr(scb, QSTR);
-            str++;
-        } else if (*str == '\n') {
-            if (scb->mode == SES_MODE_XMLDOC || 
-                scb->mode == SES_MODE_TEXT) {
-                if (indent < 0) {
-                    ses_putchar(scb, *str++);
-                } else {
-                    ses_indent(scb, indent);
-                    str++;
-                }
+    const xmlChar *start;
+    boolean        docmode;
+
+    docmode = (scb->mode == SES_MODE_XMLDOC || 
+               scb->mode == SES_MODE_TEXT);
+
+    for (start = str; *str; str++) {
+        switch (*str) {
+        case '<':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, LTSTR, LTSTR_LEN);
+            break;
+        case '>':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, GTSTR, GTSTR_LEN);
+            break;
+        case '&':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, AMPSTR, AMPSTR_LEN);
+            break;
+        case '"':
+            ses_putbytes(scb, start, (size_t)(str - start));
+            ses_putbytes(scb, QSTR, QSTR_LEN);
+            break;
+        case '\n':
+            if (docmode && indent < 0) {
+                continue;
+            }
+            ses_putbytes(scb, start, (size_t)(str - start));
+            if (docmode) {
+                ses_indent(scb, indent);
             } else {
-                put_char_entity(scb, *str++);
+                put_char_entity(scb, *str);
             }
-        } else if (isspace(*str)) {
-            put_char_entity(scb, *str++);
-        } else {
-            ses_putchar(scb, *str++);
+            break;
+        default:
+            if (!isspace(*str)) {
+                continue;
+            }
+            ses_putbytes(scb, start, (size_t)(str - start));
+            put_char_entity(scb, *str);
         }
+        start = str + 1;
     }
+    ses_putbytes(scb, start, (size_t)(str - start));
+
 }  /* ses_putastr */
 
 
@@ -1408,46 +1602,43 @@ void
                  const xmlChar *str,
                  int32 indent)
 {
+    const xmlChar *start;
+    xmlChar        esc[2];
+
     ses_indent(scb, indent);
-    while (*str) {
+
+    esc[0] = '\\';
+    for (start = str; *str; str++) {
         switch (*str) {
         case '"':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, '"');
-            break;
         case '\\':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, '\\');
-            break;
         case '/':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, '/');
+            esc[1] = *str;
             break;
         case '\b':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, 'b');
+            esc[1] = 'b';
             break;
         case '\f':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, 'f');
+            esc[1] = 'f';
             break;
         case '\n':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, 'n');
+            esc[1] = 'n';
             break;
         case '\r':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, 'r');
+            esc[1] = 'r';
             break;
         case '\t':
-            ses_putchar(scb, '\\');
-            ses_putchar(scb, 't');
+            esc[1] = 't';
             break;
         default:
-            ses_putchar(scb, *str);
+            continue;
         }
-        ++str;
+        ses_putbytes(scb, start, (size_t)(str - start));
+        ses_putbytes(scb, esc, 2);
+        start = str + 1;
     }
+    ses_putbytes(scb, start, (size_t)(str - start));
+
 }  /* ses_putjstr */
 
 
@@ -1471,18 +1662,17 @@ void
     ses_indent (ses_cb_t *scb,
                 int32 indent)
 {
-    int32 i;
+    xmlChar  buff[MAX_INDENT+1];
 
     if (indent < 0) {
         return;
     }
 
     /* set limit on indentation in case of bug */
-    indent = min(indent, 255);
-    ses_putchar(scb, '\n');
-    for (i=0; i<indent; i++) {
-        ses_putchar(scb, ' ');
-    }
+    indent = min(indent, MAX_INDENT);
+    buff[0] = '\n';
+    memset(&buff[1], ' ', (size_t)indent);
+    ses_putbytes(scb, buff, (size_t)indent + 1);
 
 }  /* ses_indent */
 
@@ -1622,7 +1812,9 @@ void ses_finish_msg (ses_cb_t *scb)
     if (scb->transport==SES_TRANSPORT_SSH ||
         scb->transport==SES_TRANSPORT_TCP) {
         if (scb->framing11) {
-            scb->outbuff->islast = TRUE;
+            if (scb->outbuff != NULL) {
+                scb->outbuff->islast = TRUE;
+            }
         } else {
             ses_putstr(scb, (const xmlChar *)NC_SSH_END);
         }
@@ -2048,8 +2240,8 @@ void
                     const xmlChar *fname)
 {
     FILE               *fil;
-    boolean             done;
-    int                 ch;
+    size_t              cnt;
+    xmlChar             buff[EXTERN_BUFFSIZE];
 
     fil = fopen((const char *)fname, "r");
     if (!fil) {
@@ -2057,16 +2249,10 @@ void
         return;
     } 
 
-    done = FALSE;
-    while (!done) {
-        ch = fgetc(fil);
-        if (ch == EOF) {
-            fclose(fil);
-            done = TRUE;
-        } else {
-            ses_putchar(scb, (uint32)ch);
-        }
+    while ((cnt = fread(buff, 1, sizeof(buff), fil)) > 0) {
+        ses_putbytes(scb, buff, cnt);
     }
+    fclose(fil);
 
 } /* ses_put_extern */
 
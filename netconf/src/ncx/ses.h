@@ -81,9 +81,28 @@ extern "C" {
 
 #define SES_NULL_SID  0
 
-/* controls the size of each buffer chuck */
+/* default size of each buffer chuck; this is the size of the
+ * smallest buffer size class, used for all input buffers
+ */
 #define SES_MSG_BUFFSIZE  2000   // 1024
 
+/* allowed range for the smallest buffer size class */
+#define SES_MSG_MIN_BUFFSIZE  512
+#define SES_MSG_MAX_BUFFSIZE  1000000
+
+/* default upper limit for the largest output buffer size class */
+#define SES_MSG_DEF_MAX_BUFFSIZE  0x10000
+
+/* max number of buffer size classes; class N holds buffers
+ * of (smallest buffer size << N) bytes
+ */
+#define SES_MSG_MAX_SIZECLASSES  12
+
+/* number of output buffers a session fills in one message
+ * before moving to the next bigger buffer size class
+ */
+#define SES_MSG_GROW_BUFFS  8
+
 /* max number of buffer chunks a session can have allocated at once  */
 #define SES_MAX_BUFFERS  4096
 
@@ -96,6 +115,9 @@ extern "C" {
 /* max number of bytes to try to send in one call to the write_fn */
 #define SES_MAX_BYTESEND   0xffff
 
+/* max number of iovecs used to send one base:1.1 chunk at a time */
+#define SES_MAX_CHUNKSEND  256
+
 /* max desired lines size; not a hard limit */
 #define SES_DEF_LINESIZE   72
 
@@ -113,9 +135,34 @@ extern "C" {
 /* leave enough room at the end for EOChunks */
 #define SES_ENDCHUNK_PAD  4
 
+/* TRUE if the base:1.1 chunk tags are written into the output
+ * buffers with ses_msg_add_framing, so the pads above are needed.
+ * Only manager sessions do this; the server sends the chunk tags
+ * in their own iovecs when the outQ is written
+ */
+#define SES_FRAMING_IN_BUFF(S)  ((S)->framing11 && (S)->mgrcb != NULL)
+
+/* default max payload size of one outgoing base:1.1 chunk */
+#define SES_DEF_OUT_CHUNKSIZE  0x10000
+
+/* allowed range for the max outgoing base:1.1 chunk size */
+#define SES_MIN_OUT_CHUNKSIZE  SES_MSG_BUFFSIZE
+#define SES_MAX_OUT_CHUNKSIZE  0x100000
+
+/* milliseconds to wait for a blocked session socket to
+ * become writable while a streamed reply is being sent
+ */
+#define SES_SEND_TIMEOUT  30000
+
 /* default read buffer size */
 #define SES_READBUFF_SIZE  1000
 
+/* number of log2 microsecond buckets in a latency histogram;
+ * bucket N counts latencies below 2^N usec, the last bucket
+ * counts everything else
+ */
+#define SES_LATENCY_BUCKETS  24
+
 /* port number for NETCONF over TCP */
 #define SES_DEF_TCP_PORT    2023
     
@@ -225,6 +272,33 @@ typedef struct ses_stats_t_ {
 } ses_stats_t;
 
 
+/* Session Message Buffer Statistics
+ * Kept per session and for all sessions combined;
+ * the global cached counters include the buffer pool
+ */
+typedef struct ses_buffstats_t_ {
+    uint32            inuse_buffs;       /* buffers in use now */
+    uint64            inuse_bytes;   /* buffer bytes in use now */
+    uint64            peak_bytes;    /* max inuse_bytes reached */
+    uint32            cached_buffs;     /* buffers cached now */
+    uint64            cached_bytes;      /* bytes cached now */
+    uint32            allocs;              /* buffers malloced */
+    uint32            reuses;      /* buffers taken from a cache */
+    uint32            grows;     /* output size class increases */
+} ses_buffstats_t;
+
+
+/* Latency histogram for messages written to a session
+ * socket, measured from a caller supplied start time
+ */
+typedef struct ses_latency_t_ {
+    uint32            count;            /* latencies recorded */
+    uint64            total_usec;      /* sum of all latencies */
+    uint64            max_usec;           /* largest latency */
+    uint32            buckets[SES_LATENCY_BUCKETS];
+} ses_latency_t;
+
+
 /* Session Total Statistics */
 typedef struct ses_total_stats_t_ {
     uint32            active_sessions;
@@ -234,18 +308,35 @@ typedef struct ses_total_stats_t_ {
     uint32            inSessions;
     uint32            droppedSessions;
     ses_stats_t       stats;
+    ses_buffstats_t   buffstats;
+    ses_latency_t     notif_latency;
     xmlChar           startTime[TSTAMP_MIN_SIZE];
 } ses_total_stats_t;
 
 
+/* Shared output bytes, encoded once and queued in the outQ
+ * of several sessions at the same time; freed when the
+ * last reference is released
+ */
+typedef struct ses_msg_shared_t_ {
+    uint32           refcnt;
+    size_t           len;                /* bytes in data[] */
+    xmlChar         *data;     /* malloced after the struct */
+} ses_msg_shared_t;
+
+
 /* Session Message Buffer */
 typedef struct ses_msg_buff_t_ {
     dlq_hdr_t        qhdr;
     size_t           buffstart;        /* buff start pos */
     size_t           bufflen;        /* buff actual size */
     size_t           buffpos;       /* buff cur position */
+    size_t           buffsize;       /* buff[] size in bytes */
+    uint32           sizeclass;          /* buff size class */
     boolean          islast;      /* T: last buff in msg */
-    xmlChar          buff[SES_MSG_BUFFSIZE];   
+    xmlChar         *buff;     /* malloced after the struct */
+    ses_msg_shared_t *shared;  /* set if buff is shared data */
+    uint64           stamp;   /* msg start usec if stamped */
 } ses_msg_buff_t;
 
 
@@ -309,12 +400,18 @@ typedef struct ses_cb_t_ {
     ses_instate_t    instate;               /* input state enum */
     uint32           buffcnt;           /* current buffer count */
     uint32           freecnt;            /* current freeQ count */
+    uint32           out_sizeclass;  /* size class for outbuffs */
+    uint32           out_classcnt;   /* outbuffs of this class */
+    ses_buffstats_t  buffstats;      /* buffer usage statistics */
+    ses_latency_t    notif_latency;   /* notification queue-to-
+                                       * socket write latency */
     dlq_hdr_t        msgQ;              /* Q of ses_msg_t input */
     dlq_hdr_t        freeQ;              /* Q of ses_msg_buff_t */
     dlq_hdr_t        outQ;               /* Q of ses_msg_buff_t */
     ses_msg_buff_t  *outbuff;          /* current output buffer */
     ses_ready_t      inready;            /* header for inreadyQ */
     ses_ready_t      outready;          /* header for outreadyQ */
+    boolean          outpoll;   /* T: server write events on */
     ses_stats_t      stats;           /* per-session statistics */
     void            *mgrcb;    /* if manager session, mgr_scb_t */
 
@@ -326,6 +423,19 @@ typedef struct ses_cb_t_ {
      */
     xmlChar          startchunk[SES_MAX_STARTCHUNK_SIZE+1];
 
+    /* base:1.1 output chunk state; the chunk in progress
+     * covers the first 'outchunk_left' payload bytes in the outQ
+     * and is resumed from the select loop if the socket blocks
+     */
+    uint32           out_chunksize;     /* max out chunk payload */
+    size_t           outq_bytes;     /* payload queued in outQ */
+    size_t           outchunk_left;   /* chunk payload not sent */
+    xmlChar          outchunk_hdr[SES_MAX_STARTCHUNK_SIZE+1];
+    uint32           outchunk_hdrlen;    /* chunk header length */
+    uint32           outchunk_hdrpos;  /* chunk header bytes sent */
+    uint32           outchunk_eompos;   /* EOChunks bytes sent */
+    boolean          outchunk_last;      /* T: chunk ends msg */
+
     /* input buffer for session */
     xmlChar         *readbuff;
     uint32           readbuffsize;
@@ -425,6 +535,51 @@ extern void
 		 uint32    ch);
 
 
+/********************************************************************
+* FUNCTION ses_putbytes
+*
+* Write a span of chars to the session, without any translation
+*
+* THIS FUNCTION DOES NOT CHECK ANY PARAMETERS TO SAVE TIME
+*
+* Same as calling ses_putchar for each char in the span,
+* except the chars are copied into the output buffers in runs
+* and the session statistics are updated once per span
+*
+* INPUTS:
+*   scb == session control block to write
+*   buff == start of the span to write
+*   len == number of bytes to write
+*
+*********************************************************************/
+extern void
+    ses_putbytes (ses_cb_t *scb,
+		  const xmlChar *buff,
+		  size_t len);
+
+
+/********************************************************************
+* FUNCTION ses_putshared
+*
+* Write a span of shared output bytes to the session
+*
+* THIS FUNCTION DOES NOT CHECK ANY PARAMETERS TO SAVE TIME
+*
+* Same as calling ses_putbytes for the shared bytes, except
+* that a normal session queues a reference to the shared
+* buffer in its outQ instead of copying the bytes
+*
+* INPUTS:
+*   scb == session control block to write
+*   shared == shared bytes to write; a reference is held
+*             until the bytes are sent or the outQ is discarded
+*
+*********************************************************************/
+extern void
+    ses_putshared (ses_cb_t *scb,
+                   ses_msg_shared_t *shared);
+
+
 /********************************************************************
 * FUNCTION ses_putstr
 *
@@ -32,15 +32,16 @@ date         init     comment
 #include  <stdio.h>
 #include  <stdlib.h>
 #include  <string.h>
+#include  <time.h>
 #include  <memory.h>
 #include  <unistd.h>
 #include  <errno.h>
 #include  <assert.h>
 #include  <sys/uio.h>
+#include  <poll.h>
 
 #include  "procdefs.h"
 #include  "log.h"
-#include  "send_buff.h"
 #include  "ses.h"
 #include  "ses_msg.h"
 #include  "status.h"
@@ -60,6 +61,11 @@ date         init     comment
 /* max number of buffers a session is allowed to cache in its freeQ */
 #define MAX_FREE_MSGS  32
 
+/* max number of bytes the global buffer pool keeps cached
+ * for each buffer size class
+ */
+#define MAX_POOL_BYTES  (4 * 1024 * 1024)
+
 
 /********************************************************************
 *                                                                   *
@@ -79,6 +85,14 @@ static dlq_hdr_t freeQ;
 static dlq_hdr_t inreadyQ;
 static dlq_hdr_t outreadyQ;
 
+/* buffer size classes and the global buffer pool;
+ * each poolQ holds free ses_msg_buff_t of 1 size class
+ */
+static uint32    buffsize = SES_MSG_BUFFSIZE;
+static uint32    numclasses = 1;
+static dlq_hdr_t poolQ[SES_MSG_MAX_SIZECLASSES];
+static uint32    poolcnt[SES_MSG_MAX_SIZECLASSES];
+
 
 /********************************************************************
 * FUNCTION trace_buff
@@ -107,65 +121,823 @@ static void
 } /* trace_buff */
 
 /********************************************************************
-* FUNCTION do_send_buff
+* FUNCTION latency_add
 *
-* Send the specified buffer.
-* Add framing chars if needed for base:1.1 over SSH
+* Add one latency to a latency histogram
+*
+* INPUTS:
+*   latency == histogram to update
+*   usec == latency in microseconds
+*********************************************************************/
+static void
+    latency_add (ses_latency_t *latency,
+                 uint64 usec)
+{
+    uint32  bucket;
+
+    for (bucket = 0; 
+         bucket < SES_LATENCY_BUCKETS - 1 && 
+             usec >= ((uint64)1 << bucket);
+         bucket++) {
+        ;
+    }
+
+    latency->count++;
+    latency->total_usec += usec;
+    if (usec > latency->max_usec) {
+        latency->max_usec = usec;
+    }
+    latency->buckets[bucket]++;
+
+} /* latency_add */
+
+
+/********************************************************************
+* FUNCTION record_latency
+*
+* Record the latency of a stamped message that was just
+* written to the session socket
 *
 * INPUTS:
 *   scb == session control block to use
-*   buff == buffer to send
+*   stamp == start time of the message
+*********************************************************************/
+static void
+    record_latency (ses_cb_t *scb,
+                    uint64 stamp)
+{
+    uint64  now, usec;
+
+    now = ses_msg_get_usec();
+    usec = (now > stamp) ? now - stamp : 0;
+    latency_add(&scb->notif_latency, usec);
+    latency_add(&ses_get_total_stats()->notif_latency, usec);
+
+} /* record_latency */
+
+
+/********************************************************************
+* FUNCTION free_outq_head
+*
+* Remove the first buffer in the outQ and free it
+* The buffer has been written to the socket
+*
+* INPUTS:
+*   scb == session control block to use
+*
+*********************************************************************/
+static void
+    free_outq_head (ses_cb_t *scb)
+{
+    ses_msg_buff_t *buff;
+
+    buff = (ses_msg_buff_t *)dlq_deque(&scb->outQ);
+    if (buff) {
+        if (buff->stamp) {
+            record_latency(scb, buff->stamp);
+        }
+        ses_msg_free_buff(scb, buff);
+    }
+
+} /* free_outq_head */
+
+
+/********************************************************************
+* FUNCTION outchunk_active
+*
+* Check if a base:1.1 output chunk is partially sent
+*
+* INPUTS:
+*   scb == session control block to check
 *
 * RETURNS:
-*   status
+*   TRUE if some of the chunk framing or payload is still pending
+*   FALSE if a new chunk needs to be started
+*********************************************************************/
+static boolean
+    outchunk_active (const ses_cb_t *scb)
+{
+    return (scb->outchunk_hdrpos < scb->outchunk_hdrlen ||
+            scb->outchunk_left ||
+            (scb->outchunk_last &&
+             scb->outchunk_eompos < NC_SSH_END_CHUNKS_LEN));
+
+} /* outchunk_active */
+
+
+/********************************************************************
+* FUNCTION start_outchunk
+*
+* Start a new base:1.1 output chunk from the buffers in the outQ
+* Buffers are coalesced into the chunk until scb->out_chunksize
+* bytes are reached, splitting a buffer if needed; the chunk
+* ends early at the last buffer of a message
+*
+* INPUTS:
+*   scb == session control block to use
+*
+* OUTPUTS:
+*   scb->outchunk_* fields set for the new chunk
+*
+* RETURNS:
+*   TRUE if a chunk was started; FALSE if nothing to send
+*********************************************************************/
+static boolean
+    start_outchunk (ses_cb_t *scb)
+{
+    ses_msg_buff_t *buff;
+    size_t          chunksize, buffleft;
+    boolean         islast;
+    int             numlen;
+
+    /* toss any empty buffers in between messages */
+    buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+    while (buff && buff->buffpos == buff->bufflen && !buff->islast) {
+        free_outq_head(scb);
+        buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+    }
+    if (buff == NULL) {
+        return FALSE;
+    }
+
+    chunksize = 0;
+    islast = FALSE;
+    for (; buff != NULL && !islast; 
+         buff = (ses_msg_buff_t *)dlq_nextEntry(buff)) {
+        buffleft = buff->bufflen - buff->buffpos;
+        if ((chunksize + buffleft) > scb->out_chunksize) {
+            /* chunk ends inside this buffer */
+            chunksize = scb->out_chunksize;
+            break;
+        }
+        chunksize += buffleft;
+        islast = buff->islast;
+    }
+
+    /* a zero length chunk is not allowed, so an empty last
+     * buffer only causes the EOChunks marker to be sent
+     */
+    numlen = 0;
+    if (chunksize) {
+        numlen = snprintf((char *)scb->outchunk_hdr, 
+                          sizeof(scb->outchunk_hdr),
+                          "\n#%zu\n",
+                          chunksize);
+    }
+
+    scb->outchunk_hdrlen = (uint32)numlen;
+    scb->outchunk_hdrpos = 0;
+    scb->outchunk_left = chunksize;
+    scb->outchunk_last = islast;
+    scb->outchunk_eompos = 0;
+
+    if (LOGDEBUG2) {
+        log_debug2("\nses_msg start 1.1 chunk:%zu%s on session %d", 
+                   chunksize,
+                   (islast) ? " (last)" : "",
+                   scb->sid);
+    }
+
+    return TRUE;
+
+} /* start_outchunk */
+
+
+/********************************************************************
+* FUNCTION setup_outchunk_iovs
+*
+* Setup the writev vector for the rest of the current chunk
+*
+* INPUTS:
+*   scb == session control block to use
+*   iovs == array of SES_MAX_CHUNKSEND iovecs to fill
+*   total == address of return byte count
+*
+* OUTPUTS:
+*   iovs[] filled with the pending chunk framing and payload
+*   *total == number of bytes in the iovs
+*
+* RETURNS:
+*   number of iovs used
+*********************************************************************/
+static int
+    setup_outchunk_iovs (ses_cb_t *scb,
+                         struct iovec *iovs,
+                         size_t *total)
+{
+    ses_msg_buff_t *buff;
+    size_t          left, buffleft;
+    int             cnt;
+
+    cnt = 0;
+    *total = 0;
+
+    if (scb->outchunk_hdrpos < scb->outchunk_hdrlen) {
+        iovs[cnt].iov_base = &scb->outchunk_hdr[scb->outchunk_hdrpos];
+        iovs[cnt].iov_len = scb->outchunk_hdrlen - scb->outchunk_hdrpos;
+        *total += iovs[cnt++].iov_len;
+    }
+
+    left = scb->outchunk_left;
+    for (buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+         buff != NULL && left && cnt < SES_MAX_CHUNKSEND - 1;
+         buff = (ses_msg_buff_t *)dlq_nextEntry(buff)) {
+        buffleft = min(buff->bufflen - buff->buffpos, left);
+        if (buffleft) {
+            iovs[cnt].iov_base = &buff->buff[buff->buffpos];
+            iovs[cnt].iov_len = buffleft;
+            *total += buffleft;
+            left -= buffleft;
+            cnt++;
+        }
+    }
+
+    if (left == 0 && scb->outchunk_last) {
+        iovs[cnt].iov_base = 
+            (void *)&NC_SSH_END_CHUNKS[scb->outchunk_eompos];
+        iovs[cnt].iov_len = NC_SSH_END_CHUNKS_LEN - scb->outchunk_eompos;
+        *total += iovs[cnt++].iov_len;
+    }
+
+    return cnt;
+
+} /* setup_outchunk_iovs */
+
+
+/********************************************************************
+* FUNCTION advance_outchunk
+*
+* Account for 'sent' bytes of the current chunk written
+* to the session socket.  Buffers are freed as soon as all
+* their payload is sent, except the last buffer of a message,
+* which is kept in the outQ until the EOChunks marker is sent
+*
+* INPUTS:
+*   scb == session control block to use
+*   sent == number of bytes written by writev
+*
+*********************************************************************/
+static void
+    advance_outchunk (ses_cb_t *scb,
+                      size_t sent)
+{
+    ses_msg_buff_t *buff;
+    size_t          cnt;
+
+    cnt = min(sent, scb->outchunk_hdrlen - scb->outchunk_hdrpos);
+    scb->outchunk_hdrpos += (uint32)cnt;
+    sent -= cnt;
+
+    while (scb->outchunk_left) {
+        buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+        if (buff == NULL) {
+            SET_ERROR(ERR_INTERNAL_VAL);
+            scb->outchunk_left = 0;
+            break;
+        }
+
+        cnt = min(sent, buff->bufflen - buff->buffpos);
+        buff->buffpos += cnt;
+        sent -= cnt;
+        scb->outchunk_left -= cnt;
+        scb->outq_bytes -= cnt;
+
+        if (buff->buffpos < buff->bufflen) {
+            return;
+        }
+        if (scb->outchunk_left == 0 && scb->outchunk_last &&
+            buff->islast) {
+            break;
+        }
+        free_outq_head(scb);
+    }
+
+    if (scb->outchunk_last) {
+        cnt = min(sent, NC_SSH_END_CHUNKS_LEN - scb->outchunk_eompos);
+        scb->outchunk_eompos += (uint32)cnt;
+        if (scb->outchunk_eompos == NC_SSH_END_CHUNKS_LEN) {
+            /* message is done; free its last buffer */
+            free_outq_head(scb);
+            scb->outchunk_last = FALSE;
+        }
+    }
+
+} /* advance_outchunk */
+
+
+/********************************************************************
+* FUNCTION write_outchunk
+*
+* Write as much of the current base:1.1 chunk as the socket
+* will take in one writev call, including the chunk header
+* and EOChunks marker.  Starts a new chunk if needed.
+*
+* INPUTS:
+*   scb == session control block to use
+*
+* RETURNS:
+*   status; ERR_NCX_SKIPPED if the socket would block
 *********************************************************************/
 static status_t
-    do_send_buff (ses_cb_t *scb,
-                  ses_msg_buff_t *buff)
+    write_outchunk (ses_cb_t *scb)
 {
-    status_t   res = NO_ERR;
+    struct iovec     iovs[SES_MAX_CHUNKSEND];
+    ssize_t          retcnt;
+    size_t           total;
+    int              cnt;
 
-    if (scb->framing11) {
-        ses_msg_add_framing(scb, buff);
-        /* bufflen has been adjusted for buffstart */
-        if (LOGDEBUG2) {
-            log_debug2("\nses_msg send 1.1 buff:%u\n",
-                      buff->bufflen - buff->buffpos);
+    if (!outchunk_active(scb) && !start_outchunk(scb)) {
+        return NO_ERR;
+    }
+
+    cnt = setup_outchunk_iovs(scb, iovs, &total);
+    if (cnt == 0) {
+        return SET_ERROR(ERR_INTERNAL_VAL);
+    }
+
+    retcnt = writev(scb->fd, iovs, cnt);
+    if (retcnt < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return ERR_NCX_SKIPPED;
+        }
+        log_info("\nses msg write failed for session %d", scb->sid);
+        return errno_to_status();
+    }
+
+    if (LOGDEBUG2) {
+        log_debug2("\nses wrote %d of %zu 1.1 bytes on session %d\n", 
+                   retcnt, 
+                   total, 
+                   scb->sid);
+    }
+
+    advance_outchunk(scb, (size_t)retcnt);
+
+    return ((size_t)retcnt < total) ? ERR_NCX_SKIPPED : NO_ERR;
+
+} /* write_outchunk */
+
+
+/********************************************************************
+* FUNCTION write_outbuffs
+*
+* Write one packet worth of base:1.0 buffers from the outQ
+* EOM markers are already in the buffers
+*
+* INPUTS:
+*   scb == session control block to use
+*
+* RETURNS:
+*   status; ERR_NCX_SKIPPED if the socket would block
+*********************************************************************/
+static status_t
+    write_outbuffs (ses_cb_t *scb)
+{
+    ses_msg_buff_t  *buff;
+    uint32           buffleft, total;
+    ssize_t          retcnt;
+    int              i, cnt;
+    boolean          done;
+    struct iovec     iovs[SES_MAX_BUFFSEND];
+
+    memset(iovs, 0x0, sizeof(iovs));
+    total = 0;
+    cnt = 0;
+    done = FALSE;
+    buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+
+    /* setup the writev call */
+    for (i=0; i<SES_MAX_BUFFSEND && !done && buff; i++) {
+        buffleft = buff->bufflen - buff->buffpos;
+        if ((total+buffleft) > SES_MAX_BYTESEND) {
+            if (i == 0) {
+                /* first buffer is larger than a packet */
+                total = SES_MAX_BYTESEND;
+                iovs[i].iov_base = &buff->buff[buff->buffpos];
+                iovs[i].iov_len = total;
+                cnt++;
+            }
+            done = TRUE;
+        } else {
+            total += buffleft;
+            iovs[i].iov_base = &buff->buff[buff->buffpos];
+            iovs[i].iov_len = buffleft;
+            buff = (ses_msg_buff_t *)dlq_nextEntry(buff);
+
+#ifdef SES_MSG_FULL_TRACE
             if (LOGDEBUG3) {
-                trace_buff(buff);
+                log_debug3("\nses_msg: setup send buff %d\n%s\n", 
+                           i,
+                           iovs[i].iov_base);
             }
+#endif
+            cnt++;
         }
+    }
 
-        if (buff->bufflen > 0) {
-            res = send_buff(scb->fd, 
-                            (const char *)&buff->buff[buff->buffstart], 
-                            buff->bufflen);
-        } else if (LOGDEBUG2) {
-            log_debug2("\nses: skip sending empty 1.1 buffer on sesion '%d'",
+    /* make sure there is at least one buffer set */
+    if (iovs[0].iov_base == NULL) {
+        return SET_ERROR(ERR_NCX_OPERATION_FAILED);
+    }
+
+    /* write a packet to the session socket */
+    retcnt = writev(scb->fd, iovs, cnt);
+    if (retcnt < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return ERR_NCX_SKIPPED;
+        }
+        log_info("\nses msg write failed for session %d", scb->sid);
+        return errno_to_status();
+    } else {
+        if (LOGDEBUG2) {
+            log_debug2("\nses wrote %d of %d bytes on session %d\n", 
+                       retcnt, 
+                       total, 
                        scb->sid);
         }
+    }
+
+    if ((uint32)retcnt < total) {
+        done = TRUE;
     } else {
-        if (buff->bufflen > buff->buffstart) {
-            /* send with base:1.0 framing; EOM markers in the buffer */
-            if (LOGDEBUG2) {
-                log_debug("\nses_msg send 1.0 buff:%u\n",
-                          buff->bufflen - buff->buffpos);
-                if (LOGDEBUG3) {
-                    trace_buff(buff);
+        done = FALSE;
+    }
+
+    /* clean up the buffers that were written */
+    buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+
+    while (retcnt && buff) {
+        /* get the number of bytes written from this buffer */
+        buffleft = buff->bufflen - buff->buffpos;
+
+        /* free the buffer if all of it was written or just
+         * bump the buffer pointer if not
+         */
+        if ((uint32)retcnt >= buffleft) {
+            scb->outq_bytes -= buffleft;
+            free_outq_head(scb);
+            retcnt -= (ssize_t)buffleft;
+            buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);            
+        } else {
+            buff->buffpos += (uint32)retcnt;
+            scb->outq_bytes -= (size_t)retcnt;
+            retcnt = 0;
+        }
+    }
+
+    return (done) ? ERR_NCX_SKIPPED : NO_ERR;
+
+} /* write_outbuffs */
+
+
+/********************************************************************
+* FUNCTION write_outq
+*
+* Write the next part of the session outQ with one writev call
+*
+* INPUTS:
+*   scb == session control block to use
+*
+* RETURNS:
+*   status; ERR_NCX_SKIPPED if the socket would block
+*********************************************************************/
+static status_t
+    write_outq (ses_cb_t *scb)
+{
+    if (scb->framing11) {
+        return write_outchunk(scb);
+    } else {
+        return write_outbuffs(scb);
+    }
+
+} /* write_outq */
+
+
+/********************************************************************
+* FUNCTION flush_outq
+*
+* Write full chunks from the session outQ until less than
+* scb->out_chunksize bytes are left, waiting for the socket
+* to become writable instead of retrying if it blocks.
+* Used in stream output mode when the outQ gets too big.
+*
+* INPUTS:
+*   scb == session control block to use
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    flush_outq (ses_cb_t *scb)
+{
+    struct pollfd    pfd;
+    status_t         res;
+    int              ret;
+
+    res = NO_ERR;
+    while (res == NO_ERR && !dlq_empty(&scb->outQ) &&
+           (scb->outq_bytes >= scb->out_chunksize || 
+            (scb->framing11 && outchunk_active(scb)))) {
+        res = write_outq(scb);
+        if (res != ERR_NCX_SKIPPED) {
+            continue;
+        }
+
+        pfd.fd = scb->fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, SES_SEND_TIMEOUT);
+        if (ret > 0) {
+            res = NO_ERR;
+        } else if (ret == 0) {
+            log_info("\nses msg write timeout for session %d", scb->sid);
+            res = ERR_NCX_TIMEOUT;
+        } else if (errno == EINTR) {
+            res = NO_ERR;
+        } else {
+            res = errno_to_status();
+        }
+    }
+    return res;
+
+} /* flush_outq */
+
+
+/********************************************************************
+* FUNCTION discard_outq
+*
+* Toss all buffers in the outQ after a fatal write error
+* so a dead session does not keep piling up output
+*
+* INPUTS:
+*   scb == session control block to use
+*
+*********************************************************************/
+static void
+    discard_outq (ses_cb_t *scb)
+{
+    ses_msg_buff_t *buff;
+
+    while (!dlq_empty(&scb->outQ)) {
+        buff = (ses_msg_buff_t *)dlq_deque(&scb->outQ);
+        ses_msg_free_buff(scb, buff);
+    }
+    scb->outq_bytes = 0;
+    scb->outchunk_left = 0;
+    scb->outchunk_hdrlen = scb->outchunk_hdrpos = 0;
+    scb->outchunk_last = FALSE;
+
+} /* discard_outq */
+
+
+/********************************************************************
+* FUNCTION enque_outbuff
+*
+* Put the current outbuff on the outQ
+*
+* INPUTS:
+*   scb == session control block to use
+*
+* OUTPUTS:
+*   scb->outbuff is moved to the outQ and set to NULL
+*********************************************************************/
+static void
+    enque_outbuff (ses_cb_t *scb)
+{
+    ses_msg_buff_t *buff;
+
+    buff = scb->outbuff;
+    buff->buffpos = buff->buffstart;
+    scb->outq_bytes += buff->bufflen - buff->buffpos;
+    dlq_enque(buff, &scb->outQ);
+    scb->outbuff = NULL;
+
+} /* enque_outbuff */
+
+
+/********************************************************************
+* FUNCTION outq_added
+*
+* Handle new buffers added to the session outQ.
+* Send the outQ right away in stream output mode if it holds
+* a full chunk, else put the session on the outreadyQ
+*
+* INPUTS:
+*   scb == session control block
+*
+* RETURNS:
+*   status of the stream output
+*********************************************************************/
+static status_t
+    outq_added (ses_cb_t *scb)
+{
+    status_t        res;
+
+    res = NO_ERR;
+    if (scb->stream_output) {
+        /* send the outQ right now if it holds a full chunk
+         * this works because the agt_ncxserver loop and mgr_io
+         * loop are single threaded and a notification cannot
+         * be in the middle of being sent right now
+         * If that code is changed, then make sure a notification
+         * is not being streamed right now
+         */
+        if (scb->outq_bytes >= scb->out_chunksize) {
+            res = flush_outq(scb);
+            if (res != NO_ERR) {
+                log_error("\nError: IO failed on session '%d' (%s)", 
+                          scb->sid,
+                          get_error_string(res));
+                discard_outq(scb);
+                if (scb->state < SES_ST_SHUTDOWN_REQ) {
+                    scb->termreason = SES_TR_DROPPED;
+                    scb->state = SES_ST_SHUTDOWN_REQ;
                 }
             }
-            res = send_buff(scb->fd, 
-                            (const char *)buff->buff, 
-                            buff->bufflen);
-        } else if (LOGDEBUG2) {
-            log_debug2("\nses: skip sending empty 1.0 buffer on sesion '%d'",
-                       scb->sid);
         }
+    } else {
+        ses_msg_make_outready(scb);
     }
-
     return res;
 
-}  /* do_send_buff */
+} /* outq_added */
+
+
+/********************************************************************
+* FUNCTION set_numclasses
+*
+* Set the number of buffer size classes that fit
+* in the specified max buffer size
+*
+* INPUTS:
+*   max_buffsize == upper limit for the biggest buffer size
+*
+*********************************************************************/
+static void
+    set_numclasses (uint32 max_buffsize)
+{
+    numclasses = 1;
+    while (numclasses < SES_MSG_MAX_SIZECLASSES &&
+           ((uint64)buffsize << numclasses) <= max_buffsize) {
+        numclasses++;
+    }
+
+} /* set_numclasses */
+
+
+/********************************************************************
+* FUNCTION stats_add
+*
+* Account for a buffer entering or leaving a buffer count
+*
+* INPUTS:
+*   stats == buffer stats to update
+*   buff == buffer being counted
+*   cached == TRUE to update the cached counters
+*             FALSE to update the inuse counters
+*   add == TRUE if the buffer is added; FALSE if removed
+*********************************************************************/
+static void
+    stats_add (ses_buffstats_t *stats,
+               const ses_msg_buff_t *buff,
+               boolean cached,
+               boolean add)
+{
+    if (cached) {
+        if (add) {
+            stats->cached_buffs++;
+            stats->cached_bytes += buff->buffsize;
+        } else {
+            stats->cached_buffs--;
+            stats->cached_bytes -= buff->buffsize;
+        }
+    } else {
+        if (add) {
+            stats->inuse_buffs++;
+            stats->inuse_bytes += buff->buffsize;
+            if (stats->inuse_bytes > stats->peak_bytes) {
+                stats->peak_bytes = stats->inuse_bytes;
+            }
+        } else {
+            stats->inuse_buffs--;
+            stats->inuse_bytes -= buff->buffsize;
+        }
+    }
+
+} /* stats_add */
+
+
+/********************************************************************
+* FUNCTION pool_get_buff
+*
+* Get a buffer of the specified size class from the
+* global buffer pool or malloc a new one
+*
+* INPUTS:
+*   sizeclass == buffer size class to get
+*   totals == global session stats
+*   reused == address of return reused flag
+*
+* OUTPUTS:
+*   *reused == TRUE if the buffer came from the pool
+*
+* RETURNS:
+*   buffer or NULL if malloc error
+*********************************************************************/
+static ses_msg_buff_t *
+    pool_get_buff (uint32 sizeclass,
+                   ses_total_stats_t *totals,
+                   boolean *reused)
+{
+    ses_msg_buff_t *newbuff;
+    size_t          size;
+
+    newbuff = (ses_msg_buff_t *)dlq_deque(&poolQ[sizeclass]);
+    if (newbuff) {
+        poolcnt[sizeclass]--;
+        stats_add(&totals->buffstats, newbuff, TRUE, FALSE);
+        *reused = TRUE;
+        return newbuff;
+    }
+
+    *reused = FALSE;
+    size = (size_t)buffsize << sizeclass;
+
+    /* +1 for the terminating zero xml_strncpy may write
+     * after a completely filled input buffer
+     */
+    newbuff = (ses_msg_buff_t *)m__getMem(sizeof(ses_msg_buff_t) + size + 1);
+    if (newbuff == NULL) {
+        return NULL;
+    }
+
+    memset(newbuff, 0x0, sizeof(ses_msg_buff_t));
+    newbuff->buff = (xmlChar *)&newbuff[1];
+    newbuff->buffsize = size;
+    newbuff->sizeclass = sizeclass;
+
+#ifdef DEBUG
+    memset(newbuff->buff, 0x0, size);
+#endif
+
+    totals->buffstats.allocs++;
+    return newbuff;
+
+} /* pool_get_buff */
+
+
+/********************************************************************
+* FUNCTION pool_put_buff
+*
+* Return a buffer to the global buffer pool or free it
+*
+* INPUTS:
+*   buff == buffer to put back (already removed from any Q)
+*   totals == global session stats
+*
+*********************************************************************/
+static void
+    pool_put_buff (ses_msg_buff_t *buff,
+                   ses_total_stats_t *totals)
+{
+    if (ses_msg_init_done &&
+        buff->buffsize == ((size_t)buffsize << buff->sizeclass) &&
+        ((uint64)(poolcnt[buff->sizeclass] + 1) * buff->buffsize) 
+        <= MAX_POOL_BYTES) {
+        dlq_enque(buff, &poolQ[buff->sizeclass]);
+        poolcnt[buff->sizeclass]++;
+        stats_add(&totals->buffstats, buff, TRUE, TRUE);
+    } else {
+        m__free(buff);
+    }
+
+} /* pool_put_buff */
+
+
+/********************************************************************
+* FUNCTION pool_flush
+*
+* Free all the buffers in the global buffer pool
+*
+*********************************************************************/
+static void
+    pool_flush (void)
+{
+    ses_total_stats_t *totals;
+    ses_msg_buff_t    *buff;
+    uint32             i;
+
+    totals = ses_get_total_stats();
+    for (i = 0; i < SES_MSG_MAX_SIZECLASSES; i++) {
+        while (!dlq_empty(&poolQ[i])) {
+            buff = (ses_msg_buff_t *)dlq_deque(&poolQ[i]);
+            stats_add(&totals->buffstats, buff, TRUE, FALSE);
+            m__free(buff);
+        }
+        poolcnt[i] = 0;
+    }
+
+} /* pool_flush */
 
 
 /********************************************************************
@@ -181,11 +953,19 @@ static status_t
 void 
     ses_msg_init (void)
 {
+    uint32  i;
+
     if (!ses_msg_init_done) {
         freecnt = 0;
         dlq_createSQue(&freeQ);
         dlq_createSQue(&inreadyQ);
         dlq_createSQue(&outreadyQ);
+        for (i = 0; i < SES_MSG_MAX_SIZECLASSES; i++) {
+            dlq_createSQue(&poolQ[i]);
+            poolcnt[i] = 0;
+        }
+        buffsize = SES_MSG_BUFFSIZE;
+        set_numclasses(SES_MSG_DEF_MAX_BUFFSIZE);
         ses_msg_init_done = TRUE;
     }
 
@@ -217,6 +997,8 @@ void
             m__free(msg);
         }
 
+        pool_flush();
+
         /* nothing malloced in these Qs now */
         memset(&freeQ, 0x0, sizeof(dlq_hdr_t));
         memset(&inreadyQ, 0x0, sizeof(dlq_hdr_t));
@@ -228,6 +1010,41 @@ void
 }  /* ses_msg_cleanup */
 
 
+/********************************************************************
+* FUNCTION ses_msg_set_buffsize
+*
+* Set the buffer size classes used for session buffers
+* Must be called before any sessions are created
+*
+* INPUTS:
+*   newbuffsize == size of the smallest buffer class,
+*                  used for all input buffers
+*   max_buffsize == upper limit for the biggest buffer class;
+*                   output buffers for large messages grow
+*                   in size up to this limit
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    ses_msg_set_buffsize (uint32 newbuffsize,
+                          uint32 max_buffsize)
+{
+    if (newbuffsize < SES_MSG_MIN_BUFFSIZE ||
+        newbuffsize > SES_MSG_MAX_BUFFSIZE) {
+        return ERR_NCX_INVALID_VALUE;
+    }
+
+    /* toss any cached buffers with the old sizes */
+    pool_flush();
+
+    buffsize = newbuffsize;
+    set_numclasses(min(max_buffsize, SES_MSG_MAX_BUFFSIZE));
+    return NO_ERR;
+
+} /* ses_msg_set_buffsize */
+
+
 /********************************************************************
 * FUNCTION ses_msg_new_msg
 *
@@ -325,24 +1142,42 @@ status_t ses_msg_new_buff( ses_cb_t *scb,
                            boolean outbuff,
                            ses_msg_buff_t **buff)
 {
-    ses_msg_buff_t *newbuff;
+    ses_total_stats_t *totals;
+    ses_msg_buff_t    *newbuff;
+    uint32             sizeclass;
+    boolean            reused;
 
     assert( scb && "scb == NULL" );
     assert( buff && "buff == NULL" );
 
-    /* handle the session freeQ separately */
-    if (scb->freecnt) {
+    totals = ses_get_total_stats();
+
+    sizeclass = 0;
+    if (outbuff) {
+        sizeclass = min(scb->out_sizeclass, numclasses - 1);
+    }
+
+    /* handle the session freeQ separately; it only
+     * caches buffers from the smallest size class
+     */
+    if (sizeclass == 0 && scb->freecnt) {
         newbuff = (ses_msg_buff_t *)dlq_deque(&scb->freeQ);
         if (newbuff) {
             /* use buffer from freeQ */
             ses_msg_init_buff(scb, outbuff, newbuff);
 
 #ifdef SES_MSG_CLEAR_INIT_BUFFERS
-            memset(newbuff->buff, 0x0, SES_MSG_BUFFSIZE);
+            memset(newbuff->buff, 0x0, newbuff->buffsize);
 #endif
 
             *buff = newbuff;
             scb->freecnt--;
+            stats_add(&scb->buffstats, newbuff, TRUE, FALSE);
+            stats_add(&scb->buffstats, newbuff, FALSE, TRUE);
+            stats_add(&totals->buffstats, newbuff, TRUE, FALSE);
+            stats_add(&totals->buffstats, newbuff, FALSE, TRUE);
+            scb->buffstats.reuses++;
+            totals->buffstats.reuses++;
 
             if (LOGDEBUG4) {
                 log_debug4("\nses_msg: reused %s buff %p for s %u", 
@@ -363,8 +1198,8 @@ status_t ses_msg_new_buff( ses_cb_t *scb,
         return ERR_NCX_RESOURCE_DENIED;
     }
 
-    /* malloc the buffer */
-    newbuff = m__getObj(ses_msg_buff_t);
+    /* get the buffer from the pool or malloc it */
+    newbuff = pool_get_buff(sizeclass, totals, &reused);
     if (newbuff == NULL) {
         return ERR_INTERNAL_MEM;
     }
@@ -372,17 +1207,23 @@ status_t ses_msg_new_buff( ses_cb_t *scb,
     /* set the fields and exit */
     ses_msg_init_buff(scb, outbuff, newbuff);
 
-#ifdef DEBUG
-    memset(newbuff->buff, 0x0, SES_MSG_BUFFSIZE);
-#endif
-
     *buff = newbuff;
     scb->buffcnt++;
+    stats_add(&scb->buffstats, newbuff, FALSE, TRUE);
+    stats_add(&totals->buffstats, newbuff, FALSE, TRUE);
+    if (reused) {
+        scb->buffstats.reuses++;
+        totals->buffstats.reuses++;
+    } else {
+        scb->buffstats.allocs++;
+    }
 
     if (LOGDEBUG4) {
-        log_debug4("\nses_msg: new %s buff %p for s %u", 
+        log_debug4("\nses_msg: %s %s buff %p (%zu) for s %u", 
+                   (reused) ? "pooled" : "new",
                    (outbuff) ? "out" : "in",
                    newbuff,
+                   newbuff->buffsize,
                    scb->sid);
     }
 
@@ -407,12 +1248,28 @@ void
     ses_msg_free_buff (ses_cb_t *scb,
                        ses_msg_buff_t *buff)
 {
+    ses_total_stats_t *totals;
+
     assert( scb && "scb == NULL" );
 
+    if (buff->shared != NULL) {
+        /* only the buffer header belongs to this session */
+        ses_msg_release_shared(buff->shared);
+        m__free(buff);
+        return;
+    }
+
+    totals = ses_get_total_stats();
+    stats_add(&scb->buffstats, buff, FALSE, FALSE);
+    stats_add(&totals->buffstats, buff, FALSE, FALSE);
+
     if (scb->state < SES_ST_SHUTDOWN_REQ &&
+        buff->sizeclass == 0 &&
         scb->freecnt < SES_MAX_FREE_BUFFERS) {
         dlq_enque(buff, &scb->freeQ);
         scb->freecnt++;
+        stats_add(&scb->buffstats, buff, TRUE, TRUE);
+        stats_add(&totals->buffstats, buff, TRUE, TRUE);
 
 #ifdef SES_MSG_DEBUG_CACHE
         if (LOGDEBUG4) {
@@ -424,18 +1281,49 @@ void
     } else {
 #ifdef SES_MSG_DEBUG_CACHE
         if (LOGDEBUG4) {
-            log_debug4("\nses_msg: free buff %p for s %u", 
+            log_debug4("\nses_msg: release buff %p for s %u", 
                        buff,
                        scb->sid);
         }
 #endif
-        m__free(buff);
+        pool_put_buff(buff, totals);
         scb->buffcnt--;
     }
 
 } /* ses_msg_free_buff */
 
 
+/********************************************************************
+* FUNCTION ses_msg_free_cache
+*
+* Release all the buffers cached in the session freeQ
+* Called when the session is being freed
+*
+* INPUTS:
+*   scb == session control block owning the freeQ
+*
+*********************************************************************/
+void
+    ses_msg_free_cache (ses_cb_t *scb)
+{
+    ses_total_stats_t *totals;
+    ses_msg_buff_t    *buff;
+
+    assert( scb && "scb == NULL" );
+
+    totals = ses_get_total_stats();
+    while (!dlq_empty(&scb->freeQ)) {
+        buff = (ses_msg_buff_t *)dlq_deque(&scb->freeQ);
+        stats_add(&scb->buffstats, buff, TRUE, FALSE);
+        stats_add(&totals->buffstats, buff, TRUE, FALSE);
+        pool_put_buff(buff, totals);
+        scb->buffcnt--;
+    }
+    scb->freecnt = 0;
+
+} /* ses_msg_free_cache */
+
+
 /********************************************************************
 * FUNCTION ses_msg_write_buff
 *
@@ -465,14 +1353,14 @@ status_t
     assert( buff && "buff == NULL" );
 
     res = NO_ERR;
-    if (scb->framing11) {
-        if (buff->bufflen < (SES_MSG_BUFFSIZE - SES_ENDCHUNK_PAD)) {
+    if (SES_FRAMING_IN_BUFF(scb)) {
+        if (buff->bufflen < (buff->buffsize - SES_ENDCHUNK_PAD)) {
             buff->buff[buff->bufflen++] = (xmlChar)ch;
         } else {
             res = ERR_BUFF_OVFL;
         }
     } else {
-        if (buff->bufflen < SES_MSG_BUFFSIZE) {
+        if (buff->bufflen < buff->buffsize) {
             buff->buff[buff->bufflen++] = (xmlChar)ch;
         } else {
             res = ERR_BUFF_OVFL;
@@ -483,11 +1371,62 @@ status_t
 } /* ses_msg_write_buff */
 
 
+/********************************************************************
+* FUNCTION ses_msg_write_bytes
+*
+* Add a span of text to the message buffer
+* Copies as many bytes as will fit in the buffer
+*
+* Upper layer code should never write framing chars to the
+* output buff -- that is always done in this module.
+*
+* INPUTS:
+*   scb == session control block to use
+*   buff == buffer to write to
+*   bytes == start of the span to write
+*   len == number of bytes in the span
+*
+* RETURNS:
+*   number of bytes actually copied into the buffer;
+*   less than 'len' if the buffer is full
+*
+*********************************************************************/
+size_t
+    ses_msg_write_bytes (ses_cb_t *scb,
+                         ses_msg_buff_t *buff,
+                         const xmlChar *bytes,
+                         size_t len)
+{
+    size_t   limit, cnt;
+
+    assert( scb && "scb == NULL" );
+    assert( buff && "buff == NULL" );
+
+    if (SES_FRAMING_IN_BUFF(scb)) {
+        limit = buff->buffsize - SES_ENDCHUNK_PAD;
+    } else {
+        limit = buff->buffsize;
+    }
+
+    if (buff->bufflen >= limit) {
+        return 0;
+    }
+
+    cnt = min(limit - buff->bufflen, len);
+    memcpy(&buff->buff[buff->bufflen], bytes, cnt);
+    buff->bufflen += cnt;
+    return cnt;
+    
+} /* ses_msg_write_bytes */
+
+
 /********************************************************************
 * FUNCTION ses_msg_send_buffs
 *
 * Send multiple buffers to the session client socket
-* Tries to send one packet at maximum MTU
+* Tries to send one packet at maximum MTU for base:1.0,
+* or as much of one chunk as the socket will take for base:1.1
+* Does not block if the socket is not ready for more output
 *
 * INPUTS:
 *   scb == session control block
@@ -499,12 +1438,7 @@ status_t
     ses_msg_send_buffs (ses_cb_t *scb)
 {
     ses_msg_buff_t  *buff;
-    uint32           buffleft, total;
-    ssize_t          retcnt;
-    int              i, cnt;
-    boolean          done;
     status_t         res;
-    struct iovec     iovs[SES_MAX_BUFFSEND];
 
     assert( scb && "scb == NULL" );
 
@@ -537,160 +1471,280 @@ status_t
         return (*scb->wrfn)(scb);
     }
 
-    memset(iovs, 0x0, sizeof(iovs));
-    total = 0;
-    cnt = 0;
-    done = FALSE;
-    buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+    /* write one packet or chunk; anything left over will
+     * be sent the next time the select loop finds the
+     * session ready for output
+     */
+    res = write_outq(scb);
+    if (res == ERR_NCX_SKIPPED) {
+        res = NO_ERR;
+    }
+    return res;
 
-    /* setup the writev call */
-    for (i=0; i<SES_MAX_BUFFSEND && !done && buff; i++) {
-        buffleft = buff->bufflen - buff->buffpos;
-        if ((total+buffleft) > SES_MAX_BYTESEND) {
-            done = TRUE;
-        } else {
-            total += buffleft;
-            iovs[i].iov_base = &buff->buff[buff->buffpos];
-            iovs[i].iov_len = buffleft;
-            buff = (ses_msg_buff_t *)dlq_nextEntry(buff);
+} /* ses_msg_send_buffs */
 
-#ifdef SES_MSG_FULL_TRACE
-            if (LOGDEBUG3) {
-                log_debug3("\nses_msg: setup send buff %d\n%s\n", 
-                           i,
-                           iovs[i].iov_base);
-            }
-#endif
-            cnt++;
-        }
+
+/********************************************************************
+* FUNCTION ses_msg_new_output_buff
+*
+* Put the current outbuff on the outQ
+* Put the session on the outreadyQ if it is not already there
+* Try to allocate a new buffer for the session
+*
+* INPUTS:
+*   scb == session control block
+*
+* OUTPUTS:
+*   scb->outbuff, scb->outready, and scb->outQ will be changed
+*   !!! outQ will be sent if stream output mode and it holds
+*   at least scb->out_chunksize bytes
+*   
+* RETURNS:
+*   status, could return malloc or buffers exceeded error
+*********************************************************************/
+status_t ses_msg_new_output_buff (ses_cb_t *scb)
+{
+    status_t        res;
+
+    assert( scb && "scb == NULL" );
+
+    /* save the buffer in the outQ to be sent when the
+     * main loop checks if any output pending
+     */
+    enque_outbuff(scb);
+
+    /* use bigger buffers if this message keeps growing */
+    if (++scb->out_classcnt >= SES_MSG_GROW_BUFFS &&
+        scb->out_sizeclass + 1 < numclasses) {
+        scb->out_sizeclass++;
+        scb->out_classcnt = 0;
+        scb->buffstats.grows++;
+        ses_get_total_stats()->buffstats.grows++;
     }
 
-    /* make sure there is at least one buffer set */
-    if (iovs[0].iov_base == NULL) {
-        return SET_ERROR(ERR_NCX_OPERATION_FAILED);
+    res = outq_added(scb);
+    if (res == NO_ERR) {
+        res = ses_msg_new_buff(scb, TRUE, &scb->outbuff);
     }
+    return res;
 
-    if (scb->framing11) {
-        /* send the 'cnt' number of buffs identified above
-         * do not use the iovs array because this function
-         * may not write the entire amount requested
-         * and that would not match the huge chunksize;
-         * so just send each buffer as a chunk
-         */
-        for (i=0; i < cnt; i++) {
-            buff = (ses_msg_buff_t *)dlq_deque(&scb->outQ);
-            if (buff == NULL) {
-                return SET_ERROR(ERR_INTERNAL_VAL);
-            }
-            res = do_send_buff(scb, buff);
-            ses_msg_free_buff(scb, buff);            
-            if (res != NO_ERR) {
-                return res;
-            }
-        }
-        return NO_ERR;
+} /* ses_msg_new_output_buff */
+
+
+/********************************************************************
+* FUNCTION ses_msg_new_shared
+*
+* Malloc a shared output buffer holding a copy of some bytes
+* The caller holds the first reference
+*
+* INPUTS:
+*   data == bytes to copy into the shared buffer
+*   len == number of bytes to copy
+*
+* RETURNS:
+*   malloced shared buffer with refcnt 1, or NULL if malloc error
+*********************************************************************/
+ses_msg_shared_t *
+    ses_msg_new_shared (const xmlChar *data,
+                        size_t len)
+{
+    ses_msg_shared_t *shared;
+
+    shared = (ses_msg_shared_t *)
+        m__getMem(sizeof(ses_msg_shared_t) + len + 1);
+    if (shared == NULL) {
+        return NULL;
     }
 
-    /* else base:1.0 framing
-     * write a packet to the session socket 
-     */
-    retcnt = writev(scb->fd, iovs, cnt);
-    if (retcnt < 0) {
-        /* should not need retries because the select loop
-         * indicated this session was ready for output
-         */
-        log_info("\nses msg write failed for session %d", scb->sid);
-        return errno_to_status();
-    } else {
-        if (LOGDEBUG2) {
-            log_debug2("\nses wrote %d of %d bytes on session %d\n", 
-                       retcnt, 
-                       total, 
-                       scb->sid);
-        }
+    shared->refcnt = 1;
+    shared->len = len;
+    shared->data = (xmlChar *)&shared[1];
+    if (len) {
+        memcpy(shared->data, data, len);
     }
+    shared->data[len] = 0;
+    return shared;
 
-    /* clean up the buffers that were written */
-    buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);
+} /* ses_msg_new_shared */
 
-    while (retcnt && buff) {
-        /* get the number of bytes written from this buffer */
-        buffleft = buff->bufflen - buff->buffpos;
 
-        /* free the buffer if all of it was written or just
-         * bump the buffer pointer if not
-         */
-        if ((uint32)retcnt >= buffleft) {
-            dlq_remove(buff);
-            ses_msg_free_buff(scb, buff);
-            retcnt -= (ssize_t)buffleft;
-            buff = (ses_msg_buff_t *)dlq_firstEntry(&scb->outQ);            
-        } else {
-            buff->buffpos += (uint32)retcnt;
-            retcnt = 0;
-        }
-    }
+/********************************************************************
+* FUNCTION ses_msg_release_shared
+*
+* Release one reference to a shared output buffer
+* and free it if this was the last reference
+*
+* INPUTS:
+*   shared == shared buffer to release
+*********************************************************************/
+void
+    ses_msg_release_shared (ses_msg_shared_t *shared)
+{
+    assert( shared && "shared == NULL" );
+    assert( shared->refcnt && "shared refcnt == 0" );
 
-    return NO_ERR;
+    if (--shared->refcnt == 0) {
+        m__free(shared);
+    }
 
-} /* ses_msg_send_buffs */
+} /* ses_msg_release_shared */
 
 
 /********************************************************************
-* FUNCTION ses_msg_new_output_buff
+* FUNCTION ses_msg_enque_shared
 *
-* Put the current outbuff on the outQ
+* Put a reference to a shared output buffer in the session outQ,
+* after anything already written to the current outbuff
 * Put the session on the outreadyQ if it is not already there
-* Try to allocate a new buffer for the session
 *
 * INPUTS:
 *   scb == session control block
+*   shared == shared buffer to queue; a reference is added
 *
 * OUTPUTS:
 *   scb->outbuff, scb->outready, and scb->outQ will be changed
-*   !!! buffer will be sent if stream output mode, then buffer reused
-*   
+*
 * RETURNS:
-*   status, could return malloc or buffers exceeded error
+*   status; if not NO_ERR, nothing was queued
 *********************************************************************/
-status_t ses_msg_new_output_buff (ses_cb_t *scb)
+status_t
+    ses_msg_enque_shared (ses_cb_t *scb,
+                          ses_msg_shared_t *shared)
 {
-    ses_msg_buff_t *buff;
-    status_t        res;
+    ses_msg_buff_t  *buff;
 
     assert( scb && "scb == NULL" );
+    assert( shared && "shared == NULL" );
 
-    buff = scb->outbuff;
-    buff->buffpos = 0;
+    /* the buffer header points at the shared bytes;
+     * it never goes into the freeQ or the buffer pool
+     */
+    buff = m__getObj(ses_msg_buff_t);
+    if (buff == NULL) {
+        return ERR_INTERNAL_MEM;
+    }
+    memset(buff, 0x0, sizeof(ses_msg_buff_t));
+    buff->buff = shared->data;
+    buff->bufflen = shared->len;
+    buff->buffsize = shared->len;
+    buff->shared = shared;
+    shared->refcnt++;
+
+    /* anything already in the outbuff goes first */
+    if (scb->outbuff != NULL && 
+        scb->outbuff->bufflen > scb->outbuff->buffstart) {
+        enque_outbuff(scb);
+    }
 
-    if (scb->stream_output) {
-        /* send this buffer right now 
-         * this works because the agt_ncxserver loop and mgr_io
-         * loop are single threaded and a notification cannot
-         * be in the middle of being sent right now
-         * If that code is changed, then make sure a notification
-         * is not being streamed right now
-         */
-        if (buff->bufflen) {
-            res = do_send_buff(scb, buff);
-            ses_msg_init_buff(scb, TRUE, buff);
-        } else {
-            res = SET_ERROR(ERR_INTERNAL_VAL);
-        }
+    dlq_enque(buff, &scb->outQ);
+    scb->outq_bytes += buff->bufflen;
+
+    /* errors are handled the same as for a new output buffer,
+     * after the shared bytes are already queued
+     */
+    if (outq_added(scb) == NO_ERR && scb->outbuff == NULL) {
+        (void)ses_msg_new_buff(scb, TRUE, &scb->outbuff);
+    }
+    return NO_ERR;
+
+} /* ses_msg_enque_shared */
+
+
+/********************************************************************
+* FUNCTION ses_msg_get_usec
+*
+* Get the monotonic time used for message latency stamps
+*
+* RETURNS:
+*   usec since some unspecified starting point
+*********************************************************************/
+uint64
+    ses_msg_get_usec (void)
+{
+    struct timespec  ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64)ts.tv_sec * 1000000) + (uint64)(ts.tv_nsec / 1000);
+
+} /* ses_msg_get_usec */
+
+
+/********************************************************************
+* FUNCTION ses_msg_stamp_outmsg
+*
+* Stamp the last message queued for output with its start time
+* The latency is added to the notification latency histograms
+* of the session and the totals when the last buffer of the
+* message has been written to the socket
+*
+* INPUTS:
+*   scb == session control block; ses_finish_msg already called
+*   stamp == start time of the message from ses_msg_get_usec
+*********************************************************************/
+void
+    ses_msg_stamp_outmsg (ses_cb_t *scb,
+                          uint64 stamp)
+{
+    ses_msg_buff_t  *buff;
+
+    assert( scb && "scb == NULL" );
 
-        /* reuse the same outbuff again */
+    /* the message ends in the last buffer of the outQ;
+     * if the outQ is empty it was already written
+     */
+    buff = (ses_msg_buff_t *)dlq_lastEntry(&scb->outQ);
+    if (buff) {
+        buff->stamp = stamp;
     } else {
-        /* save the buffer in the message loop do be sent when
-         * the main loop checks if any output pending
-         */
-        dlq_enque(scb->outbuff, &scb->outQ);
-        ses_msg_make_outready(scb);
-        scb->outbuff = NULL;
-        res = ses_msg_new_buff(scb, TRUE, &scb->outbuff);
+        record_latency(scb, stamp);
     }
-    return res;
 
-} /* ses_msg_new_output_buff */
+} /* ses_msg_stamp_outmsg */
+
+
+/********************************************************************
+* FUNCTION ses_msg_log_latency
+*
+* Log a latency histogram at debug level
+*
+* INPUTS:
+*   name == label for the histogram
+*   latency == histogram to log
+*********************************************************************/
+void
+    ses_msg_log_latency (const char *name,
+                         const ses_latency_t *latency)
+{
+    uint32  i;
+
+    assert( name && "name == NULL" );
+    assert( latency && "latency == NULL" );
+
+    if (!LOGDEBUG || latency->count == 0) {
+        return;
+    }
+
+    log_debug("\n%s latency: %u msgs, avg %llu usec, max %llu usec",
+              name,
+              latency->count,
+              (unsigned long long)(latency->total_usec / latency->count),
+              (unsigned long long)latency->max_usec);
+    for (i = 0; i < SES_LATENCY_BUCKETS; i++) {
+        if (latency->buckets[i] == 0) {
+            continue;
+        }
+        if (i == SES_LATENCY_BUCKETS - 1) {
+            log_debug("\n   >= %llu usec: %u",
+                      (unsigned long long)((uint64)1 << (i - 1)),
+                      latency->buckets[i]);
+        } else {
+            log_debug("\n    < %llu usec: %u",
+                      (unsigned long long)((uint64)1 << i),
+                      latency->buckets[i]);
+        }
+    }
+
+} /* ses_msg_log_latency */
 
 
 /********************************************************************
@@ -778,20 +1832,29 @@ void ses_msg_finish_outmsg (ses_cb_t *scb)
     assert( scb && "scb is NULL" );
     assert( scb->outbuff && "scb->outbuff is NULL" );
 
+    enque_outbuff(scb);
+
+    /* start the next message with the smallest buffers */
+    scb->out_sizeclass = 0;
+    scb->out_classcnt = 0;
+    (void)ses_msg_new_buff(scb, TRUE, &scb->outbuff);
+
     if (scb->stream_output) {
-        res = do_send_buff(scb, scb->outbuff);
-        ses_msg_init_buff(scb, TRUE, scb->outbuff);
-        if (res != NO_ERR) {
+        /* send what the socket will take right now;
+         * the rest is sent from the select loop
+         */
+        res = NO_ERR;
+        while (res == NO_ERR && !dlq_empty(&scb->outQ)) {
+            res = write_outq(scb);
+        }
+        if (res != NO_ERR && res != ERR_NCX_SKIPPED) {
             log_error("\nError: IO failed on session '%d' (%s)", 
                       scb->sid,
                       get_error_string(res));
         }
-    } else {
-        scb->outbuff->buffpos = scb->outbuff->buffstart;
-        dlq_enque(scb->outbuff, &scb->outQ);
-        scb->outbuff = NULL;
-        (void)ses_msg_new_buff(scb, TRUE, &scb->outbuff);
+    }
 
+    if (!dlq_empty(&scb->outQ)) {
         ses_msg_make_outready(scb);
     }
 
@@ -955,7 +2018,8 @@ void
 
     buff->buffpos = 0;
     buff->islast = FALSE;
-    if (outbuff && scb->framing11) {
+    buff->stamp = 0;
+    if (outbuff && SES_FRAMING_IN_BUFF(scb)) {
         buff->buffstart = SES_STARTCHUNK_PAD;
     } else {
         buff->buffstart = 0;
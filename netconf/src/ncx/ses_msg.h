@@ -96,6 +96,27 @@ extern void
     ses_msg_cleanup (void);
 
 
+/********************************************************************
+* FUNCTION ses_msg_set_buffsize
+*
+* Set the buffer size classes used for session buffers
+* Must be called before any sessions are created
+*
+* INPUTS:
+*   newbuffsize == size of the smallest buffer class,
+*                  used for all input buffers
+*   max_buffsize == upper limit for the biggest buffer class;
+*                   output buffers for large messages grow
+*                   in size up to this limit
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    ses_msg_set_buffsize (uint32 newbuffsize,
+                          uint32 max_buffsize);
+
+
 /********************************************************************
 * FUNCTION ses_msg_new_msg
 *
@@ -172,6 +193,20 @@ extern void
 		       ses_msg_buff_t *buff);
 
 
+/********************************************************************
+* FUNCTION ses_msg_free_cache
+*
+* Release all the buffers cached in the session freeQ
+* Called when the session is being freed
+*
+* INPUTS:
+*   scb == session control block owning the freeQ
+*
+*********************************************************************/
+extern void
+    ses_msg_free_cache (ses_cb_t *scb);
+
+
 /********************************************************************
 * FUNCTION ses_msg_write_buff
 *
@@ -192,6 +227,30 @@ extern status_t
                         uint32 ch);
 
 
+/********************************************************************
+* FUNCTION ses_msg_write_bytes
+*
+* Add a span of text to the message buffer
+* Copies as many bytes as will fit in the buffer
+*
+* INPUTS:
+*   scb == session control block to use
+*   buff == buffer to write to
+*   bytes == start of the span to write
+*   len == number of bytes in the span
+*
+* RETURNS:
+*   number of bytes actually copied into the buffer;
+*   less than 'len' if the buffer is full
+*
+*********************************************************************/
+extern size_t
+    ses_msg_write_bytes (ses_cb_t *scb,
+                         ses_msg_buff_t *buff,
+                         const xmlChar *bytes,
+                         size_t len);
+
+
 /********************************************************************
 * FUNCTION ses_msg_send_buffs
 *
@@ -228,6 +287,102 @@ extern status_t
     ses_msg_new_output_buff (ses_cb_t *scb);
 
 
+/********************************************************************
+* FUNCTION ses_msg_new_shared
+*
+* Malloc a shared output buffer holding a copy of some bytes
+* The caller holds the first reference
+*
+* INPUTS:
+*   data == bytes to copy into the shared buffer
+*   len == number of bytes to copy
+*
+* RETURNS:
+*   malloced shared buffer with refcnt 1, or NULL if malloc error
+*********************************************************************/
+extern ses_msg_shared_t *
+    ses_msg_new_shared (const xmlChar *data,
+                        size_t len);
+
+
+/********************************************************************
+* FUNCTION ses_msg_release_shared
+*
+* Release one reference to a shared output buffer
+* and free it if this was the last reference
+*
+* INPUTS:
+*   shared == shared buffer to release
+*********************************************************************/
+extern void
+    ses_msg_release_shared (ses_msg_shared_t *shared);
+
+
+/********************************************************************
+* FUNCTION ses_msg_enque_shared
+*
+* Put a reference to a shared output buffer in the session outQ,
+* after anything already written to the current outbuff
+* Put the session on the outreadyQ if it is not already there
+*
+* INPUTS:
+*   scb == session control block
+*   shared == shared buffer to queue; a reference is added
+*
+* OUTPUTS:
+*   scb->outbuff, scb->outready, and scb->outQ will be changed
+*
+* RETURNS:
+*   status; if not NO_ERR, nothing was queued
+*********************************************************************/
+extern status_t
+    ses_msg_enque_shared (ses_cb_t *scb,
+                          ses_msg_shared_t *shared);
+
+
+/********************************************************************
+* FUNCTION ses_msg_get_usec
+*
+* Get the monotonic time used for message latency stamps
+*
+* RETURNS:
+*   usec since some unspecified starting point
+*********************************************************************/
+extern uint64
+    ses_msg_get_usec (void);
+
+
+/********************************************************************
+* FUNCTION ses_msg_stamp_outmsg
+*
+* Stamp the last message queued for output with its start time
+* The latency is added to the notification latency histograms
+* of the session and the totals when the last buffer of the
+* message has been written to the socket
+*
+* INPUTS:
+*   scb == session control block; ses_finish_msg already called
+*   stamp == start time of the message from ses_msg_get_usec
+*********************************************************************/
+extern void
+    ses_msg_stamp_outmsg (ses_cb_t *scb,
+                          uint64 stamp);
+
+
+/********************************************************************
+* FUNCTION ses_msg_log_latency
+*
+* Log a latency histogram at debug level
+*
+* INPUTS:
+*   name == label for the histogram
+*   latency == histogram to log
+*********************************************************************/
+extern void
+    ses_msg_log_latency (const char *name,
+                         const ses_latency_t *latency);
+
+
 /********************************************************************
 * FUNCTION ses_msg_make_inready
 *
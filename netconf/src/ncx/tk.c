@@ -3171,6 +3171,11 @@ tk_chain_t *
         token->linenum = oldtoken->linenum;
         token->linepos = oldtoken->linepos;
         token->nsid = oldtoken->nsid;
+        token->xpdone = oldtoken->xpdone;
+        token->xpaxis = oldtoken->xpaxis;
+        token->xpnodetyp = oldtoken->xpnodetyp;
+        token->xpfncb = oldtoken->xpfncb;
+        token->xpfnmod = oldtoken->xpfnmod;
         dlq_enque(token, &tkc->tkQ);
     }
 
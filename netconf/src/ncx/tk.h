@@ -288,6 +288,13 @@ typedef struct tk_token_t_ {
     uint32      linepos;
     xmlns_id_t  nsid;        /* only used for TK_TT_MSTRING tokens */
     dlq_hdr_t   origstrQ;  /* Q of tk_origstr_t only used in DOCMODE */
+
+    /* XPath name lookups cached on TK_TT_TSTRING tokens by xpath1.c */
+    boolean           xpdone;          /* xpaxis and xpnodetyp are set */
+    ncx_xpath_axis_t  xpaxis;            /* axis name ID or XP_AX_NONE */
+    uint32            xpnodetyp;  /* xpath_nodetype_t or XP_EXNT_NONE */
+    const void       *xpfncb;    /* xpath_fncb_t or NULL if not found */
+    const void       *xpfnmod;    /* module xpfncb was looked up from */
 } tk_token_t;
 
 
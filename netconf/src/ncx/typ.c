@@ -20,6 +20,7 @@
 date         init     comment
 ----------------------------------------------------------------------
 12nov05      abb      begun
+17oct26               get compiled patterns from ncx_regex
 
 *********************************************************************
 *                                                                   *
@@ -38,6 +39,7 @@ date         init     comment
 #include "ncx.h"
 #include "ncx_appinfo.h"
 #include "ncx_num.h"
+#include "ncx_regex.h"
 #include "tk.h"
 #include "typ.h"
 #include "xml_util.h"
@@ -4096,7 +4098,7 @@ void
 #endif
 
     if (pat->pattern) {
-        xmlRegFreeRegexp(pat->pattern);
+        ncx_regex_release(pat->pattern);
     }
     if (pat->pat_str) {
         m__free(pat->pat_str);
@@ -4112,10 +4114,11 @@ void
 * FUNCTION typ_compile_pattern
 * 
 * Compile a pattern as into a regex_t struct
+* The compiled pattern is shared with all other users
+* of the same pattern string
 *
 * INPUTS:
-*     btyp == base type of the string
-*     sv == ncx_sval_t holding the pattern to compile
+*     pat == typ_pattern_t holding the pattern string to compile
 *
 * OUTPUTS:
 *     pat->pattern is set if NO_ERR
@@ -4126,6 +4129,7 @@ void
 status_t
     typ_compile_pattern (typ_pattern_t *pat)
 {
+    status_t  res;
 
 #ifdef DEBUG
     if (!pat || !pat->pat_str) {
@@ -4133,12 +4137,11 @@ status_t
     }
 #endif
 
-    pat->pattern = xmlRegexpCompile(pat->pat_str);
-    if (!pat->pattern) {
-        return ERR_NCX_INVALID_PATTERN;
-    } else {
-        return NO_ERR;
+    if (pat->pattern) {
+        ncx_regex_release(pat->pattern);
     }
+    pat->pattern = ncx_regex_get(pat->pat_str, &res);
+    return res;
 
 }  /* typ_compile_pattern */
 
@@ -31,6 +31,7 @@ date	     init     comment
 22-oct-05    abb      Begun
 13-oct-08    abb      Moved pattern from typ_sval_t to ncx_pattern_t 
                       to support N patterns per typdef
+17-oct-26             Share compiled patterns through ncx_regex
 */
 
 #include <xmlstring.h>
@@ -43,6 +44,10 @@ date	     init     comment
 #include "ncxtypes.h"
 #endif
 
+#ifndef _H_ncx_regex
+#include "ncx_regex.h"
+#endif
+
 #ifndef _H_status
 #include "status.h"
 #endif
@@ -207,7 +212,7 @@ typedef struct typ_range_t_ {
  */
 typedef struct typ_pattern_t_ {
     dlq_hdr_t       qhdr;
-    xmlRegexpPtr    pattern;
+    ncx_regex_t    *pattern;    /* shared; see ncx_regex_get */
     xmlChar        *pat_str;
     ncx_errinfo_t   pat_errinfo;
 } typ_pattern_t;
@@ -1828,10 +1833,11 @@ extern void
 * FUNCTION typ_compile_pattern
 * 
 * Compile a pattern as into a regex_t struct
+* The compiled pattern is shared with all other users
+* of the same pattern string
 *
 * INPUTS:
-*     btyp == base type of the string
-*     sv == ncx_sval_t holding the pattern to compile
+*     pat == typ_pattern_t holding the pattern string to compile
 *
 * OUTPUTS:
 *     pat->pattern is set if NO_ERR
@@ -29,6 +29,7 @@ date         init     comment
 19dec05      abb      begun
 21jul08      abb      start obj-based rewrite
 28dec11      abb      add editvars only if XML attrs present
+17oct26               match patterns through ncx_regex
 
 *********************************************************************
 *                                                                   *
@@ -46,6 +47,7 @@ date         init     comment
 
 #include "procdefs.h"
 #include "b64.h"
+#include "bobhash.h"
 #include "cfg.h"
 #include "dlq.h"
 #include "getcb.h"
@@ -54,6 +56,7 @@ date         init     comment
 #include "ncx.h"
 #include "ncx_list.h"
 #include "ncx_num.h"
+#include "ncx_regex.h"
 #include "ncx_str.h"
 #include "ncxconst.h"
 #include "obj.h"
@@ -95,6 +98,52 @@ typedef struct finderparms_t_ {
     int64         foundpos;
 } finderparms_t;
 
+/* one list entry in a val_keytab_t hash bucket */
+typedef struct val_keyent_t_ {
+    struct val_keyent_t_ *next;                 /* bucket chain */
+    uint32        hash;                     /* hash of the key values */
+    val_value_t  *val;                           /* the list entry */
+} val_keyent_t;
+
+/* key value index of the list entries with the same name */
+typedef struct val_keytab_t_ {
+    obj_template_t *obj;                  /* list object being hashed */
+    uint32          numbuckets;            /* always a power of 2 */
+    uint32          numentries;
+    val_keyent_t  **buckets;
+
+    /* entries that cannot be hashed yet, usually because the
+     * key leafs have not been parsed; these are checked
+     * one by one and moved to the buckets when complete
+     */
+    val_value_t   **pend;
+    uint32          pendcnt;
+    uint32          pendmax;
+} val_keytab_t;
+
+/* one child name entry in a val_chidx_t hash bucket */
+typedef struct val_chidx_ent_t_ {
+    struct val_chidx_ent_t_ *next;              /* bucket chain */
+    uint32        hash;
+    uint32        count;         /* childQ instances with this name */
+    val_value_t  *first;         /* first instance in the childQ */
+    val_value_t  *last;           /* last instance in the childQ */
+
+    /* TRUE if the instances form one run in the childQ with only
+     * unnamed marker nodes between them, all for the same object 
+     */
+    boolean       contig;
+    boolean       nokeytab;     /* list keys cannot be hashed */
+    val_keytab_t *keytab;        /* list entries by key, or NULL */
+} val_chidx_ent_t;
+
+/* child name index of a complex value node */
+typedef struct val_chidx_t_ {
+    uint32            numbuckets;          /* always a power of 2 */
+    uint32            numentries;
+    val_chidx_ent_t **buckets;
+} val_chidx_t;
+
 /* pick a log output function for dump_value */
 typedef void (*dumpfn_t) (const char *fstr, ...);
 
@@ -106,6 +155,10 @@ static uint32 editvars_malloc = 0;
 static uint32 editvars_free = 0;
 #endif
 
+/* TRUE while value trees are read by more than one thread;
+ * lookups still use the child indexes but never change them */
+static boolean chidx_frozen = FALSE;
+
 
 /********************************************************************
 * FUNCTION stdout_num
@@ -336,124 +389,1219 @@ static void
         log_stdout("%c", *ch++);
     }
 
-} /* stdout_intern */
+} /* stdout_intern */
+
+
+/********************************************************************
+* FUNCTION pattern_match
+* 
+* Check the specified string against the specified pattern
+*
+* INPUTS:
+*    pattern == compiled pattern to use 
+*    strval == string to check
+*
+* RETURNS:
+*    TRUE is string matches pattern; FALSE otherwise
+*********************************************************************/
+static boolean
+    pattern_match (const ncx_regex_t *pattern,
+                   const xmlChar *strval)
+{
+    int ret;
+
+    ret = ncx_regex_match(pattern, strval);
+    if (ret==1) {
+        return TRUE;
+    } else if (ret==0) {
+        return FALSE;
+    } else if (ret < 0) {
+        /* pattern match execution error, but compiled ok */
+        SET_ERROR(ERR_NCX_INVALID_PATTERN);
+        return FALSE;
+    } else {
+        SET_ERROR(ERR_INTERNAL_VAL);
+        return FALSE;
+    }
+    /*NOTREACHED*/
+
+} /* pattern_match */
+
+
+/********************************************************************
+* FUNCTION check_svalQ_enum
+* 
+* Check all the ncx_enum_t structs in a queue of typ_sval_t 
+*
+* INPUTS:
+*    name == enum string
+*    checkQ == pointer to Q of typ_sval_t to check
+*    reten == address of return typ_enum_t
+* 
+* OUTPUTS:
+*    *reten == typ_enum_t found if matched (res == NO_ERR)
+* RETURNS:
+*    status, NO_ERR if string value is in the set
+*********************************************************************/
+static status_t
+    check_svalQ_enum (const xmlChar *name,
+                      const dlq_hdr_t *checkQ,
+                      typ_enum_t  **reten)
+{
+    typ_enum_t  *en;
+
+    /* check this typdef for restrictions */
+    for (en = (typ_enum_t *)dlq_firstEntry(checkQ);
+         en != NULL;
+         en = (typ_enum_t *)dlq_nextEntry(en)) {
+
+        if (!xml_strcmp(name, en->name)) {
+            *reten = en;
+            return NO_ERR;
+        }
+    }
+    return ERR_NCX_NOT_FOUND;
+
+} /* check_svalQ_enum */
+
+
+
+/********************************************************************
+* FUNCTION free_editvars
+* 
+* Clean and free the val->editvars field
+*
+* INPUTS:
+*    val == val_value_t data structure to use
+*
+* OUTPUTS:
+*    val->editvars is cleaned, freed, and set to NULL
+*********************************************************************/
+static void
+    free_editvars (val_value_t *val)
+{
+    if (val->editvars) {
+#ifdef VAL_EDITVARS_DEBUG
+        log_debug3("\n\nfree_editvars: %s: %d = %p\n",
+                   (val->name) ? val->name : NCX_EL_NONE,
+                   ++editvars_free,
+                   val->editvars);
+#endif
+
+        if (val->editvars->insertstr) {
+            m__free(val->editvars->insertstr);
+        }
+
+        if (val->editvars->insertxpcb) {
+            xpath_free_pcb(val->editvars->insertxpcb);
+        }
+
+        m__free(val->editvars);
+        val->editvars = NULL;
+    } else {
+#ifdef VAL_EDITVARS_DEBUG
+        log_debug3("\nval_free_editvars skipped (%u, %s)",
+                   editvars_free, 
+                   val->name);
+#endif
+    }
+
+}  /* free_editvars */
+
+
+/********************************************************************
+* FUNCTION chidx_hash
+* 
+* Get the hash value for a child node name
+*
+* INPUTS:
+*    name == child node name
+*
+* RETURNS:
+*   hash value
+*********************************************************************/
+static uint32
+    chidx_hash (const xmlChar *name)
+{
+    return (uint32)bobhash((const ub1 *)name, xml_strlen(name), 0);
+
+}  /* chidx_hash */
+
+
+/********************************************************************
+* FUNCTION key_hash
+* 
+* Get the hash value for the key leafs of a list entry
+* The hash is only available if the index chain is complete,
+* in schema order, and every key value has the base type of
+* its key leaf, so equal keys in the val_compare sense
+* always get the same hash
+*
+* INPUTS:
+*    val == list entry to check
+*    hash == address of return hash value
+*
+* OUTPUTS:
+*    *hash == hash of the key values if TRUE returned
+*
+* RETURNS:
+*   TRUE if the key values could be hashed
+*********************************************************************/
+static boolean
+    key_hash (val_value_t *val,
+              uint32 *hash)
+{
+    obj_key_t         *key;
+    const val_index_t *in;
+    const val_value_t *keyval;
+    ub4                h;
+
+    if (val->btyp != NCX_BT_LIST) {
+        return FALSE;
+    }
+
+    key = obj_first_key(val->obj);
+    if (key == NULL) {
+        return FALSE;
+    }
+
+    h = 0;
+    for (in = (const val_index_t *)dlq_firstEntry(&val->indexQ);
+         key != NULL && in != NULL;
+         key = obj_next_key(key),
+             in = (const val_index_t *)dlq_nextEntry(in)) {
+
+        keyval = in->val;
+        if (keyval->btyp != obj_get_basetype(key->keyobj) ||
+            keyval->name == NULL ||
+            xml_strcmp(keyval->name, obj_get_name(key->keyobj))) {
+            return FALSE;
+        }
+
+        switch (keyval->btyp) {
+        case NCX_BT_EMPTY:
+        case NCX_BT_BOOLEAN:
+            h = bobhash((const ub1 *)&keyval->v.boo, sizeof(boolean), h);
+            break;
+        case NCX_BT_ENUM:
+            h = bobhash((const ub1 *)&VAL_ENUM(keyval), sizeof(int32), h);
+            break;
+        case NCX_BT_INT8:
+        case NCX_BT_INT16:
+        case NCX_BT_INT32:
+            h = bobhash((const ub1 *)&keyval->v.num.i, sizeof(int32), h);
+            break;
+        case NCX_BT_INT64:
+            h = bobhash((const ub1 *)&keyval->v.num.l, sizeof(int64), h);
+            break;
+        case NCX_BT_UINT8:
+        case NCX_BT_UINT16:
+        case NCX_BT_UINT32:
+            h = bobhash((const ub1 *)&keyval->v.num.u, sizeof(uint32), h);
+            break;
+        case NCX_BT_UINT64:
+            h = bobhash((const ub1 *)&keyval->v.num.ul, sizeof(uint64), h);
+            break;
+        case NCX_BT_STRING:
+        case NCX_BT_INSTANCE_ID:
+        case NCX_BT_LEAFREF:
+            if (keyval->v.str == NULL) {
+                return FALSE;
+            }
+            h = bobhash((const ub1 *)keyval->v.str,
+                        xml_strlen(keyval->v.str), h);
+            break;
+        case NCX_BT_BINARY:
+            if (keyval->v.binary.ustr == NULL) {
+                return FALSE;
+            }
+            h = bobhash((const ub1 *)keyval->v.binary.ustr,
+                        keyval->v.binary.ustrlen, h);
+            break;
+        case NCX_BT_IDREF:
+            if (keyval->v.idref.name == NULL) {
+                return FALSE;
+            }
+            h = bobhash((const ub1 *)&keyval->v.idref.nsid,
+                        sizeof(xmlns_id_t), h);
+            h = bobhash((const ub1 *)keyval->v.idref.name,
+                        xml_strlen(keyval->v.idref.name), h);
+            break;
+        default:
+            /* decimal64 and float compares are not bit exact */
+            return FALSE;
+        }
+    }
+
+    if (key != NULL || in != NULL) {
+        /* index chain not complete yet */
+        return FALSE;
+    }
+
+    *hash = (uint32)h;
+    return TRUE;
+
+}  /* key_hash */
+
+
+/********************************************************************
+* FUNCTION keytab_free
+* 
+* Free a list entry key index
+*
+* INPUTS:
+*    keytab == key index to free
+*********************************************************************/
+static void
+    keytab_free (val_keytab_t *keytab)
+{
+    val_keyent_t *kent;
+    uint32        i;
+
+    for (i = 0; i < keytab->numbuckets; i++) {
+        while (keytab->buckets[i]) {
+            kent = keytab->buckets[i];
+            keytab->buckets[i] = kent->next;
+            m__free(kent);
+        }
+    }
+    if (keytab->pend) {
+        m__free(keytab->pend);
+    }
+    m__free(keytab->buckets);
+    m__free(keytab);
+
+}  /* keytab_free */
+
+
+/********************************************************************
+* FUNCTION keytab_insert
+* 
+* Add a list entry with a complete key to a key index
+*
+* INPUTS:
+*    keytab == key index to use
+*    val == list entry to add
+*    hash == key_hash for the list entry
+*
+* RETURNS:
+*   TRUE if added, FALSE if out of memory
+*********************************************************************/
+static boolean
+    keytab_insert (val_keytab_t *keytab,
+                   val_value_t *val,
+                   uint32 hash)
+{
+    val_keyent_t  *kent, **newbuckets;
+    uint32         i, newsize;
+
+    kent = m__getObj(val_keyent_t);
+    if (kent == NULL) {
+        return FALSE;
+    }
+    kent->hash = hash;
+    kent->val = val;
+    kent->next = keytab->buckets[hash & (keytab->numbuckets - 1)];
+    keytab->buckets[hash & (keytab->numbuckets - 1)] = kent;
+    keytab->numentries++;
+
+    if (keytab->numentries <= keytab->numbuckets * 2) {
+        return TRUE;
+    }
+
+    newsize = keytab->numbuckets * 4;
+    newbuckets = m__getMem(newsize * sizeof(val_keyent_t *));
+    if (newbuckets == NULL) {
+        /* keep using the smaller table */
+        return TRUE;
+    }
+    memset(newbuckets, 0x0, newsize * sizeof(val_keyent_t *));
+
+    for (i = 0; i < keytab->numbuckets; i++) {
+        while (keytab->buckets[i]) {
+            kent = keytab->buckets[i];
+            keytab->buckets[i] = kent->next;
+            kent->next = newbuckets[kent->hash & (newsize - 1)];
+            newbuckets[kent->hash & (newsize - 1)] = kent;
+        }
+    }
+    m__free(keytab->buckets);
+    keytab->buckets = newbuckets;
+    keytab->numbuckets = newsize;
+    return TRUE;
+
+}  /* keytab_insert */
+
+
+/********************************************************************
+* FUNCTION keytab_add
+* 
+* Add a list entry to the key index of a child name entry
+* The key index is dropped if it runs out of memory
+*
+* INPUTS:
+*    ent == child name index entry with a keytab
+*    val == list entry to add
+*********************************************************************/
+static void
+    keytab_add (val_chidx_ent_t *ent,
+                val_value_t *val)
+{
+    val_keytab_t  *keytab = ent->keytab;
+    val_value_t  **newpend;
+    uint32         hash;
+
+    if (val->obj == keytab->obj && key_hash(val, &hash)) {
+        if (keytab_insert(keytab, val, hash)) {
+            return;
+        }
+    } else {
+        if (keytab->pendcnt == keytab->pendmax) {
+            newpend = m__getMem((keytab->pendmax * 2 + 4) *
+                                sizeof(val_value_t *));
+            if (newpend) {
+                if (keytab->pend) {
+                    memcpy(newpend, keytab->pend,
+                           keytab->pendcnt * sizeof(val_value_t *));
+                    m__free(keytab->pend);
+                }
+                keytab->pend = newpend;
+                keytab->pendmax = keytab->pendmax * 2 + 4;
+            }
+        }
+        if (keytab->pendcnt < keytab->pendmax) {
+            keytab->pend[keytab->pendcnt++] = val;
+            return;
+        }
+    }
+
+    keytab_free(keytab);
+    ent->keytab = NULL;
+
+}  /* keytab_add */
+
+
+/********************************************************************
+* FUNCTION keytab_remove
+* 
+* Remove a list entry from a key index
+* The key values may have changed since the entry was
+* hashed, so all buckets are searched if it is not found
+* under its current hash
+*
+* INPUTS:
+*    keytab == key index to use
+*    val == list entry to remove
+*********************************************************************/
+static void
+    keytab_remove (val_keytab_t *keytab,
+                   val_value_t *val)
+{
+    val_keyent_t **link, *kent;
+    uint32         i, hash;
+
+    for (i = 0; i < keytab->pendcnt; i++) {
+        if (keytab->pend[i] == val) {
+            keytab->pend[i] = keytab->pend[--keytab->pendcnt];
+            return;
+        }
+    }
+
+    if (key_hash(val, &hash)) {
+        for (link = &keytab->buckets[hash & (keytab->numbuckets - 1)];
+             *link != NULL;
+             link = &(*link)->next) {
+            if ((*link)->val == val) {
+                kent = *link;
+                *link = kent->next;
+                m__free(kent);
+                keytab->numentries--;
+                return;
+            }
+        }
+    }
+
+    for (i = 0; i < keytab->numbuckets; i++) {
+        for (link = &keytab->buckets[i]; *link != NULL;
+             link = &(*link)->next) {
+            if ((*link)->val == val) {
+                kent = *link;
+                *link = kent->next;
+                m__free(kent);
+                keytab->numentries--;
+                return;
+            }
+        }
+    }
+
+}  /* keytab_remove */
+
+
+/********************************************************************
+* FUNCTION keytab_drain
+* 
+* Move the pending list entries that now have a complete
+* key into the hash buckets of a key index
+*
+* INPUTS:
+*    keytab == key index to use
+*********************************************************************/
+static void
+    keytab_drain (val_keytab_t *keytab)
+{
+    val_value_t  *val;
+    uint32        i, hash;
+
+    i = 0;
+    while (i < keytab->pendcnt) {
+        val = keytab->pend[i];
+        if (val->obj == keytab->obj && key_hash(val, &hash) &&
+            keytab_insert(keytab, val, hash)) {
+            keytab->pend[i] = keytab->pend[--keytab->pendcnt];
+        } else {
+            i++;
+        }
+    }
+
+}  /* keytab_drain */
+
+
+/********************************************************************
+* FUNCTION keytab_build
+* 
+* Build the key index for the list entries of a child name entry
+* Sets ent->nokeytab instead if the list keys cannot be hashed
+*
+* INPUTS:
+*    ent == child name index entry to use
+*********************************************************************/
+static void
+    keytab_build (val_chidx_ent_t *ent)
+{
+    val_keytab_t   *keytab;
+    obj_template_t *obj = ent->first->obj;
+    obj_key_t      *key;
+    val_value_t    *val;
+
+    if (obj == NULL || obj->objtype != OBJ_TYP_LIST ||
+        obj_first_key(obj) == NULL) {
+        ent->nokeytab = TRUE;
+        return;
+    }
+
+    for (key = obj_first_key(obj); key != NULL; key = obj_next_key(key)) {
+        switch (obj_get_basetype(key->keyobj)) {
+        case NCX_BT_DECIMAL64:
+        case NCX_BT_FLOAT64:
+        case NCX_BT_UNION:
+        case NCX_BT_BITS:
+        case NCX_BT_SLIST:
+            ent->nokeytab = TRUE;
+            return;
+        default:
+            ;
+        }
+    }
+
+    keytab = m__getObj(val_keytab_t);
+    if (keytab == NULL) {
+        return;
+    }
+    memset(keytab, 0x0, sizeof(val_keytab_t));
+    keytab->obj = obj;
+    keytab->numbuckets = VAL_CHIDX_INIT_BUCKETS;
+    keytab->buckets = m__getMem(VAL_CHIDX_INIT_BUCKETS *
+                                sizeof(val_keyent_t *));
+    if (keytab->buckets == NULL) {
+        m__free(keytab);
+        return;
+    }
+    memset(keytab->buckets, 0x0,
+           VAL_CHIDX_INIT_BUCKETS * sizeof(val_keyent_t *));
+    ent->keytab = keytab;
+
+    for (val = ent->first; val != NULL && ent->keytab != NULL;
+         val = (val_value_t *)dlq_nextEntry(val)) {
+        if (val->name && !xml_strcmp(val->name, ent->first->name)) {
+            keytab_add(ent, val);
+        }
+        if (val == ent->last) {
+            break;
+        }
+    }
+
+}  /* keytab_build */
+
+
+/********************************************************************
+* FUNCTION prev_named_sibling
+* 
+* Get the previous sibling that has a name, skipping
+* unnamed marker nodes
+*
+* INPUTS:
+*    val == value node to start from
+*
+* RETURNS:
+*   previous named sibling or NULL if none
+*********************************************************************/
+static val_value_t *
+    prev_named_sibling (const val_value_t *val)
+{
+    val_value_t *prev = (val_value_t *)dlq_prevEntry(val);
+
+    while (prev && prev->name == NULL) {
+        prev = (val_value_t *)dlq_prevEntry(prev);
+    }
+    return prev;
+
+}  /* prev_named_sibling */
+
+
+/********************************************************************
+* FUNCTION next_named_sibling
+* 
+* Get the next sibling that has a name, skipping
+* unnamed marker nodes
+*
+* INPUTS:
+*    val == value node to start from
+*
+* RETURNS:
+*   next named sibling or NULL if none
+*********************************************************************/
+static val_value_t *
+    next_named_sibling (const val_value_t *val)
+{
+    val_value_t *next = (val_value_t *)dlq_nextEntry(val);
+
+    while (next && next->name == NULL) {
+        next = (val_value_t *)dlq_nextEntry(next);
+    }
+    return next;
+
+}  /* next_named_sibling */
+
+
+/********************************************************************
+* FUNCTION chidx_free
+* 
+* Free the child name index of a complex value node
+*
+* INPUTS:
+*    parent == value node to use
+*
+* OUTPUTS:
+*    parent->chidx is freed and set to NULL
+*********************************************************************/
+static void
+    chidx_free (val_value_t *parent)
+{
+    val_chidx_t     *chidx = parent->chidx;
+    val_chidx_ent_t *ent;
+    uint32           i;
+
+    if (chidx == NULL) {
+        return;
+    }
+
+    for (i = 0; i < chidx->numbuckets; i++) {
+        while (chidx->buckets[i]) {
+            ent = chidx->buckets[i];
+            chidx->buckets[i] = ent->next;
+            if (ent->keytab) {
+                keytab_free(ent->keytab);
+            }
+            m__free(ent);
+        }
+    }
+    m__free(chidx->buckets);
+    m__free(chidx);
+    parent->chidx = NULL;
+
+}  /* chidx_free */
+
+
+/********************************************************************
+* FUNCTION chidx_find
+* 
+* Find the bucket link for a child name in a child name index
+*
+* INPUTS:
+*    chidx == child name index to search
+*    name == child node name
+*    hash == chidx_hash(name)
+*
+* RETURNS:
+*   pointer to the link holding the entry for this name;
+*   *link is NULL if the name is not in the index
+*********************************************************************/
+static val_chidx_ent_t **
+    chidx_find (val_chidx_t *chidx,
+                const xmlChar *name,
+                uint32 hash)
+{
+    val_chidx_ent_t **link = &chidx->buckets[hash & (chidx->numbuckets - 1)];
+
+    for (; *link != NULL; link = &(*link)->next) {
+        if ((*link)->hash == hash &&
+            !xml_strcmp((*link)->first->name, name)) {
+            break;
+        }
+    }
+    return link;
+
+}  /* chidx_find */
+
+
+/********************************************************************
+* FUNCTION chidx_new_entry
+* 
+* Add a new child name entry to a child name index
+* The index is freed if the entry cannot be malloced
+* since it would no longer cover every child name
+*
+* INPUTS:
+*    parent == value node owning the index
+*    link == link returned by chidx_find for this name
+*    hash == chidx_hash(child->name)
+*    child == first instance of this child name
+*********************************************************************/
+static void
+    chidx_new_entry (val_value_t *parent,
+                     val_chidx_ent_t **link,
+                     uint32 hash,
+                     val_value_t *child)
+{
+    val_chidx_t      *chidx = parent->chidx;
+    val_chidx_ent_t  *ent, **newbuckets;
+    uint32            i, newsize;
+
+    ent = m__getObj(val_chidx_ent_t);
+    if (ent == NULL) {
+        chidx_free(parent);
+        return;
+    }
+    memset(ent, 0x0, sizeof(val_chidx_ent_t));
+    ent->hash = hash;
+    ent->count = 1;
+    ent->first = child;
+    ent->last = child;
+    ent->contig = TRUE;
+    *link = ent;
+    chidx->numentries++;
+
+    if (chidx->numentries <= chidx->numbuckets * 2) {
+        return;
+    }
+
+    /* rehash into a table twice the size; keep the old one
+     * if there is no memory for it
+     */
+    newsize = chidx->numbuckets * 2;
+    newbuckets = m__getMem(newsize * sizeof(val_chidx_ent_t *));
+    if (newbuckets == NULL) {
+        return;
+    }
+    memset(newbuckets, 0x0, newsize * sizeof(val_chidx_ent_t *));
+
+    for (i = 0; i < chidx->numbuckets; i++) {
+        while (chidx->buckets[i]) {
+            ent = chidx->buckets[i];
+            chidx->buckets[i] = ent->next;
+            ent->next = newbuckets[ent->hash & (newsize - 1)];
+            newbuckets[ent->hash & (newsize - 1)] = ent;
+        }
+    }
+    m__free(chidx->buckets);
+    chidx->buckets = newbuckets;
+    chidx->numbuckets = newsize;
+
+}  /* chidx_new_entry */
+
+
+/********************************************************************
+* FUNCTION chidx_build
+* 
+* Build the child name index for a complex value node
+*
+* INPUTS:
+*    parent == value node to index
+*
+* OUTPUTS:
+*    parent->chidx is set if there was enough memory
+*********************************************************************/
+static void
+    chidx_build (val_value_t *parent)
+{
+    val_chidx_t      *chidx;
+    val_chidx_ent_t **link, *ent;
+    val_value_t      *val, *prevval;
+    uint32            hash;
+
+    chidx = m__getObj(val_chidx_t);
+    if (chidx == NULL) {
+        return;
+    }
+    chidx->numbuckets = VAL_CHIDX_INIT_BUCKETS;
+    chidx->numentries = 0;
+    chidx->buckets = m__getMem(VAL_CHIDX_INIT_BUCKETS *
+                               sizeof(val_chidx_ent_t *));
+    if (chidx->buckets == NULL) {
+        m__free(chidx);
+        return;
+    }
+    memset(chidx->buckets, 0x0,
+           VAL_CHIDX_INIT_BUCKETS * sizeof(val_chidx_ent_t *));
+    parent->chidx = chidx;
+
+    prevval = NULL;
+    for (val = (val_value_t *)dlq_firstEntry(&parent->v.childQ);
+         val != NULL && parent->chidx != NULL;
+         val = (val_value_t *)dlq_nextEntry(val)) {
+        if (val->name == NULL) {
+            continue;
+        }
+        hash = chidx_hash(val->name);
+        link = chidx_find(parent->chidx, val->name, hash);
+        ent = *link;
+        if (ent) {
+            ent->count++;
+            if (ent->last != prevval || ent->first->obj != val->obj) {
+                ent->contig = FALSE;
+            }
+            ent->last = val;
+        } else {
+            chidx_new_entry(parent, link, hash, val);
+        }
+        prevval = val;
+    }
+
+}  /* chidx_build */
+
+
+/********************************************************************
+* FUNCTION chidx_add
+* 
+* Update the child name index after a child node has
+* been linked into the childQ of its parent
+*
+* INPUTS:
+*    parent == parent value node
+*    child == child node that was just added
+*********************************************************************/
+static void
+    chidx_add (val_value_t *parent,
+               val_value_t *child)
+{
+    val_chidx_ent_t **link, *ent;
+    val_value_t      *prev, *next, *val;
+    uint32            hash;
+
+    if (parent->chidx == NULL || child->name == NULL) {
+        return;
+    }
+
+    prev = prev_named_sibling(child);
+    next = next_named_sibling(child);
+
+    /* a new node between 2 instances of another name
+     * splits the run of that name
+     */
+    if (prev && next && prev->name != NULL &&
+        !xml_strcmp(prev->name, next->name) &&
+        xml_strcmp(prev->name, child->name)) {
+        ent = *chidx_find(parent->chidx, prev->name,
+                          chidx_hash(prev->name));
+        if (ent) {
+            ent->contig = FALSE;
+        }
+    }
+
+    hash = chidx_hash(child->name);
+    link = chidx_find(parent->chidx, child->name, hash);
+    ent = *link;
+    if (ent == NULL) {
+        chidx_new_entry(parent, link, hash, child);
+        return;
+    }
+
+    ent->count++;
+    if (child->obj != ent->first->obj) {
+        ent->contig = FALSE;
+    }
+
+    /* check if the new node is now the first or last instance;
+     * the common cases of a node added next to one of its
+     * siblings do not need a walk
+     */
+    if (prev && !xml_strcmp(prev->name, child->name)) {
+        if (prev == ent->last) {
+            ent->last = child;
+        }
+    } else if (next && !xml_strcmp(next->name, child->name)) {
+        if (next == ent->first) {
+            ent->first = child;
+        }
+    } else {
+        ent->contig = FALSE;
+        if (prev == NULL) {
+            ent->first = child;
+        } else if (next == NULL) {
+            ent->last = child;
+        } else {
+            for (val = next; val != NULL;
+                 val = (val_value_t *)dlq_nextEntry(val)) {
+                if (val->name && !xml_strcmp(val->name, child->name)) {
+                    break;
+                }
+            }
+            if (val == NULL) {
+                ent->last = child;
+            } else if (val == ent->first) {
+                ent->first = child;
+            }
+        }
+    }
+
+    if (ent->keytab) {
+        keytab_add(ent, child);
+    }
+
+}  /* chidx_add */
+
+
+/********************************************************************
+* FUNCTION chidx_remove
+* 
+* Update the child name index before a child node is
+* unlinked from the childQ of its parent
+*
+* INPUTS:
+*    parent == parent value node
+*    child == child node that is about to be removed
+*********************************************************************/
+static void
+    chidx_remove (val_value_t *parent,
+                  val_value_t *child)
+{
+    val_chidx_ent_t **link, *ent;
+    val_value_t      *val;
+
+    if (child->name == NULL || parent->chidx == NULL) {
+        return;
+    }
+
+    link = chidx_find(parent->chidx, child->name,
+                      chidx_hash(child->name));
+    ent = *link;
+    if (ent == NULL) {
+        return;
+    }
+
+    if (ent->keytab) {
+        keytab_remove(ent->keytab, child);
+    }
+
+    if (ent->count > 0) {
+        ent->count--;
+    }
+    if (ent->count == 0) {
+        *link = ent->next;
+        if (ent->keytab) {
+            keytab_free(ent->keytab);
+        }
+        m__free(ent);
+        parent->chidx->numentries--;
+        return;
+    }
+
+    /* removing a node never splits a run */
+    if (ent->first == child) {
+        for (val = (val_value_t *)dlq_nextEntry(child);
+             val != NULL;
+             val = (val_value_t *)dlq_nextEntry(val)) {
+            if (val->name && !xml_strcmp(val->name, child->name)) {
+                break;
+            }
+        }
+        if (val == NULL) {
+            /* count was off; should not happen */
+            val_reset_child_index(parent);
+            return;
+        }
+        ent->first = val;
+    }
+
+    if (ent->last == child) {
+        for (val = (val_value_t *)dlq_prevEntry(child);
+             val != NULL;
+             val = (val_value_t *)dlq_prevEntry(val)) {
+            if (val->name && !xml_strcmp(val->name, child->name)) {
+                break;
+            }
+        }
+        if (val == NULL) {
+            val_reset_child_index(parent);
+            return;
+        }
+        ent->last = val;
+    }
+
+}  /* chidx_remove */
+
+
+/********************************************************************
+* FUNCTION first_named_child
+* 
+* Get the first child node with the specified name,
+* including deleted nodes.  Starting a child search here
+* gives the same result as starting at the first child
+* for any match function that also compares the name.
+*
+* A linear search that has to step over too many
+* siblings builds the child name index for the parent
+* so the next search is done with a hash lookup
+*
+* INPUTS:
+*    parent == complex value node to check
+*    name == child name to find
+*
+* RETURNS:
+*   pointer to the first child with this name or NULL if none
+*********************************************************************/
+static val_value_t *
+    first_named_child (const val_value_t *parent,
+                       const xmlChar *name)
+{
+    /* the index is a cache so it is built even for a const parent */
+    val_value_t       *useparent = (val_value_t *)parent;
+    val_chidx_ent_t   *ent;
+    val_value_t       *val;
+    uint32             cnt;
+
+    if (name == NULL) {
+        return (val_value_t *)dlq_firstEntry(&useparent->v.childQ);
+    }
+
+    if (useparent->chidx) {
+        ent = *chidx_find(useparent->chidx, name, chidx_hash(name));
+        if (ent == NULL) {
+            return NULL;
+        }
+        if (ent->first->parent == useparent) {
+            return ent->first;
+        }
+
+        /* the childQ was moved without the val functions */
+        if (!chidx_frozen) {
+            chidx_free(useparent);
+        }
+    }
+
+    cnt = 0;
+    for (val = (val_value_t *)dlq_firstEntry(&useparent->v.childQ);
+         val != NULL;
+         val = (val_value_t *)dlq_nextEntry(val)) {
+        if (val->name && !xml_strcmp(val->name, name)) {
+            break;
+        }
+        cnt++;
+    }
+
+    if (cnt > VAL_CHIDX_THRESHOLD && useparent->chidx == NULL &&
+        !chidx_frozen) {
+        chidx_build(useparent);
+    }
+    return val;
+
+}  /* first_named_child */
 
 
 /********************************************************************
-* FUNCTION pattern_match
+* FUNCTION last_run_child
 * 
-* Check the specified string against the specified pattern
+* Get the last instance of a child node name if all the
+* instances form one run starting at the specified node
 *
 * INPUTS:
-*    pattern == compiled pattern to use 
-*    strval == string to check
+*    parent == complex value node to check
+*    curval == first non-deleted instance of the child node
 *
 * RETURNS:
-*    TRUE is string matches pattern; FALSE otherwise
+*   pointer to the last instance of the run, or NULL
+*   if the run has to be walked to find its end
 *********************************************************************/
-static boolean
-    pattern_match (const xmlRegexpPtr pattern,
-                   const xmlChar *strval)
+static val_value_t *
+    last_run_child (val_value_t *parent,
+                    val_value_t *curval)
 {
-    int ret;
+    val_chidx_ent_t   *ent;
 
-    ret = xmlRegexpExec(pattern, strval);
-    if (ret==1) {
-        return TRUE;
-    } else if (ret==0) {
-        return FALSE;
-    } else if (ret < 0) {
-        /* pattern match execution error, but compiled ok */
-        SET_ERROR(ERR_NCX_INVALID_PATTERN);
-        return FALSE;
-    } else {
-        SET_ERROR(ERR_INTERNAL_VAL);
-        return FALSE;
+    if (parent->chidx == NULL || curval->name == NULL) {
+        return NULL;
     }
-    /*NOTREACHED*/
 
-} /* pattern_match */
+    ent = *chidx_find(parent->chidx, curval->name,
+                      chidx_hash(curval->name));
+    if (ent == NULL || !ent->contig || ent->first != curval ||
+        VAL_IS_DELETED(ent->last) || ent->last->obj != curval->obj) {
+        return NULL;
+    }
+    return ent->last;
+
+}  /* last_run_child */
 
 
 /********************************************************************
-* FUNCTION check_svalQ_enum
+* FUNCTION child_match
 * 
-* Check all the ncx_enum_t structs in a queue of typ_sval_t 
+* Check if a child node is an instance of the child value
+* used by val_first_child_match and val_next_child_match
 *
 * INPUTS:
-*    name == enum string
-*    checkQ == pointer to Q of typ_sval_t to check
-*    reten == address of return typ_enum_t
-* 
-* OUTPUTS:
-*    *reten == typ_enum_t found if matched (res == NO_ERR)
+*    val == child node of the parent to check
+*    child == child value to find (e.g., from a NETCONF PDU)
+*
 * RETURNS:
-*    status, NO_ERR if string value is in the set
+*   TRUE if val matches child
 *********************************************************************/
-static status_t
-    check_svalQ_enum (const xmlChar *name,
-                      const dlq_hdr_t *checkQ,
-                      typ_enum_t  **reten)
+static boolean
+    child_match (val_value_t *val,
+                 val_value_t *child)
 {
-    typ_enum_t  *en;
+    if (VAL_IS_DELETED(val)) {
+        return FALSE;
+    }
 
-    /* check this typdef for restrictions */
-    for (en = (typ_enum_t *)dlq_firstEntry(checkQ);
-         en != NULL;
-         en = (typ_enum_t *)dlq_nextEntry(en)) {
+    /* check the node if the QName matches */
+    if (val->nsid == child->nsid &&
+        !xml_strcmp(val->name, child->name)) {
 
-        if (!xml_strcmp(name, en->name)) {
-            *reten = en;
-            return NO_ERR;
+        if (val->btyp == NCX_BT_LIST) {
+            /* match the instance identifiers, if any */
+            if (val_index_match(child, val)) {
+                return TRUE;
+            }
+        } else if (val->obj->objtype == OBJ_TYP_LEAF_LIST) {
+            if (val->btyp == child->btyp) {
+                /* find the leaf-list with the same value */
+                if (!val_compare(val, child)) {
+                    return TRUE;
+                }
+            } else {
+                /* match any value; if this is a subtree
+                 * filter test, it is not for a content match
+                 * node
+                 */
+                return TRUE;
+            }
+        } else {
+            /* can only be this one instance */
+            return TRUE;
         }
     }
-    return ERR_NCX_NOT_FOUND;
-
-} /* check_svalQ_enum */
+    return FALSE;
 
+}  /* child_match */
 
 
 /********************************************************************
-* FUNCTION free_editvars
+* FUNCTION find_keyed_child
 * 
-* Clean and free the val->editvars field
+* Use the list key index to find the first list entry
+* matching a list child value
+*
+* The key index for a list is built once the parent has
+* more than VAL_CHIDX_THRESHOLD instances of it.
+* If more than one entry matches, the caller has to scan
+* the childQ to find the first one in document order.
 *
 * INPUTS:
-*    val == val_value_t data structure to use
+*    parent == parent value to check
+*    child == list value to find (e.g., from a NETCONF PDU)
+*    retval == address of return match
 *
 * OUTPUTS:
-*    val->editvars is cleaned, freed, and set to NULL
+*    *retval == the matching entry or NULL if none, if TRUE returned
+*
+* RETURNS:
+*   TRUE if the key index was used; FALSE if a linear scan is needed
 *********************************************************************/
-static void
-    free_editvars (val_value_t *val)
+static boolean
+    find_keyed_child (val_value_t *parent,
+                      val_value_t *child,
+                      val_value_t **retval)
 {
-    if (val->editvars) {
-#ifdef VAL_EDITVARS_DEBUG
-        log_debug3("\n\nfree_editvars: %s: %d = %p\n",
-                   (val->name) ? val->name : NCX_EL_NONE,
-                   ++editvars_free,
-                   val->editvars);
-#endif
+    val_chidx_ent_t  *ent;
+    val_keytab_t     *keytab;
+    val_keyent_t     *kent;
+    val_value_t      *match;
+    uint32            hash, i;
 
-        if (val->editvars->insertstr) {
-            m__free(val->editvars->insertstr);
+    *retval = NULL;
+
+    if (parent->chidx == NULL || child->name == NULL ||
+        child->btyp != NCX_BT_LIST) {
+        return FALSE;
+    }
+
+    ent = *chidx_find(parent->chidx, child->name, chidx_hash(child->name));
+    if (ent == NULL) {
+        return TRUE;
+    }
+    if (ent->first->parent != parent) {
+        if (!chidx_frozen) {
+            chidx_free(parent);
         }
+        return FALSE;
+    }
 
-        if (val->editvars->insertxpcb) {
-            xpath_free_pcb(val->editvars->insertxpcb);
+    if (ent->keytab == NULL) {
+        if (ent->nokeytab || ent->count <= VAL_CHIDX_THRESHOLD ||
+            chidx_frozen) {
+            return FALSE;
         }
+        keytab_build(ent);
+        if (ent->keytab == NULL) {
+            return FALSE;
+        }
+    }
+    keytab = ent->keytab;
 
-        m__free(val->editvars);
-        val->editvars = NULL;
-    } else {
-#ifdef VAL_EDITVARS_DEBUG
-        log_debug3("\nval_free_editvars skipped (%u, %s)",
-                   editvars_free, 
-                   val->name);
-#endif
+    if (child->obj != keytab->obj || !key_hash(child, &hash)) {
+        return FALSE;
     }
 
-}  /* free_editvars */
+    /* the pending entries are checked below if they stay pending */
+    if (!chidx_frozen) {
+        keytab_drain(keytab);
+    }
+
+    match = NULL;
+    for (kent = keytab->buckets[hash & (keytab->numbuckets - 1)];
+         kent != NULL;
+         kent = kent->next) {
+        if (kent->hash == hash && child_match(kent->val, child)) {
+            if (match) {
+                return FALSE;
+            }
+            match = kent->val;
+        }
+    }
+    for (i = 0; i < keytab->pendcnt; i++) {
+        if (child_match(keytab->pend[i], child)) {
+            if (match) {
+                return FALSE;
+            }
+            match = keytab->pend[i];
+        }
+    }
+
+    *retval = match;
+    return TRUE;
+
+}  /* find_keyed_child */
 
 
 /********************************************************************
@@ -489,6 +1637,8 @@ static void
         free_editvars(val);
     }
 
+    chidx_free(val);
+
     /* clean the val->v union, depending on base type */
     switch (btyp) {
     case NCX_BT_INT8:
@@ -607,7 +1757,18 @@ static status_t
     /* need to replace the current value or merge a list, etc. */
     switch (btyp) {
     case NCX_BT_ENUM:
-        dest->v.enu.name = src->v.enu.name;
+        /* do not leave the old malloced name behind;
+         * val_clone uses dname if it is set */
+        ncx_clean_enum(&dest->v.enu);
+        if (src->v.enu.dname != NULL) {
+            dest->v.enu.dname = xml_strdup(src->v.enu.dname);
+            if (dest->v.enu.dname == NULL) {
+                res = ERR_INTERNAL_MEM;
+            }
+            dest->v.enu.name = dest->v.enu.dname;
+        } else {
+            dest->v.enu.name = src->v.enu.name;
+        }
         dest->v.enu.val = src->v.enu.val;
         break;
     case NCX_BT_EMPTY:
@@ -1071,7 +2232,9 @@ static void
     realval->nsid = virval->nsid;
     realval->obj = virval->obj;
     realval->typdef = virval->typdef;
-    realval->flags = virval->flags;
+    realval->flags = virval->flags &
+        ~(VAL_FL_SUBTREE_GETCB | VAL_FL_VIRTUAL_PARTIAL |
+          VAL_FL_STREAM_GETCB);
     realval->btyp = virval->btyp;
     realval->dataclass = virval->dataclass;
     realval->parent = virval->parent;
@@ -1155,6 +2318,44 @@ static status_t
 }  /* copy_editvars */
 
 
+/********************************************************************
+* FUNCTION fill_virtual_stream
+* 
+* Get all the child nodes from an iterator get callback
+* and add them to the virtual value being cached
+*
+* INPUTS:
+*   scb == session control block getting the virtual value
+*   val == virtual container with the iterator callback
+*   retval == value to add the child nodes to
+*
+* RETURNS:
+*   status
+*********************************************************************/
+static status_t
+    fill_virtual_stream (ses_cb_t *scb,
+                         val_value_t *val,
+                         val_value_t *retval)
+{
+    val_value_t   *chval;
+    getcb_iter_t   iter;
+    status_t       res;
+
+    memset(&iter, 0x0, sizeof(getcb_iter_t));
+    res = NO_ERR;
+
+    for (chval = val_get_virtual_next(scb, val, &iter, &res);
+         chval != NULL;
+         chval = val_get_virtual_next(scb, val, &iter, &res)) {
+        val_add_child(chval, retval);
+    }
+    val_get_virtual_done(scb, val, &iter);
+
+    return (res == ERR_NCX_NO_INSTANCE) ? NO_ERR : res;
+
+}  /* fill_virtual_stream */
+
+
 /********************************************************************
 * FUNCTION cache_virtual_value
 * 
@@ -1168,10 +2369,16 @@ static status_t
 * This will be returned if virtual value has no
 * instance at this time.
 *
+* A subtree get callback may return a partial value for
+* a non-NULL selection; that value is not cached and is
+* owned by the caller
+*
 * INPUTS:
 *   scb == session control block getting the virtual value
 *          the scb->cache_timeout value will be used
 *          id scb is not NULL
+*   select == selection to pass to a subtree get callback
+*             NULL if the entire subtree is needed
 *   val == virtual value to get value for
 *   res == pointer to output function return status value
 *
@@ -1188,15 +2395,17 @@ static status_t
 *********************************************************************/
 static val_value_t *
     cache_virtual_value (ses_cb_t *scb,
+                         const getcb_select_t *select,
                          val_value_t *val,
                          status_t *res)
 {
-    val_value_t *retval;
-    getcb_fn_t   getcb;
-    time_t       timenow;
-    double       timediff, timerval;
-    uint32       deftimeout;
-    boolean      disable_cache;
+    val_value_t        *retval;
+    getcb_fn_t          getcb;
+    getcb_subtree_fn_t  subtreecb;
+    time_t              timenow;
+    double              timediff, timerval;
+    uint32              deftimeout;
+    boolean             disable_cache;
 
     *res = NO_ERR;
 
@@ -1205,8 +2414,6 @@ static val_value_t *
         return NULL;
     }
 
-    getcb = (getcb_fn_t)val->getcb;
-
     if (val->virtualval != NULL) {
         /* already have a value; check if it is fresh enough */
         (void)uptime(&timenow);
@@ -1248,11 +2455,25 @@ static val_value_t *
     setup_virtual_retval(val, retval);
     (void)uptime(&val->cachetime);
 
-    *res = (*getcb)(NULL, GETCB_GET_VALUE, val, retval);
+    if (val->flags & VAL_FL_SUBTREE_GETCB) {
+        subtreecb = (getcb_subtree_fn_t)val->getcb;
+        *res = (*subtreecb)(scb, select, val, retval);
+    } else if (val->flags & VAL_FL_STREAM_GETCB) {
+        *res = fill_virtual_stream(scb, val, retval);
+    } else {
+        getcb = (getcb_fn_t)val->getcb;
+        *res = (*getcb)(NULL, GETCB_GET_VALUE, val, retval);
+    }
+
     if (*res != NO_ERR) {
         val_free_value(retval);
         retval = NULL;
+    } else if (select != NULL &&
+               (retval->flags & VAL_FL_VIRTUAL_PARTIAL)) {
+        /* only good for this selection; the caller owns it */
+        retval->parent = val->parent;
     } else {
+        retval->flags &= ~VAL_FL_VIRTUAL_PARTIAL;
         val->virtualval = retval;
         val->virtualval->parent = val->parent;
     }
@@ -1613,6 +2834,73 @@ void
 }  /* val_init_virtual */
 
 
+/********************************************************************
+* FUNCTION val_init_virtual_subtree
+* 
+* Special function to initialize a virtual container or list
+* node that is filled in by one subtree get callback
+*
+* MUST CALL val_new_value FIRST
+*
+* INPUTS:
+*   val == pointer to the malloced struct to initialize
+*   cbfn == getcb_subtree_fn_t callback function to use
+*   obj == object template to use
+*********************************************************************/
+void
+    val_init_virtual_subtree (val_value_t *val,
+                              void  *cbfn,
+                              obj_template_t *obj)
+{
+#ifdef DEBUG
+    if (!val || !cbfn || !obj) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return;
+    }
+#endif
+
+    val_init_virtual(val, cbfn, obj);
+    val->flags |= VAL_FL_SUBTREE_GETCB;
+
+}  /* val_init_virtual_subtree */
+
+
+/********************************************************************
+* FUNCTION val_init_virtual_stream
+* 
+* Special function to initialize a virtual container node
+* whose child nodes are returned one at a time by an
+* iterator get callback
+*
+* MUST CALL val_new_value FIRST
+*
+* INPUTS:
+*   val == pointer to the malloced struct to initialize
+*   cbfn == getcb_iter_fn_t callback function to use
+*   obj == object template to use
+*********************************************************************/
+void
+    val_init_virtual_stream (val_value_t *val,
+                             void  *cbfn,
+                             obj_template_t *obj)
+{
+#ifdef DEBUG
+    if (!val || !cbfn || !obj) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return;
+    }
+    if (obj->objtype != OBJ_TYP_CONTAINER) {
+        SET_ERROR(ERR_INTERNAL_VAL);
+        return;
+    }
+#endif
+
+    val_init_virtual(val, cbfn, obj);
+    val->flags |= VAL_FL_STREAM_GETCB;
+
+}  /* val_init_virtual_stream */
+
+
 /********************************************************************
 * FUNCTION val_init_from_template
 * 
@@ -5411,29 +6699,27 @@ void
 
     child->parent = parent;
     dlq_enque(child, &parent->v.childQ);
+    chidx_add(parent, child);
 
 }   /* val_add_child */
 
 
 /********************************************************************
-* FUNCTION val_add_child_sorted
+* FUNCTION link_child_sorted
 * 
-*   Add a child value node to a parent value node
-*   in the proper place
+*   Link a child value node into the childQ of a parent
+*   value node in the proper place
+*   Does not update the parent child name index
 *
 * INPUTS:
 *    child == node to store in the parent
 *    parent == complex value node with a childQ
 *
 *********************************************************************/
-void
-    val_add_child_sorted (val_value_t *child,
-                          val_value_t *parent)
+static void
+    link_child_sorted (val_value_t *child,
+                       val_value_t *parent)
 {
-    assert( child && "child is NULL!" );
-    assert( parent && "parent is NULL!" );
-
-    child->parent = parent;
     dlq_hdr_t *childQ = &parent->v.childQ;
 
     /* check new first entry */
@@ -5470,6 +6756,27 @@ void
                 /* make a new sorted or last one of these entries */
                 boolean syssorted = ncx_get_system_sorted();
                 boolean done = FALSE;
+                uint32 cnt = 0;
+
+                /* jump to the end of the run if it is known and
+                 * the new entry does not sort ahead of the last one
+                 */
+                val_value_t *lastval = last_run_child(parent, curval);
+                if (lastval) {
+                    if (sysorder && syssorted) {
+                        if (newobj->objtype == OBJ_TYP_LIST) {
+                            ret = val_index_compare(child, lastval);
+                        } else {
+                            ret = val_compare(child, lastval);
+                        }
+                    } else {
+                        ret = 0;
+                    }
+                    if (ret >= 0) {
+                        dlq_insertAfter(child, lastval);
+                        return;
+                    }
+                }
 
                 while (!done) {
                     if (sysorder && syssorted) {
@@ -5488,8 +6795,12 @@ void
                         done = TRUE;
                     } else {
                         curval = nextchild;
+                        cnt++;
                     }
                 }
+                if (cnt > VAL_CHIDX_THRESHOLD && parent->chidx == NULL) {
+                    chidx_build(parent);
+                }
                 dlq_insertAfter(child, curval);
                 return;
             }
@@ -5543,6 +6854,27 @@ void
                 /* make a new last one of these entries */
                 boolean syssorted = ncx_get_system_sorted();
                 boolean done = FALSE;
+                uint32 cnt = 0;
+
+                /* jump to the end of the run if it is known and
+                 * the new entry does not sort ahead of the last one
+                 */
+                val_value_t *lastval = last_run_child(parent, curval);
+                if (lastval) {
+                    if (sysorder && syssorted) {
+                        if (newobj->objtype == OBJ_TYP_LIST) {
+                            ret = val_index_compare(child, lastval);
+                        } else {
+                            ret = val_compare(child, lastval);
+                        }
+                    } else {
+                        ret = 0;
+                    }
+                    if (ret >= 0) {
+                        dlq_insertAfter(child, lastval);
+                        return;
+                    }
+                }
 
                 while (!done) {
                     if (sysorder && syssorted) {
@@ -5562,8 +6894,12 @@ void
                         done = TRUE;
                     } else {
                         curval = nextchild;
+                        cnt++;
                     }              
                 }
+                if (cnt > VAL_CHIDX_THRESHOLD && parent->chidx == NULL) {
+                    chidx_build(parent);
+                }
 
                 /* make a new last instance of this node type */
                 dlq_insertAfter(child, curval);
@@ -5600,9 +6936,34 @@ void
             }
         }
 
-        /* make a new last entry */
-        dlq_enque(child, childQ);
-    }
+        /* make a new last entry */
+        dlq_enque(child, childQ);
+    }
+
+}   /* link_child_sorted */
+
+
+/********************************************************************
+* FUNCTION val_add_child_sorted
+* 
+*   Add a child value node to a parent value node
+*   in the proper place
+*
+* INPUTS:
+*    child == node to store in the parent
+*    parent == complex value node with a childQ
+*
+*********************************************************************/
+void
+    val_add_child_sorted (val_value_t *child,
+                          val_value_t *parent)
+{
+    assert( child && "child is NULL!" );
+    assert( parent && "parent is NULL!" );
+
+    child->parent = parent;
+    link_child_sorted(child, parent);
+    chidx_add(parent, child);
 
 }   /* val_add_child_sorted */
 
@@ -5634,6 +6995,7 @@ void
     child->parent = parent;
     if (current) {
         dlq_insertAfter(child, current);
+        chidx_add(parent, child);
     } else {
         val_add_child_sorted(child, parent);
     }
@@ -5641,6 +7003,36 @@ void
 }   /* val_insert_child */
 
 
+/********************************************************************
+* FUNCTION val_insert_child_before
+* 
+*   Insert a child value node ahead of a current child node
+*
+* INPUTS:
+*    child == node to store in the parent
+*    current == current child node to insert ahead of
+*    parent == complex value node with a childQ
+*
+*********************************************************************/
+void
+    val_insert_child_before (val_value_t *child,
+                             val_value_t *current,
+                             val_value_t *parent)
+{
+#ifdef DEBUG
+    if (child == NULL || current == NULL || parent == NULL) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return;
+    }
+#endif
+
+    child->parent = parent;
+    dlq_insertAhead(child, current);
+    chidx_add(parent, child);
+
+}   /* val_insert_child_before */
+
+
 /********************************************************************
 * FUNCTION val_remove_child
 * 
@@ -5660,6 +7052,9 @@ void
     }
 #endif
 
+    if (child->parent) {
+        chidx_remove(child->parent, child);
+    }
     dlq_remove(child);
     child->parent = NULL;
 
@@ -5687,16 +7082,70 @@ void
     }
 #endif
 
-    newchild->parent = curchild->parent;
+    val_value_t *parent = curchild->parent;
+
+    newchild->parent = parent;
     newchild->getcb = curchild->getcb;
+    newchild->flags |= (curchild->flags &
+                        (VAL_FL_SUBTREE_GETCB | VAL_FL_STREAM_GETCB));
 
-    dlq_swap(newchild, curchild);
+    if (parent && parent->chidx) {
+        chidx_remove(parent, curchild);
+        dlq_swap(newchild, curchild);
+        chidx_add(parent, newchild);
+    } else {
+        dlq_swap(newchild, curchild);
+    }
 
     curchild->parent = NULL;
 
 }   /* val_swap_child */
 
 
+/********************************************************************
+* FUNCTION val_reset_child_index
+* 
+*   Drop the child name index of a complex value node
+*   Must be called after the childQ has been edited
+*   directly with dlq functions instead of val functions
+*   The index is rebuilt on demand by a later lookup
+*
+* INPUTS:
+*    parent == complex value node with a childQ
+*
+*********************************************************************/
+void
+    val_reset_child_index (val_value_t *parent)
+{
+    assert( parent && "parent is NULL!" );
+
+    chidx_free(parent);
+
+}   /* val_reset_child_index */
+
+
+/********************************************************************
+* FUNCTION val_freeze_child_index
+* 
+*   Stop or restart building and repairing the child name
+*   and list key indexes during lookups.  While frozen, a
+*   lookup that finds no usable index does a linear scan,
+*   so value trees can be searched by several threads
+*   at once as long as none of them is changed
+*
+* INPUTS:
+*    freeze == TRUE to stop changing the indexes in lookups
+*              FALSE to build them on demand again
+*
+*********************************************************************/
+void
+    val_freeze_child_index (boolean freeze)
+{
+    chidx_frozen = freeze;
+
+}   /* val_freeze_child_index */
+
+
 /********************************************************************
 * FUNCTION val_first_child_match
 * 
@@ -5714,6 +7163,7 @@ val_value_t *
                            val_value_t *child)
 {
     val_value_t *val;
+    uint32       cnt;
 
 #ifdef DEBUG
     if (!parent || !child) {
@@ -5726,44 +7176,26 @@ val_value_t *
         return NULL;
     }
 
-    for (val = (val_value_t *)dlq_firstEntry(&parent->v.childQ);
+    if (find_keyed_child(parent, child, &val)) {
+        return val;
+    }
+
+    cnt = 0;
+    for (val = first_named_child(parent, child->name);
          val != NULL;
          val = (val_value_t *)dlq_nextEntry(val)) {
-
-        if (VAL_IS_DELETED(val)) {
-            continue;
-        }
-
-        /* check the node if the QName matches */
-        if (val->nsid == child->nsid &&
-            !xml_strcmp(val->name, child->name)) {
-
-            if (val->btyp == NCX_BT_LIST) {
-                /* match the instance identifiers, if any */
-                if (val_index_match(child, val)) {
-                    return val;
-                }
-            } else if (val->obj->objtype == OBJ_TYP_LEAF_LIST) {
-                if (val->btyp == child->btyp) {
-                    /* find the leaf-list with the same value */
-                    if (!val_compare(val, child)) {
-                        return val;
-                    }
-                } else {
-                    /* match any value; if this is a subtree
-                     * filter test, it is not for a content match
-                     * node
-                     */
-                    return val;
-                }
-            } else {
-                /* can only be this one instance */
-                return val;
-            }
+        if (child_match(val, child)) {
+            break;
         }
+        cnt++;
     }
 
-    return NULL;
+    /* a long scan over list entries gets the list key index built */
+    if (cnt > VAL_CHIDX_THRESHOLD && parent->chidx == NULL &&
+        !chidx_frozen) {
+        chidx_build(parent);
+    }
+    return val;
 
 }  /* val_first_child_match */
 
@@ -5802,37 +7234,8 @@ val_value_t *
     for (val = (val_value_t *)dlq_nextEntry(curmatch);
          val != NULL;
          val = (val_value_t *)dlq_nextEntry(val)) {
-
-        if (VAL_IS_DELETED(val)) {
-            continue;
-        }
-
-        /* check the node if the QName matches */
-        if (val->nsid == child->nsid &&
-            !xml_strcmp(val->name, child->name)) {
-
-            if (val->btyp == NCX_BT_LIST) {
-                /* match the instance identifiers, if any */
-                if (val_index_match(child, val)) {
-                    return val;
-                }
-            } else if (val->obj->objtype == OBJ_TYP_LEAF_LIST) {
-                if (val->btyp == child->btyp) {
-                    /* find the leaf-list with the same value */
-                    if (!val_compare(val, child)) {
-                        return val;
-                    }
-                } else {
-                    /* match any value; if this is a subtree
-                     * filter test, it is not for a content match
-                     * node
-                     */
-                    return val;
-                }
-            } else {
-                /* can only be this one instance */
-                return val;
-            }
+        if (child_match(val, child)) {
+            return val;
         }
     }
 
@@ -5949,7 +7352,7 @@ val_value_t *
         return NULL;
     }
 
-    for (val = (val_value_t *)dlq_firstEntry(&parent->v.childQ);
+    for (val = first_named_child(parent, childname);
          val != NULL;
          val = (val_value_t *)dlq_nextEntry(val)) {
         if (VAL_IS_DELETED(val)) {
@@ -6002,8 +7405,13 @@ val_value_t *
     }
 #endif
 
-    for (val = (val_value_t *)dlq_firstEntry(childQ);
-         val != NULL;
+    /* use the child name index if this is the childQ of a value */
+    val = (val_value_t *)dlq_firstEntry(childQ);
+    if (val && val->parent && childQ == &val->parent->v.childQ) {
+        val = first_named_child(val->parent, childname);
+    }
+
+    for (; val != NULL;
          val = (val_value_t *)dlq_nextEntry(val)) {
         if (VAL_IS_DELETED(val)) {
             continue;
@@ -6166,7 +7574,7 @@ val_value_t *
         return NULL;
     }
         
-    for (val = (val_value_t *)dlq_firstEntry(&parent->v.childQ);
+    for (val = first_named_child(parent, name);
          val != NULL;
          val = (val_value_t *)dlq_nextEntry(val)) {
 
@@ -6216,7 +7624,7 @@ val_value_t *
         return NULL;
     }
         
-    for (val = (val_value_t *)dlq_firstEntry(&parent->v.childQ);
+    for (val = first_named_child(parent, name);
          val != NULL;
          val = (val_value_t *)dlq_nextEntry(val)) {
 
@@ -6331,7 +7739,7 @@ val_value_t *
         return NULL;
     }
         
-    for (val = (val_value_t *)dlq_firstEntry(&parent->v.childQ);
+    for (val = first_named_child(parent, name);
          val != NULL;
          val = (val_value_t *)dlq_nextEntry(val)) {
 
@@ -6436,7 +7844,7 @@ uint32
     }
         
     cnt = 0;
-    for (val = (const val_value_t *)dlq_firstEntry(&parent->v.childQ);
+    for (val = first_named_child(parent, name);
          val != NULL;
          val = (const val_value_t *)dlq_nextEntry(val)) {
 
@@ -6521,7 +7929,7 @@ boolean
 
     if (val_is_virtual(startnode)) {
         res = NO_ERR;
-        useval = cache_virtual_value(NULL, startnode, &res);
+        useval = cache_virtual_value(NULL, NULL, startnode, &res);
         if (useval == NULL) {
             return FALSE;
         }
@@ -6700,7 +8108,7 @@ boolean
 
     if (val_is_virtual(startnode)) {
         res = NO_ERR;
-        useval = cache_virtual_value(NULL, startnode, &res);
+        useval = cache_virtual_value(NULL, NULL, startnode, &res);
         if (useval == NULL) {
             return res;
         }
@@ -6876,7 +8284,7 @@ boolean
 
         if (val_is_virtual(val)) {
             res = NO_ERR;
-            useval = cache_virtual_value(NULL, val, &res);
+            useval = cache_virtual_value(NULL, NULL, val, &res);
             if (useval == NULL) {
                 return res;
             }
@@ -7038,7 +8446,7 @@ boolean
 
         if (val_is_virtual(val)) {
             res = NO_ERR;
-            useval = cache_virtual_value(NULL, val, &res);
+            useval = cache_virtual_value(NULL, NULL, val, &res);
             if (useval == NULL) {
                 return FALSE;
             }
@@ -9050,12 +10458,252 @@ val_value_t *
 #endif
 
     scb = (ses_cb_t *)session;
-    retval = cache_virtual_value(scb, val, res);
+    retval = cache_virtual_value(scb, NULL, val, res);
     return retval;
 
 }  /* val_get_virtual_value */
 
 
+/********************************************************************
+* FUNCTION val_get_virtual_subtree
+* 
+* Get the value of a virtual node for a specific selection
+* Same as val_get_virtual_value except a subtree get callback
+* is told which descendant nodes are going to be used.
+* A plain getcb_fn_t callback ignores the selection.
+*
+* If the callback returns a partial result (val_is_virtual_partial)
+* it is not cached and the caller must free it with val_free_value
+*
+* Caller should check for *res == ERR_NCX_SKIPPED
+*
+* INPUTS:
+*   session == session CB ptr cast as void *
+*              that is getting the virtual value
+*   select == getcb_select_t selection cast as void *
+*             NULL if the entire subtree is needed
+*   val == virtual value to get value for
+*   res == pointer to output function return status value
+*
+* OUTPUTS:
+*    val->virtualval will be set with the cached return value
+*      unless the result is partial
+*    *res == the function return status
+*
+* RETURNS:
+*   pointer to the cached value or the malloced partial value
+*********************************************************************/
+val_value_t *
+    val_get_virtual_subtree (void *session,
+                             const void *select,
+                             val_value_t *val,
+                             status_t *res)
+{
+#ifdef DEBUG
+    if (!val || !res) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return NULL;
+    }
+    if (!val->getcb) {
+        *res = SET_ERROR(ERR_INTERNAL_VAL);
+        return NULL;
+    }
+#endif
+
+    return cache_virtual_value((ses_cb_t *)session,
+                               (const getcb_select_t *)select,
+                               val,
+                               res);
+
+}  /* val_get_virtual_subtree */
+
+
+/********************************************************************
+* FUNCTION val_set_virtual_partial
+* 
+* Mark a value returned by a subtree get callback as
+* holding only the nodes for the selection it was given
+*
+* INPUTS:
+*   val == dstval filled in by the subtree get callback
+*********************************************************************/
+void
+    val_set_virtual_partial (val_value_t *val)
+{
+#ifdef DEBUG
+    if (!val) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return;
+    }
+#endif
+
+    val->flags |= VAL_FL_VIRTUAL_PARTIAL;
+
+}  /* val_set_virtual_partial */
+
+
+/********************************************************************
+* FUNCTION val_is_virtual_partial
+* 
+* Check if a virtual value result only holds the selected nodes
+*
+* INPUTS:
+*   val == value returned by val_get_virtual_subtree
+*
+* RETURNS:
+*   TRUE if val is partial and owned by the caller
+*   FALSE otherwise
+*********************************************************************/
+boolean
+    val_is_virtual_partial (const val_value_t *val)
+{
+#ifdef DEBUG
+    if (!val) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return FALSE;
+    }
+#endif
+
+    return (val->flags & VAL_FL_VIRTUAL_PARTIAL) ? TRUE : FALSE;
+
+}  /* val_is_virtual_partial */
+
+
+/********************************************************************
+* FUNCTION val_is_virtual_stream
+* 
+* Check if the specified value is a virtual container
+* with an iterator get callback
+*
+* INPUTS:
+*   val == value to check
+*   
+* RETURNS:
+*   TRUE if the child nodes can be retrieved one at a time
+*   FALSE otherwise
+*********************************************************************/
+boolean
+    val_is_virtual_stream (const val_value_t *val)
+{
+#ifdef DEBUG
+    if (!val) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return FALSE;
+    }
+#endif
+
+    return (val->getcb && (val->flags & VAL_FL_STREAM_GETCB))
+        ? TRUE : FALSE;
+
+}  /* val_is_virtual_stream */
+
+
+/********************************************************************
+* FUNCTION val_get_virtual_next
+* 
+* Get the next child node from a virtual container
+* with an iterator get callback
+*
+* The caller must call val_get_virtual_done when finished,
+* even if *res is an error
+*
+* INPUTS:
+*   session == session CB ptr cast as void *
+*              that is getting the virtual value
+*   val == virtual container to get the next child for
+*   iter == getcb_iter_t iterator state cast as void *
+*           set to zero before the first call
+*   res == pointer to output function return status value
+*
+* OUTPUTS:
+*    *res == the function return status
+*            ERR_NCX_NO_INSTANCE if there are no more child nodes
+*
+* RETURNS:
+*   malloced child node; parent set to val but not added to val
+*   The caller must free it with val_free_value
+*   NULL if no more child nodes or some error
+*********************************************************************/
+val_value_t *
+    val_get_virtual_next (void *session,
+                          val_value_t *val,
+                          void *iter,
+                          status_t *res)
+{
+    getcb_iter_fn_t  itercb;
+    getcb_iter_t    *myiter;
+    val_value_t     *chval;
+
+#ifdef DEBUG
+    if (!val || !iter || !res) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return NULL;
+    }
+    if (!val_is_virtual_stream(val)) {
+        *res = SET_ERROR(ERR_INTERNAL_VAL);
+        return NULL;
+    }
+#endif
+
+    itercb = (getcb_iter_fn_t)val->getcb;
+    myiter = (getcb_iter_t *)iter;
+
+    chval = val_new_value();
+    if (!chval) {
+        *res = ERR_INTERNAL_MEM;
+        return NULL;
+    }
+
+    *res = (*itercb)((ses_cb_t *)session, GETCB_GET_NEXT,
+                     myiter, val, chval);
+    if (*res != NO_ERR) {
+        val_free_value(chval);
+        return NULL;
+    }
+
+    chval->parent = val;
+    myiter->count++;
+    return chval;
+
+}  /* val_get_virtual_next */
+
+
+/********************************************************************
+* FUNCTION val_get_virtual_done
+* 
+* Finish the iteration over a virtual container
+* started with val_get_virtual_next
+*
+* INPUTS:
+*   session == session CB ptr cast as void *
+*   val == virtual container being iterated
+*   iter == getcb_iter_t iterator state cast as void *
+*********************************************************************/
+void
+    val_get_virtual_done (void *session,
+                          val_value_t *val,
+                          void *iter)
+{
+    getcb_iter_fn_t  itercb;
+
+#ifdef DEBUG
+    if (!val || !iter) {
+        SET_ERROR(ERR_INTERNAL_PTR);
+        return;
+    }
+    if (!val_is_virtual_stream(val)) {
+        SET_ERROR(ERR_INTERNAL_VAL);
+        return;
+    }
+#endif
+
+    itercb = (getcb_iter_fn_t)val->getcb;
+    (void)(*itercb)((ses_cb_t *)session, GETCB_GET_DONE,
+                    (getcb_iter_t *)iter, val, NULL);
+
+}  /* val_get_virtual_done */
+
+
 /********************************************************************
 * FUNCTION val_is_default
 * 
@@ -10280,6 +11928,8 @@ void
 
     /* move all the entries at once */
     dlq_block_enque(&srcval->v.childQ, &destval->v.childQ);
+    chidx_free(srcval);
+    chidx_free(destval);
 
 }  /* val_move_children */
 
@@ -115,6 +115,14 @@ extern "C" {
 /* max number of concurrent partial locks by the same session */
 #define VAL_MAX_PLOCKS  4
 
+/* a complex value gets a child name index once a linear
+ * child lookup has to step over this many siblings
+ */
+#define VAL_CHIDX_THRESHOLD     32
+
+/* initial number of hash buckets in a child name index */
+#define VAL_CHIDX_INIT_BUCKETS  16
+
 /* maximum number of bytes in a number string */
 #define VAL_MAX_NUMLEN  NCX_MAX_NUMLEN
 
@@ -179,6 +187,17 @@ extern "C" {
  */
 #define VAL_FL_SUBTREE_DIRTY bit10
 
+/* if set, val->getcb is a getcb_subtree_fn_t instead of a getcb_fn_t */
+#define VAL_FL_SUBTREE_GETCB bit11
+
+/* if set, this virtual value result only holds the nodes
+ * for the selection it was retrieved for; it is not cached
+ */
+#define VAL_FL_VIRTUAL_PARTIAL bit12
+
+/* if set, val->getcb is a getcb_iter_fn_t instead of a getcb_fn_t */
+#define VAL_FL_STREAM_GETCB bit13
+
 /* set the virtualval lifetime to 3 seconds */
 #define VAL_VIRTUAL_CACHE_TIME   3
 
@@ -359,6 +378,13 @@ typedef struct val_value_t_ {
      */
     plock_cb_t  *plock[VAL_MAX_PLOCKS];
 
+    /* lazily built name index of the childQ for complex types;
+     * maintained by the val_add/insert/remove/swap_child functions
+     * and dropped by val_reset_child_index if the childQ is
+     * edited directly
+     */
+    struct val_chidx_t_ *chidx;
+
     /* union of all the NCX-specific sub-types
      * note that the following invisible constructs should
      * never show up in this struct:
@@ -517,6 +543,45 @@ extern void
 		      struct obj_template_t_ *obj);
 
 
+/********************************************************************
+* FUNCTION val_init_virtual_subtree
+* 
+* Special function to initialize a virtual container or list
+* node that is filled in by one subtree get callback
+*
+* MUST CALL val_new_value FIRST
+*
+* INPUTS:
+*   val == pointer to the malloced struct to initialize
+*   cbfn == getcb_subtree_fn_t callback function to use
+*   obj == object template to use
+*********************************************************************/
+extern void
+    val_init_virtual_subtree (val_value_t *val,
+			      void *cbfn,
+			      struct obj_template_t_ *obj);
+
+
+/********************************************************************
+* FUNCTION val_init_virtual_stream
+* 
+* Special function to initialize a virtual container node
+* whose child nodes are returned one at a time by an
+* iterator get callback
+*
+* MUST CALL val_new_value FIRST
+*
+* INPUTS:
+*   val == pointer to the malloced struct to initialize
+*   cbfn == getcb_iter_fn_t callback function to use
+*   obj == object template to use
+*********************************************************************/
+extern void
+    val_init_virtual_stream (val_value_t *val,
+			     void *cbfn,
+			     struct obj_template_t_ *obj);
+
+
 /********************************************************************
 * FUNCTION val_init_from_template
 * 
@@ -1765,6 +1830,23 @@ extern void
 		      val_value_t *parent);
 
 
+/********************************************************************
+* FUNCTION val_insert_child_before
+* 
+*   Insert a child value node ahead of a current child node
+*
+* INPUTS:
+*    child == node to store in the parent
+*    current == current child node to insert ahead of
+*    parent == complex value node with a childQ
+*
+*********************************************************************/
+extern void
+    val_insert_child_before (val_value_t *child,
+                             val_value_t *current,
+                             val_value_t *parent);
+
+
 /********************************************************************
 * FUNCTION val_remove_child
 * 
@@ -1793,6 +1875,40 @@ extern void
 		    val_value_t *curchild);
 
 
+/********************************************************************
+* FUNCTION val_reset_child_index
+* 
+*   Drop the child name index of a complex value node
+*   Must be called after the childQ has been edited
+*   directly with dlq functions instead of val functions
+*   The index is rebuilt on demand by a later lookup
+*
+* INPUTS:
+*    parent == complex value node with a childQ
+*
+*********************************************************************/
+extern void
+    val_reset_child_index (val_value_t *parent);
+
+
+/********************************************************************
+* FUNCTION val_freeze_child_index
+* 
+*   Stop or restart building and repairing the child name
+*   and list key indexes during lookups.  While frozen, a
+*   lookup that finds no usable index does a linear scan,
+*   so value trees can be searched by several threads
+*   at once as long as none of them is changed
+*
+* INPUTS:
+*    freeze == TRUE to stop changing the indexes in lookups
+*              FALSE to build them on demand again
+*
+*********************************************************************/
+extern void
+    val_freeze_child_index (boolean freeze);
+
+
 /********************************************************************
 * FUNCTION val_first_child_match
 * 
@@ -2979,6 +3095,138 @@ extern val_value_t *
 			   status_t *res);
 
 
+/********************************************************************
+* FUNCTION val_get_virtual_subtree
+* 
+* Get the value of a virtual node for a specific selection
+* Same as val_get_virtual_value except a subtree get callback
+* is told which descendant nodes are going to be used.
+* A plain getcb_fn_t callback ignores the selection.
+*
+* If the callback returns a partial result (val_is_virtual_partial)
+* it is not cached and the caller must free it with val_free_value
+*
+* Caller should check for *res == ERR_NCX_SKIPPED
+*
+* INPUTS:
+*   session == session CB ptr cast as void *
+*              that is getting the virtual value
+*   select == getcb_select_t selection cast as void *
+*             NULL if the entire subtree is needed
+*   val == virtual value to get value for
+*   res == pointer to output function return status value
+*
+* OUTPUTS:
+*    val->virtualval will be set with the cached return value
+*      unless the result is partial
+*    *res == the function return status
+*
+* RETURNS:
+*   pointer to the cached value or the malloced partial value
+*********************************************************************/
+extern val_value_t *
+    val_get_virtual_subtree (void *session,  /* really ses_cb_t *   */
+			     const void *select, /* getcb_select_t * */
+			     val_value_t *val,
+			     status_t *res);
+
+
+/********************************************************************
+* FUNCTION val_set_virtual_partial
+* 
+* Mark a value returned by a subtree get callback as
+* holding only the nodes for the selection it was given
+*
+* INPUTS:
+*   val == dstval filled in by the subtree get callback
+*********************************************************************/
+extern void
+    val_set_virtual_partial (val_value_t *val);
+
+
+/********************************************************************
+* FUNCTION val_is_virtual_partial
+* 
+* Check if a virtual value result only holds the selected nodes
+*
+* INPUTS:
+*   val == value returned by val_get_virtual_subtree
+*
+* RETURNS:
+*   TRUE if val is partial and owned by the caller
+*   FALSE otherwise
+*********************************************************************/
+extern boolean
+    val_is_virtual_partial (const val_value_t *val);
+
+
+/********************************************************************
+* FUNCTION val_is_virtual_stream
+* 
+* Check if the specified value is a virtual container
+* with an iterator get callback
+*
+* INPUTS:
+*   val == value to check
+*   
+* RETURNS:
+*   TRUE if the child nodes can be retrieved one at a time
+*   FALSE otherwise
+*********************************************************************/
+extern boolean
+    val_is_virtual_stream (const val_value_t *val);
+
+
+/********************************************************************
+* FUNCTION val_get_virtual_next
+* 
+* Get the next child node from a virtual container
+* with an iterator get callback
+*
+* The caller must call val_get_virtual_done when finished,
+* even if *res is an error
+*
+* INPUTS:
+*   session == session CB ptr cast as void *
+*              that is getting the virtual value
+*   val == virtual container to get the next child for
+*   iter == getcb_iter_t iterator state cast as void *
+*           set to zero before the first call
+*   res == pointer to output function return status value
+*
+* OUTPUTS:
+*    *res == the function return status
+*            ERR_NCX_NO_INSTANCE if there are no more child nodes
+*
+* RETURNS:
+*   malloced child node; parent set to val but not added to val
+*   The caller must free it with val_free_value
+*   NULL if no more child nodes or some error
+*********************************************************************/
+extern val_value_t *
+    val_get_virtual_next (void *session,  /* really ses_cb_t *   */
+			  val_value_t *val,
+			  void *iter,     /* really getcb_iter_t * */
+			  status_t *res);
+
+
+/********************************************************************
+* FUNCTION val_get_virtual_done
+* 
+* Finish the iteration over a virtual container
+* started with val_get_virtual_next
+*
+* INPUTS:
+*   session == session CB ptr cast as void *
+*   val == virtual container being iterated
+*   iter == getcb_iter_t iterator state cast as void *
+*********************************************************************/
+extern void
+    val_get_virtual_done (void *session,  /* really ses_cb_t *   */
+			  val_value_t *val,
+			  void *iter);    /* really getcb_iter_t * */
+
+
 /********************************************************************
 * FUNCTION val_is_default
 * 
@@ -956,6 +956,7 @@ void
     /* transfer all the val->childQ nodes to the tempQ */
     dlq_createSQue(&tempQ);
     dlq_block_enque(&val->v.childQ, &tempQ);
+    val_reset_child_index(val);
 
     switch (val->obj->objtype) {
     case OBJ_TYP_LEAF:
@@ -1038,6 +1039,7 @@ void
                       " to end of childQ for val %s",
                       dlq_count(&tempQ), val->name);
             dlq_block_enque(&tempQ, &val->v.childQ);
+            val_reset_child_index(val);
         }
 
         break;
@@ -3325,6 +3327,52 @@ void
 }  /* val_write_intern */
 
 
+/********************************************************************
+* FUNCTION val_output_allowed
+* 
+* Check if a value node can be written to a session
+* Checks access control if enabled
+* Checks filtering via testfn if non-NULL
+* Does not get the value of a virtual node
+*
+* INPUTS:
+*   scb == session control block
+*   msg == xml_msg_hdr_t in progress
+*   val == value to write (node from system)
+*   testcb == callback function to use, NULL if not used
+*   acmcheck == TRUE if NACM should be checked; FALSE to skip
+*
+* RETURNS:
+*   TRUE if the node should be written
+*   FALSE if it is filtered or access is denied
+*********************************************************************/
+boolean
+    val_output_allowed (ses_cb_t *scb,
+                        xml_msg_hdr_t *msg,
+                        val_value_t *val,
+                        val_nodetest_fn_t testfn,
+                        boolean acmcheck)
+{
+    /* check the user filter callback function */
+    if (testfn) {
+        if (!(*testfn)(msg->withdef, TRUE, val)) {
+            return FALSE;
+        }
+    }
+
+    if (acmcheck && msg->acm_cbfn) {
+        xml_msg_authfn_t cbfn = (xml_msg_authfn_t)msg->acm_cbfn;
+        boolean acmtest = (*cbfn)(msg, scb->username, val);
+        if (!acmtest) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+
+}  /* val_output_allowed */
+
+
 /********************************************************************
 * FUNCTION val_get_value
 * 
@@ -3372,23 +3420,11 @@ val_value_t *
 
     *malloced = FALSE;
 
-    /* check the user filter callback function */
-    if (testfn) {
-        if (!(*testfn)(msg->withdef, TRUE, val)) {
-            *res = ERR_NCX_SKIPPED;
-            return NULL;
-        }
+    if (!val_output_allowed(scb, msg, val, testfn, acmcheck)) {
+        *res = ERR_NCX_SKIPPED;
+        return NULL;
     }
 
-    if (acmcheck && msg->acm_cbfn) {
-        xml_msg_authfn_t cbfn = (xml_msg_authfn_t)msg->acm_cbfn;
-        boolean acmtest = (*cbfn)(msg, scb->username, val);
-        if (!acmtest) {
-            *res = ERR_NCX_SKIPPED;
-            return NULL;
-        }
-    }
-                                   
     if (val_is_virtual(val)) {
         v_val = val_get_virtual_value(scb, val, res);
         if (!v_val) {
@@ -3550,6 +3586,86 @@ status_t
 }  /* val_build_index_chains */
 
 
+/********************************************************************
+* FUNCTION val_clone_identity
+* 
+* Make a node that only identifies a data node among its
+* siblings, so it can be used with val_first_child_match:
+* the list keys for a list, the value for a leaf or leaf-list,
+* or an empty node otherwise
+*
+* INPUTS:
+*   val == value node to identify
+*   res == address of return status
+*
+* OUTPUTS:
+*   *res == return status
+*
+* RETURNS:
+*   malloced identity node, or NULL if error
+*********************************************************************/
+val_value_t *
+    val_clone_identity (const val_value_t *val,
+                        status_t *res)
+{
+    val_value_t        *newval, *keyval;
+    const val_index_t  *valindex;
+
+#ifdef DEBUG
+    if (!val || !res) {
+        if (res) {
+            *res = SET_ERROR(ERR_INTERNAL_PTR);
+        }
+        return NULL;
+    }
+#endif
+
+    *res = NO_ERR;
+
+    if (obj_is_leafy(val->obj)) {
+        newval = val_clone(val);
+        if (!newval) {
+            *res = ERR_INTERNAL_MEM;
+        } else {
+            /* the node may be marked deleted in its tree,
+             * which would stop it from matching anything */
+            newval->flags &= ~(VAL_FL_DELETED | VAL_FL_DIRTY |
+                               VAL_FL_SUBTREE_DIRTY);
+        }
+        return newval;
+    }
+
+    newval = val_new_value();
+    if (!newval) {
+        *res = ERR_INTERNAL_MEM;
+        return NULL;
+    }
+    val_init_from_template(newval, val->obj);
+
+    for (valindex = val_get_first_index(val);
+         valindex != NULL;
+         valindex = val_get_next_index(valindex)) {
+        keyval = val_clone(valindex->val);
+        if (!keyval) {
+            val_free_value(newval);
+            *res = ERR_INTERNAL_MEM;
+            return NULL;
+        }
+        val_add_child(keyval, newval);
+    }
+
+    if (val->obj->objtype == OBJ_TYP_LIST) {
+        *res = val_gen_index_chain(val->obj, newval);
+        if (*res != NO_ERR) {
+            val_free_value(newval);
+            return NULL;
+        }
+    }
+    return newval;
+
+}  /* val_clone_identity */
+
+
 /* END file val_util.c */
 
 
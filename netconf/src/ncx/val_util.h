@@ -928,6 +928,33 @@ extern void
                       const val_value_t *val);
 
 
+/********************************************************************
+* FUNCTION val_output_allowed
+* 
+* Check if a value node can be written to a session
+* Checks access control if enabled
+* Checks filtering via testfn if non-NULL
+* Does not get the value of a virtual node
+*
+* INPUTS:
+*   scb == session control block
+*   msg == xml_msg_hdr_t in progress
+*   val == value to write (node from system)
+*   testcb == callback function to use, NULL if not used
+*   acmcheck == TRUE if NACM should be checked; FALSE to skip
+*
+* RETURNS:
+*   TRUE if the node should be written
+*   FALSE if it is filtered or access is denied
+*********************************************************************/
+extern boolean
+    val_output_allowed (ses_cb_t *scb,
+                        xml_msg_hdr_t *msg,
+                        val_value_t *val,
+                        val_nodetest_fn_t testfn,
+                        boolean acmcheck);
+
+
 /********************************************************************
 * FUNCTION val_get_value
 * 
@@ -1004,6 +1031,29 @@ extern status_t
     val_build_index_chains (val_value_t *val);
 
 
+/********************************************************************
+* FUNCTION val_clone_identity
+* 
+* Make a node that only identifies a data node among its
+* siblings, so it can be used with val_first_child_match:
+* the list keys for a list, the value for a leaf or leaf-list,
+* or an empty node otherwise
+*
+* INPUTS:
+*   val == value node to identify
+*   res == address of return status
+*
+* OUTPUTS:
+*   *res == return status
+*
+* RETURNS:
+*   malloced identity node, or NULL if error
+*********************************************************************/
+extern val_value_t *
+    val_clone_identity (const val_value_t *val,
+                        status_t *res);
+
+
 #ifdef __cplusplus
 }  /* end extern 'C' */
 #endif
@@ -754,6 +754,136 @@ status_t
 
 }  /* xml_msg_gen_new_prefix */
 
+
+/********************************************************************
+* FUNCTION xml_msg_copy_prefix_map
+*
+* Copy the prefix map of one message header into another
+* Used to give a temporary message header the same prefixes
+* as the message in progress
+* 
+* INPUTS:
+*    msg  == message header with an empty prefixQ to fill in
+*    srcmsg == message header to copy the prefixQ from
+*
+* RETURNS:
+*    status
+*********************************************************************/
+status_t 
+    xml_msg_copy_prefix_map (xml_msg_hdr_t *msg,
+                             xml_msg_hdr_t *srcmsg)
+{
+    const xmlns_pmap_t  *pmap;
+    xmlns_pmap_t        *newpmap;
+
+#ifdef DEBUG
+    if (!msg || !srcmsg) {
+        return SET_ERROR(ERR_INTERNAL_PTR);
+    }
+#endif
+
+    for (pmap = (const xmlns_pmap_t *)dlq_firstEntry(&srcmsg->prefixQ);
+         pmap != NULL;
+         pmap = (const xmlns_pmap_t *)dlq_nextEntry(pmap)) {
+
+        newpmap = xmlns_new_pmap(0);
+        if (!newpmap) {
+            return ERR_INTERNAL_MEM;
+        }
+        newpmap->nm_id = pmap->nm_id;
+        newpmap->nm_topattr = pmap->nm_topattr;
+        if (pmap->nm_pfix) {
+            newpmap->nm_pfix = xml_strdup(pmap->nm_pfix);
+            if (!newpmap->nm_pfix) {
+                xmlns_free_pmap(newpmap);
+                return ERR_INTERNAL_MEM;
+            }
+        }
+
+        /* srcmsg->prefixQ is already sorted by namespace ID */
+        dlq_enque(newpmap, &msg->prefixQ);
+    }
+    return NO_ERR;
+
+}  /* xml_msg_copy_prefix_map */
+
+
+/********************************************************************
+* FUNCTION xml_msg_merge_prefix_map
+*
+* Add the prefix mappings from one message header that are
+* not yet in another.  Nothing is added if a namespace has
+* a different prefix in the two maps, or a new prefix is
+* already used for a different namespace
+* 
+* INPUTS:
+*    msg  == message header to add the prefix mappings to
+*    srcmsg == message header with the prefix mappings to add
+*
+* RETURNS:
+*    status, ERR_NCX_DUP_PREFIX if the maps do not agree
+*********************************************************************/
+status_t 
+    xml_msg_merge_prefix_map (xml_msg_hdr_t *msg,
+                              xml_msg_hdr_t *srcmsg)
+{
+    const xmlns_pmap_t  *pmap;
+    const xmlChar       *pfix;
+    xmlns_pmap_t        *newpmap;
+    xmlns_id_t           testid;
+
+#ifdef DEBUG
+    if (!msg || !srcmsg) {
+        return SET_ERROR(ERR_INTERNAL_PTR);
+    }
+#endif
+
+    /* make sure all the new mappings can be added first */
+    for (pmap = (const xmlns_pmap_t *)dlq_firstEntry(&srcmsg->prefixQ);
+         pmap != NULL;
+         pmap = (const xmlns_pmap_t *)dlq_nextEntry(pmap)) {
+
+        pfix = find_prefix(msg, pmap->nm_id);
+        if (pfix) {
+            if (xml_strcmp(pfix, pmap->nm_pfix)) {
+                return ERR_NCX_DUP_PREFIX;
+            }
+        } else if (pmap->nm_pfix) {
+            testid = find_prefix_val(msg, pmap->nm_pfix);
+            if (testid != XMLNS_NULL_NS_ID) {
+                return ERR_NCX_DUP_PREFIX;
+            }
+        }
+    }
+
+    for (pmap = (const xmlns_pmap_t *)dlq_firstEntry(&srcmsg->prefixQ);
+         pmap != NULL;
+         pmap = (const xmlns_pmap_t *)dlq_nextEntry(pmap)) {
+
+        if (find_pmap(msg, pmap->nm_id)) {
+            continue;
+        }
+
+        newpmap = xmlns_new_pmap(0);
+        if (!newpmap) {
+            return ERR_INTERNAL_MEM;
+        }
+        newpmap->nm_id = pmap->nm_id;
+        newpmap->nm_topattr = pmap->nm_topattr;
+        if (pmap->nm_pfix) {
+            newpmap->nm_pfix = xml_strdup(pmap->nm_pfix);
+            if (!newpmap->nm_pfix) {
+                xmlns_free_pmap(newpmap);
+                return ERR_INTERNAL_MEM;
+            }
+        }
+        add_pmap(msg, newpmap);
+    }
+    return NO_ERR;
+
+}  /* xml_msg_merge_prefix_map */
+
+
 /********************************************************************
  * Build a queue of xmlns_pmap_t records for the current message
  * This function will populate msg->prefixQ as needed,
@@ -246,6 +246,45 @@ extern status_t
 			    uint32 buffsize);
 
 
+/********************************************************************
+* FUNCTION xml_msg_copy_prefix_map
+*
+* Copy the prefix map of one message header into another
+* Used to give a temporary message header the same prefixes
+* as the message in progress
+* 
+* INPUTS:
+*    msg  == message header with an empty prefixQ to fill in
+*    srcmsg == message header to copy the prefixQ from
+*
+* RETURNS:
+*    status
+*********************************************************************/
+extern status_t 
+    xml_msg_copy_prefix_map (xml_msg_hdr_t *msg,
+			     xml_msg_hdr_t *srcmsg);
+
+
+/********************************************************************
+* FUNCTION xml_msg_merge_prefix_map
+*
+* Add the prefix mappings from one message header that are
+* not yet in another.  Nothing is added if a namespace has
+* a different prefix in the two maps, or a new prefix is
+* already used for a different namespace
+* 
+* INPUTS:
+*    msg  == message header to add the prefix mappings to
+*    srcmsg == message header with the prefix mappings to add
+*
+* RETURNS:
+*    status, ERR_NCX_DUP_PREFIX if the maps do not agree
+*********************************************************************/
+extern status_t 
+    xml_msg_merge_prefix_map (xml_msg_hdr_t *msg,
+			      xml_msg_hdr_t *srcmsg);
+
+
 /********************************************************************
 * FUNCTION xml_msg_build_prefix_map
 *
@@ -373,6 +373,43 @@ status_t
 } /* xml_get_reader_from_filespec */
 
 
+/********************************************************************
+* FUNCTION xml_get_reader_from_memory
+* 
+* Get a new xmlTextReader for parsing an XML document
+* that is already in a memory buffer
+*
+* INPUTS:
+*   buffer == XML instance document to parse
+*   bufflen == number of bytes in buffer
+*              the buffer must stay valid until the reader is freed
+* OUTPUTS:
+*   *reader == pointer to new reader or NULL if some error
+*
+* RETURNS:
+*   status of the operation
+*********************************************************************/
+status_t
+    xml_get_reader_from_memory (const xmlChar *buffer,
+                                uint32 bufflen,
+                                xmlTextReaderPtr  *reader)
+{
+#ifdef DEBUG
+    if (!buffer || !reader) {
+        return SET_ERROR(ERR_INTERNAL_PTR);
+    } 
+#endif
+
+    *reader = xmlReaderForMemory((const char *)buffer, (int)bufflen,
+                                 NULL, NULL, XML_READER_OPTIONS);
+    if (*reader==NULL) {
+        return ERR_XML_READER_START_FAILED;
+    }
+    return NO_ERR;
+
+} /* xml_get_reader_from_memory */
+
+
 /********************************************************************
 * FUNCTION xml_get_reader_for_session
 * 
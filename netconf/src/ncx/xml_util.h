@@ -27,6 +27,7 @@
 
     - XmlReader utilities
       - xml_get_reader_from_filespec  (parse debug test documents)
+      - xml_get_reader_from_memory
       - xml_get_reader_for_session
       - xml_reset_reader_for_session
       - xml_free_reader
@@ -240,6 +241,28 @@ extern status_t
 				  xmlTextReaderPtr  *reader);
 
 
+/********************************************************************
+* FUNCTION xml_get_reader_from_memory
+* 
+* Get a new xmlTextReader for parsing an XML document
+* that is already in a memory buffer
+*
+* INPUTS:
+*   buffer == XML instance document to parse
+*   bufflen == number of bytes in buffer
+*              the buffer must stay valid until the reader is freed
+* OUTPUTS:
+*   *reader == pointer to new reader or NULL if some error
+*
+* RETURNS:
+*   status of the operation
+*********************************************************************/
+extern status_t
+    xml_get_reader_from_memory (const xmlChar *buffer,
+				uint32 bufflen,
+				xmlTextReaderPtr  *reader);
+
+
 /********************************************************************
 * FUNCTION xml_get_reader_for_session
 * 
@@ -35,6 +35,7 @@ date         init     comment
 
 #include "procdefs.h"
 #include "dlq.h"
+#include "getcb.h"
 #include "ncx.h"
 #include "ncx_num.h"
 #include "ncxconst.h"
@@ -147,8 +148,7 @@ static void
         ses_putchar(scb, ':');
         ses_putstr(scb, pfix);
     }
-    ses_putchar(scb, '=');
-    ses_putchar(scb, '\"');
+    ses_putbytes(scb, (const xmlChar *)"=\"", 2);
     ses_putstr(scb, val);      /* write the namespace URI value */
     ses_putchar(scb, '\"');
     
@@ -370,8 +370,7 @@ static void
         }
 
         ses_putstr(scb, attr_name);
-        ses_putchar(scb, '=');
-        ses_putchar(scb, '\"');
+        ses_putbytes(scb, (const xmlChar *)"=\"", 2);
         if (isattrq) {
             ses_putastr(scb, attr->attr_val, -1);
         } else if (typ_is_string(val->btyp)) {
@@ -533,9 +532,10 @@ static void
 
     /* finish up the element */
     if (empty) {
-        ses_putchar(scb, '/');
+        ses_putbytes(scb, (const xmlChar *)"/>", 2);
+    } else {
+        ses_putchar(scb, '>');
     }
-    ses_putchar(scb, '>');
 
     /* hack in XMLDOC mode to get more readable XSD output */
     if (empty && scb->mode==SES_MODE_XMLDOC && indent < 
@@ -578,7 +578,7 @@ static void write_num_val( ses_cb_t *scb,
 
     res = ncx_sprintf_num( buff, &out->v.num, out->btyp, &len );
     if (res == NO_ERR) {
-        ses_putstr(scb, buff); 
+        ses_putbytes(scb, buff, len);
     } else {
         SET_ERROR(res);
     }
@@ -821,6 +821,65 @@ static void write_child_values( ses_cb_t *scb,
     } 
 }
 
+/********************************************************************
+* FUNCTION write_stream_val
+* 
+* Write a virtual container with an iterator get callback
+* Each child node is written and freed before the next
+* one is retrieved
+*
+* INPUTS:
+*   scb == session control block
+*   msg == xml_msg_hdr_t in progress
+*   val == virtual container to write
+*   indent == start indent amount if indent enabled
+*   testcb == callback function to use, NULL if not used
+*   writetop == TRUE to write the container start and end tags
+*               FALSE to write just the child nodes
+*
+* RETURNS:
+*   none
+*********************************************************************/
+static void write_stream_val ( ses_cb_t *scb,
+                               xml_msg_hdr_t *msg,
+                               val_value_t *val,
+                               int32  indent,
+                               val_nodetest_fn_t testfn,
+                               boolean writetop )
+{
+    val_value_t  *chval;
+    getcb_iter_t  iter;
+    status_t      res = NO_ERR;
+    int32         chindent = indent;
+
+    memset(&iter, 0x0, sizeof(getcb_iter_t));
+    chval = val_get_virtual_next(scb, val, &iter, &res);
+
+    if (writetop) {
+        if (chval) {
+            begin_elem_val(scb, msg, val, indent);
+            chindent = indent + ses_indent_count(scb);
+        } else if (res == ERR_NCX_NO_INSTANCE) {
+            xml_wr_empty_elem(scb, msg, val_get_parent_nsid(val), val->nsid,
+                              val->name, indent);
+        }
+    }
+
+    while (chval) {
+        xml_wr_full_check_val(scb, msg, chval, chindent, testfn);
+        val_free_value(chval);
+        chval = val_get_virtual_next(scb, val, &iter, &res);
+    }
+
+    if (writetop && iter.count) {
+        xml_wr_end_elem(scb, msg, val->nsid, val->name, indent);
+    }
+
+    val_get_virtual_done(scb, val, &iter);
+
+}  /* write_stream_val */
+
+
 /********************************************************************
 * FUNCTION write_check_val
 * 
@@ -863,6 +922,13 @@ static void write_check_val ( ses_cb_t *scb,
     status_t res = NO_ERR;
     boolean malloced = FALSE;
 
+    if (val_is_virtual_stream(val)) {
+        if (val_output_allowed(scb, msg, val, testfn, acmcheck)) {
+            write_stream_val(scb, msg, val, indent, testfn, FALSE);
+        }
+        return;
+    }
+
     // Handle virtual values and check access control
     out = val_get_value(scb, msg, val, testfn, acmcheck, &malloced, &res);
     if ( !out || res != NO_ERR) {
@@ -1058,9 +1124,10 @@ static void
 
     /* finish up the element */
     if (empty) {
-        ses_putchar(scb, '/');
+        ses_putbytes(scb, (const xmlChar *)"/>", 2);
+    } else {
+        ses_putchar(scb, '>');
     }
-    ses_putchar(scb, '>');
 
     /* hack in XMLDOC mode to get more readable XSD output */
     if (empty && scb->mode==SES_MODE_XMLDOC && indent < 
@@ -1093,14 +1160,10 @@ void
                  uint32 bufflen)
 {
 
-    uint32  i;
-
     assert( scb && "scb is NULL!" );
     assert( buff && "buff is NULL!" );
 
-    for (i=0; i<bufflen; i++) {
-        ses_putchar(scb, *buff++);
-    }
+    ses_putbytes(scb, buff, bufflen);
 
 }  /* xml_wr_buff */
 
@@ -1259,8 +1322,7 @@ void
     ses_indent(scb, indent);
 
     /* start the element and write the prefix, if any */
-    ses_putchar(scb, '<');
-    ses_putchar(scb, '/');
+    ses_putbytes(scb, (const xmlChar *)"</", 2);
     pfix = NULL;
     if (nsid && msg->useprefix) {
         pfix = xml_msg_get_prefix(msg, 0, nsid, NULL, &xneeded);
@@ -1504,6 +1566,13 @@ void
     assert( msg && "msg is NULL" );
     assert( val && "val is NULL" );
 
+    if (val_is_virtual_stream(val)) {
+        if (val_output_allowed(scb, msg, val, testfn, TRUE)) {
+            write_stream_val(scb, msg, val, indent, testfn, TRUE);
+        }
+        return;
+    }
+
     malloced = FALSE;
     res = NO_ERR;
     out = val_get_value(scb, msg, val, testfn, TRUE, &malloced, &res);
@@ -2285,6 +2285,56 @@ status_t
 }  /* xpath_find_val_unique */
 
 
+/********************************************************************
+* FUNCTION xpath_find_obj_unique
+* 
+* called by server to find the descendant object node
+* named by a relative-path sub-clause of a unique-stmt
+*
+* Error messages are logged by this function
+* only if logerrors is TRUE
+*
+* INPUTS:
+*    startobj == object node containing the unique-stmt
+*    mod == module to use for the default context
+*           and prefixes will be relative to this module's
+*           import statements.
+*        == NULL and the default registered prefixes
+*           will be used
+*    target == Xpath expression string to evaluate
+*    logerrors == TRUE to use log_error, FALSE to skip it
+*    targobj == address of return value
+*
+* OUTPUTS:
+*   if object node found:
+*      *targobj == target object node
+*
+* RETURNS:
+*   status
+*********************************************************************/
+status_t
+    xpath_find_obj_unique (obj_template_t *startobj,
+                           ncx_module_t *mod,
+                           const xmlChar *target,
+                           boolean logerrors,
+                           obj_template_t **targobj)
+{
+    assert( startobj && "startobj is NULL!" );
+    assert( target && "target is NULL!" );
+    assert( targobj && "targobj is NULL!" );
+
+    *targobj = NULL;
+
+    status_t res = find_obj_node_unique(startobj, mod, target,
+                                        logerrors, targobj);
+    if (res == NO_ERR && *targobj == NULL) {
+        res = ERR_NCX_OPERATION_FAILED;
+    }
+    return res;
+
+}  /* xpath_find_obj_unique */
+
+
 /*******    X P A T H   and   K E Y R E F    S U P P O R T   *******/
 
 
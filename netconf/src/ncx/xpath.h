@@ -85,6 +85,10 @@ extern "C" {
 /* max size of the pcb->resnode_cacheQ */
 #define XPATH_RESNODE_CACHE_MAX     64
 
+/* a Q of resnodes longer than this gets a pointer hash index
+ * for duplicate checks while a node-set is being built */
+#define XPATH_RESIDX_THRESHOLD      32
+
 
 /* XPath 1.0 sec 2.2 AxisName */
 #define XP_AXIS_ANCESTOR           (const xmlChar *)"ancestor"
@@ -457,11 +461,26 @@ typedef struct xpath_fncb_t_ {
 } xpath_fncb_t;
 
 
+/* Pointer hash side index for a Q of xpath_resnode_t;
+ * the slots are only allocated once the Q gets longer
+ * than XPATH_RESIDX_THRESHOLD
+ */
+typedef struct xpath_residx_t_ {
+    dlq_hdr_t         *resnodeQ;
+    xpath_resnode_t  **slots;        /* open addressing or NULL */
+    uint32             numslots;
+    uint32             count;
+} xpath_residx_t;
+
+
 /* Value or object node walker fn callback parameters */
 typedef struct xpath_walkerparms_t_ {
     dlq_hdr_t         *resnodeQ;
+    xpath_residx_t    *residx;       /* index for resnodeQ */
     int64              callcount;
     status_t           res;
+    val_value_t       *lastval;      /* last value node added */
+    int64              lastpos;      /* sibling position of lastval */
 } xpath_walkerparms_t;
 
 
@@ -683,6 +702,41 @@ extern status_t
                            xpath_pcb_t **retpcb);
 
 
+/********************************************************************
+* FUNCTION xpath_find_obj_unique
+* 
+* called by server to find the descendant object node
+* named by a relative-path sub-clause of a unique-stmt
+*
+* Error messages are logged by this function
+* only if logerrors is TRUE
+*
+* INPUTS:
+*    startobj == object node containing the unique-stmt
+*    mod == module to use for the default context
+*           and prefixes will be relative to this module's
+*           import statements.
+*        == NULL and the default registered prefixes
+*           will be used
+*    target == Xpath expression string to evaluate
+*    logerrors == TRUE to use log_error, FALSE to skip it
+*    targobj == address of return value
+*
+* OUTPUTS:
+*   if object node found:
+*      *targobj == target object node
+*
+* RETURNS:
+*   status
+*********************************************************************/
+extern status_t
+    xpath_find_obj_unique (obj_template_t *startobj,
+                           ncx_module_t *mod,
+                           const xmlChar *target,
+                           boolean logerrors,
+                           obj_template_t **targobj);
+
+
 /********************************************************************
 * FUNCTION xpath_new_pcb
 * 
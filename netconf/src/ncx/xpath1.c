@@ -43,6 +43,7 @@ date         init     comment
 #include "ncx.h"
 #include "ncx_feature.h"
 #include "ncx_num.h"
+#include "ncx_regex.h"
 #include "obj.h"
 #include "val123.h"
 #include "tk.h"
@@ -4548,7 +4549,7 @@ static xpath_result_t *
     int ret;
     xpath_result_t *result;
     xpath_result_t  *parm1, *parm2;
-    xmlRegexpPtr regex;
+    ncx_regex_t *regex;
 
     xmlns_id_t  nsid;
     const xmlChar *name;
@@ -4559,7 +4560,7 @@ static xpath_result_t *
     assert(parm1->restype==XP_RT_STRING || parm1->restype==XP_RT_NODESET);
     assert(parm2->restype==XP_RT_STRING);
 
-    regex=xmlRegexpCompile(parm2->r.str);
+    regex = ncx_regex_get(parm2->r.str, res);
 
     result = new_result(pcb, XP_RT_BOOLEAN);
     assert(result);
@@ -4569,9 +4570,10 @@ static xpath_result_t *
         /*No data context. Just make sure the regex is valid.*/
         if(regex) {
             result->r.boo = TRUE;
-        } else {
-            *res = ERR_NCX_INVALID_PATTERN;
         }
+    } else if (regex==NULL) {
+        /* *res already set by ncx_regex_get */
+        ;
     } else if(parm1->restype==XP_RT_NODESET) {
     for (resnode = (xpath_resnode_t *) dlq_firstEntry(&parm1->r.nodeQ);
          resnode != NULL;
@@ -4581,7 +4583,7 @@ static xpath_result_t *
 
         if (val && val->btyp==NCX_BT_STRING) {
             /* all nodes in the nodeset must be leafs of type string */
-            ret = xmlRegexpExec(regex, VAL_STRING(val));
+            ret = ncx_regex_match(regex, VAL_STRING(val));
             if (ret==1) {
                 /*at least one match in the set*/
                 result->r.boo = TRUE;
@@ -4602,7 +4604,7 @@ static xpath_result_t *
         }
     }
     } else if(parm1->restype==XP_RT_STRING) {
-        ret = xmlRegexpExec(regex, parm1->r.str);
+        ret = ncx_regex_match(regex, parm1->r.str);
         if (ret==1) {
             /*at least one match in the set*/
             result->r.boo = TRUE;
@@ -4619,7 +4621,7 @@ static xpath_result_t *
     }
 
     if(regex) {
-        xmlRegFreeRegexp(regex);
+        ncx_regex_release(regex);
     }
 
     if(*res!=NO_ERR) {
@@ -5013,6 +5015,98 @@ static const xpath_fncb_t *
 } /* find_fncb */
 
 
+/********************************************************************
+* FUNCTION resolve_token
+* 
+* Get the cached axis name and NodeType name lookups for
+* a TK_TT_TSTRING token, doing the lookups the first time
+* the token is seen.  The parse phase visits every token,
+* so later evaluations of the same token chain do not
+* repeat any of the string compares.
+*
+* INPUTS:
+*    pcb == parser control block in progress
+*    tk == token to resolve (may be NULL)
+*
+* RETURNS:
+*   tk, with the xp* fields set if it is a TK_TT_TSTRING token
+*********************************************************************/
+static tk_token_t *
+    resolve_token (xpath_pcb_t *pcb,
+                   tk_token_t *tk)
+{
+    if (tk == NULL || tk->typ != TK_TT_TSTRING) {
+        return tk;
+    }
+
+    if (!tk->xpdone) {
+        tk->xpaxis = get_axis_id(tk->val);
+        tk->xpnodetyp = (uint32)get_nodetype_id(tk->val);
+        tk->xpdone = TRUE;
+    }
+
+    return tk;
+
+} /* resolve_token */
+
+
+/********************************************************************
+* FUNCTION resolve_fncb
+* 
+* Get the cached function lookup for the current token.
+* The function set depends on the YANG version of the
+* module, so it is cached along with the module it was
+* looked up for.
+*
+* INPUTS:
+*    pcb == parser control block in progress
+*
+* RETURNS:
+*   pointer to found control block
+*   NULL if not found
+*********************************************************************/
+static const xpath_fncb_t *
+    resolve_fncb (xpath_pcb_t *pcb)
+{
+    tk_token_t  *tk;
+
+    tk = TK_CUR(pcb->tkc);
+    if (tk->val == NULL) {
+        return NULL;
+    }
+
+    if (tk->xpfnmod == NULL || tk->xpfnmod != pcb->tkerr.mod) {
+        tk->xpfncb = find_fncb(pcb, tk->val);
+        tk->xpfnmod = pcb->tkerr.mod;
+    }
+
+    return (const xpath_fncb_t *)tk->xpfncb;
+
+} /* resolve_fncb */
+
+
+/********************************************************************
+* FUNCTION next_token
+* 
+* Get the token after the current token without moving
+*
+* INPUTS:
+*    pcb == parser control block in progress
+*
+* RETURNS:
+*   pointer to the next token, NULL if none
+*********************************************************************/
+static tk_token_t *
+    next_token (xpath_pcb_t *pcb)
+{
+    if (!pcb->tkc->cur) {
+        return NULL;
+    }
+    return resolve_token(pcb, (tk_token_t *)dlq_nextEntry(pcb->tkc->cur));
+
+} /* next_token */
+
+
 /********************************************************************
 * FUNCTION get_varbind
 * 
@@ -5269,7 +5363,7 @@ static xpath_result_t *
 
 
 /********************************************************************
-* FUNCTION find_resnode
+* FUNCTION find_resnode_slow
 * 
 * Check if the specified resnode ptr is already in the Q
 *
@@ -5277,15 +5371,17 @@ static xpath_result_t *
 *    pcb == parser control block to use
 *    resultQ == Q of xpath_resnode_t structs to check
 *               DOES NOT HAVE TO BE WITHIN A RESULT NODE Q
-*    ptr   == pointer value to find
+*    nsid == namespace ID of node to find; 0 to skip NS test
+*    name == local-name of node to find
 *
 * RETURNS:
 *    found resnode or NULL if not found
 *********************************************************************/
 static xpath_resnode_t *
-    find_resnode (xpath_pcb_t *pcb,
-                  dlq_hdr_t *resultQ,
-                  const void *ptr)
+    find_resnode_slow (xpath_pcb_t *pcb,
+                       dlq_hdr_t *resultQ,
+                       xmlns_id_t nsid,
+                       const xmlChar *name)
 {
     xpath_resnode_t  *resnode;
 
@@ -5294,67 +5390,355 @@ static xpath_resnode_t *
          resnode = (xpath_resnode_t *)dlq_nextEntry(resnode)) {
 
         if (pcb->val) {
-            if (resnode->node.valptr == ptr) {
+            if (nsid && (nsid != val_get_nsid(resnode->node.valptr))) {
+                continue;
+            }
+            if (!xml_strcmp(name, resnode->node.valptr->name)) {
                 return resnode;
             }
         } else {
-            if (resnode->node.objptr == ptr) {
+            if (nsid && (nsid != obj_get_nsid(resnode->node.objptr))) {
+                continue;
+            }
+            if (!xml_strcmp(name,
+                            obj_get_name(resnode->node.objptr))) {
                 return resnode;
             }
         }
     }
     return NULL;
 
-}  /* find_resnode */
+}  /* find_resnode_slow */
 
 
 /********************************************************************
-* FUNCTION find_resnode_slow
+* FUNCTION resnode_ptr
+* 
+* Get the node pointer that identifies a resnode
+*
+* INPUTS:
+*    pcb == parser control block to use
+*    resnode == resnode to check
+*
+* RETURNS:
+*    value node or object node pointer
+*********************************************************************/
+static const void *
+    resnode_ptr (const xpath_pcb_t *pcb,
+                 const xpath_resnode_t *resnode)
+{
+    if (pcb->val) {
+        return (const void *)resnode->node.valptr;
+    } else {
+        return (const void *)resnode->node.objptr;
+    }
+
+}  /* resnode_ptr */
+
+
+/********************************************************************
+* FUNCTION residx_slot
+* 
+* Get the first slot to probe for a node pointer
+*
+* INPUTS:
+*    residx == index to use (slots must be allocated)
+*    ptr == node pointer to hash
+*
+* RETURNS:
+*    slot number
+*********************************************************************/
+static uint32
+    residx_slot (const xpath_residx_t *residx,
+                 const void *ptr)
+{
+    uint32 h = (uint32)((size_t)ptr >> 4) * 2654435761U;
+
+    return (h ^ (h >> 16)) & (residx->numslots - 1);
+
+}  /* residx_slot */
+
+
+/********************************************************************
+* FUNCTION residx_init
+* 
+* Initialize a resnode index for the specified Q
+* The Q must be empty or the index will be built
+* the first time a long Q is searched
+*
+* INPUTS:
+*    residx == index to initialize
+*    resnodeQ == Q of xpath_resnode_t to index
+*********************************************************************/
+static void
+    residx_init (xpath_residx_t *residx,
+                 dlq_hdr_t *resnodeQ)
+{
+    residx->resnodeQ = resnodeQ;
+    residx->slots = NULL;
+    residx->numslots = 0;
+    residx->count = 0;
+
+}  /* residx_init */
+
+
+/********************************************************************
+* FUNCTION residx_clean
+* 
+* Free the slots of a resnode index; the Q is not touched
+*
+* INPUTS:
+*    residx == index to clean
+*********************************************************************/
+static void
+    residx_clean (xpath_residx_t *residx)
+{
+    if (residx->slots) {
+        m__free(residx->slots);
+    }
+    residx->slots = NULL;
+    residx->numslots = 0;
+    residx->count = 0;
+
+}  /* residx_clean */
+
+
+/********************************************************************
+* FUNCTION residx_insert
+* 
+* Add a resnode that is in the Q to the index slots,
+* growing the slots if needed
+*
+* INPUTS:
+*    pcb == parser control block to use
+*    residx == index to use (slots must be allocated)
+*    resnode == resnode to add
+*
+* RETURNS:
+*    FALSE if a malloc failed and the index was dropped
+*********************************************************************/
+static boolean
+    residx_insert (const xpath_pcb_t *pcb,
+                   xpath_residx_t *residx,
+                   xpath_resnode_t *resnode)
+{
+    uint32 i;
+
+    if ((residx->count + 1) * 2 > residx->numslots) {
+        xpath_resnode_t **oldslots = residx->slots;
+        uint32 oldnum = residx->numslots;
+        uint32 newnum = (oldnum) ? oldnum * 2 : 64;
+
+        residx->slots = m__getMem(newnum * sizeof(xpath_resnode_t *));
+        if (residx->slots == NULL) {
+            residx->slots = oldslots;
+            residx_clean(residx);
+            return FALSE;
+        }
+        memset(residx->slots, 0x0, newnum * sizeof(xpath_resnode_t *));
+        residx->numslots = newnum;
+        residx->count = 0;
+
+        for (i = 0; i < oldnum; i++) {
+            if (oldslots[i]) {
+                (void)residx_insert(pcb, residx, oldslots[i]);
+            }
+        }
+        if (oldslots) {
+            m__free(oldslots);
+        }
+    }
+
+    i = residx_slot(residx, resnode_ptr(pcb, resnode));
+    while (residx->slots[i]) {
+        i = (i + 1) & (residx->numslots - 1);
+    }
+    residx->slots[i] = resnode;
+    residx->count++;
+    return TRUE;
+
+}  /* residx_insert */
+
+
+/********************************************************************
+* FUNCTION residx_find
 * 
 * Check if the specified resnode ptr is already in the Q
+* The Q is searched linearly until it is longer than
+* XPATH_RESIDX_THRESHOLD; then the index is built for
+* the next search
 *
 * INPUTS:
 *    pcb == parser control block to use
-*    resultQ == Q of xpath_resnode_t structs to check
-*               DOES NOT HAVE TO BE WITHIN A RESULT NODE Q
-*    nsid == namespace ID of node to find; 0 to skip NS test
-*    name == local-name of node to find
+*    residx == index for the Q to check
+*    ptr   == pointer value to find
 *
 * RETURNS:
 *    found resnode or NULL if not found
 *********************************************************************/
 static xpath_resnode_t *
-    find_resnode_slow (xpath_pcb_t *pcb,
-                       dlq_hdr_t *resultQ,
-                       xmlns_id_t nsid,
-                       const xmlChar *name)
+    residx_find (xpath_pcb_t *pcb,
+                 xpath_residx_t *residx,
+                 const void *ptr)
 {
     xpath_resnode_t  *resnode;
+    uint32            cnt = 0;
 
-    for (resnode = (xpath_resnode_t *)dlq_firstEntry(resultQ);
+    if (residx->slots) {
+        uint32 i = residx_slot(residx, ptr);
+        for (resnode = residx->slots[i]; resnode != NULL;
+             resnode = residx->slots[i]) {
+            if (resnode_ptr(pcb, resnode) == ptr) {
+                return resnode;
+            }
+            i = (i + 1) & (residx->numslots - 1);
+        }
+        return NULL;
+    }
+
+    for (resnode = (xpath_resnode_t *)dlq_firstEntry(residx->resnodeQ);
          resnode != NULL;
          resnode = (xpath_resnode_t *)dlq_nextEntry(resnode)) {
 
-        if (pcb->val) {
-            if (nsid && (nsid != val_get_nsid(resnode->node.valptr))) {
-                continue;
-            }
-            if (!xml_strcmp(name, resnode->node.valptr->name)) {
-                return resnode;
-            }
-        } else {
-            if (nsid && (nsid != obj_get_nsid(resnode->node.objptr))) {
-                continue;
-            }
-            if (!xml_strcmp(name,
-                            obj_get_name(resnode->node.objptr))) {
-                return resnode;
+        if (resnode_ptr(pcb, resnode) == ptr) {
+            return resnode;
+        }
+        cnt++;
+    }
+
+    if (cnt > XPATH_RESIDX_THRESHOLD) {
+        /* long Q so build the index for the next search */
+        for (resnode = (xpath_resnode_t *)dlq_firstEntry(residx->resnodeQ);
+             resnode != NULL;
+             resnode = (xpath_resnode_t *)dlq_nextEntry(resnode)) {
+            if (!residx_insert(pcb, residx, resnode)) {
+                break;
             }
         }
     }
     return NULL;
 
-}  /* find_resnode_slow */
+}  /* residx_find */
+
+
+/********************************************************************
+* FUNCTION residx_add
+* 
+* Add a resnode to the end of the indexed Q
+*
+* INPUTS:
+*    pcb == parser control block to use
+*    residx == index for the Q
+*    resnode == resnode to add
+*********************************************************************/
+static void
+    residx_add (const xpath_pcb_t *pcb,
+                xpath_residx_t *residx,
+                xpath_resnode_t *resnode)
+{
+    dlq_enque(resnode, residx->resnodeQ);
+    if (residx->slots) {
+        (void)residx_insert(pcb, residx, resnode);
+    }
+
+}  /* residx_add */
+
+
+/********************************************************************
+* FUNCTION residx_remove
+* 
+* Remove a resnode from the indexed Q
+*
+* INPUTS:
+*    pcb == parser control block to use
+*    residx == index for the Q
+*    resnode == resnode to remove
+*********************************************************************/
+static void
+    residx_remove (const xpath_pcb_t *pcb,
+                   xpath_residx_t *residx,
+                   xpath_resnode_t *resnode)
+{
+    dlq_remove(resnode);
+    if (residx->slots == NULL) {
+        return;
+    }
+
+    uint32 mask = residx->numslots - 1;
+    uint32 i = residx_slot(residx, resnode_ptr(pcb, resnode));
+    while (residx->slots[i] && residx->slots[i] != resnode) {
+        i = (i + 1) & mask;
+    }
+    if (residx->slots[i] == NULL) {
+        return;
+    }
+
+    /* close the gap so later entries in the probe run stay reachable */
+    residx->slots[i] = NULL;
+    residx->count--;
+    uint32 j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        xpath_resnode_t *testnode = residx->slots[j];
+        if (testnode == NULL) {
+            break;
+        }
+        uint32 k = residx_slot(residx, resnode_ptr(pcb, testnode));
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            residx->slots[i] = testnode;
+            residx->slots[j] = NULL;
+            i = j;
+        }
+    }
+
+}  /* residx_remove */
+
+
+/********************************************************************
+* FUNCTION check_node_exists
+* 
+* Check if any ancestor-or-self node is already in the
+* indexed Q; ONLY FOR VALUE NODES IN THE RESULT
+*
+* INPUTS:
+*    pcb == parser control block to use
+*    residx == index for the Q of xpath_resnode_t structs to check
+*    val   == value node pointer value to find
+*
+* RETURNS:
+*    TRUE if found, FALSE otherwise
+*********************************************************************/
+static boolean
+    check_node_exists (xpath_pcb_t *pcb,
+                       xpath_residx_t *residx,
+                       const val_value_t *val)
+{
+    /* quick test -- see if docroot is already in the Q
+     * which means nothing else is needed
+     */
+    if (residx_find(pcb, residx, pcb->val_docroot)) {
+        return TRUE;
+    }
+
+    /* no docroot in the Q so check the node itself */
+    if (val == pcb->val_docroot) {
+        return FALSE;
+    }
+        
+    while (val) {
+        if (residx_find(pcb, residx, val)) {
+            return TRUE;
+        }
+
+        if (val->parent && !obj_is_root(val->parent->obj)) {
+            val = val->parent;
+        } else {
+            return FALSE;
+        }
+    }
+    return FALSE;
+
+}  /* check_node_exists */
 
 
 /********************************************************************
@@ -5377,6 +5761,7 @@ static void
                    xpath_result_t *val2)
 {
     xpath_resnode_t        *resnode, *findnode;
+    xpath_residx_t          residx;
 
     if (!pcb->val && !pcb->obj) {
         return;
@@ -5388,19 +5773,13 @@ static void
         return;
     }
 
+    residx_init(&residx, &val2->r.nodeQ);
+
     while (!dlq_empty(&val1->r.nodeQ)) {
         resnode = (xpath_resnode_t *)
             dlq_deque(&val1->r.nodeQ);
 
-        if (pcb->val) {
-            findnode = find_resnode(pcb, 
-                                    &val2->r.nodeQ,
-                                    resnode->node.valptr);
-        } else {
-            findnode = find_resnode(pcb, 
-                                    &val2->r.nodeQ,
-                                    resnode->node.objptr);
-        }
+        findnode = residx_find(pcb, &residx, resnode_ptr(pcb, resnode));
         if (findnode) {
             if (resnode->dblslash) {
                 findnode->dblslash = TRUE;
@@ -5408,10 +5787,12 @@ static void
             findnode->position = resnode->position;
             free_resnode(pcb, resnode);
         } else {
-            dlq_enque(resnode, &val2->r.nodeQ);
+            residx_add(pcb, &residx, resnode);
         }
     }
 
+    residx_clean(&residx);
+
 }  /* merge_nodeset */
 
 
@@ -5488,23 +5869,40 @@ static boolean
     parms = (xpath_walkerparms_t *)cookie2;
 
     /* check if this node is already in the result */
-    if (find_resnode(pcb, parms->resnodeQ, val)) {
+    if (residx_find(pcb, parms->residx, val)) {
         return TRUE;
     }
 
     if (obj_is_root(val->obj) || val->parent==NULL) {
         position = 1;
     } else {
+        /* siblings are usually visited in order, so continue
+         * counting from the last node added if possible */
         position = 0;
-        done = FALSE;
-        for (child = val_get_first_child(val->parent);
-             child != NULL && !done;
-             child = val_get_next_child(child)) {
-            position++;
-            if (child == val) {
-                done = TRUE;
+        child = NULL;
+        if (parms->lastval && parms->lastval->parent == val->parent) {
+            position = parms->lastpos;
+            for (child = parms->lastval;
+                 child != NULL && child != val;
+                 child = val_get_next_child(child)) {
+                position++;
+            }
+        }
+
+        if (child == NULL) {
+            position = 0;
+            done = FALSE;
+            for (child = val_get_first_child(val->parent);
+                 child != NULL && !done;
+                 child = val_get_next_child(child)) {
+                position++;
+                if (child == val) {
+                    done = TRUE;
+                }
             }
         }
+        parms->lastval = val;
+        parms->lastpos = position;
     }
 
     ++parms->callcount;
@@ -5519,7 +5917,7 @@ static boolean
         return FALSE;
     }
 
-    dlq_enque(newresnode, parms->resnodeQ);
+    residx_add(pcb, parms->residx, newresnode);
     return TRUE;
 
 }  /* value_walker_fn */
@@ -5558,7 +5956,7 @@ static boolean
     parms = (xpath_walkerparms_t *)cookie2;
 
     /* check if this node is already in the result */
-    if (find_resnode(pcb, parms->resnodeQ, obj)) {
+    if (residx_find(pcb, parms->residx, obj)) {
         return TRUE;
     }
 
@@ -5574,7 +5972,7 @@ static boolean
         return FALSE;
     }
 
-    dlq_enque(newresnode, parms->resnodeQ);
+    residx_add(pcb, parms->residx, newresnode);
     return TRUE;
 
 }  /* object_walker_fn */
@@ -5620,6 +6018,7 @@ static status_t
     dlq_hdr_t               resnodeQ;
     status_t                res;
     xpath_walkerparms_t     walkerparms;
+    xpath_residx_t          residx;
 
     if (!pcb->val && !pcb->obj) {
         return NO_ERR;
@@ -5630,8 +6029,12 @@ static status_t
     }
 
     dlq_createSQue(&resnodeQ);
+    residx_init(&residx, &resnodeQ);
 
     walkerparms.resnodeQ = &resnodeQ;
+    walkerparms.residx = &residx;
+    walkerparms.lastval = NULL;
+    walkerparms.lastpos = 0;
     walkerparms.res = NO_ERR;
     walkerparms.callcount = 0;
 
@@ -5717,9 +6120,7 @@ static status_t
                 }
 
                 if (keep) {
-                    findnode = find_resnode(pcb, 
-                                            &resnodeQ, 
-                                            testval);
+                    findnode = residx_find(pcb, &residx, testval);
                     if (findnode) {
                         if (resnode->dblslash) {
                             findnode->dblslash = TRUE;
@@ -5732,7 +6133,7 @@ static status_t
                         resnode->node.valptr = testval;
                         resnode->position = 
                             ++walkerparms.callcount;
-                        dlq_enque(resnode, &resnodeQ);
+                        residx_add(pcb, &residx, resnode);
                     }
                 } else {
                     free_resnode(pcb, resnode);
@@ -5764,9 +6165,7 @@ static status_t
                 }
 
                 if (keep) {
-                    findnode = find_resnode(pcb, 
-                                            &resnodeQ, 
-                                            testobj);
+                    findnode = residx_find(pcb, &residx, testobj);
                     if (findnode) {
                         if (resnode->dblslash) {
                             findnode->dblslash = TRUE;
@@ -5779,7 +6178,7 @@ static status_t
                         resnode->node.objptr = testobj;
                         resnode->position =
                             ++walkerparms.callcount;
-                        dlq_enque(resnode, &resnodeQ);
+                        residx_add(pcb, &residx, resnode);
                     }
                 } else {
                     if (pcb->logerrors && 
@@ -5799,6 +6198,8 @@ static status_t
         }
     }
 
+    residx_clean(&residx);
+
     /* put the resnode entries back where they belong */
     if (!dlq_empty(&resnodeQ)) {
         dlq_block_enque(&resnodeQ, &result->r.nodeQ);
@@ -5848,6 +6249,7 @@ static status_t
     dlq_hdr_t               resnodeQ;
     status_t                res;
     xpath_walkerparms_t     walkerparms;
+    xpath_residx_t          residx;
     int64                   position;
 
 
@@ -5860,8 +6262,12 @@ static status_t
     }
 
     dlq_createSQue(&resnodeQ);
+    residx_init(&residx, &resnodeQ);
 
     walkerparms.resnodeQ = &resnodeQ;
+    walkerparms.residx = &residx;
+    walkerparms.lastval = NULL;
+    walkerparms.lastpos = 0;
     walkerparms.res = NO_ERR;
     walkerparms.callcount = 0;
 
@@ -5927,7 +6333,7 @@ static status_t
                     if (resnode->dblslash) {
                         /* just move this node to the result */
                         resnode->position = ++position;
-                        dlq_enque(resnode, &resnodeQ);
+                        residx_add(pcb, &residx, resnode);
                     } else {
                         /* no parent available error
                          * remove node from result 
@@ -5958,9 +6364,7 @@ static status_t
                     }
 
                     if (keep) {
-                        findnode = find_resnode(pcb, 
-                                                &resnodeQ, 
-                                                testval);
+                        findnode = residx_find(pcb, &residx, testval);
                         if (findnode) {
                             /* parent already in the Q
                              * remove node from result 
@@ -5974,7 +6378,7 @@ static status_t
                             /* set the resnode to its parent */
                             resnode->position = ++position;
                             resnode->node.valptr = testval;
-                            dlq_enque(resnode, &resnodeQ);
+                            residx_add(pcb, &residx, resnode);
                         }
                     } else {
                         /* no parent available error
@@ -5988,16 +6392,14 @@ static status_t
                 testobj = resnode->node.objptr;
                 if (testobj == pcb->docroot) {
                     resnode->position = ++position;
-                    dlq_enque(resnode, &resnodeQ);
+                    residx_add(pcb, &residx, resnode);
                 } else if (!testobj->parent) {
                     if (!resnode->dblslash && (modname || name)) {
                         no_parent_warning(pcb);
                         free_resnode(pcb, resnode);
                     } else {
                         /* this is a databd node */
-                        findnode = find_resnode(pcb, 
-                                                &resnodeQ, 
-                                                pcb->docroot);
+                        findnode = residx_find(pcb, &residx, pcb->docroot);
                         if (findnode) {
                             if (resnode->dblslash) {
                                 findnode->position = ++position;
@@ -6007,7 +6409,7 @@ static status_t
                         } else {
                             resnode->position = ++position;
                             resnode->node.objptr = pcb->docroot;
-                            dlq_enque(resnode, &resnodeQ);
+                            residx_add(pcb, &residx, resnode);
                         }
                     }
                 } else {
@@ -6052,7 +6454,7 @@ static status_t
 
                     if (keep) {
                         /* replace this node with the useobj */
-                        findnode = find_resnode(pcb, &resnodeQ, useobj);
+                        findnode = residx_find(pcb, &residx, useobj);
                         if (findnode) {
                             if (resnode->dblslash) {
                                 findnode->position = ++position;
@@ -6062,7 +6464,7 @@ static status_t
                         } else {
                             resnode->node.objptr = useobj;
                             resnode->position = ++position;
-                            dlq_enque(resnode, &resnodeQ);
+                            residx_add(pcb, &residx, resnode);
                         }
                     } else {
                         no_parent_warning(pcb);
@@ -6073,6 +6475,8 @@ static status_t
         }
     }
 
+    residx_clean(&residx);
+
     /* put the resnode entries back where they belong */
     if (!dlq_empty(&resnodeQ)) {
         dlq_block_enque(&resnodeQ, &result->r.nodeQ);
@@ -6136,6 +6540,7 @@ static status_t
     boolean               orself, myorself, useroot;
     dlq_hdr_t             resnodeQ;
     xpath_walkerparms_t   walkerparms;
+    xpath_residx_t        residx;
 
     if (!pcb->val && !pcb->obj) {
         return NO_ERR;
@@ -6146,6 +6551,7 @@ static status_t
     }
 
     dlq_createSQue(&resnodeQ);
+    residx_init(&residx, &resnodeQ);
     res = NO_ERR;
     cfgonly = (pcb->flags & XP_FL_CONFIGONLY) ? TRUE : FALSE;
     orself = (axis == XP_AX_DESCENDANT_OR_SELF) ? TRUE : FALSE;
@@ -6158,6 +6564,9 @@ static status_t
     }
 
     walkerparms.resnodeQ = &resnodeQ;
+    walkerparms.residx = &residx;
+    walkerparms.lastval = NULL;
+    walkerparms.lastpos = 0;
     walkerparms.res = NO_ERR;
     walkerparms.callcount = 0;
 
@@ -6248,6 +6657,8 @@ static status_t
         free_resnode(pcb, resnode);
     }
 
+    residx_clean(&residx);
+
     /* put the resnode entries back where they belong */
     if (!dlq_empty(&resnodeQ)) {
         dlq_block_enque(&resnodeQ, &result->r.nodeQ);
@@ -6362,6 +6773,7 @@ static status_t
     boolean               fnresult, fncalled, cfgonly, useroot;
     dlq_hdr_t             resnodeQ;
     xpath_walkerparms_t   walkerparms;
+    xpath_residx_t        residx;
     
     if (!pcb->val && !pcb->obj) {
         return NO_ERR;
@@ -6372,6 +6784,7 @@ static status_t
     }
 
     dlq_createSQue(&resnodeQ);
+    residx_init(&residx, &resnodeQ);
     res = NO_ERR;
     cfgonly = (pcb->flags & XP_FL_CONFIGONLY) ? TRUE : FALSE;
 
@@ -6379,6 +6792,9 @@ static status_t
     useroot = (pcb->flags & XP_FL_USEROOT) ? TRUE : FALSE;
 
     walkerparms.resnodeQ = &resnodeQ;
+    walkerparms.residx = &residx;
+    walkerparms.lastval = NULL;
+    walkerparms.lastpos = 0;
     walkerparms.res = NO_ERR;
     walkerparms.callcount = 0;
 
@@ -6448,6 +6864,8 @@ static status_t
         free_resnode(pcb, resnode);
     }
 
+    residx_clean(&residx);
+
     /* put the resnode entries back where they belong */
     if (!dlq_empty(&resnodeQ)) {
         dlq_block_enque(&resnodeQ, &result->r.nodeQ);
@@ -6519,6 +6937,7 @@ static status_t
     boolean                 cfgonly, fnresult, fncalled, orself, useroot;
     dlq_hdr_t               resnodeQ;
     xpath_walkerparms_t     walkerparms;
+    xpath_residx_t          residx, dummyidx;
 
     if (!pcb->val && !pcb->obj) {
         return NO_ERR;
@@ -6529,6 +6948,7 @@ static status_t
     }
 
     dlq_createSQue(&resnodeQ);
+    residx_init(&residx, &resnodeQ);
 
     res = NO_ERR;
     testval = NULL;
@@ -6541,6 +6961,9 @@ static status_t
     orself = (axis == XP_AX_ANCESTOR_OR_SELF) ? TRUE : FALSE;
 
     walkerparms.resnodeQ = &resnodeQ;
+    walkerparms.residx = &residx;
+    walkerparms.lastval = NULL;
+    walkerparms.lastpos = 0;
     walkerparms.res = NO_ERR;
 
     /* the resnodes need to be deleted or moved to a tempQ
@@ -6590,7 +7013,9 @@ static status_t
                 continue;
             }
 
+            residx_init(&dummyidx, &dummy->r.nodeQ);
             walkerparms.resnodeQ = &dummy->r.nodeQ;
+            walkerparms.residx = &dummyidx;
             if (pcb->val) {
                 fnresult = val_find_all_descendants(value_walker_fn,
                                                     pcb,
@@ -6618,6 +7043,8 @@ static status_t
                                                     &fncalled);
             }
             walkerparms.resnodeQ = &resnodeQ;
+            walkerparms.residx = &residx;
+            residx_clean(&dummyidx);
 
             if (walkerparms.res != NO_ERR) {
                 res = walkerparms.res;
@@ -6636,11 +7063,10 @@ static status_t
 
                     /* It is assumed that testnode cannot NULL because the call 
                      * to dlq_empty returned false. */
-                    if (find_resnode(pcb, &resnodeQ,
-                                     (const void *)testnode->node.valptr)) {
+                    if (residx_find(pcb, &residx, (const void *)testnode->node.valptr)) {
                         free_resnode(pcb, testnode);
                     } else {
-                        dlq_enque(testnode, &resnodeQ);
+                        residx_add(pcb, &residx, testnode);
                     }
                 }
                 free_result(pcb, dummy);
@@ -6650,6 +7076,8 @@ static status_t
         free_resnode(pcb, resnode);
     }
 
+    residx_clean(&residx);
+
     /* put the resnode entries back where they belong */
     if (!dlq_empty(&resnodeQ)) {
         dlq_block_enque(&resnodeQ, &result->r.nodeQ);
@@ -6781,7 +7209,8 @@ static status_t
         break;
     case TK_TT_TSTRING:
         /* check the ID token for a NodeType name */
-        nodetyp = get_nodetype_id(TK_CUR_VAL(pcb->tkc));
+        nodetyp = (xpath_nodetype_t)
+            resolve_token(pcb, TK_CUR(pcb->tkc))->xpnodetyp;
         if (nodetyp == XP_EXNT_NONE ||
             (tk_next_typ(pcb->tkc) != TK_TT_LPAREN)) {
             name = TK_CUR_VAL(pcb->tkc);
@@ -7358,7 +7787,6 @@ static status_t
     parse_step (xpath_pcb_t *pcb,
                 xpath_result_t **result)
 {
-    const xmlChar    *nextval;
     tk_type_t         nexttyp, nexttyp2;
     ncx_xpath_axis_t  axis;
     status_t          res;
@@ -7501,8 +7929,7 @@ static status_t
     case TK_TT_TSTRING:
         /* check the ID token for an axis name */
         nexttyp2 = tk_next_typ2(pcb->tkc);
-        nextval = tk_next_val(pcb->tkc);
-        axis = get_axis_id(nextval);
+        axis = next_token(pcb)->xpaxis;
         if (axis != XP_AX_NONE && nexttyp2==TK_TT_DBLCOLON) {
             /* correct axis-name :: sequence */
             res = xpath_parse_token(pcb, TK_TT_TSTRING);
@@ -7677,10 +8104,7 @@ static xpath_result_t *
     }
 
     /* find the function in the library */
-    fncb = NULL;
-    if (TK_CUR_VAL(pcb->tkc) != NULL) {
-        fncb = find_fncb(pcb, TK_CUR_VAL(pcb->tkc));
-    }
+    fncb = resolve_fncb(pcb);
     if (fncb) {
         /* get the mandatory left paren */
         *res = xpath_parse_token(pcb, TK_TT_LPAREN);
@@ -8061,7 +8485,7 @@ static xpath_result_t *
                      status_t *res)
 {
     xpath_result_t  *val1, *val2;
-    const xmlChar   *nextval;
+    tk_token_t      *nexttk;
     tk_type_t        nexttyp, nexttyp2;
     xpath_exop_t     curop;
 
@@ -8085,16 +8509,16 @@ static xpath_result_t *
          * get the value of the string and the following token type
          */
         nexttyp2 = tk_next_typ2(pcb->tkc);
-        nextval = tk_next_val(pcb->tkc);
+        nexttk = next_token(pcb);
 
         /* check 'axis-name ::' sequence */
-        if (nexttyp2==TK_TT_DBLCOLON && get_axis_id(nextval)) {
+        if (nexttyp2==TK_TT_DBLCOLON && nexttk->xpaxis != XP_AX_NONE) {
             /* this is an axis name */
             return parse_location_path(pcb, NULL, res);
         }               
 
         /* check 'NodeType (' sequence */
-        if (nexttyp2==TK_TT_LPAREN && get_nodetype_id(nextval)) {
+        if (nexttyp2==TK_TT_LPAREN && nexttk->xpnodetyp != XP_EXNT_NONE) {
             /* this is an nodetype name */
             return parse_location_path(pcb, NULL, res);
         }
@@ -9758,6 +10182,7 @@ void
                           xpath_result_t *result)
 {
     xpath_resnode_t        *resnode, *nextnode;
+    xpath_residx_t          residx;
 
 #ifdef DEBUG
     if (!result) {
@@ -9778,6 +10203,8 @@ void
         return;
     }
 
+    residx_init(&residx, &result->r.nodeQ);
+
     /* the resnodes need to be deleted or moved to a tempQ
      * to correctly track duplicates and remove them
      */
@@ -9788,11 +10215,9 @@ void
 
         nextnode = (xpath_resnode_t *)dlq_nextEntry(resnode);
 
-        dlq_remove(resnode);
+        residx_remove(pcb, &residx, resnode);
 
-        if (xpath1_check_node_exists(pcb, 
-                                     &result->r.nodeQ,
-                                     resnode->node.valptr)) {
+        if (check_node_exists(pcb, &residx, resnode->node.valptr)) {
             log_debug2("\nxpath1: prune node '%s:%s'",
                        val_get_mod_name(resnode->node.valptr),
                        resnode->node.valptr->name);
@@ -9803,9 +10228,14 @@ void
             } else {
                 dlq_enque(resnode, &result->r.nodeQ);
             }
+            if (residx.slots) {
+                (void)residx_insert(pcb, &residx, resnode);
+            }
         }
     }
 
+    residx_clean(&residx);
+
 }  /* xpath1_prune_nodeset */
 
 
@@ -9841,32 +10271,13 @@ boolean
     }
 #endif
 
-    /* quick test -- see if docroot is already in the Q
-     * which means nothing else is needed
-     */
-    if (find_resnode(pcb, 
-                     resultQ,
-                     pcb->val_docroot)) {
-        return TRUE;
-    }
+    xpath_residx_t residx;
+    residx_init(&residx, resultQ);
 
-    /* no docroot in the Q so check the node itself */
-    if (val == pcb->val_docroot) {
-        return FALSE;
-    }
-        
-    while (val) {
-        if (find_resnode(pcb, resultQ, val)) {
-            return TRUE;
-        }
+    boolean retval = check_node_exists(pcb, &residx, val);
 
-        if (val->parent && !obj_is_root(val->parent->obj)) {
-            val = val->parent;
-        } else {
-            return FALSE;
-        }
-    }
-    return FALSE;
+    residx_clean(&residx);
+    return retval;
 
 }  /* xpath1_check_node_exists */
 
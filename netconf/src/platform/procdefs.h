@@ -243,20 +243,24 @@ typedef		long double		LDBL;
 #endif	    /* FALSE | TRUE */
 
 
-/* memory for these vars in ncx/ncx.c */
+/* memory for these vars in ncx/ncx.c
+ * updated atomically since the server can validate
+ * a config with several threads */
 extern uint32  malloc_cnt;
 extern uint32  free_cnt;
 
+#define m__count(CNT)  __atomic_add_fetch(&CNT, 1, __ATOMIC_RELAXED)
+
 #ifndef m__getMem
-#define m__getMem(X)   malloc(X);malloc_cnt++
+#define m__getMem(X)   malloc(X);m__count(malloc_cnt)
 #endif		/* m__getMem */
 
 #ifndef m__free
-#define m__free(X)    do { if ( X ) { free(X); free_cnt++; } } while(0)
+#define m__free(X)    do { if ( X ) { free(X); m__count(free_cnt); } } while(0)
 #endif		/* m__free */
 
 #ifndef m__getObj
-#define m__getObj(OBJ)	(OBJ *)malloc(sizeof(OBJ));malloc_cnt++
+#define m__getObj(OBJ)	(OBJ *)malloc(sizeof(OBJ));m__count(malloc_cnt)
 #endif		/* m__getObj */
 
 #ifdef __cplusplus
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2008 - 2012, Andy Bierman, All Rights Reserved.
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*  FILE: ncx-regex-check.c
+
+    Cross-check ncx_regex_match against libxml2
+
+    Every pattern is matched against every string with
+    ncx_regex_match, which uses PCRE2 when the pattern could be
+    translated, and with xmlRegexpExec on the libxml2 regex of
+    the same cache entry.  Any difference is printed with
+    !MISMATCH and the program exits with 1.
+
+    With a count argument the IPv4 and IPv6 address patterns of
+    ietf-inet-types are also matched that many times each and
+    the time is printed, e.g. ncx-regex-check 1000000
+
+*********************************************************************
+*								    *
+*		   C H A N G E	 H I S T O R Y			    *
+*								    *
+*********************************************************************
+
+date	     init     comment
+----------------------------------------------------------------------
+17-oct-26             Begun
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "procdefs.h"
+#include "ncx_regex.h"
+#include "status.h"
+
+/* ietf-inet-types ipv4-address and ipv6-address first, then
+ * patterns using the XSD constructs the translation handles
+ * or rejects
+ */
+static const char *patterns[] = {
+    "(([0-9]|[1-9][0-9]|1[0-9][0-9]|2[0-4][0-9]|25[0-5])\\.){3}"
+    "([0-9]|[1-9][0-9]|1[0-9][0-9]|2[0-4][0-9]|25[0-5])"
+    "(%[\\p{N}\\p{L}]+)?",
+    "((:|[0-9a-fA-F]{0,4}):)([0-9a-fA-F]{0,4}:){0,5}"
+    "((([0-9a-fA-F]{0,4}:)?(:|[0-9a-fA-F]{0,4}))|"
+    "(((25[0-5]|2[0-4][0-9]|[01]?[0-9]?[0-9])\\.){3}"
+    "(25[0-5]|2[0-4][0-9]|[01]?[0-9]?[0-9])))"
+    "(%[\\p{N}\\p{L}]+)?",
+    "[a-zA-Z_][a-zA-Z0-9\\-_.]*",
+    "a.c",
+    "x^y$",
+    "[\\s]+",
+    "\\S*",
+    "[^a-c]+d?",
+    "[a-z-[aeiou]]+",
+    "\\i\\c*",
+    "[ab\\[]+",
+    "\\w+",
+    "[\\-a]+",
+    "(ab|cd){2,3}",
+    ".*",
+    "\\d{2}-\\d+",
+    NULL
+};
+
+static const char *strings[] = {
+    "192.168.1.1", "10.0.0.256", "1.2.3.4%eth0", "fe80::1",
+    "2001:db8::1%eth0", "::", "abc", "a\nc", "a.c", "x^y$", "xy",
+    " \t", "ab cd", "", "d", "zzd", "bcd", "bcdf", "bcdf ", "_foo",
+    "a-b", "[ab", "abab", "abcdab", "12-3", "12-",
+    "\xc3\xa9", "a\xc3\xa9", "a\rc",
+    NULL
+};
+
+/* matched by the timing loop, two per address pattern */
+static const char *addresses[] = {
+    "192.168.100.200", "10.1.2.3",
+    "fe80::1234:5678", "2001:db8:0:0:1:0:0:1"
+};
+
+int
+main (int argc, char **argv)
+{
+    ncx_regex_t *regex;
+    status_t     res;
+    long         count, k, matches;
+    int          i, j, a, b, retval;
+    struct timespec t0, t1;
+
+    count = (argc > 1) ? atol(argv[1]) : 0;
+    retval = 0;
+
+    ncx_regex_init();
+
+    for (i = 0; patterns[i] != NULL; i++) {
+        regex = ncx_regex_get((const xmlChar *)patterns[i], &res);
+        if (regex == NULL) {
+            printf("P%d invalid: %s\n", i, get_error_string(res));
+            retval = 1;
+            continue;
+        }
+        printf("P%d fast=%d:", i, regex->fastregex != NULL);
+        for (j = 0; strings[j] != NULL; j++) {
+            a = ncx_regex_match(regex, (const xmlChar *)strings[j]);
+            b = xmlRegexpExec(regex->xmlregex,
+                              (const xmlChar *)strings[j]);
+            printf(" %d", a);
+            if (a != b) {
+                printf("!MISMATCH(S%d)", j);
+                retval = 1;
+            }
+        }
+        printf("\n");
+        ncx_regex_release(regex);
+    }
+
+    for (i = 0; i < 2 && count > 0; i++) {
+        regex = ncx_regex_get((const xmlChar *)patterns[i], &res);
+        if (regex == NULL) {
+            continue;
+        }
+        matches = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (k = 0; k < count; k++) {
+            matches += ncx_regex_match(regex, (const xmlChar *)
+                                       addresses[i*2 + (k & 1)]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        printf("P%d count=%ld matches=%ld %.3fs\n", i, count, matches,
+               (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+        ncx_regex_release(regex);
+    }
+
+    ncx_regex_cleanup();
+    return retval;
+}
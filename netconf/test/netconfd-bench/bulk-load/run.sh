@@ -0,0 +1,11 @@
+#!/bin/bash -e
+rm -rf tmp || true
+mkdir tmp
+killall -KILL netconfd || true
+rm /tmp/ncxserver.sock || true
+/usr/sbin/netconfd --module=iana-if-type --module=ietf-interfaces --no-startup --superuser=$USER 2>&1 1>tmp/server.log &
+SERVER_PID=$!
+sleep 4
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --entries=$BULK_LOAD_ENTRIES
+kill -KILL $SERVER_PID
+sleep 1
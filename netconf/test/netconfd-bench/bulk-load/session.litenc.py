@@ -0,0 +1,135 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+import random
+
+def edit_config(conn, entries):
+	edit_config_rpc = """
+<edit-config>
+    <target>
+      <candidate/>
+    </target>
+    <default-operation>merge</default-operation>
+    <test-option>set</test-option>
+    <config>
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces">
+%(entries)s
+      </interfaces>
+    </config>
+  </edit-config>
+""" % {'entries':entries}
+	start = time.time()
+	result = conn.rpc(edit_config_rpc)
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+	return time.time() - start
+
+def commit(conn):
+	start = time.time()
+	result = conn.rpc("<commit/>")
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+	return time.time() - start
+
+def main():
+	print("""
+#Description: Bulk load a large keyed list and time the list entry operations.
+#Procedure:
+#1 - Create N /interfaces/interface entries in one <edit-config> and commit.
+#2 - Merge a description into 2000 randomly chosen existing entries and commit.
+#3 - Delete /interfaces and commit.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+	parser.add_argument("--entries", help="number of list entries to load (1000000 if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	if(args.entries==None or args.entries==""):
+		entries=1000000
+	else:
+		entries=int(args.entries)
+
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return(-1)
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return(-1)
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return(-1)
+
+	print("Connected ...")
+
+	print("#1 - Create %(entries)d /interfaces/interface entries in one <edit-config> and commit." % {'entries':entries})
+	load = "".join(["""<interface><name>e%(i)d</name><type xmlns:ianaift="urn:ietf:params:xml:ns:yang:iana-if-type">ianaift:ethernetCsmacd</type></interface>""" % {'i':i} for i in range(entries)])
+	print("edit-config: %(sec).2f sec" % {'sec':edit_config(conn, load)})
+	print("commit: %(sec).2f sec" % {'sec':commit(conn)})
+
+	print("#2 - Merge a description into 2000 randomly chosen existing entries and commit.")
+	random.seed(1)
+	merge = "".join(["""<interface><name>e%(i)d</name><description>m%(i)d</description></interface>""" % {'i':i} for i in random.sample(range(entries), min(entries, 2000))])
+	print("edit-config: %(sec).2f sec" % {'sec':edit_config(conn, merge)})
+	print("commit: %(sec).2f sec" % {'sec':commit(conn)})
+
+	print("#3 - Delete /interfaces and commit.")
+	delete = """<interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0" nc:operation="delete"/>"""
+	edit_config_rpc = """
+<edit-config>
+    <target>
+      <candidate/>
+    </target>
+    <config>
+%(delete)s
+    </config>
+  </edit-config>
+""" % {'delete':delete}
+	result = conn.rpc(edit_config_rpc)
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+	print("commit: %(sec).2f sec" % {'sec':commit(conn)})
+
+sys.exit(main())
@@ -0,0 +1,12 @@
+#!/bin/bash -e
+rm -rf tmp || true
+mkdir tmp
+killall -KILL netconfd || true
+rm /tmp/ncxserver.sock || true
+ulimit -n 20000
+/usr/sbin/netconfd --module=iana-if-type --module=ietf-interfaces --no-startup --max-sessions=10000 --superuser=$USER 2>&1 1>tmp/server.log &
+SERVER_PID=$!
+sleep 4
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --idle=$IDLE_SESSIONS --active=$ACTIVE_SESSIONS
+kill -KILL $SERVER_PID
+sleep 1
@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+import socket
+
+def connect(server, port, user, password):
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return None
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return None
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return None
+	return conn
+
+def get_config(conn):
+	start = time.time()
+	result = conn.rpc("""
+<get-config>
+  <source>
+    <running/>
+  </source>
+</get-config>
+""")
+	data = result.xpath('//data')
+	assert(len(data)==1)
+	return time.time() - start
+
+def main():
+	print("""
+#Description: Per-request latency on active sessions while idle connections are open.
+#Procedure:
+#1 - Open M active sessions.
+#2 - For each idle count N, open idle connections to the ncxserver socket
+#    until N are open, then send 50 <get-config> on each active session
+#    and report the mean and max latency.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+	parser.add_argument("--idle", help="comma separated idle connection counts (0,1000,2000,5000 if not specified)")
+	parser.add_argument("--active", help="number of active sessions (4 if not specified)")
+	parser.add_argument("--sockname", help="ncxserver socket (/tmp/ncxserver.sock if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	if(args.idle==None or args.idle==""):
+		idle=[0, 1000, 2000, 5000]
+	else:
+		idle=[int(n) for n in args.idle.split(",")]
+
+	if(args.active==None or args.active==""):
+		active=4
+	else:
+		active=int(args.active)
+
+	if(args.sockname==None or args.sockname==""):
+		sockname="/tmp/ncxserver.sock"
+	else:
+		sockname=args.sockname
+
+	print("#1 - Open %(active)d active sessions." % {'active':active})
+	conns = []
+	for i in range(active):
+		conn = connect(server, port, user, password)
+		if conn == None:
+			return(-1)
+		conns.append(conn)
+
+	print("#2 - Time <get-config> with N idle connections open.")
+	socks = []
+	for n in idle:
+		# an idle connection is a socket the server accepted
+		# that never sends anything, like a stalled subsystem
+		while len(socks) < n:
+			s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+			s.connect(sockname)
+			socks.append(s)
+		time.sleep(1)
+
+		times = []
+		for r in range(50):
+			for conn in conns:
+				times.append(get_config(conn))
+		print("idle=%(n)d active=%(active)d requests=%(requests)d mean=%(mean).2f ms max=%(max).2f ms" % {'n':len(socks), 'active':active, 'requests':len(times), 'mean':1000*sum(times)/len(times), 'max':1000*max(times)})
+
+	for s in socks:
+		s.close()
+	for conn in conns:
+		conn.rpc("<close-session/>")
+
+sys.exit(main())
@@ -0,0 +1,18 @@
+#!/bin/bash -e
+
+if [ "$RUN_WITH_CONFD" != "" ] ; then
+    # skipped test return value
+    exit 77
+fi
+
+rm -rf tmp || true
+mkdir tmp
+killall -KILL netconfd || true
+rm /tmp/ncxserver.sock || true
+/usr/sbin/netconfd --module=./test-commit-edits.yang --target=candidate --no-startup --superuser=$USER 2>&1 1>tmp/server.log &
+SERVER_PID=$!
+sleep 3
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD
+kill -KILL $SERVER_PID
+cat tmp/server.log
+sleep 1
@@ -0,0 +1,264 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+# list the nodes under an element as /path or /path=value for leafs
+def get_nodes(elem, path=""):
+	nodes = []
+	for child in elem:
+		child_path = path + "/" + child.tag
+		if len(child) == 0:
+			nodes.append(child_path + "=" + (child.text or "").strip())
+		else:
+			nodes.append(child_path)
+			nodes.extend(get_nodes(child, child_path))
+	return nodes
+
+def get_top(conn, source):
+	result = conn.rpc("""
+<get-config>
+  <source>
+    <%(source)s/>
+  </source>
+  <filter type="subtree">
+    <top xmlns="http://yuma123.org/ns/test-commit-edits"/>
+  </filter>
+</get-config>
+""" % {'source':source})
+	data = result.xpath('//data')
+	assert(len(data)==1)
+	nodes = get_nodes(data[0])
+	print nodes
+	return nodes
+
+def rpc_ok(conn, rpc):
+	result = conn.rpc(rpc)
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+def edit_candidate(conn, config):
+	rpc_ok(conn, """
+<edit-config>
+    <target>
+      <candidate/>
+    </target>
+    <config>
+      <top xmlns="http://yuma123.org/ns/test-commit-edits" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0" xmlns:yang="urn:ietf:params:xml:ns:yang:1">
+%(config)s
+      </top>
+    </config>
+  </edit-config>
+""" % {'config':config})
+
+# the candidate must be the same as running after it is
+# resynchronized from running
+def check_synced(conn):
+	assert(get_top(conn, "candidate")==get_top(conn, "running"))
+
+def commit(conn):
+	rpc_ok(conn, "<commit/>")
+	check_synced(conn)
+
+def main():
+	print("""
+#Description: Verify <commit> applies the candidate edits to running.
+#Procedure:
+#1 - Create /top with items a, b and c and commit.
+#2 - Merge, create and delete items and commit.
+#3 - Move an item of the user-ordered list and commit.
+#4 - Replace the candidate with <copy-config> and commit.
+#5 - Disable /top so the when-stmt removes /top/extra and commit.
+#6 - Edit the candidate and <discard-changes>.
+#7 - Lock the candidate, edit it and <unlock>.
+#8 - Edit the candidate while a confirmed commit times out and restores running.
+#   After each commit and in #6 - #8, verify the candidate is the same as running.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return(-1)
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return(-1)
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return(-1)
+
+	print "[OK] Receiving <hello> =%(reply_xml)s:" % {'reply_xml':reply_xml}
+
+	print("#1 - Create /top with items a, b and c and commit.")
+	edit_candidate(conn, """
+        <enabled>true</enabled>
+        <item><name>a</name><value>1</value></item>
+        <item><name>b</name><value>2</value></item>
+        <item><name>c</name><value>3</value></item>
+        <extra><e>x1</e></extra>
+""")
+	commit(conn)
+	assert(get_top(conn, "running")==["/top", "/top/enabled=true",
+		"/top/item", "/top/item/name=a", "/top/item/value=1",
+		"/top/item", "/top/item/name=b", "/top/item/value=2",
+		"/top/item", "/top/item/name=c", "/top/item/value=3",
+		"/top/extra", "/top/extra/e=x1"])
+
+	print("#2 - Merge, create and delete items and commit.")
+	edit_candidate(conn, """
+        <item><name>b</name><value>20</value></item>
+        <item nc:operation="create"><name>d</name><value>4</value></item>
+        <item nc:operation="delete"><name>a</name></item>
+""")
+	commit(conn)
+	assert(get_top(conn, "running")==["/top", "/top/enabled=true",
+		"/top/item", "/top/item/name=b", "/top/item/value=20",
+		"/top/item", "/top/item/name=c", "/top/item/value=3",
+		"/top/item", "/top/item/name=d", "/top/item/value=4",
+		"/top/extra", "/top/extra/e=x1"])
+
+	# only the position of d changes, none of its values
+	print("#3 - Move an item of the user-ordered list and commit.")
+	edit_candidate(conn, """
+        <item nc:operation="replace" yang:insert="first"><name>d</name><value>4</value></item>
+""")
+	commit(conn)
+	assert(get_top(conn, "running")==["/top", "/top/enabled=true",
+		"/top/item", "/top/item/name=d", "/top/item/value=4",
+		"/top/item", "/top/item/name=b", "/top/item/value=20",
+		"/top/item", "/top/item/name=c", "/top/item/value=3",
+		"/top/extra", "/top/extra/e=x1"])
+
+	# copy-config does not record the edits, so the commit
+	# compares the whole candidate with running; b is deleted,
+	# c is changed and e is created
+	print("#4 - Replace the candidate with <copy-config> and commit.")
+	rpc_ok(conn, """
+<copy-config>
+  <target>
+    <candidate/>
+  </target>
+  <source>
+    <config>
+      <top xmlns="http://yuma123.org/ns/test-commit-edits">
+        <enabled>true</enabled>
+        <item><name>d</name><value>4</value></item>
+        <item><name>c</name><value>30</value></item>
+        <item><name>e</name><value>5</value></item>
+        <extra><e>x2</e></extra>
+      </top>
+    </config>
+  </source>
+</copy-config>
+""")
+	commit(conn)
+	assert(get_top(conn, "running")==["/top", "/top/enabled=true",
+		"/top/item", "/top/item/name=d", "/top/item/value=4",
+		"/top/item", "/top/item/name=c", "/top/item/value=30",
+		"/top/item", "/top/item/name=e", "/top/item/value=5",
+		"/top/extra", "/top/extra/e=x2"])
+
+	# /top/extra is removed from the candidate by the edit,
+	# the commit must remove it from running
+	print("#5 - Disable /top so the when-stmt removes /top/extra and commit.")
+	edit_candidate(conn, """
+        <enabled>false</enabled>
+""")
+	assert(get_top(conn, "candidate")==["/top", "/top/enabled=false",
+		"/top/item", "/top/item/name=d", "/top/item/value=4",
+		"/top/item", "/top/item/name=c", "/top/item/value=30",
+		"/top/item", "/top/item/name=e", "/top/item/value=5"])
+	commit(conn)
+	assert(get_top(conn, "running")==["/top", "/top/enabled=false",
+		"/top/item", "/top/item/name=d", "/top/item/value=4",
+		"/top/item", "/top/item/name=c", "/top/item/value=30",
+		"/top/item", "/top/item/name=e", "/top/item/value=5"])
+	expected = get_top(conn, "running")
+
+	pending = """
+        <enabled>true</enabled>
+        <item nc:operation="delete"><name>c</name></item>
+        <item nc:operation="replace" yang:insert="first"><name>e</name><value>50</value></item>
+        <item><name>f</name><value>6</value></item>
+        <extra><e>x3</e></extra>
+"""
+
+	print("#6 - Edit the candidate and <discard-changes>.")
+	edit_candidate(conn, pending)
+	rpc_ok(conn, "<discard-changes/>")
+	check_synced(conn)
+	assert(get_top(conn, "running")==expected)
+
+	print("#7 - Lock the candidate, edit it and <unlock>.")
+	rpc_ok(conn, "<lock><target><candidate/></target></lock>")
+	edit_candidate(conn, pending)
+	rpc_ok(conn, "<unlock><target><candidate/></target></unlock>")
+	check_synced(conn)
+	assert(get_top(conn, "running")==expected)
+
+	# running cannot be edited directly with --target=candidate;
+	# the confirmed commit rollback is the running change that
+	# is made while the candidate has pending edits
+	print("#8 - Edit the candidate while a confirmed commit times out and restores running.")
+	edit_candidate(conn, """
+        <item><name>g</name><value>7</value></item>
+""")
+	rpc_ok(conn, """
+<commit>
+  <confirmed/>
+  <confirm-timeout>2</confirm-timeout>
+</commit>
+""")
+	check_synced(conn)
+	edit_candidate(conn, pending)
+	time.sleep(4)
+	check_synced(conn)
+	assert(get_top(conn, "running")==expected)
+
+	return(0)
+
+sys.exit(main())
@@ -0,0 +1,20 @@
+#!/bin/bash -e
+
+if [ "$RUN_WITH_CONFD" != "" ] ; then
+    # skipped test return value
+    exit 77
+fi
+
+rm -rf tmp || true
+mkdir tmp
+killall -KILL netconfd || true
+for target in candidate running ; do
+  rm /tmp/ncxserver.sock || true
+  /usr/sbin/netconfd --module=iana-if-type --module=ietf-interfaces --module=test-commit-test-deps.yang --target=$target --no-startup --superuser=$USER 2>&1 1>tmp/server-$target.log &
+  SERVER_PID=$!
+  sleep 3
+  python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --target=$target
+  kill -KILL $SERVER_PID
+  cat tmp/server-$target.log
+  sleep 1
+done
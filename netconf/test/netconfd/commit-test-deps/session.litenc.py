@@ -0,0 +1,195 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+# apply the edit to the target and return the reply with the error,
+# or of the <commit> with target candidate if there was none;
+# candidate edits are not validated so the commit runs the tests
+def edit(conn, target, config):
+	if(target=="running"):
+		test_option="test-then-set"
+	else:
+		test_option="set"
+	edit_config_rpc = """
+<edit-config>
+    <target>
+      <%(target)s/>
+    </target>
+    <default-operation>merge</default-operation>
+    <test-option>%(test_option)s</test-option>
+    <config>
+%(config)s
+    </config>
+  </edit-config>
+""" % {'target':target, 'test_option':test_option, 'config':config}
+	print("edit-config ...")
+	result = conn.rpc(edit_config_rpc)
+	if(target=="running"):
+		return result
+
+	if(len(result.xpath('//ok'))==1):
+		print("commit ...")
+		result = conn.rpc("<commit/>")
+	if(len(result.xpath('//ok'))!=1):
+		print("discard-changes ...")
+		discard = conn.rpc("<discard-changes/>")
+		ok = discard.xpath('//ok')
+		assert(len(ok)==1)
+	return result
+
+def get_interface_names(conn):
+	result = conn.rpc("""
+<get-config>
+  <source>
+    <running/>
+  </source>
+</get-config>
+""")
+	names = [name.text for name in result.xpath('//data/interfaces/interface/name')]
+	print names
+	return names
+
+def main():
+	print("""
+#Description: Verify commit tests reading another module are not skipped.
+#Procedure:
+#1 - Create interfaces eth0 and eth1, /mgmt/interface=eth0 and /mgmt/backup-interface=eth1.
+#2 - Delete interface eth0 and verify the instance-required error for the /mgmt/interface leafref.
+#3 - Disable interface eth1 and verify the /mgmt/backup-interface must error.
+#4 - Delete /mgmt and both interfaces.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+	parser.add_argument("--target", help="candidate or running (candidate if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	if(args.target==None or args.target==""):
+		target="candidate"
+	else:
+		target=args.target
+
+
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return(-1)
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return(-1)
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return(-1)
+
+	print "[OK] Receiving <hello> =%(reply_xml)s:" % {'reply_xml':reply_xml}
+
+	print("#1 - Create interfaces eth0 and eth1, /mgmt/interface=eth0 and /mgmt/backup-interface=eth1.")
+	result = edit(conn, target, """
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces" xmlns:ianaift="urn:ietf:params:xml:ns:yang:iana-if-type">
+        <interface>
+          <name>eth0</name>
+          <type>ianaift:ethernetCsmacd</type>
+        </interface>
+        <interface>
+          <name>eth1</name>
+          <type>ianaift:ethernetCsmacd</type>
+          <enabled>true</enabled>
+        </interface>
+      </interfaces>
+      <mgmt xmlns="http://yuma123.org/ns/test-commit-test-deps">
+        <interface>eth0</interface>
+        <backup-interface>eth1</backup-interface>
+      </mgmt>
+""")
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+	# the next two edits change ietf-interfaces data only, so the
+	# tests of the /mgmt leafs are selected by their dependencies
+	print("#2 - Delete interface eth0 and verify the instance-required error for the /mgmt/interface leafref.")
+	result = edit(conn, target, """
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0">
+        <interface nc:operation="delete">
+          <name>eth0</name>
+        </interface>
+      </interfaces>
+""")
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==0)
+	app_tag = result.xpath('//rpc-error/error-app-tag')
+	assert(len(app_tag)==1)
+	assert(app_tag[0].text=="instance-required")
+	assert(get_interface_names(conn)==["eth0", "eth1"])
+
+	print("#3 - Disable interface eth1 and verify the /mgmt/backup-interface must error.")
+	result = edit(conn, target, """
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces">
+        <interface>
+          <name>eth1</name>
+          <enabled>false</enabled>
+        </interface>
+      </interfaces>
+""")
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==0)
+	error_message = result.xpath('//rpc-error/error-message')
+	assert(len(error_message)==1)
+	assert(error_message[0].text=="The backup interface must be enabled.")
+
+	print("#4 - Delete /mgmt and both interfaces.")
+	result = edit(conn, target, """
+      <mgmt xmlns="http://yuma123.org/ns/test-commit-test-deps" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0" nc:operation="delete"/>
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0" nc:operation="delete"/>
+""")
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+	assert(get_interface_names(conn)==[])
+
+	return(0)
+
+sys.exit(main())
@@ -0,0 +1,31 @@
+#!/bin/bash -e
+
+if [ "$RUN_WITH_CONFD" != "" ] ; then
+    # skipped test return value
+    exit 77
+fi
+
+rm -rf tmp || true
+mkdir tmp
+killall -KILL netconfd || true
+rm /tmp/ncxserver.sock || true
+/usr/sbin/netconfd --module=iana-if-type --module=ietf-interfaces --no-startup --superuser=$USER --eventlog-dir=$PWD/tmp/eventlog 2>&1 1>tmp/server.log &
+SERVER_PID=$!
+sleep 3
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD
+kill -KILL $SERVER_PID
+cat tmp/server.log
+sleep 2
+
+# restart twice with the same event log; the second restart
+# also checks the sequence-ids used after the first one
+for restart in 1 2 ; do
+  rm /tmp/ncxserver.sock || true
+  /usr/sbin/netconfd --module=iana-if-type --module=ietf-interfaces --no-startup --superuser=$USER --eventlog-dir=$PWD/tmp/eventlog 2>&1 1>tmp/server-restart-$restart.log &
+  SERVER_PID=$!
+  sleep 3
+  python session-replay.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --server-log=tmp/server-restart-$restart.log
+  kill -KILL $SERVER_PID
+  cat tmp/server-restart-$restart.log
+  sleep 2
+done
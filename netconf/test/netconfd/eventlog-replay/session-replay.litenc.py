@@ -0,0 +1,183 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+START_TIME="2000-01-01T00:00:00Z"
+
+def connect(server, port, user, password):
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return None
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return None
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return None
+
+	print "[OK] Receiving <hello> =%(reply_xml)s:" % {'reply_xml':reply_xml}
+	return conn
+
+# returns a list of (event name, eventTime, notification) tuples
+# received before the <last> event, which is not included
+def receive_events(conn, last):
+	events=[]
+	while True:
+		notification = conn.receive()
+		assert(notification!=None)
+		event = notification.xpath('/notification/*')[1]
+		event_time = notification.xpath('/notification/eventTime')[0].text
+		print("%(time)s %(name)s" % {'time':event_time, 'name':event.tag})
+		if(event.tag==last):
+			return events
+		events.append((event.tag, event_time, notification))
+
+def config_change_targets(events):
+	targets=[]
+	for (name, event_time, notification) in events:
+		if(name=="netconf-config-change"):
+			targets.append(notification.xpath('/notification/netconf-config-change/edit/target')[0].text)
+	return targets
+
+def main():
+	print("""
+#Description: Replay the events logged before a restart from the --eventlog-dir event log.
+#Procedure:
+#1 - <create-subscription> with startTime and verify all logged events are replayed in order.
+#2 - Verify the restarted server continued the sequence-id from the last logged event.
+#3 - <create-subscription> with startTime and stopTime and verify the replay stops at stopTime.
+#4 - <create-subscription> with startTime, stopTime and a subtree filter and verify only the matching events are replayed.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+	parser.add_argument("--server-log", help="log file of the restarted server")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	print("#1 - <create-subscription> with startTime and verify all logged events are replayed in order.")
+	conn = connect(server, port, user, password)
+	assert(conn!=None)
+	result = conn.rpc("""
+<create-subscription xmlns="urn:ietf:params:xml:ns:netconf:notification:1.0">
+  <startTime>%(start)s</startTime>
+</create-subscription>
+""" % {'start':START_TIME})
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+	events = receive_events(conn, "replayComplete")
+
+	# one <sysStartup> per server start, the last one is
+	# the first event logged after the last restart
+	startups = [i for i in range(len(events)) if events[i][0]=="sysStartup"]
+	assert(len(startups)>=2)
+	assert(startups[0]==0)
+	restart = startups[-1]
+
+	for i in range(1, len(events)):
+		assert(events[i-1][1] <= events[i][1])
+
+	before = events[:restart]
+	targets = config_change_targets(before)
+	print targets
+	assert(targets==["/if:interfaces",
+	                 "/if:interfaces/if:interface[if:name='eth1']",
+	                 "/if:interfaces/if:interface[if:name='eth2']"])
+
+	print("#2 - Verify the restarted server continued the sequence-id from the last logged event.")
+	# sequence-ids start at 1 and have no gaps, so the last one logged
+	# before the restart is the number of events replayed before it
+	if(args.server_log!=None and args.server_log!=""):
+		server_log = open(args.server_log).read()
+		print server_log
+		assert(server_log.find("last sequence-id %u)" % (restart))>=0)
+
+	print("#3 - <create-subscription> with startTime and stopTime and verify the replay stops at stopTime.")
+	stop_time = [e[1] for e in before if e[0]=="netconf-config-change"][-1]
+	conn2 = connect(server, port, user, password)
+	assert(conn2!=None)
+	result = conn2.rpc("""
+<create-subscription xmlns="urn:ietf:params:xml:ns:netconf:notification:1.0">
+  <startTime>%(start)s</startTime>
+  <stopTime>%(stop)s</stopTime>
+</create-subscription>
+""" % {'start':START_TIME, 'stop':stop_time})
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+	stopped = receive_events(conn2, "replayComplete")
+	assert(len(stopped)<=restart)
+	for i in range(len(stopped)):
+		assert(stopped[i][0]==events[i][0])
+		assert(stopped[i][1]==events[i][1])
+		assert(stopped[i][1]<=stop_time)
+	assert(config_change_targets(stopped)==targets)
+	assert(receive_events(conn2, "notificationComplete")==[])
+
+	print("#4 - <create-subscription> with startTime, stopTime and a subtree filter and verify only the matching events are replayed.")
+	conn3 = connect(server, port, user, password)
+	assert(conn3!=None)
+	# the filter is matched against the child nodes of the event;
+	# only <netconf-config-change> has an <edit> child
+	result = conn3.rpc("""
+<create-subscription xmlns="urn:ietf:params:xml:ns:netconf:notification:1.0">
+  <filter type="subtree">
+    <edit xmlns="urn:ietf:params:xml:ns:yang:ietf-netconf-notifications"/>
+  </filter>
+  <startTime>%(start)s</startTime>
+  <stopTime>%(stop)s</stopTime>
+</create-subscription>
+""" % {'start':START_TIME, 'stop':stop_time})
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+	filtered = receive_events(conn3, "replayComplete")
+	assert(len(filtered)==3)
+	assert(config_change_targets(filtered)==targets)
+	assert(receive_events(conn3, "notificationComplete")==[])
+
+	return(0)
+
+sys.exit(main())
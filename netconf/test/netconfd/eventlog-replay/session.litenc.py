@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+def main():
+	print("""
+#Description: Generate events stored in the --eventlog-dir event log.
+#Procedure:
+#1 - Create /interfaces/interface[name='eth0'], 'eth1' and 'eth2', one commit each.
+#2 - Verify each commit is reported with <netconf-config-change> to a live subscription.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return(-1)
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return(-1)
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return(-1)
+
+	print "[OK] Receiving <hello> =%(reply_xml)s:" % {'reply_xml':reply_xml}
+
+	result = conn.rpc("""
+<create-subscription xmlns="urn:ietf:params:xml:ns:netconf:notification:1.0"/>
+""")
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+	print("#1 - Create /interfaces/interface[name='eth0'], 'eth1' and 'eth2', one commit each.")
+	for name in ["eth0", "eth1", "eth2"]:
+		edit_config_rpc = """
+<edit-config>
+    <target>
+      <candidate/>
+    </target>
+    <default-operation>merge</default-operation>
+    <test-option>set</test-option>
+    <config>
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces">
+        <interface>
+          <name>%(name)s</name>
+          <type xmlns:ianaift="urn:ietf:params:xml:ns:yang:iana-if-type">ianaift:ethernetCsmacd</type>
+        </interface>
+      </interfaces>
+    </config>
+  </edit-config>
+""" % {'name':name}
+		print("edit-config %(name)s ..." % {'name':name})
+		result = conn.rpc(edit_config_rpc)
+		ok = result.xpath('//ok')
+		assert(len(ok)==1)
+
+		print("commit ...")
+		result = conn.rpc("<commit/>")
+		ok = result.xpath('//ok')
+		assert(len(ok)==1)
+
+		print("#2 - Verify the commit is reported with <netconf-config-change>.")
+		notification = conn.receive()
+		assert(notification!=None)
+		change = notification.xpath('/notification/netconf-config-change')
+		assert(len(change)==1)
+
+	return(0)
+
+sys.exit(main())
@@ -0,0 +1,145 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+# list the nodes under an element as /path or /path=value for leafs
+def get_nodes(elem, path=""):
+	nodes = []
+	for child in elem:
+		child_path = path + "/" + child.tag
+		if len(child) == 0:
+			nodes.append(child_path + "=" + (child.text or "").strip())
+		else:
+			nodes.append(child_path)
+			nodes.extend(get_nodes(child, child_path))
+	return nodes
+
+def get(conn):
+	result = conn.rpc("<get/>")
+	data = result.xpath('//data')
+	assert(len(data)==1)
+	nodes = get_nodes(data[0])
+	print nodes
+	return nodes
+
+def edit(conn, config):
+	edit_config_rpc = """
+<edit-config>
+    <target>
+      <running/>
+    </target>
+    <config>
+      <top xmlns="http://yuma123.org/ns/test-nacm-data-rules" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0">
+%(config)s
+      </top>
+    </config>
+  </edit-config>
+""" % {'config':config}
+	result = conn.rpc(edit_config_rpc)
+	print result
+	return result
+
+def edit_ok(conn, config):
+	result = edit(conn, config)
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+def edit_denied(conn, config):
+	result = edit(conn, config)
+	ok = result.xpath('//ok')
+	assert(len(ok)==0)
+	error_tag = result.xpath('//rpc-error/error-tag')
+	assert(len(error_tag)==1)
+	assert(error_tag[0].text=="access-denied")
+
+def main():
+	print("""
+#Description: Verify the NACM data rules for a user that is not the superuser.
+#Procedure:
+#1 - Verify <get> returns only the nodes permitted by the read rules.
+#2 - Verify <edit-config> with the create, update and delete rules.
+#3 - Verify the XPath rule with a predicate selects the node after an edit.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return(-1)
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return(-1)
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return(-1)
+
+	print "[OK] Receiving <hello> =%(reply_xml)s:" % {'reply_xml':reply_xml}
+
+	# read-default is deny, so /nacm, /other and all the state
+	# data are not returned; /top is returned as the ancestor
+	# of the rule targets; secret/s is not 'shared' yet, so the
+	# predicate rule does not select /top/secret
+	print("#1 - Verify <get> returns only the nodes permitted by the read rules.")
+	assert(get(conn)==["/top", "/top/open", "/top/open/a=a1", "/top/x=x1", "/top/blob=b1"])
+
+	# write-default is deny; the rule with path '/' permits any create
+	print("#2 - Verify <edit-config> with the create, update and delete rules.")
+	edit_ok(conn, "<open><a>a2</a></open>")
+	edit_ok(conn, "<open><b>b1</b></open>")
+	edit_denied(conn, "<x2>x3</x2>")
+	edit_ok(conn, "<x>x4</x>")
+	edit_denied(conn, "<blob2>b4</blob2>")
+	edit_denied(conn, """<open><a nc:operation="delete"/></open>""")
+	edit_ok(conn, """<open><b nc:operation="delete"/></open>""")
+
+	print("#3 - Verify the XPath rule with a predicate selects the node after an edit.")
+	edit_ok(conn, "<secret><s>shared</s></secret>")
+	assert(get(conn)==["/top", "/top/open", "/top/open/a=a2", "/top/secret", "/top/secret/s=shared", "/top/x=x4", "/top/blob=b1"])
+
+	return(0)
+
+sys.exit(main())
@@ -0,0 +1,24 @@
+#!/bin/bash -e
+
+if [ "$RUN_WITH_CONFD" != "" ] ; then
+    # skipped test return value
+    exit 77
+fi
+
+rm -rf tmp || true
+mkdir tmp
+# the NACM rules are for the test user, who is not the superuser
+if [ "$NCUSER" != "" ] ; then
+  sed "s/NCUSER/$NCUSER/" startup-cfg.xml > tmp/startup-cfg.xml
+else
+  sed "s/NCUSER/$USER/" startup-cfg.xml > tmp/startup-cfg.xml
+fi
+killall -KILL netconfd || true
+rm /tmp/ncxserver.sock || true
+/usr/sbin/netconfd --module=iana-if-type --module=ietf-interfaces --startup=$PWD/tmp/startup-cfg.xml 2>&1 1>tmp/server.log &
+SERVER_PID=$!
+sleep 3
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD
+kill -KILL $SERVER_PID
+cat tmp/server.log
+sleep 1
@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+def connect(server, port, user, password):
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return None
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return None
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return None
+	print "[OK] Receiving <hello> =%(reply_xml)s:" % {'reply_xml':reply_xml}
+	return conn
+
+def get_interface_names(conn):
+	result = conn.rpc("""
+<get-config>
+  <source>
+    <running/>
+  </source>
+</get-config>
+""")
+	data = result.xpath('//data')
+	assert(len(data)==1)
+	names = [name.text for name in result.xpath('//data/interfaces/interface/name')]
+	print names
+	return names
+
+# add or delete the rule permitting read access to /interfaces
+# in the candidate and commit
+def set_interfaces_read(conn, permit):
+	if(permit):
+		rule = """
+        <rule>
+          <name>interfaces-read</name>
+          <path xmlns:if="urn:ietf:params:xml:ns:yang:ietf-interfaces">/if:interfaces</path>
+          <access-operations>read</access-operations>
+          <action>permit</action>
+        </rule>
+"""
+	else:
+		rule = """
+        <rule nc:operation="delete">
+          <name>interfaces-read</name>
+        </rule>
+"""
+	edit_config_rpc = """
+<edit-config>
+    <target>
+      <candidate/>
+    </target>
+    <config>
+      <nacm xmlns="urn:ietf:params:xml:ns:yang:ietf-netconf-acm" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0">
+        <rule-list>
+          <name>test</name>
+%(rule)s
+        </rule-list>
+      </nacm>
+    </config>
+  </edit-config>
+""" % {'rule':rule}
+	result = conn.rpc(edit_config_rpc)
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+	result = conn.rpc("<commit/>")
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+def main():
+	print("""
+#Description: Verify sessions of the same user see /nacm changes made by each other.
+#Procedure:
+#1 - Open sessions A and B of the same user and verify both read /interfaces.
+#2 - Delete the /interfaces read rule on A and verify B no longer reads /interfaces.
+#3 - Add the rule back on A and verify B reads /interfaces.
+#4 - Close A and verify B still reads /interfaces.
+#5 - Delete the rule on B and verify B and a new session C no longer read /interfaces.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	print("#1 - Open sessions A and B of the same user and verify both read /interfaces.")
+	conn_a = connect(server, port, user, password)
+	if conn_a == None:
+		return(-1)
+	conn_b = connect(server, port, user, password)
+	if conn_b == None:
+		return(-1)
+	assert(get_interface_names(conn_a)==["eth0"])
+	assert(get_interface_names(conn_b)==["eth0"])
+
+	# the sessions share the user's cached NACM state, which
+	# must be rebuilt after any commit that changes /nacm
+	print("#2 - Delete the /interfaces read rule on A and verify B no longer reads /interfaces.")
+	set_interfaces_read(conn_a, False)
+	assert(get_interface_names(conn_b)==[])
+	assert(get_interface_names(conn_a)==[])
+
+	print("#3 - Add the rule back on A and verify B reads /interfaces.")
+	set_interfaces_read(conn_a, True)
+	assert(get_interface_names(conn_b)==["eth0"])
+
+	# closing A releases its reference to the shared state
+	print("#4 - Close A and verify B still reads /interfaces.")
+	result = conn_a.rpc("<close-session/>")
+	print result
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+	assert(get_interface_names(conn_b)==["eth0"])
+
+	print("#5 - Delete the rule on B and verify B and a new session C no longer read /interfaces.")
+	set_interfaces_read(conn_b, False)
+	assert(get_interface_names(conn_b)==[])
+	conn_c = connect(server, port, user, password)
+	if conn_c == None:
+		return(-1)
+	assert(get_interface_names(conn_c)==[])
+
+	return(0)
+
+sys.exit(main())
@@ -0,0 +1,45 @@
+#!/bin/bash -e
+
+if [ "$RUN_WITH_CONFD" != "" ] ; then
+    # skipped test return value
+    exit 77
+fi
+
+function start_server {
+  rm /tmp/ncxserver.sock || true
+  /usr/sbin/netconfd --module=iana-if-type --module=ietf-interfaces --startup=$PWD/tmp/startup-cfg.xml --nvstore-journal --superuser=$USER 2>&1 1>tmp/server-$1.log &
+  SERVER_PID=$!
+  sleep 3
+}
+
+function stop_server {
+  kill -KILL $SERVER_PID
+  cat tmp/server-$1.log
+  sleep 1
+}
+
+rm -rf tmp || true
+mkdir tmp
+cp startup-cfg.xml tmp/startup-cfg.xml
+killall -KILL netconfd || true
+
+start_server edit
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --step=edit
+stop_server edit
+
+start_server restart
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --step=restart --server-log=tmp/server-restart.log
+stop_server restart
+
+# append a record cut short by a crash in the middle of a write
+printf '<config xmlns="urn:ietf:params:xml:ns:netconf:base:1.0"><interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces"><interface><name>eth3</name>' >> tmp/startup-cfg.xml.journal
+start_server torn
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --step=torn --server-log=tmp/server-torn.log
+stop_server torn
+
+# replace the snapshot the journal was written for
+rm tmp/startup-cfg.xml
+cp startup-cfg-swapped.xml tmp/startup-cfg.xml
+start_server snapshot
+python session.litenc.py --server=$NCSERVER --port=$NCPORT --user=$NCUSER --password=$NCPASSWORD --step=snapshot --server-log=tmp/server-snapshot.log
+stop_server snapshot
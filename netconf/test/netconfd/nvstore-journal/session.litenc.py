@@ -0,0 +1,193 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+STARTUP="tmp/startup-cfg.xml"
+JOURNAL=STARTUP+".journal"
+RECORD_END="]]>]]>\n"
+
+def get_interfaces(conn):
+	result = conn.rpc("""
+<get-config>
+  <source>
+    <running/>
+  </source>
+</get-config>
+""")
+	interfaces={}
+	for interface in result.xpath('//data/interfaces/interface'):
+		description = interface.xpath('description')
+		if(len(description)==1):
+			interfaces[interface.xpath('name')[0].text]=description[0].text
+		else:
+			interfaces[interface.xpath('name')[0].text]=None
+	print interfaces
+	return interfaces
+
+def edit_commit(conn, config):
+	edit_config_rpc = """
+<edit-config>
+    <target>
+      <candidate/>
+    </target>
+    <default-operation>merge</default-operation>
+    <test-option>set</test-option>
+    <config>
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces" xmlns:ianaift="urn:ietf:params:xml:ns:yang:iana-if-type" xmlns:nc="urn:ietf:params:xml:ns:netconf:base:1.0">
+%(config)s
+      </interfaces>
+    </config>
+  </edit-config>
+""" % {'config':config}
+	print("edit-config ...")
+	result = conn.rpc(edit_config_rpc)
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+	print("commit ...")
+	result = conn.rpc("<commit/>")
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+def main():
+	print("""
+#Description: Test the --nvstore-journal running config journal.
+#Procedure:
+#1 - (--step=edit) Commit two edits and verify the last one is saved in the journal, not in the startup file.
+#2 - (--step=restart) Verify the running config is the same after a restart.
+#3 - (--step=torn) Verify a partial record at the end of the journal is dropped and the journal is truncated.
+#4 - (--step=snapshot) Verify a journal written for another startup file is ignored.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+	parser.add_argument("--step", help="edit, restart, torn or snapshot")
+	parser.add_argument("--server-log", help="log file of the server")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	if(args.server_log==None or args.server_log==""):
+		server_log=""
+	else:
+		server_log=open(args.server_log).read()
+
+
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return(-1)
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return(-1)
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return(-1)
+
+	print "[OK] Receiving <hello> =%(reply_xml)s:" % {'reply_xml':reply_xml}
+
+	expected={'eth0':'two', 'eth2':None}
+
+	if(args.step=="edit"):
+		print("#1 - Commit two edits and verify the last one is saved in the journal, not in the startup file.")
+		edit_commit(conn, """
+        <interface>
+          <name>eth0</name>
+          <type>ianaift:ethernetCsmacd</type>
+          <description>one</description>
+        </interface>
+        <interface>
+          <name>eth1</name>
+          <type>ianaift:ethernetCsmacd</type>
+        </interface>
+""")
+		edit_commit(conn, """
+        <interface>
+          <name>eth0</name>
+          <description>two</description>
+        </interface>
+        <interface nc:operation="delete">
+          <name>eth1</name>
+        </interface>
+        <interface>
+          <name>eth2</name>
+          <type>ianaift:ethernetCsmacd</type>
+        </interface>
+""")
+		assert(get_interfaces(conn)==expected)
+
+		# there is no journal yet at the first save, so it writes a new
+		# startup file; the second one is appended to the journal
+		journal=open(JOURNAL).read()
+		print journal
+		assert(journal.count(RECORD_END)==1)
+		assert(journal.endswith(RECORD_END))
+		assert(journal.find("eth2")>=0)
+		assert(open(STARTUP).read().find("eth2")<0)
+
+	elif(args.step=="restart"):
+		print("#2 - Verify the running config is the same after a restart.")
+		assert(get_interfaces(conn)==expected)
+		assert(server_log.find("NV-store journal records")>=0)
+
+	elif(args.step=="torn"):
+		print("#3 - Verify a partial record at the end of the journal is dropped and the journal is truncated.")
+		assert(get_interfaces(conn)==expected)
+		assert(server_log.find("Warning: dropping")>=0)
+		journal=open(JOURNAL).read()
+		print journal
+		assert(journal.count(RECORD_END)==1)
+		assert(journal.endswith(RECORD_END))
+		assert(journal.find("eth3")<0)
+
+	elif(args.step=="snapshot"):
+		print("#4 - Verify a journal written for another startup file is ignored.")
+		assert(get_interfaces(conn)=={'eth9':'swapped'})
+		assert(server_log.find("is not for the current snapshot")>=0)
+
+	else:
+		print("[FAILED] Unknown --step=%(step)s" % {'step':args.step})
+		return(-1)
+
+	return(0)
+
+sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python
+
+import time
+import sys, os
+sys.path.append("../../litenc")
+import litenc
+import litenc_lxml
+import lxml
+import argparse
+
+def get_config_xpath(conn, select):
+	get_config_rpc = """
+<get-config>
+  <source>
+    <candidate/>
+  </source>
+  <filter type="xpath" xmlns:if="urn:ietf:params:xml:ns:yang:ietf-interfaces" select="%(select)s"/>
+</get-config>
+""" % {'select':select}
+	start = time.time()
+	result = conn.rpc(get_config_rpc)
+	print("%(select)s: %(sec).2f sec" % {'select':select, 'sec':time.time() - start})
+	return result
+
+def main():
+	print("""
+#Description: Check and time XPath node-set steps over a synthetic list.
+#Procedure:
+#1 - Create N /interfaces/interface entries in the candidate.
+#2 - Run child, descendant, parent, sibling, ancestor and union
+#    steps over all entries and verify the number of nodes selected.
+#3 - Discard the changes.
+""")
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--server", help="server name e.g. 127.0.0.1 or server.com (127.0.0.1 if not specified)")
+	parser.add_argument("--user", help="username e.g. admin ($USER if not specified)")
+	parser.add_argument("--port", help="port e.g. 830 (830 if not specified)")
+	parser.add_argument("--password", help="password e.g. mypass123 (passwordless if not specified)")
+	parser.add_argument("--entries", help="number of list entries to create (100 if not specified)")
+
+	args = parser.parse_args()
+
+	if(args.server==None or args.server==""):
+		server="127.0.0.1"
+	else:
+		server=args.server
+
+	if(args.port==None or args.port==""):
+		port=830
+	else:
+		port=int(args.port)
+
+	if(args.user==None or args.user==""):
+		user=os.getenv('USER')
+	else:
+		user=args.user
+
+	if(args.password==None or args.password==""):
+		password=None
+	else:
+		password=args.password
+
+	if(args.entries==None or args.entries==""):
+		entries=100
+	else:
+		entries=int(args.entries)
+
+	conn_raw = litenc.litenc()
+	ret = conn_raw.connect(server=server, port=port, user=user, password=password)
+	if ret != 0:
+		print "[FAILED] Connecting to server=%(server)s:" % {'server':server}
+		return(-1)
+	print "[OK] Connecting to server=%(server)s:" % {'server':server}
+	conn=litenc_lxml.litenc_lxml(conn_raw)
+	ret = conn_raw.send("""
+<hello xmlns="urn:ietf:params:xml:ns:netconf:base:1.0">
+ <capabilities>
+  <capability>urn:ietf:params:netconf:base:1.0</capability>
+ </capabilities>
+</hello>
+""")
+	if ret != 0:
+		print("[FAILED] Sending <hello>")
+		return(-1)
+	(ret, reply_xml)=conn_raw.receive()
+	if ret != 0:
+		print("[FAILED] Receiving <hello>")
+		return(-1)
+
+	print("Connected ...")
+
+	print("#1 - Create %(entries)d /interfaces/interface entries in the candidate." % {'entries':entries})
+	interfaces = "".join(["""<interface><name>e%(i)07d</name><description>d%(d)d</description><type xmlns:ianaift="urn:ietf:params:xml:ns:yang:iana-if-type">ianaift:ethernetCsmacd</type></interface>""" % {'i':i, 'd':i%10} for i in range(entries)])
+	edit_config_rpc = """
+<edit-config>
+    <target>
+      <candidate/>
+    </target>
+    <config>
+      <interfaces xmlns="urn:ietf:params:xml:ns:yang:ietf-interfaces">
+%(interfaces)s
+      </interfaces>
+    </config>
+  </edit-config>
+""" % {'interfaces':interfaces}
+	result = conn.rpc(edit_config_rpc)
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+	print("#2 - Run node-set steps over all entries.")
+	result = get_config_xpath(conn, "/if:interfaces/if:interface/if:name")
+	assert(len(result.xpath('//interface/name'))==entries)
+
+	result = get_config_xpath(conn, "//if:name")
+	assert(len(result.xpath('//interface/name'))==entries)
+
+	result = get_config_xpath(conn, "/if:interfaces/if:interface/if:description/../if:name")
+	assert(len(result.xpath('//interface/name'))==entries)
+
+	result = get_config_xpath(conn, "/if:interfaces/if:interface[last()]/preceding-sibling::if:interface/if:name")
+	assert(len(result.xpath('//interface/name'))==entries-1)
+
+	result = get_config_xpath(conn, "//if:description/ancestor::if:interface/if:name")
+	assert(len(result.xpath('//interface/name'))==entries)
+
+	result = get_config_xpath(conn, "/if:interfaces/if:interface/if:name | /if:interfaces/if:interface[if:description='d1']/if:name")
+	assert(len(result.xpath('//interface/name'))==entries)
+
+	result = get_config_xpath(conn, "/if:interfaces/if:interface[%(pos)d]/if:name" % {'pos':entries})
+	name = result.xpath('//interface/name')
+	assert(len(name)==1)
+	assert(name[0].text=="e%(i)07d" % {'i':entries-1})
+
+	print("#3 - Discard the changes.")
+	result = conn.rpc("<discard-changes/>")
+	ok = result.xpath('//ok')
+	assert(len(ok)==1)
+
+sys.exit(main())